@@ -0,0 +1,134 @@
+// Compares one-message-per-sample publishing with batch mode
+// ({"batch": {"samples": N}} on a command topic).
+//
+// For each batch size it serializes representative samples with the
+// firmware serializer and reports the payload and wire bytes per sample and
+// the messages/s a node sends at the given sample period. Wire bytes count
+// the MQTT fixed header and topic plus 40 bytes of TCP/IP headers per
+// 1460-byte segment; TLS and broker-side fan-out are not included.
+//
+// Usage: batch_bench [--period MS] [--buffer BYTES]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "SensorData.h"
+#include "TelemetrySerializer.h"
+
+namespace {
+
+const size_t TOPIC_LENGTH = 26;          // "/home/sensors/240ac4123456"
+const size_t BATCH_TOPIC_LENGTH = 32;    // "/home/sensors/240ac4123456/batch"
+const size_t TCP_MSS = 1460;
+const size_t TCP_IP_HEADERS = 40;
+const int ITERATIONS = 2000;
+const uint32_t MAX_BATCH = 20;               // SampleStore::MAX_BATCH
+
+StoredSample makeSample(uint32_t i) {
+    StoredSample s;
+    memset(&s, 0, sizeof(s));
+    s.seq = 100000 + i;
+    s.timestamp = 1760000000 + 2 * i;
+    SensorData& d = s.data;
+    d.soilTemp = 21.37f + (i % 7) * 0.11f;
+    d.soilMoisture = 612 + i % 13;
+    d.airTemp = 23.4f;
+    d.humidity = 45.1f + (i % 5);
+    d.h2Value = 1834;
+    d.h2Voltage = 1.48f;
+    d.co2 = 612 + i % 40;
+    d.tvoc = 34;
+    d.targetCount = i % 2;
+    d.speed = 0.35f;
+    d.distance = 2.41f;
+    d.energy = 1200;
+    d.pm25 = 12.3f;
+    d.pm10 = 20.1f;
+    d.validMask = (1 << SENSOR_CHANNEL_COUNT) - 1;
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        d.ageDeciseconds[c] = (uint16_t)(10 + c);
+    }
+    return s;
+}
+
+// MQTT PUBLISH fixed header (1 byte + remaining length) and QoS 0 topic
+size_t mqttOverhead(size_t topicLength, size_t payloadLength) {
+    size_t remaining = 2 + topicLength + payloadLength;
+    size_t lengthBytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+    return 1 + lengthBytes + 2 + topicLength;
+}
+
+size_t wireBytes(size_t topicLength, size_t payloadLength) {
+    size_t message = payloadLength + mqttOverhead(topicLength, payloadLength);
+    size_t segments = (message + TCP_MSS - 1) / TCP_MSS;
+    return message + segments * TCP_IP_HEADERS;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    double periodMs = 2000;
+    size_t bufferSize = 4096 - 5 - 2 - 64;  // MQTTManager::MAX_PAYLOAD
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--period") == 0 && i + 1 < argc) {
+            periodMs = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--buffer") == 0 && i + 1 < argc) {
+            bufferSize = (size_t)atol(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--period MS] [--buffer BYTES]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<StoredSample> samples;
+    for (uint32_t i = 0; i < MAX_BATCH; i++) {
+        samples.push_back(makeSample(i));
+    }
+    std::vector<char> buffer(bufferSize);
+
+    // Bytes and encode time are per sample
+    printf("%-8s %8s %10s %10s %10s %12s\n",
+        "mode", "samples", "payload B", "wire B", "msgs/s", "encode us");
+
+    // Single-sample mode, as published on the live topic
+    {
+        size_t payload = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int it = 0; it < ITERATIONS; it++) {
+            payload = TelemetrySerializer::serialize(samples[it % samples.size()],
+                buffer.data(), buffer.size());
+        }
+        double us = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+        printf("%-8s %8d %10zu %10zu %10.3f %12.2f\n", "single", 1, payload,
+            wireBytes(TOPIC_LENGTH, payload), 1000.0 / periodMs, us);
+    }
+
+    const size_t sizes[] = { 2, 4, 6, 8, 10, 12, 16, 20 };
+    for (size_t n : sizes) {
+        size_t included = 0;
+        size_t payload = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int it = 0; it < ITERATIONS; it++) {
+            payload = TelemetrySerializer::serializeBatch(samples.data(), n,
+                buffer.data(), buffer.size(), included);
+        }
+        double us = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+        if (included == 0) {
+            continue;
+        }
+        printf("%-8s %8zu %10zu %10zu %10.3f %12.2f%s\n", "batch", included,
+            payload / included, wireBytes(BATCH_TOPIC_LENGTH, payload) / included,
+            1000.0 / (periodMs * included), us / included,
+            included < n ? "  (buffer full)" : "");
+        if (included < n) {
+            break;
+        }
+    }
+    return 0;
+}
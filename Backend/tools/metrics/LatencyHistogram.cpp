@@ -0,0 +1,70 @@
+#include "LatencyHistogram.h"
+#include <string.h>
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::reset() {
+    memset(counts, 0, sizeof(counts));
+    total = 0;
+    sum = 0;
+    largest = 0;
+}
+
+int LatencyHistogram::bucketOf(uint64_t value) {
+    if (value < (uint64_t)SUB_BUCKETS) {
+        return (int)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS + (int)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t LatencyHistogram::bucketTop(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return low + ((uint64_t)1 << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+    counts[bucketOf(micros)]++;
+    total++;
+    sum += micros;
+    if (micros > largest) {
+        largest = micros;
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (int i = 0; i < BUCKETS; i++) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    if (other.largest > largest) {
+        largest = other.largest;
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(p * total);
+    if (rank >= total) {
+        rank = total - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen > rank) {
+            uint64_t top = bucketTop(i);
+            return top < largest ? top : largest;
+        }
+    }
+    return largest;
+}
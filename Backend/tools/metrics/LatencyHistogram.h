@@ -0,0 +1,40 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-size log-linear histogram of microsecond latencies: 32 linear
+// sub-buckets per power of two, so percentiles are within about 3% from
+// 1 us to days, and recording never allocates. Not thread-safe; keep one per
+// thread and merge() them afterwards.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t micros);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return largest; }
+    double mean() const { return total ? (double)sum / total : 0.0; }
+
+    // Value at or below which a fraction p (0..1) of the samples fall
+    uint64_t percentile(double p) const;
+
+private:
+    static const int SUB_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    static int bucketOf(uint64_t value);
+    static uint64_t bucketTop(int bucket);
+
+    uint64_t counts[BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t largest;
+};
+
+#endif
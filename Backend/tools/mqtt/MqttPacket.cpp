@@ -0,0 +1,213 @@
+#include "MqttPacket.h"
+#include <string.h>
+
+namespace {
+
+class PacketWriter {
+private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t pos;
+    bool overflow;
+
+public:
+    PacketWriter(uint8_t* buf, size_t size) : buffer(buf), capacity(size), pos(0), overflow(false) {}
+
+    void byte(uint8_t b) {
+        if (pos >= capacity) {
+            overflow = true;
+            return;
+        }
+        buffer[pos++] = b;
+    }
+
+    void u16(uint16_t v) {
+        byte(v >> 8);
+        byte(v & 0xFF);
+    }
+
+    void bytes(const void* data, size_t length) {
+        if (overflow || length > capacity - pos) {
+            overflow = true;
+            return;
+        }
+        memcpy(buffer + pos, data, length);
+        pos += length;
+    }
+
+    // UTF-8 string with its 2-byte length prefix
+    void string(const char* s) {
+        size_t length = strlen(s);
+        if (length > 0xFFFF) {
+            overflow = true;
+            return;
+        }
+        u16((uint16_t)length);
+        bytes(s, length);
+    }
+
+    void fixedHeader(MqttType type, uint8_t flags, size_t remaining) {
+        if (remaining > MqttPacket::MAX_REMAINING) {
+            overflow = true;
+            return;
+        }
+        byte((uint8_t)type << 4 | flags);
+        do {
+            uint8_t digit = remaining & 0x7F;
+            remaining >>= 7;
+            byte(remaining > 0 ? digit | 0x80 : digit);
+        } while (remaining > 0);
+    }
+
+    size_t length() const { return overflow ? 0 : pos; }
+};
+
+size_t stringLength(const char* s) {
+    return 2 + strlen(s);
+}
+
+}  // namespace
+
+size_t MqttPacket::connect(uint8_t* buffer, size_t size, const char* clientId, uint16_t keepAliveSeconds,
+                           bool cleanSession, const MqttWill* will) {
+    size_t remaining = stringLength("MQTT") + 1 + 1 + 2 + stringLength(clientId);
+    uint8_t flags = cleanSession ? 0x02 : 0;
+    if (will != nullptr) {
+        remaining += stringLength(will->topic) + stringLength(will->payload);
+        flags |= 0x04 | (will->qos & 3) << 3 | (will->retain ? 0x20 : 0);
+    }
+
+    PacketWriter out(buffer, size);
+    out.fixedHeader(MqttType::Connect, 0, remaining);
+    out.string("MQTT");
+    out.byte(4);    // protocol level 3.1.1
+    out.byte(flags);
+    out.u16(keepAliveSeconds);
+    out.string(clientId);
+    if (will != nullptr) {
+        out.string(will->topic);
+        out.string(will->payload);
+    }
+    return out.length();
+}
+
+size_t MqttPacket::publishHeader(uint8_t* buffer, size_t size, const char* topic, size_t payloadLength,
+                                 uint8_t qos, bool retain, uint16_t packetId) {
+    size_t remaining = stringLength(topic) + (qos > 0 ? 2 : 0) + payloadLength;
+    PacketWriter out(buffer, size);
+    out.fixedHeader(MqttType::Publish, (qos & 3) << 1 | (retain ? 1 : 0), remaining);
+    out.string(topic);
+    if (qos > 0) {
+        out.u16(packetId);
+    }
+    return out.length();
+}
+
+size_t MqttPacket::publish(uint8_t* buffer, size_t size, const char* topic, const void* payload,
+                           size_t payloadLength, uint8_t qos, bool retain, uint16_t packetId) {
+    size_t header = publishHeader(buffer, size, topic, payloadLength, qos, retain, packetId);
+    if (header == 0 || payloadLength > size - header) {
+        return 0;
+    }
+    memcpy(buffer + header, payload, payloadLength);
+    return header + payloadLength;
+}
+
+size_t MqttPacket::subscribe(uint8_t* buffer, size_t size, uint16_t packetId, const char* topic, uint8_t qos) {
+    PacketWriter out(buffer, size);
+    out.fixedHeader(MqttType::Subscribe, 0x02, 2 + stringLength(topic) + 1);
+    out.u16(packetId);
+    out.string(topic);
+    out.byte(qos & 3);
+    return out.length();
+}
+
+size_t MqttPacket::puback(uint8_t* buffer, size_t size, uint16_t packetId) {
+    PacketWriter out(buffer, size);
+    out.fixedHeader(MqttType::Puback, 0, 2);
+    out.u16(packetId);
+    return out.length();
+}
+
+size_t MqttPacket::pingreq(uint8_t* buffer, size_t size) {
+    PacketWriter out(buffer, size);
+    out.fixedHeader(MqttType::Pingreq, 0, 0);
+    return out.length();
+}
+
+size_t MqttPacket::disconnect(uint8_t* buffer, size_t size) {
+    PacketWriter out(buffer, size);
+    out.fixedHeader(MqttType::Disconnect, 0, 0);
+    return out.length();
+}
+
+int MqttPacket::parse(const uint8_t* data, size_t length, MqttFrame& frame) {
+    if (length < 2) {
+        return 0;
+    }
+    size_t remaining = 0;
+    size_t pos = 1;
+    for (int shift = 0;; shift += 7) {
+        if (shift > 21) {
+            return -1;      // more than 4 length bytes
+        }
+        if (pos >= length) {
+            return 0;
+        }
+        uint8_t digit = data[pos++];
+        remaining |= (size_t)(digit & 0x7F) << shift;
+        if ((digit & 0x80) == 0) {
+            break;
+        }
+    }
+    uint8_t type = data[0] >> 4;
+    if (type == 0 || type == 15) {
+        return -1;
+    }
+    if (length - pos < remaining) {
+        return 0;
+    }
+    frame.type = (MqttType)type;
+    frame.flags = data[0] & 0x0F;
+    frame.body = data + pos;
+    frame.bodyLength = remaining;
+    frame.frameLength = pos + remaining;
+    return 1;
+}
+
+bool MqttPacket::parsePublish(const MqttFrame& frame, MqttPublish& publish) {
+    if (frame.type != MqttType::Publish || frame.bodyLength < 2) {
+        return false;
+    }
+    const uint8_t* p = frame.body;
+    size_t topicLength = (size_t)p[0] << 8 | p[1];
+    size_t header = 2 + topicLength;
+    publish.qos = (frame.flags >> 1) & 3;
+    publish.retain = (frame.flags & 1) != 0;
+    if (publish.qos > 0) {
+        header += 2;
+    }
+    if (header > frame.bodyLength) {
+        return false;
+    }
+    publish.topic = reinterpret_cast<const char*>(p + 2);
+    publish.topicLength = topicLength;
+    publish.packetId = publish.qos > 0 ? (uint16_t)(p[2 + topicLength] << 8 | p[3 + topicLength]) : 0;
+    publish.payload = p + header;
+    publish.payloadLength = frame.bodyLength - header;
+    return true;
+}
+
+uint16_t MqttPacket::packetId(const MqttFrame& frame) {
+    if (frame.bodyLength < 2) {
+        return 0;
+    }
+    return (uint16_t)(frame.body[0] << 8 | frame.body[1]);
+}
+
+int MqttPacket::connackCode(const MqttFrame& frame) {
+    if (frame.type != MqttType::Connack || frame.bodyLength < 2) {
+        return -1;
+    }
+    return frame.body[1];
+}
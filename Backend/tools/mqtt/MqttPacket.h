@@ -0,0 +1,87 @@
+#ifndef MQTT_PACKET_H
+#define MQTT_PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// MQTT 3.1.1 packets for the host tools: the client side of what
+// PubSubClient speaks on the nodes, plus QoS 1 acknowledgements.
+//
+// Encoders write into a caller buffer and return the packet length, or 0 if
+// it does not fit. The decoder never copies: frames and publishes point into
+// the receive buffer and are valid until it is compacted.
+
+enum class MqttType : uint8_t {
+    Connect = 1,
+    Connack = 2,
+    Publish = 3,
+    Puback = 4,
+    Subscribe = 8,
+    Suback = 9,
+    Pingreq = 12,
+    Pingresp = 13,
+    Disconnect = 14
+};
+
+struct MqttWill {
+    const char* topic;
+    const char* payload;
+    uint8_t qos;
+    bool retain;
+};
+
+struct MqttFrame {
+    MqttType type;
+    uint8_t flags;            // low nibble of the fixed header
+    const uint8_t* body;      // variable header and payload
+    size_t bodyLength;
+    size_t frameLength;       // fixed header included
+};
+
+struct MqttPublish {
+    const char* topic;        // not NUL-terminated
+    size_t topicLength;
+    const uint8_t* payload;
+    size_t payloadLength;
+    uint16_t packetId;        // 0 for QoS 0
+    uint8_t qos;
+    bool retain;
+};
+
+class MqttPacket {
+public:
+    // Largest remaining length the 4-byte length field can express
+    static const size_t MAX_REMAINING = 268435455;
+
+    // will may be nullptr
+    static size_t connect(uint8_t* buffer, size_t size, const char* clientId, uint16_t keepAliveSeconds,
+                          bool cleanSession, const MqttWill* will);
+
+    // Fixed header, topic and packet id of a PUBLISH whose payload the
+    // caller appends; returns the header length
+    static size_t publishHeader(uint8_t* buffer, size_t size, const char* topic, size_t payloadLength,
+                                uint8_t qos, bool retain, uint16_t packetId);
+
+    // Whole PUBLISH with the payload copied in
+    static size_t publish(uint8_t* buffer, size_t size, const char* topic, const void* payload,
+                          size_t payloadLength, uint8_t qos, bool retain, uint16_t packetId);
+
+    static size_t subscribe(uint8_t* buffer, size_t size, uint16_t packetId, const char* topic, uint8_t qos);
+    static size_t puback(uint8_t* buffer, size_t size, uint16_t packetId);
+    static size_t pingreq(uint8_t* buffer, size_t size);
+    static size_t disconnect(uint8_t* buffer, size_t size);
+
+    // Looks for one frame at the start of data. Returns 1 and fills frame
+    // when a whole frame is there, 0 if more bytes are needed, -1 if the
+    // fixed header is malformed.
+    static int parse(const uint8_t* data, size_t length, MqttFrame& frame);
+
+    // Splits a PUBLISH frame; false if it is truncated
+    static bool parsePublish(const MqttFrame& frame, MqttPublish& publish);
+
+    // Packet id of a PUBACK or SUBACK, CONNACK return code, 0 if malformed
+    static uint16_t packetId(const MqttFrame& frame);
+    static int connackCode(const MqttFrame& frame);
+};
+
+#endif
@@ -0,0 +1,797 @@
+// Ingest bridge: subscribes to the garden telemetry topics and writes every
+// sample to InfluxDB 1.8 as line protocol, in place of the Node-RED flow.
+//
+// Payloads are parsed in the receive buffer (TelemetryParser) and formatted
+// straight into the current write batch, so a message costs no allocation.
+// A batch is sent when it reaches --batch-lines or --batch-kb, or when its
+// oldest line is --flush-ms old. Batches come from a fixed pool of
+// --buffers, which bounds memory: when InfluxDB is slow or down the pool
+// fills up, and then either the bridge stops reading from the broker
+// (--overflow block, the default; with the QoS 1 persistent session the
+// broker queues for us) or the oldest unsent batch is dropped
+// (--overflow drop). Failed writes are retried with backoff; InfluxDB
+// overwrites points with the same series and time, so a retried batch never
+// duplicates data.
+//
+// Each node publishes under /home/sensors/<device id>, so the default
+// subscriptions are wildcards and every point is tagged device=<id> (ahead
+// of any --tags); without it, points from different nodes with the same
+// timestamp would overwrite each other.
+//
+// Every --report seconds it prints ingest and write rates, queue depth and
+// lag, and writes the same figures to InfluxDB as the garden_ingest
+// measurement. Pipeline lag runs from receiving a message to InfluxDB
+// accepting its batch; end-to-end lag runs from the sample's own timestamp
+// (whole seconds, so it includes time spent queued on the node).
+//
+// Usage: mqtt_influx [--mqtt HOST[:PORT]] [--influx HOST[:PORT]] [--db NAME]
+//                    [--measurement NAME] [--tags k=v,...] [--topic T]...
+//                    [--client-id ID] [--qos 0|1] [--batch-lines N]
+//                    [--batch-kb N] [--flush-ms MS] [--buffers N]
+//                    [--overflow block|drop] [--report S]
+
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SensorData.h"
+#include "metrics/LatencyHistogram.h"
+#include "mqtt/MqttPacket.h"
+#include "net/HttpClient.h"
+#include "net/Tcp.h"
+#include "telemetry/LineProtocol.h"
+#include "telemetry/TelemetryParser.h"
+
+namespace {
+
+const size_t MAX_LINE = 1024;
+const size_t MAX_MESSAGE = 1 << 20;      // larger publishes drop the connection
+const uint16_t KEEP_ALIVE = 30;          // s
+const int HTTP_TIMEOUT = 10000;          // ms
+const int MAX_BACKOFF = 5000;            // ms between failed writes
+const char* TOPIC_ROOT = "/home/sensors/";
+const char* FLEET_COMMAND_TOPIC = "/home/sensors/command";  // also matches /home/sensors/+
+const size_t MAX_TAGS = 256;
+
+struct Options {
+    std::string mqttHost = "127.0.0.1";
+    uint16_t mqttPort = 1883;
+    std::string influxHost = "127.0.0.1";
+    uint16_t influxPort = 8086;
+    const char* database = "garden";
+    const char* measurement = "garden";
+    const char* tags = nullptr;
+    std::vector<const char*> topics;
+    const char* clientId = "garden-ingest";
+    uint8_t qos = 1;
+    uint32_t batchLines = 5000;
+    size_t batchBytes = 512 * 1024;
+    double flushMs = 1000;
+    uint32_t buffers = 8;
+    bool dropOnOverflow = false;
+    double report = 10;
+};
+
+Options options;
+std::atomic<bool> stopping(false);
+
+typedef std::chrono::steady_clock Clock;
+Clock::time_point startTime;
+
+uint64_t nowMicros() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startTime).count();
+}
+
+uint64_t wallMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void add(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+    counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+struct Counters {
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> malformed{0};
+    std::atomic<uint64_t> points{0};          // formatted into a batch
+    std::atomic<uint64_t> written{0};         // accepted by InfluxDB
+    std::atomic<uint64_t> rejected{0};        // refused by InfluxDB (4xx)
+    std::atomic<uint64_t> dropped{0};         // discarded on overflow
+    std::atomic<uint64_t> writes{0};
+    std::atomic<uint64_t> writeFailures{0};
+    std::atomic<uint64_t> blockedMicros{0};   // reader waiting for a free batch
+    std::atomic<uint64_t> blockedSince{0};    // start of the current wait, 0 if none
+    std::atomic<uint64_t> mqttConnects{0};
+};
+
+Counters counters;
+
+// ---- Write batches ----
+
+struct Batch {
+    std::vector<char> text;            // preallocated, options.batchBytes
+    size_t length = 0;
+    uint32_t lines = 0;
+    std::vector<uint64_t> received;    // per line: nowMicros() on arrival
+    std::vector<uint32_t> sampleTime;  // per line: sample Unix seconds, 0 if unknown
+    uint64_t opened = 0;
+
+    void clear() {
+        length = 0;
+        lines = 0;
+    }
+
+    bool append(const char* line, size_t lineLength, uint64_t at, uint32_t timestamp) {
+        if (lines >= received.size() || length + lineLength + 1 > text.size()) {
+            return false;
+        }
+        if (lines == 0) {
+            opened = at;
+        }
+        memcpy(text.data() + length, line, lineLength);
+        length += lineLength;
+        text[length++] = '\n';
+        received[lines] = at;
+        sampleTime[lines] = timestamp;
+        lines++;
+        return true;
+    }
+};
+
+// Fixed pool: free batches for the reader, full ones in send order for the
+// writer. Nothing is allocated after construction.
+class BatchPool {
+public:
+    explicit BatchPool(uint32_t count) : batches(count), ready(count), head(0), queued(0) {
+        for (Batch& batch : batches) {
+            batch.text.resize(options.batchBytes);
+            batch.received.resize(options.batchLines);
+            batch.sampleTime.resize(options.batchLines);
+            free.push_back(&batch);
+        }
+    }
+
+    // A free batch, waiting up to waitMillis; nullptr on timeout
+    Batch* acquire(int waitMillis) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!changed.wait_for(lock, std::chrono::milliseconds(waitMillis), [this] { return !free.empty(); })) {
+            return nullptr;
+        }
+        Batch* batch = free.back();
+        free.pop_back();
+        batch->clear();
+        return batch;
+    }
+
+    // With --overflow drop: recycle the oldest batch still waiting to be sent
+    Batch* takeOldest() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queued == 0) {
+            return nullptr;
+        }
+        Batch* batch = ready[head];
+        head = (head + 1) % ready.size();
+        queued--;
+        add(counters.dropped, batch->lines);
+        batch->clear();
+        return batch;
+    }
+
+    void submit(Batch* batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready[(head + queued) % ready.size()] = batch;
+        queued++;
+        changed.notify_all();
+    }
+
+    // Next batch to send, oldest first; nullptr if none is queued within
+    // waitMillis
+    Batch* next(int waitMillis) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait_for(lock, std::chrono::milliseconds(waitMillis), [this] { return queued > 0; });
+        if (queued == 0) {
+            return nullptr;
+        }
+        Batch* batch = ready[head];
+        head = (head + 1) % ready.size();
+        queued--;
+        return batch;
+    }
+
+    void release(Batch* batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        free.push_back(batch);
+        changed.notify_all();
+    }
+
+    uint32_t queuedCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queued;
+    }
+
+private:
+    std::vector<Batch> batches;
+    std::vector<Batch*> free;
+    std::vector<Batch*> ready;    // ring of queued batches
+    size_t head;
+    uint32_t queued;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+// Lag histograms, filled by the writer and read by the reporter
+struct LagStats {
+    std::mutex mutex;
+    LatencyHistogram pipeline;       // receive -> accepted
+    LatencyHistogram endToEnd;       // sample timestamp -> accepted
+};
+
+LagStats lagStats;
+
+// Self-metrics line handed from the reporter to the reader
+std::mutex metricsMutex;
+std::string pendingMetrics;
+
+// ---- Reader: MQTT subscription into batches ----
+
+class Reader {
+public:
+    explicit Reader(BatchPool& pool) : pool(pool), fd(-1), current(nullptr), lastSent(0) {
+        buffer.resize(64 * 1024);
+        outbound.reserve(4096);
+    }
+
+    void run() {
+        current = pool.acquire(1000);
+        while (!stopping) {
+            if (!connect()) {
+                sleepInterruptible(2000);
+                continue;
+            }
+            readLoop();
+            close(fd);
+            fd = -1;
+        }
+        if (current != nullptr && current->lines > 0) {
+            pool.submit(current);
+        } else if (current != nullptr) {
+            pool.release(current);
+        }
+    }
+
+private:
+    BatchPool& pool;
+    int fd;
+    Batch* current;
+    std::vector<uint8_t> buffer;
+    std::vector<uint8_t> outbound;
+    uint64_t lastSent;
+    uint64_t arrival;
+    char line[MAX_LINE];
+    char messageTags[MAX_TAGS];
+    const char* tags = nullptr;    // for the message being parsed
+
+    static void sleepInterruptible(int millis) {
+        for (int waited = 0; waited < millis && !stopping; waited += 100) {
+            usleep(100000);
+        }
+    }
+
+    bool connect() {
+        sockaddr_storage address;
+        socklen_t length;
+        if (!Tcp::resolve(options.mqttHost.c_str(), options.mqttPort, address, length)) {
+            fprintf(stderr, "mqtt: cannot resolve %s\n", options.mqttHost.c_str());
+            return false;
+        }
+        fd = Tcp::open(address, length, false);
+        if (fd < 0) {
+            fprintf(stderr, "mqtt: connect to %s:%u failed: %s\n", options.mqttHost.c_str(),
+                    (unsigned)options.mqttPort, strerror(errno));
+            return false;
+        }
+        Tcp::setReceiveTimeout(fd, 100);
+        Tcp::setSendTimeout(fd, 5000);
+
+        // Persistent session: with QoS 1 the broker keeps our messages
+        // while we are disconnected or holding back
+        uint8_t packet[512];
+        size_t n = MqttPacket::connect(packet, sizeof(packet), options.clientId, KEEP_ALIVE,
+                                       options.qos == 0, nullptr);
+        outbound.assign(packet, packet + n);
+        uint16_t packetId = 1;
+        for (const char* topic : options.topics) {
+            n = MqttPacket::subscribe(packet, sizeof(packet), packetId++, topic, options.qos);
+            outbound.insert(outbound.end(), packet, packet + n);
+        }
+        if (!flush()) {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        add(counters.mqttConnects);
+        fprintf(stderr, "mqtt: connected to %s:%u\n", options.mqttHost.c_str(), (unsigned)options.mqttPort);
+        return true;
+    }
+
+    bool flush() {
+        size_t pos = 0;
+        while (pos < outbound.size()) {
+            ssize_t n = send(fd, outbound.data() + pos, outbound.size() - pos, 0);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            pos += n;
+        }
+        outbound.clear();
+        lastSent = nowMicros();
+        return true;
+    }
+
+    bool ping() {
+        if (nowMicros() - lastSent < KEEP_ALIVE * 500000ull) {
+            return true;
+        }
+        uint8_t packet[2];
+        size_t n = MqttPacket::pingreq(packet, sizeof(packet));
+        outbound.insert(outbound.end(), packet, packet + n);
+        return flush();
+    }
+
+    void readLoop() {
+        size_t length = 0;
+        while (!stopping) {
+            ssize_t n = recv(fd, buffer.data() + length, buffer.size() - length, 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                fprintf(stderr, "mqtt: connection lost\n");
+                return;
+            }
+            arrival = nowMicros();
+            if (n > 0) {
+                length += n;
+                size_t pos = 0;
+                MqttFrame frame;
+                int result;
+                while ((result = MqttPacket::parse(buffer.data() + pos, length - pos, frame)) == 1) {
+                    if (!handleFrame(frame)) {
+                        return;
+                    }
+                    pos += frame.frameLength;
+                }
+                if (result < 0) {
+                    fprintf(stderr, "mqtt: malformed packet\n");
+                    return;
+                }
+                memmove(buffer.data(), buffer.data() + pos, length - pos);
+                length -= pos;
+                if (length == buffer.size()) {
+                    if (buffer.size() >= MAX_MESSAGE) {
+                        fprintf(stderr, "mqtt: message larger than %zu bytes\n", MAX_MESSAGE);
+                        return;
+                    }
+                    buffer.resize(buffer.size() * 2);
+                }
+            }
+
+            appendMetrics();
+            if (current != nullptr && current->lines > 0 &&
+                arrival - current->opened >= (uint64_t)(options.flushMs * 1000)) {
+                rotate();
+            }
+            if (!outbound.empty() && !flush()) {
+                return;
+            }
+            if (!ping()) {
+                return;
+            }
+        }
+    }
+
+    bool handleFrame(const MqttFrame& frame) {
+        if (frame.type == MqttType::Connack) {
+            int code = MqttPacket::connackCode(frame);
+            if (code != 0) {
+                fprintf(stderr, "mqtt: connection refused (%d)\n", code);
+                return false;
+            }
+            return true;
+        }
+        if (frame.type != MqttType::Publish) {
+            return true;
+        }
+
+        MqttPublish publish;
+        if (!MqttPacket::parsePublish(frame, publish)) {
+            add(counters.malformed);
+            return true;
+        }
+        size_t commandLength = strlen(FLEET_COMMAND_TOPIC);
+        bool command = publish.topicLength == commandLength &&
+                       memcmp(publish.topic, FLEET_COMMAND_TOPIC, commandLength) == 0;
+        if (!command) {
+            add(counters.messages);
+            tags = deviceTags(publish);
+            int samples = TelemetryParser::parsePayload(reinterpret_cast<const char*>(publish.payload),
+                                                        publish.payloadLength, onSample, this);
+            if (samples < 0) {
+                add(counters.malformed);
+            }
+        }
+        // Acknowledged once the points sit in a batch: delivery is at least
+        // once up to here, and the pool bounds what a crash can lose
+        if (publish.qos == 1) {
+            uint8_t packet[4];
+            size_t n = MqttPacket::puback(packet, sizeof(packet), publish.packetId);
+            outbound.insert(outbound.end(), packet, packet + n);
+        }
+        return true;
+    }
+
+    // "device=<id>" from "/home/sensors/<id>[/...]", followed by --tags
+    const char* deviceTags(const MqttPublish& publish) {
+        size_t rootLength = strlen(TOPIC_ROOT);
+        if (publish.topicLength <= rootLength || memcmp(publish.topic, TOPIC_ROOT, rootLength) != 0) {
+            return options.tags;
+        }
+        const char* id = publish.topic + rootLength;
+        size_t idLength = 0;
+        while (rootLength + idLength < publish.topicLength && id[idLength] != '/') {
+            // Anything that would need escaping is not a device ID
+            if (!isalnum((unsigned char)id[idLength]) && id[idLength] != '-' && id[idLength] != '_') {
+                return options.tags;
+            }
+            idLength++;
+        }
+        int n = snprintf(messageTags, sizeof(messageTags), "device=%.*s%s%s", (int)idLength, id,
+                         options.tags ? "," : "", options.tags ? options.tags : "");
+        return n > 0 && (size_t)n < sizeof(messageTags) ? messageTags : options.tags;
+    }
+
+    static void onSample(const ParsedSample& sample, void* context) {
+        static_cast<Reader*>(context)->addSample(sample);
+    }
+
+    void addSample(const ParsedSample& sample) {
+        // Samples taken before the node had NTP time are stamped on arrival
+        int64_t timestampNs = sample.timestamp > 0
+            ? (int64_t)sample.timestamp * 1000000000
+            : (int64_t)wallMicros() * 1000;
+        size_t length = LineProtocol::format(sample.data, options.measurement, tags, timestampNs,
+                                             line, sizeof(line), sample.fieldMask);
+        if (length == 0) {
+            return;
+        }
+        appendLine(line, length, sample.timestamp);
+        add(counters.points);
+    }
+
+    void appendLine(const char* text, size_t length, uint32_t timestamp) {
+        while (current == nullptr || !current->append(text, length, arrival, timestamp)) {
+            if (current != nullptr && current->lines == 0) {
+                return;     // longer than a whole batch
+            }
+            rotate();
+        }
+    }
+
+    // Queues the current batch and takes a fresh one. Blocks while the pool
+    // is exhausted (or recycles the oldest queued batch with --overflow drop).
+    void rotate() {
+        if (current != nullptr) {
+            pool.submit(current);
+            current = nullptr;
+        }
+        uint64_t blockedSince = nowMicros();
+        counters.blockedSince = blockedSince;
+        while (current == nullptr) {
+            current = pool.acquire(options.dropOnOverflow ? 0 : 1000);
+            if (current == nullptr && options.dropOnOverflow) {
+                current = pool.takeOldest();
+            }
+            if (current == nullptr && (stopping || !ping())) {
+                break;
+            }
+        }
+        add(counters.blockedMicros, nowMicros() - blockedSince);
+        counters.blockedSince = 0;
+    }
+
+    void appendMetrics() {
+        std::string metrics;
+        {
+            std::lock_guard<std::mutex> lock(metricsMutex);
+            if (pendingMetrics.empty()) {
+                return;
+            }
+            metrics.swap(pendingMetrics);
+        }
+        appendLine(metrics.data(), metrics.size(), 0);
+    }
+};
+
+// ---- Writer: batches to InfluxDB ----
+
+class Writer {
+public:
+    explicit Writer(BatchPool& pool) : pool(pool), http(options.influxHost.c_str(), options.influxPort) {
+        snprintf(path, sizeof(path), "/write?db=%s", options.database);
+    }
+
+    // Runs until stopped and everything queued is written or given up
+    void run(std::atomic<bool>& readerDone) {
+        int backoff = 100;
+        Batch* batch = nullptr;
+        for (;;) {
+            if (batch == nullptr) {
+                batch = pool.next(100);
+                if (batch == nullptr) {
+                    if (readerDone) {
+                        return;
+                    }
+                    continue;
+                }
+            }
+
+            int status = http.post(path, "text/plain; charset=utf-8", batch->text.data(), batch->length,
+                                   HTTP_TIMEOUT);
+            add(counters.writes);
+            if (status >= 200 && status < 300) {
+                recordLag(*batch);
+                add(counters.written, batch->lines);
+            } else if (status >= 400 && status < 500 && status != 408 && status != 429) {
+                // The data itself was refused; resending will not help
+                fprintf(stderr, "influx: write rejected (%d): %s\n", status, http.responseBody().c_str());
+                add(counters.rejected, batch->lines);
+            } else {
+                add(counters.writeFailures);
+                if (status < 0) {
+                    fprintf(stderr, "influx: %s:%u unreachable, retrying in %d ms\n",
+                            options.influxHost.c_str(), (unsigned)options.influxPort, backoff);
+                } else {
+                    fprintf(stderr, "influx: write failed (%d), retrying in %d ms\n", status, backoff);
+                }
+                if (readerDone && backoff >= MAX_BACKOFF) {
+                    add(counters.dropped, batch->lines);
+                    pool.release(batch);
+                    batch = nullptr;
+                    continue;
+                }
+                usleep(backoff * 1000);
+                backoff = std::min(backoff * 2, MAX_BACKOFF);
+                continue;
+            }
+            backoff = 100;
+            pool.release(batch);
+            batch = nullptr;
+        }
+    }
+
+private:
+    BatchPool& pool;
+    HttpClient http;
+    char path[256];
+
+    void recordLag(const Batch& batch) {
+        uint64_t now = nowMicros();
+        uint64_t wall = wallMicros();
+        std::lock_guard<std::mutex> lock(lagStats.mutex);
+        for (uint32_t i = 0; i < batch.lines; i++) {
+            lagStats.pipeline.record(now - batch.received[i]);
+            if (batch.sampleTime[i] != 0) {
+                uint64_t sampled = (uint64_t)batch.sampleTime[i] * 1000000;
+                lagStats.endToEnd.record(wall > sampled ? wall - sampled : 0);
+            }
+        }
+    }
+};
+
+// ---- Setup and reporting ----
+
+bool parseHostPort(const char* text, std::string& host, uint16_t& port) {
+    const char* colon = strrchr(text, ':');
+    if (colon == nullptr) {
+        host = text;
+        return true;
+    }
+    host.assign(text, colon - text);
+    long value = strtol(colon + 1, nullptr, 10);
+    if (value <= 0 || value > 65535) {
+        return false;
+    }
+    port = (uint16_t)value;
+    return true;
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [--mqtt HOST[:PORT]] [--influx HOST[:PORT]] [--db NAME]\n"
+            "          [--measurement NAME] [--tags k=v,...] [--topic T]...\n"
+            "          [--client-id ID] [--qos 0|1] [--batch-lines N]\n"
+            "          [--batch-kb N] [--flush-ms MS] [--buffers N]\n"
+            "          [--overflow block|drop] [--report S]\n",
+            program);
+}
+
+void onSignal(int) {
+    stopping = true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--mqtt") == 0 && hasValue) {
+            if (!parseHostPort(argv[++i], options.mqttHost, options.mqttPort)) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (strcmp(arg, "--influx") == 0 && hasValue) {
+            if (!parseHostPort(argv[++i], options.influxHost, options.influxPort)) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (strcmp(arg, "--db") == 0 && hasValue) {
+            options.database = argv[++i];
+        } else if (strcmp(arg, "--measurement") == 0 && hasValue) {
+            options.measurement = argv[++i];
+        } else if (strcmp(arg, "--tags") == 0 && hasValue) {
+            options.tags = argv[++i];
+        } else if (strcmp(arg, "--topic") == 0 && hasValue) {
+            options.topics.push_back(argv[++i]);
+        } else if (strcmp(arg, "--client-id") == 0 && hasValue) {
+            options.clientId = argv[++i];
+        } else if (strcmp(arg, "--qos") == 0 && hasValue) {
+            options.qos = (uint8_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "--batch-lines") == 0 && hasValue) {
+            options.batchLines = (uint32_t)atol(argv[++i]);
+        } else if (strcmp(arg, "--batch-kb") == 0 && hasValue) {
+            options.batchBytes = (size_t)atol(argv[++i]) * 1024;
+        } else if (strcmp(arg, "--flush-ms") == 0 && hasValue) {
+            options.flushMs = atof(argv[++i]);
+        } else if (strcmp(arg, "--buffers") == 0 && hasValue) {
+            options.buffers = (uint32_t)atol(argv[++i]);
+        } else if (strcmp(arg, "--overflow") == 0 && hasValue) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "drop") != 0 && strcmp(mode, "block") != 0) {
+                usage(argv[0]);
+                return 2;
+            }
+            options.dropOnOverflow = strcmp(mode, "drop") == 0;
+        } else if (strcmp(arg, "--report") == 0 && hasValue) {
+            options.report = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.qos > 1 || options.batchLines == 0 || options.batchBytes < MAX_LINE ||
+        options.buffers < 2 || options.flushMs <= 0 || options.report <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.topics.empty()) {
+        options.topics.push_back("/home/sensors/+");
+        options.topics.push_back("/home/sensors/+/replay");
+        options.topics.push_back("/home/sensors/+/batch");
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    startTime = Clock::now();
+
+    BatchPool pool(options.buffers);
+    Reader reader(pool);
+    Writer writer(pool);
+    std::atomic<bool> readerDone(false);
+    std::thread readerThread([&reader, &readerDone]() {
+        reader.run();
+        readerDone = true;
+    });
+    std::thread writerThread([&writer, &readerDone]() { writer.run(readerDone); });
+
+    fprintf(stderr, "ingesting into %s:%u/%s, batches of %u lines or %zu kB every %.0f ms, %u buffers (%s)\n",
+            options.influxHost.c_str(), (unsigned)options.influxPort, options.database, options.batchLines,
+            options.batchBytes / 1024, options.flushMs, options.buffers,
+            options.dropOnOverflow ? "drop when full" : "block when full");
+    printf("%8s %9s %9s %9s %6s %8s %8s %9s %9s %9s %9s\n", "t s", "msgs/s", "points/s", "written/s",
+           "queue", "dropped", "rejected", "blocked%", "lag p50", "lag p99", "e2e p50");
+
+    uint64_t lastReport = nowMicros();
+    uint64_t lastMessages = 0;
+    uint64_t lastPoints = 0;
+    uint64_t lastWritten = 0;
+    uint64_t lastBlocked = 0;
+    while (!stopping) {
+        usleep(100000);
+        uint64_t now = nowMicros();
+        if (now - lastReport < options.report * 1e6) {
+            continue;
+        }
+        double interval = (now - lastReport) / 1e6;
+        LatencyHistogram pipeline;
+        LatencyHistogram endToEnd;
+        {
+            std::lock_guard<std::mutex> lock(lagStats.mutex);
+            pipeline = lagStats.pipeline;
+            endToEnd = lagStats.endToEnd;
+            lagStats.pipeline.reset();
+            lagStats.endToEnd.reset();
+        }
+        uint64_t messages = counters.messages.load();
+        uint64_t points = counters.points.load();
+        uint64_t written = counters.written.load();
+        // Include a wait still in progress so a long stall shows up as it happens
+        uint64_t since = counters.blockedSince.load();
+        uint64_t blocked = counters.blockedMicros.load() + (since != 0 && since < now ? now - since : 0);
+        uint32_t queued = pool.queuedCount();
+        double messageRate = (messages - lastMessages) / interval;
+        double pointRate = (points - lastPoints) / interval;
+        double writeRate = (written - lastWritten) / interval;
+        double blockedPercent = std::min(100.0, (blocked - lastBlocked) / (interval * 1e4));
+        double lagP50 = pipeline.percentile(0.50) / 1e3;
+        double lagP99 = pipeline.percentile(0.99) / 1e3;
+        double lagMax = pipeline.max() / 1e3;
+        double endToEndP50 = endToEnd.percentile(0.50) / 1e6;
+        double endToEndP99 = endToEnd.percentile(0.99) / 1e6;
+
+        printf("%8.1f %9.1f %9.1f %9.1f %6u %8llu %8llu %9.1f %7.1fms %7.1fms %8.1fs\n", now / 1e6,
+               messageRate, pointRate, writeRate, queued, (unsigned long long)counters.dropped.load(),
+               (unsigned long long)counters.rejected.load(), blockedPercent, lagP50, lagP99, endToEndP50);
+        fflush(stdout);
+
+        char line[MAX_LINE];
+        int length = snprintf(line, sizeof(line),
+                              "garden_ingest,client=%s messages=%.2f,points=%.2f,written=%.2f,queued=%ui,"
+                              "dropped=%llui,rejected=%llui,malformed=%llui,write_failures=%llui,"
+                              "blocked_pct=%.2f,lag_p50_ms=%.3f,lag_p99_ms=%.3f,lag_max_ms=%.3f,"
+                              "e2e_p50_s=%.3f,e2e_p99_s=%.3f %llu",
+                              options.clientId, messageRate, pointRate, writeRate, queued,
+                              (unsigned long long)counters.dropped.load(),
+                              (unsigned long long)counters.rejected.load(),
+                              (unsigned long long)counters.malformed.load(),
+                              (unsigned long long)counters.writeFailures.load(), blockedPercent, lagP50,
+                              lagP99, lagMax, endToEndP50, endToEndP99,
+                              (unsigned long long)wallMicros() * 1000);
+        if (length > 0 && (size_t)length < sizeof(line)) {
+            std::lock_guard<std::mutex> lock(metricsMutex);
+            pendingMetrics.assign(line, length);
+        }
+
+        lastReport = now;
+        lastMessages = messages;
+        lastPoints = points;
+        lastWritten = written;
+        lastBlocked = blocked;
+    }
+
+    fprintf(stderr, "stopping: flushing queued batches\n");
+    readerThread.join();
+    writerThread.join();
+    fprintf(stderr, "%llu messages, %llu points written, %llu dropped, %llu rejected, %llu malformed\n",
+            (unsigned long long)counters.messages.load(), (unsigned long long)counters.written.load(),
+            (unsigned long long)counters.dropped.load(), (unsigned long long)counters.rejected.load(),
+            (unsigned long long)counters.malformed.load());
+    return 0;
+}
@@ -0,0 +1,960 @@
+// Simulates a fleet of garden nodes against a local broker (the mosquitto
+// service in docker-compose.yaml) to see how the backend copes with
+// hundreds or thousands of devices.
+//
+// Each node talks like the firmware's MQTTManager: a garden-<device id>
+// client ID, a retained "offline" will on /home/sensors/<id>/status, a
+// retained "online" once connected and subscriptions to its own
+// /home/sensors/<id>/command and the fleet's /home/sensors/command. It then
+// publishes its live sample (TelemetrySerializer JSON with seq and ts,
+// retained) every period, with jitter. A lost connection is retried after a
+// fixed delay like MQTT_RETRY_DELAY, so a storm (--storm) brings the whole
+// group back at once.
+//
+// Nodes are spread over worker threads, each running a poll() loop over
+// non-blocking sockets. A probe client subscribes to every node's telemetry
+// and status topics and matches each sample's seq, unique across the fleet, to
+// its send time for end-to-end latency. With --qos 1 the PUBACK round trip
+// is measured as well.
+//
+// Usage: mqtt_load [--host H] [--port P] [--nodes N] [--threads T]
+//                  [--period MS] [--jitter PCT] [--seconds S] [--ramp PER_S]
+//                  [--qos 0|1] [--retry MS] [--keepalive S] [--report S]
+//                  [--storm AT:PCT]... [--no-probe]
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "SensorData.h"
+#include "TelemetrySerializer.h"
+#include "metrics/LatencyHistogram.h"
+#include "mqtt/MqttPacket.h"
+#include "net/Tcp.h"
+
+namespace {
+
+const char* TOPIC_ROOT = "/home/sensors";
+const char* FLEET_COMMAND_TOPIC = "/home/sensors/command";
+const char* TELEMETRY_FILTER = "/home/sensors/+";
+const char* STATUS_FILTER = "/home/sensors/+/status";
+const uint32_t DEVICE_OUI = 0x240ac4;    // Espressif, so IDs look like eFuse MACs
+
+const size_t IN_BUFFER = 2048;           // PubSubClient drops anything larger
+const size_t MAX_OUTBOUND = 16384;       // unsent bytes before a publish fails
+const size_t INFLIGHT = 64;              // QoS 1 packet ids awaiting PUBACK
+const uint64_t CONNECT_TIMEOUT = 2000;   // ms, MQTTManager::SOCKET_TIMEOUT_S
+const size_t SEND_TIMES = 1 << 20;       // seq -> send time, for the probe
+
+struct Storm {
+    double at;       // seconds into the run
+    double percent;  // of the nodes online at that moment
+};
+
+struct Options {
+    const char* host = "127.0.0.1";
+    uint16_t port = 1883;
+    uint32_t nodes = 100;
+    uint32_t threads = 0;               // 0: one per core, at most 8
+    double period = 2000;               // ms, SAMPLE_PERIOD
+    double jitter = 10;                 // +- percent of the period
+    double seconds = 60;
+    double ramp = 100;                  // connects per second at start, 0 = all at once
+    uint8_t qos = 0;
+    double retry = 5000;                // ms, MQTT_RETRY_DELAY
+    uint16_t keepAlive = 15;            // s, PubSubClient MQTT_KEEPALIVE
+    double report = 5;
+    bool probe = true;
+    std::vector<Storm> storms;
+};
+
+Options options;
+sockaddr_storage brokerAddress;
+socklen_t brokerAddressLength;
+
+std::atomic<bool> stopping(false);
+std::atomic<uint32_t> nextSeq(1);
+std::atomic<uint64_t> sendTimes[SEND_TIMES];   // ns since start, 0 = unknown
+
+typedef std::chrono::steady_clock Clock;
+Clock::time_point startTime;
+
+uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime).count();
+}
+
+uint64_t msToNs(double ms) {
+    return (uint64_t)(ms * 1e6);
+}
+
+// Fleet-wide counters, shared by all workers and read by the reporter
+struct Counters {
+    std::atomic<int64_t> online{0};
+    std::atomic<uint64_t> connects{0};
+    std::atomic<uint64_t> connectFailures{0};
+    std::atomic<uint64_t> connectionsLost{0};
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint64_t> publishedBytes{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> acked{0};
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> statusOnline{0};
+    std::atomic<uint64_t> statusOffline{0};
+};
+
+Counters counters;
+
+void add(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+    counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+// xorshift; every worker has its own
+struct Random {
+    uint64_t state;
+
+    explicit Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull | 1) {}
+
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    // Uniform in -1..1
+    double symmetric() {
+        return (double)(next() >> 11) / (double)(1ull << 52) - 1.0;
+    }
+};
+
+// ---- Simulated node ----
+
+enum class NodeState : uint8_t {
+    Waiting,      // until nextConnect
+    Connecting,   // TCP handshake in progress
+    Handshake,    // CONNECT sent, waiting for CONNACK
+    Online
+};
+
+struct Node {
+    uint32_t id = 0;
+    int fd = -1;
+    NodeState state = NodeState::Waiting;
+    char clientId[24];
+    // Built once, like the firmware's topic table
+    char telemetryTopic[32];
+    char statusTopic[40];
+    char commandTopic[40];
+
+    uint64_t nextConnect = 0;
+    uint64_t connectStarted = 0;
+    uint64_t nextPublish = 0;
+    uint64_t lastSent = 0;
+    uint64_t scheduled = 0;      // wake-up currently queued for this node
+
+    std::vector<uint8_t> out;
+    size_t outPos = 0;
+    std::vector<uint8_t> in;
+    size_t inLength = 0;
+
+    uint16_t nextPacketId = 1;
+    uint64_t inflight[INFLIGHT];  // send time per packet id slot, 0 = free
+
+    StoredSample sample;
+
+    size_t pendingOut() const { return out.size() - outPos; }
+};
+
+void initSample(Node& node, Random& random) {
+    memset(&node.sample, 0, sizeof(node.sample));
+    SensorData& d = node.sample.data;
+    double offset = (node.id % 17) / 17.0;
+    d.soilTemp = (float)(18.0 + 4.0 * offset);
+    d.soilMoisture = (uint16_t)(450 + 300 * offset);
+    d.airTemp = (float)(20.0 + 5.0 * offset);
+    d.humidity = (float)(55.0 + 10.0 * offset);
+    d.h2Value = 1800;
+    d.h2Voltage = 1.45f;
+    d.co2 = (uint16_t)(550 + 100 * offset);
+    d.tvoc = 30;
+    d.targetCount = 0;
+    d.speed = 0;
+    d.distance = 0;
+    d.energy = 0;
+    d.pm25 = (float)(8.0 + 4.0 * offset);
+    d.pm10 = d.pm25 * 1.6f;
+    d.validMask = (1 << SENSOR_CHANNEL_COUNT) - 1;
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        d.ageDeciseconds[c] = (uint16_t)(random.next() % 40);
+    }
+}
+
+// Small random walk so payload sizes vary like real readings
+void updateSample(Node& node, Random& random) {
+    SensorData& d = node.sample.data;
+    d.soilTemp += (float)(0.02 * random.symmetric());
+    d.airTemp += (float)(0.05 * random.symmetric());
+    d.humidity += (float)(0.1 * random.symmetric());
+    d.co2 = (uint16_t)(d.co2 + (int)(3 * random.symmetric()));
+    d.h2Value = (uint16_t)(d.h2Value + (int)(5 * random.symmetric()));
+    d.targetCount = random.next() % 10 == 0 ? 1 : 0;
+    d.speed = d.targetCount ? (float)(0.4 + 0.3 * random.symmetric()) : 0;
+    d.distance = d.targetCount ? (float)(2.5 + random.symmetric()) : 0;
+    d.energy = d.targetCount ? (uint32_t)(1500 + 500 * random.symmetric()) : 0;
+}
+
+// ---- Worker: one poll() loop over a share of the nodes ----
+
+class Worker {
+public:
+    LatencyHistogram connectLatency;
+    LatencyHistogram ackLatency;
+
+    Worker(uint32_t index, uint32_t firstNode, uint32_t count)
+        : random(index + 1), nextStorm(0) {
+        nodes.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            Node& node = nodes[i];
+            node.id = firstNode + i;
+            node.in.resize(IN_BUFFER);
+            memset(node.inflight, 0, sizeof(node.inflight));
+            char deviceId[13];
+            snprintf(deviceId, sizeof(deviceId), "%06x%06x", DEVICE_OUI, node.id & 0xFFFFFF);
+            snprintf(node.clientId, sizeof(node.clientId), "garden-%s", deviceId);
+            snprintf(node.telemetryTopic, sizeof(node.telemetryTopic), "%s/%s", TOPIC_ROOT, deviceId);
+            snprintf(node.statusTopic, sizeof(node.statusTopic), "%s/status", node.telemetryTopic);
+            snprintf(node.commandTopic, sizeof(node.commandTopic), "%s/command", node.telemetryTopic);
+            initSample(node, random);
+            double start = options.ramp > 0 ? node.id * 1000.0 / options.ramp : 0;
+            schedule(i, msToNs(start));
+        }
+    }
+
+    void run() {
+        std::vector<pollfd> fds;
+        std::vector<uint32_t> owners;
+        while (!stopping.load(std::memory_order_relaxed)) {
+            uint64_t now = nowNs();
+            applyStorms(now);
+            runTimers(now);
+
+            fds.clear();
+            owners.clear();
+            for (uint32_t i = 0; i < nodes.size(); i++) {
+                Node& node = nodes[i];
+                if (node.fd < 0) {
+                    continue;
+                }
+                pollfd p;
+                p.fd = node.fd;
+                p.events = POLLIN;
+                if (node.state == NodeState::Connecting || node.pendingOut() > 0) {
+                    p.events |= POLLOUT;
+                }
+                p.revents = 0;
+                fds.push_back(p);
+                owners.push_back(i);
+            }
+
+            int timeout = 50;
+            if (!timers.empty()) {
+                uint64_t next = timers.top().first;
+                now = nowNs();
+                timeout = next <= now ? 0 : (int)std::min<uint64_t>((next - now) / 1000000 + 1, 50);
+            }
+            int ready = poll(fds.data(), fds.size(), timeout);
+            if (ready <= 0) {
+                continue;
+            }
+            now = nowNs();
+            for (size_t k = 0; k < fds.size(); k++) {
+                if (fds[k].revents != 0) {
+                    handleEvents(owners[k], fds[k].revents, now);
+                }
+            }
+        }
+
+        for (Node& node : nodes) {
+            if (node.state == NodeState::Online) {
+                uint8_t packet[2];
+                size_t length = MqttPacket::disconnect(packet, sizeof(packet));
+                ssize_t ignored = send(node.fd, packet, length, 0);
+                (void)ignored;
+            }
+            if (node.fd >= 0) {
+                close(node.fd);
+            }
+        }
+    }
+
+private:
+    typedef std::pair<uint64_t, uint32_t> Timer;
+
+    std::vector<Node> nodes;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    Random random;
+    size_t nextStorm;
+    char json[1024];
+
+    void schedule(uint32_t index, uint64_t at) {
+        Node& node = nodes[index];
+        node.scheduled = at;
+        timers.push(Timer(at, index));
+    }
+
+    // A node has a single pending wake-up; earlier entries for it are stale
+    void runTimers(uint64_t now) {
+        while (!timers.empty() && timers.top().first <= now) {
+            Timer timer = timers.top();
+            timers.pop();
+            if (nodes[timer.second].scheduled == timer.first) {
+                service(timer.second, now);
+            }
+        }
+    }
+
+    uint64_t jittered(double periodMs) {
+        return msToNs(periodMs * (1.0 + options.jitter / 100.0 * random.symmetric()));
+    }
+
+    void service(uint32_t index, uint64_t now) {
+        Node& node = nodes[index];
+        switch (node.state) {
+            case NodeState::Waiting:
+                startConnect(node, now);
+                break;
+            case NodeState::Connecting:
+            case NodeState::Handshake:
+                if (now - node.connectStarted >= msToNs(CONNECT_TIMEOUT)) {
+                    add(counters.connectFailures);
+                    dropConnection(node, now, false);
+                }
+                break;
+            case NodeState::Online:
+                if (now >= node.nextPublish) {
+                    publishSample(node, now);
+                    node.nextPublish += jittered(options.period);
+                    if (node.nextPublish < now) {
+                        node.nextPublish = now + jittered(options.period);
+                    }
+                }
+                if (now - node.lastSent >= (uint64_t)options.keepAlive * 1000000000ull) {
+                    queuePacket(node, now, [](uint8_t* b, size_t s) { return MqttPacket::pingreq(b, s); });
+                }
+                flush(node, now);
+                break;
+        }
+        if (node.state == NodeState::Waiting) {
+            schedule(index, node.nextConnect);
+        } else if (node.state == NodeState::Online) {
+            uint64_t ping = node.lastSent + (uint64_t)options.keepAlive * 1000000000ull;
+            schedule(index, std::min(node.nextPublish, ping));
+        } else {
+            schedule(index, node.connectStarted + msToNs(CONNECT_TIMEOUT));
+        }
+    }
+
+    void startConnect(Node& node, uint64_t now) {
+        node.connectStarted = now;
+        node.fd = Tcp::open(brokerAddress, brokerAddressLength, true);
+        if (node.fd < 0) {
+            add(counters.connectFailures);
+            node.state = NodeState::Waiting;
+            node.nextConnect = now + msToNs(options.retry);
+            return;
+        }
+        node.state = NodeState::Connecting;
+        node.out.clear();
+        node.outPos = 0;
+        node.inLength = 0;
+    }
+
+    // Abrupt close: the broker publishes the will. Reconnects follow the
+    // firmware's fixed retry delay.
+    void dropConnection(Node& node, uint64_t now, bool wasOnline) {
+        if (node.fd >= 0) {
+            close(node.fd);
+            node.fd = -1;
+        }
+        if (wasOnline) {
+            counters.online.fetch_sub(1, std::memory_order_relaxed);
+            add(counters.connectionsLost);
+        }
+        node.state = NodeState::Waiting;
+        node.nextConnect = now + msToNs(options.retry);
+        memset(node.inflight, 0, sizeof(node.inflight));
+    }
+
+    template <typename Encode>
+    bool queuePacket(Node& node, uint64_t now, Encode encode) {
+        uint8_t packet[256];
+        size_t length = encode(packet, sizeof(packet));
+        if (length == 0) {
+            return false;
+        }
+        node.out.insert(node.out.end(), packet, packet + length);
+        node.lastSent = now;
+        return true;
+    }
+
+    void publishSample(Node& node, uint64_t now) {
+        if (node.pendingOut() > MAX_OUTBOUND) {
+            // PubSubClient's write would block and fail; the sample is lost
+            add(counters.dropped);
+            return;
+        }
+        uint16_t packetId = 0;
+        size_t slot = 0;
+        if (options.qos > 0) {
+            packetId = node.nextPacketId++;
+            if (node.nextPacketId == 0) {
+                node.nextPacketId = 1;
+            }
+            slot = packetId % INFLIGHT;
+            if (node.inflight[slot] != 0) {
+                add(counters.dropped);
+                return;
+            }
+        }
+
+        updateSample(node, random);
+        uint32_t seq = nextSeq.fetch_add(1, std::memory_order_relaxed);
+        node.sample.seq = seq;
+        node.sample.timestamp = (uint32_t)time(nullptr);
+        size_t payloadLength = TelemetrySerializer::serialize(node.sample, json, sizeof(json));
+
+        uint8_t header[8 + 64];
+        size_t headerLength = MqttPacket::publishHeader(header, sizeof(header), node.telemetryTopic,
+                                                        payloadLength, options.qos, true, packetId);
+        if (payloadLength == 0 || headerLength == 0) {
+            add(counters.dropped);
+            return;
+        }
+        node.out.insert(node.out.end(), header, header + headerLength);
+        node.out.insert(node.out.end(), json, json + payloadLength);
+        node.lastSent = now;
+
+        sendTimes[seq % SEND_TIMES].store(now, std::memory_order_relaxed);
+        if (options.qos > 0) {
+            node.inflight[slot] = now;
+        }
+        add(counters.published);
+        add(counters.publishedBytes, headerLength + payloadLength);
+    }
+
+    void flush(Node& node, uint64_t now) {
+        while (node.pendingOut() > 0) {
+            ssize_t n = send(node.fd, node.out.data() + node.outPos, node.pendingOut(), 0);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                    return;
+                }
+                dropConnection(node, now, node.state == NodeState::Online);
+                return;
+            }
+            node.outPos += n;
+        }
+        node.out.clear();
+        node.outPos = 0;
+    }
+
+    void handleEvents(uint32_t index, short revents, uint64_t now) {
+        Node& node = nodes[index];
+        if (node.state == NodeState::Connecting) {
+            if (Tcp::pendingError(node.fd) != 0) {
+                add(counters.connectFailures);
+                dropConnection(node, now, false);
+                schedule(index, node.nextConnect);
+                return;
+            }
+            MqttWill will = { node.statusTopic, "offline", 1, true };
+            const char* clientId = node.clientId;
+            queuePacket(node, now, [clientId, &will](uint8_t* b, size_t s) {
+                return MqttPacket::connect(b, s, clientId, options.keepAlive, true, &will);
+            });
+            node.state = NodeState::Handshake;
+            flush(node, now);
+            return;
+        }
+
+        if (revents & POLLOUT) {
+            flush(node, now);
+            if (node.fd < 0) {
+                schedule(index, node.nextConnect);
+                return;
+            }
+        }
+        if (revents & (POLLIN | POLLHUP | POLLERR)) {
+            receive(index, now);
+        }
+    }
+
+    void receive(uint32_t index, uint64_t now) {
+        Node& node = nodes[index];
+        bool wasOnline = node.state == NodeState::Online;
+        ssize_t n = recv(node.fd, node.in.data() + node.inLength, node.in.size() - node.inLength, 0);
+        if (n <= 0) {
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                return;
+            }
+            if (!wasOnline) {
+                add(counters.connectFailures);
+            }
+            dropConnection(node, now, wasOnline);
+            schedule(index, node.nextConnect);
+            return;
+        }
+        node.inLength += n;
+
+        size_t pos = 0;
+        MqttFrame frame;
+        int result;
+        while ((result = MqttPacket::parse(node.in.data() + pos, node.inLength - pos, frame)) == 1) {
+            handleFrame(index, frame, now);
+            if (node.fd < 0) {
+                schedule(index, node.nextConnect);
+                return;
+            }
+            pos += frame.frameLength;
+        }
+        if (result < 0 || (pos == 0 && node.inLength == node.in.size())) {
+            // Malformed or larger than the client buffer: PubSubClient disconnects
+            if (!wasOnline) {
+                add(counters.connectFailures);
+            }
+            dropConnection(node, now, node.state == NodeState::Online);
+            schedule(index, node.nextConnect);
+            return;
+        }
+        memmove(node.in.data(), node.in.data() + pos, node.inLength - pos);
+        node.inLength -= pos;
+    }
+
+    void handleFrame(uint32_t index, const MqttFrame& frame, uint64_t now) {
+        Node& node = nodes[index];
+        switch (frame.type) {
+            case MqttType::Connack:
+                if (node.state != NodeState::Handshake || MqttPacket::connackCode(frame) != 0) {
+                    add(counters.connectFailures);
+                    dropConnection(node, now, false);
+                    return;
+                }
+                node.state = NodeState::Online;
+                counters.online.fetch_add(1, std::memory_order_relaxed);
+                add(counters.connects);
+                connectLatency.record((now - node.connectStarted) / 1000);
+                queuePacket(node, now, [&node](uint8_t* b, size_t s) {
+                    return MqttPacket::publish(b, s, node.statusTopic, "online", 6, 0, true, 0);
+                });
+                queuePacket(node, now, [&node](uint8_t* b, size_t s) {
+                    return MqttPacket::subscribe(b, s, 1, node.commandTopic, 0);
+                });
+                queuePacket(node, now, [](uint8_t* b, size_t s) {
+                    return MqttPacket::subscribe(b, s, 2, FLEET_COMMAND_TOPIC, 0);
+                });
+                node.nextPublish = now + jittered(options.period);
+                flush(node, now);
+                if (node.fd >= 0) {
+                    schedule(index, now);
+                }
+                break;
+
+            case MqttType::Puback: {
+                size_t slot = MqttPacket::packetId(frame) % INFLIGHT;
+                if (node.inflight[slot] != 0) {
+                    ackLatency.record((now - node.inflight[slot]) / 1000);
+                    node.inflight[slot] = 0;
+                    add(counters.acked);
+                }
+                break;
+            }
+
+            case MqttType::Publish: {
+                // Commands are accepted and ignored; QoS 1 ones are acknowledged
+                MqttPublish publish;
+                if (MqttPacket::parsePublish(frame, publish) && publish.qos == 1) {
+                    uint16_t id = publish.packetId;
+                    queuePacket(node, now, [id](uint8_t* b, size_t s) { return MqttPacket::puback(b, s, id); });
+                    flush(node, now);
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    // Every worker drops its share of the online nodes at the same moment
+    void applyStorms(uint64_t now) {
+        while (nextStorm < options.storms.size() &&
+               now >= msToNs(options.storms[nextStorm].at * 1000)) {
+            double fraction = options.storms[nextStorm].percent / 100.0;
+            for (uint32_t i = 0; i < nodes.size(); i++) {
+                Node& node = nodes[i];
+                if (node.state == NodeState::Online &&
+                    (double)(random.next() % 1000000) / 1e6 < fraction) {
+                    dropConnection(node, now, true);
+                    schedule(i, node.nextConnect);
+                }
+            }
+            nextStorm++;
+        }
+    }
+};
+
+// ---- Probe: one subscriber measuring what the backend actually receives ----
+
+class Probe {
+public:
+    LatencyHistogram endToEnd;
+
+    Probe() : fd(-1) {}
+
+    bool connect() {
+        fd = Tcp::open(brokerAddress, brokerAddressLength, false);
+        if (fd < 0) {
+            return false;
+        }
+        Tcp::setReceiveTimeout(fd, 100);
+        uint8_t packet[128];
+        size_t length = MqttPacket::connect(packet, sizeof(packet), "mqtt-load-probe", 60, true, nullptr);
+        length += MqttPacket::subscribe(packet + length, sizeof(packet) - length, 1, TELEMETRY_FILTER, 0);
+        length += MqttPacket::subscribe(packet + length, sizeof(packet) - length, 2, STATUS_FILTER, 0);
+        return send(fd, packet, length, 0) == (ssize_t)length;
+    }
+
+    // Runs until stopped, then keeps reading for drainMs so in-flight
+    // samples are still counted
+    void run(std::atomic<bool>& stop, uint64_t drainMs) {
+        std::vector<uint8_t> buffer(1 << 16);
+        size_t length = 0;
+        uint64_t lastPing = nowNs();
+        uint64_t drainUntil = 0;
+        for (;;) {
+            uint64_t now = nowNs();
+            if (stop.load()) {
+                if (drainUntil == 0) {
+                    drainUntil = now + msToNs(drainMs);
+                } else if (now >= drainUntil) {
+                    break;
+                }
+            }
+            if (now - lastPing > 30000000000ull) {
+                uint8_t ping[2];
+                size_t n = MqttPacket::pingreq(ping, sizeof(ping));
+                if (send(fd, ping, n, 0) < 0) {
+                    break;
+                }
+                lastPing = now;
+            }
+
+            ssize_t n = recv(fd, buffer.data() + length, buffer.size() - length, 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                fprintf(stderr, "probe: connection to the broker lost\n");
+                break;
+            }
+            if (n < 0) {
+                continue;
+            }
+            length += n;
+            now = nowNs();
+
+            size_t pos = 0;
+            MqttFrame frame;
+            int result;
+            while ((result = MqttPacket::parse(buffer.data() + pos, length - pos, frame)) == 1) {
+                handleFrame(frame, now);
+                pos += frame.frameLength;
+            }
+            if (result < 0) {
+                fprintf(stderr, "probe: malformed packet from the broker\n");
+                break;
+            }
+            if (pos == 0 && length == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
+            memmove(buffer.data(), buffer.data() + pos, length - pos);
+            length -= pos;
+        }
+        close(fd);
+    }
+
+private:
+    int fd;
+
+    // True for "<root>/<device id><suffix>"
+    static bool isDeviceTopic(const MqttPublish& publish, const char* suffix) {
+        size_t rootLength = strlen(TOPIC_ROOT);
+        size_t suffixLength = strlen(suffix);
+        if (publish.topicLength <= rootLength + 1 + suffixLength ||
+            memcmp(publish.topic, TOPIC_ROOT, rootLength) != 0 || publish.topic[rootLength] != '/' ||
+            memcmp(publish.topic + publish.topicLength - suffixLength, suffix, suffixLength) != 0) {
+            return false;
+        }
+        const char* id = publish.topic + rootLength + 1;
+        return memchr(id, '/', publish.topicLength - rootLength - 1 - suffixLength) == nullptr;
+    }
+
+    // "seq": is the second-to-last key of a live sample
+    static bool findSeq(const MqttPublish& publish, uint32_t& seq) {
+        const char* text = reinterpret_cast<const char*>(publish.payload);
+        static const char KEY[] = "\"seq\":";
+        size_t keyLength = sizeof(KEY) - 1;
+        for (size_t i = publish.payloadLength; i-- > keyLength;) {
+            const char* at = text + i - keyLength;
+            if (memcmp(at, KEY, keyLength) == 0) {
+                seq = 0;
+                for (size_t j = i; j < publish.payloadLength && text[j] >= '0' && text[j] <= '9'; j++) {
+                    seq = seq * 10 + (text[j] - '0');
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void handleFrame(const MqttFrame& frame, uint64_t now) {
+        MqttPublish publish;
+        // Retained copies delivered on subscribe are not live traffic
+        if (!MqttPacket::parsePublish(frame, publish) || publish.retain) {
+            return;
+        }
+        if (isDeviceTopic(publish, "")) {
+            uint32_t seq;
+            if (!findSeq(publish, seq)) {
+                return;
+            }
+            add(counters.received);
+            uint64_t sent = sendTimes[seq % SEND_TIMES].load(std::memory_order_relaxed);
+            if (sent != 0 && sent <= now) {
+                endToEnd.record((now - sent) / 1000);
+            }
+        } else if (isDeviceTopic(publish, "/status")) {
+            if (publish.payloadLength == 6 && memcmp(publish.payload, "online", 6) == 0) {
+                add(counters.statusOnline);
+            } else {
+                add(counters.statusOffline);
+            }
+        }
+    }
+};
+
+// ---- Reporting ----
+
+void printLatency(const char* name, const LatencyHistogram& h) {
+    if (h.count() == 0) {
+        printf("  %-12s no samples\n", name);
+        return;
+    }
+    printf("  %-12s n=%-9llu mean %7.2f  p50 %7.2f  p90 %7.2f  p99 %7.2f  p99.9 %7.2f  max %7.2f ms\n",
+           name, (unsigned long long)h.count(), h.mean() / 1e3,
+           h.percentile(0.50) / 1e3, h.percentile(0.90) / 1e3, h.percentile(0.99) / 1e3,
+           h.percentile(0.999) / 1e3, h.max() / 1e3);
+}
+
+bool parseStorm(const char* text, Storm& storm) {
+    return sscanf(text, "%lf:%lf", &storm.at, &storm.percent) == 2 &&
+           storm.at >= 0 && storm.percent > 0 && storm.percent <= 100;
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [--host H] [--port P] [--nodes N] [--threads T]\n"
+            "          [--period MS] [--jitter PCT] [--seconds S] [--ramp PER_S]\n"
+            "          [--qos 0|1] [--retry MS] [--keepalive S] [--report S]\n"
+            "          [--storm AT:PCT]... [--no-probe]\n",
+            program);
+}
+
+// Each node needs a descriptor; raise the soft limit as far as allowed
+void raiseFileLimit(uint32_t needed) {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur >= needed) {
+        return;
+    }
+    limit.rlim_cur = limit.rlim_max == RLIM_INFINITY ? needed : std::min<rlim_t>(needed, limit.rlim_max);
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < needed) {
+        fprintf(stderr, "warning: open file limit %llu is below %u; raise it with ulimit -n\n",
+                (unsigned long long)limit.rlim_cur, needed);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--host") == 0 && hasValue) {
+            options.host = argv[++i];
+        } else if (strcmp(arg, "--port") == 0 && hasValue) {
+            options.port = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "--nodes") == 0 && hasValue) {
+            options.nodes = (uint32_t)atol(argv[++i]);
+        } else if (strcmp(arg, "--threads") == 0 && hasValue) {
+            options.threads = (uint32_t)atol(argv[++i]);
+        } else if (strcmp(arg, "--period") == 0 && hasValue) {
+            options.period = atof(argv[++i]);
+        } else if (strcmp(arg, "--jitter") == 0 && hasValue) {
+            options.jitter = atof(argv[++i]);
+        } else if (strcmp(arg, "--seconds") == 0 && hasValue) {
+            options.seconds = atof(argv[++i]);
+        } else if (strcmp(arg, "--ramp") == 0 && hasValue) {
+            options.ramp = atof(argv[++i]);
+        } else if (strcmp(arg, "--qos") == 0 && hasValue) {
+            options.qos = (uint8_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "--retry") == 0 && hasValue) {
+            options.retry = atof(argv[++i]);
+        } else if (strcmp(arg, "--keepalive") == 0 && hasValue) {
+            options.keepAlive = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "--report") == 0 && hasValue) {
+            options.report = atof(argv[++i]);
+        } else if (strcmp(arg, "--storm") == 0 && hasValue) {
+            Storm storm;
+            if (!parseStorm(argv[++i], storm)) {
+                fprintf(stderr, "--storm expects AT:PCT, e.g. 30:100\n");
+                return 2;
+            }
+            options.storms.push_back(storm);
+        } else if (strcmp(arg, "--no-probe") == 0) {
+            options.probe = false;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.nodes == 0 || options.period <= 0 || options.qos > 1 || options.keepAlive == 0 ||
+        options.jitter < 0 || options.jitter >= 100 || options.report <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.threads == 0) {
+        options.threads = std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+    }
+    options.threads = std::min(options.threads, options.nodes);
+    std::sort(options.storms.begin(), options.storms.end(),
+              [](const Storm& a, const Storm& b) { return a.at < b.at; });
+
+    if (!Tcp::resolve(options.host, options.port, brokerAddress, brokerAddressLength)) {
+        fprintf(stderr, "cannot resolve %s\n", options.host);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    raiseFileLimit(options.nodes + 64);
+    startTime = Clock::now();
+
+    Probe probe;
+    std::atomic<bool> probeStop(false);
+    std::thread probeThread;
+    if (options.probe) {
+        if (!probe.connect()) {
+            fprintf(stderr, "cannot connect to %s:%u: %s\n", options.host, (unsigned)options.port,
+                    strerror(errno));
+            return 1;
+        }
+        probeThread = std::thread([&probe, &probeStop]() { probe.run(probeStop, 2000); });
+    }
+
+    printf("%u nodes on %u threads -> %s:%u, period %.0f ms +-%.0f%%, qos %u, %.0f s\n",
+           options.nodes, options.threads, options.host, (unsigned)options.port,
+           options.period, options.jitter, (unsigned)options.qos, options.seconds);
+
+    std::vector<Worker*> workers;
+    std::vector<std::thread> threads;
+    uint32_t first = 0;
+    for (uint32_t t = 0; t < options.threads; t++) {
+        uint32_t count = options.nodes / options.threads + (t < options.nodes % options.threads ? 1 : 0);
+        workers.push_back(new Worker(t, first, count));
+        first += count;
+    }
+    for (Worker* worker : workers) {
+        threads.push_back(std::thread([worker]() { worker->run(); }));
+    }
+
+    printf("%8s %7s %9s %9s %10s %9s %9s %8s %8s\n",
+           "t s", "online", "connects", "failed", "sent/s", "kB/s", "recv/s", "dropped", "offline");
+    uint64_t lastPublished = 0;
+    uint64_t lastBytes = 0;
+    uint64_t lastReceived = 0;
+    uint64_t lastReport = 0;
+    uint64_t end = msToNs(options.seconds * 1000);
+    while (nowNs() < end) {
+        uint64_t next = std::min(end, lastReport + msToNs(options.report * 1000));
+        std::this_thread::sleep_for(std::chrono::nanoseconds(next - std::min(next, nowNs())));
+        uint64_t now = nowNs();
+        double interval = (now - lastReport) / 1e9;
+        uint64_t published = counters.published.load();
+        uint64_t bytes = counters.publishedBytes.load();
+        uint64_t received = counters.received.load();
+        printf("%8.1f %7lld %9llu %9llu %10.1f %9.1f %9.1f %8llu %8llu\n", now / 1e9,
+               (long long)counters.online.load(), (unsigned long long)counters.connects.load(),
+               (unsigned long long)counters.connectFailures.load(),
+               (published - lastPublished) / interval, (bytes - lastBytes) / interval / 1e3,
+               (received - lastReceived) / interval, (unsigned long long)counters.dropped.load(),
+               (unsigned long long)counters.statusOffline.load());
+        fflush(stdout);
+        lastPublished = published;
+        lastBytes = bytes;
+        lastReceived = received;
+        lastReport = now;
+    }
+
+    stopping = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double elapsed = nowNs() / 1e9;
+    probeStop = true;
+    if (probeThread.joinable()) {
+        probeThread.join();
+    }
+
+    LatencyHistogram connectLatency;
+    LatencyHistogram ackLatency;
+    for (Worker* worker : workers) {
+        connectLatency.merge(worker->connectLatency);
+        ackLatency.merge(worker->ackLatency);
+        delete worker;
+    }
+
+    uint64_t published = counters.published.load();
+    uint64_t received = counters.received.load();
+    printf("\nsummary over %.1f s\n", elapsed);
+    printf("  connects     %llu ok, %llu failed, %llu connections lost\n",
+           (unsigned long long)counters.connects.load(), (unsigned long long)counters.connectFailures.load(),
+           (unsigned long long)counters.connectionsLost.load());
+    printf("  published    %llu msgs (%.1f/s), %.2f MB (%.1f kB/s), %llu dropped at the nodes\n",
+           (unsigned long long)published, published / elapsed, counters.publishedBytes.load() / 1e6,
+           counters.publishedBytes.load() / elapsed / 1e3, (unsigned long long)counters.dropped.load());
+    if (options.probe) {
+        printf("  received     %llu msgs by the probe (%.2f%% of published)\n",
+               (unsigned long long)received, published ? 100.0 * received / published : 0.0);
+        printf("  status       %llu online, %llu offline (wills) seen by the probe\n",
+               (unsigned long long)counters.statusOnline.load(),
+               (unsigned long long)counters.statusOffline.load());
+    }
+    printf("\nlatency\n");
+    printLatency("connect", connectLatency);
+    if (options.qos > 0) {
+        printLatency("puback", ackLatency);
+    }
+    if (options.probe) {
+        printLatency("end-to-end", probe.endToEnd);
+    }
+    return 0;
+}
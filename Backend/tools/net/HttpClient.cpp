@@ -0,0 +1,194 @@
+#include "HttpClient.h"
+#include "Tcp.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// Value of a header in the block before the blank line, or nullptr
+const char* findHeader(const std::string& headers, size_t headerEnd, const char* name) {
+    size_t nameLength = strlen(name);
+    size_t pos = headers.find("\r\n");
+    while (pos != std::string::npos && pos < headerEnd) {
+        const char* line = headers.c_str() + pos + 2;
+        if (strncasecmp(line, name, nameLength) == 0 && line[nameLength] == ':') {
+            const char* value = line + nameLength + 1;
+            while (*value == ' ') {
+                value++;
+            }
+            return value;
+        }
+        pos = headers.find("\r\n", pos + 2);
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+HttpClient::HttpClient(const char* host, uint16_t port) : host(host), port(port), fd(-1) {}
+
+HttpClient::~HttpClient() {
+    disconnect();
+}
+
+void HttpClient::disconnect() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool HttpClient::ensureConnected(int timeoutMillis) {
+    if (fd >= 0) {
+        return true;
+    }
+    sockaddr_storage address;
+    socklen_t length;
+    if (!Tcp::resolve(host.c_str(), port, address, length)) {
+        return false;
+    }
+    fd = Tcp::open(address, length, false);
+    if (fd < 0) {
+        return false;
+    }
+    Tcp::setReceiveTimeout(fd, timeoutMillis);
+    Tcp::setSendTimeout(fd, timeoutMillis);
+    return true;
+}
+
+bool HttpClient::sendAll(const char* header, size_t headerLength, const char* data, size_t length) {
+    iovec parts[2];
+    parts[0].iov_base = const_cast<char*>(header);
+    parts[0].iov_len = headerLength;
+    parts[1].iov_base = const_cast<char*>(data);
+    parts[1].iov_len = length;
+    iovec* part = parts;
+    int remaining = 2;
+    while (remaining > 0) {
+        ssize_t n = writev(fd, part, remaining);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        while (remaining > 0 && (size_t)n >= part->iov_len) {
+            n -= part->iov_len;
+            part++;
+            remaining--;
+        }
+        if (remaining > 0) {
+            part->iov_base = static_cast<char*>(part->iov_base) + n;
+            part->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+int HttpClient::readResponse(bool& keepAlive) {
+    response.clear();
+    body.clear();
+    char chunk[4096];
+    size_t headerEnd = std::string::npos;
+    size_t bodyStart = 0;
+    long contentLength = -1;
+    bool chunked = false;
+    int status = -1;
+    keepAlive = true;
+
+    for (;;) {
+        if (headerEnd == std::string::npos) {
+            headerEnd = response.find("\r\n\r\n");
+            if (headerEnd != std::string::npos) {
+                bodyStart = headerEnd + 4;
+                if (sscanf(response.c_str(), "HTTP/1.%*d %d", &status) != 1) {
+                    return -1;
+                }
+                const char* value = findHeader(response, headerEnd, "Content-Length");
+                if (value != nullptr) {
+                    contentLength = strtol(value, nullptr, 10);
+                }
+                value = findHeader(response, headerEnd, "Transfer-Encoding");
+                chunked = value != nullptr && strncasecmp(value, "chunked", 7) == 0;
+                value = findHeader(response, headerEnd, "Connection");
+                keepAlive = value == nullptr || strncasecmp(value, "close", 5) != 0;
+                if (status == 204 || status == 304 || (status >= 100 && status < 200)) {
+                    contentLength = 0;
+                }
+            }
+        }
+
+        if (headerEnd != std::string::npos) {
+            size_t have = response.size() - bodyStart;
+            bool complete = false;
+            if (contentLength >= 0) {
+                complete = have >= (size_t)contentLength;
+            } else if (chunked) {
+                complete = response.compare(bodyStart, 5, "0\r\n\r\n") == 0 ||
+                           response.find("\r\n0\r\n\r\n", bodyStart) != std::string::npos;
+            }
+            if (complete) {
+                body = response.substr(bodyStart, MAX_BODY);
+                return status;
+            }
+        }
+
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // Without a length, the body runs until the server closes
+            if (n == 0 && headerEnd != std::string::npos && contentLength < 0 && !chunked) {
+                keepAlive = false;
+                body = response.substr(bodyStart, MAX_BODY);
+                return status;
+            }
+            return -1;
+        }
+        response.append(chunk, n);
+    }
+}
+
+int HttpClient::post(const char* path, const char* contentType, const char* data, size_t length,
+                     int timeoutMillis) {
+    // A kept-alive connection may have been closed by the server meanwhile;
+    // try once more on a fresh one before giving up
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = fd >= 0;
+        if (!ensureConnected(timeoutMillis)) {
+            return -1;
+        }
+        char header[512];
+        int headerLength = snprintf(header, sizeof(header),
+                                    "POST %s HTTP/1.1\r\n"
+                                    "Host: %s:%u\r\n"
+                                    "Content-Type: %s\r\n"
+                                    "Content-Length: %zu\r\n"
+                                    "\r\n",
+                                    path, host.c_str(), (unsigned)port, contentType, length);
+        if (headerLength < 0 || (size_t)headerLength >= sizeof(header)) {
+            return -1;
+        }
+
+        bool keepAlive = false;
+        int status = sendAll(header, headerLength, data, length) ? readResponse(keepAlive) : -1;
+        if (status < 0) {
+            disconnect();
+            if (reused) {
+                continue;
+            }
+            return -1;
+        }
+        if (!keepAlive) {
+            disconnect();
+        }
+        return status;
+    }
+    return -1;
+}
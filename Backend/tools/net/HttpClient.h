@@ -0,0 +1,40 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Minimal blocking HTTP/1.1 client for POSTing to one server over a
+// kept-alive connection, e.g. InfluxDB's /write endpoint. Not thread-safe.
+class HttpClient {
+public:
+    HttpClient(const char* host, uint16_t port);
+    ~HttpClient();
+
+    // Sends body and waits for the response, reconnecting first if needed.
+    // Returns the status code, or -1 if the server could not be reached or
+    // did not answer within timeoutMillis.
+    int post(const char* path, const char* contentType, const char* body, size_t length,
+             int timeoutMillis);
+
+    // Start of the last response body, for error messages
+    const std::string& responseBody() const { return body; }
+
+    void disconnect();
+
+private:
+    static const size_t MAX_BODY = 512;
+
+    std::string host;
+    uint16_t port;
+    int fd;
+    std::string response;   // receive buffer, reused between requests
+    std::string body;
+
+    bool ensureConnected(int timeoutMillis);
+    bool sendAll(const char* header, size_t headerLength, const char* data, size_t length);
+    int readResponse(bool& keepAlive);
+};
+
+#endif
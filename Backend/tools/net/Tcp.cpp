@@ -0,0 +1,75 @@
+#include "Tcp.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+bool Tcp::resolve(const char* host, uint16_t port, sockaddr_storage& address, socklen_t& length) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, service, &hints, &result) != 0 || result == nullptr) {
+        return false;
+    }
+    memcpy(&address, result->ai_addr, result->ai_addrlen);
+    length = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+int Tcp::open(const sockaddr_storage& address, socklen_t length, bool nonBlocking) {
+    int fd = socket(address.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (nonBlocking) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), length) != 0 && errno != EINPROGRESS) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+int Tcp::pendingError(int fd) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0) {
+        return errno;
+    }
+    return error;
+}
+
+namespace {
+
+void setTimeout(int fd, int option, int millis) {
+    timeval timeout;
+    timeout.tv_sec = millis / 1000;
+    timeout.tv_usec = (millis % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, option, &timeout, sizeof(timeout));
+}
+
+}  // namespace
+
+void Tcp::setReceiveTimeout(int fd, int millis) {
+    setTimeout(fd, SO_RCVTIMEO, millis);
+}
+
+void Tcp::setSendTimeout(int fd, int millis) {
+    setTimeout(fd, SO_SNDTIMEO, millis);
+}
@@ -0,0 +1,26 @@
+#ifndef TCP_H
+#define TCP_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+// Plain POSIX TCP helpers shared by the host tools
+class Tcp {
+public:
+    // Resolves host (name, IPv4 or IPv6) and port; false if it does not resolve
+    static bool resolve(const char* host, uint16_t port, sockaddr_storage& address, socklen_t& length);
+
+    // Opens a connection with TCP_NODELAY set. Returns the descriptor or -1.
+    // When nonBlocking, the connect may still be in progress: wait until the
+    // socket is writable, then check pendingError().
+    static int open(const sockaddr_storage& address, socklen_t length, bool nonBlocking);
+
+    // Result of a non-blocking connect, 0 once it succeeded
+    static int pendingError(int fd);
+
+    // Receive timeout for blocking sockets, so readers can notice a stop flag
+    static void setReceiveTimeout(int fd, int millis);
+    static void setSendTimeout(int fd, int millis);
+};
+
+#endif
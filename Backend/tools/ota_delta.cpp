@@ -0,0 +1,211 @@
+// Makes a firmware delta patch (DeltaPatch format, Hardware/src/DeltaPatch.h)
+// that turns the image a node runs into a new one, for {"ota": ...} updates.
+//
+// Every BLOCK-byte window of the base image is indexed by a rolling hash.
+// The new image is scanned for windows the base also has; each hit is
+// grown in both directions and becomes a COPY, and the bytes between hits
+// go out as DATA. Code that only moved costs a few bytes per run instead
+// of its full size. The patch is applied again before it is written, so a
+// patch that would not rebuild the image exactly is never produced.
+//
+// Usage: ota_delta BASE.bin NEW.bin PATCH
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DeltaPatch.h"
+
+namespace {
+
+const size_t BLOCK = 32;                 // shortest run worth a COPY
+const uint64_t PRIME = 1099511628211ULL;
+const size_t APP_DESC_OFFSET = 32;       // image header + first segment header
+const size_t ELF_SHA_OFFSET = APP_DESC_OFFSET + 144;
+const uint32_t APP_DESC_MAGIC = 0xABCD5432;
+
+typedef std::vector<uint8_t> Bytes;
+
+bool readFile(const char* path, Bytes& contents) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return false;
+    }
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        contents.insert(contents.end(), chunk, chunk + n);
+    }
+    fclose(file);
+    return true;
+}
+
+uint32_t readU32(const uint8_t* bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+uint64_t windowHash(const uint8_t* data) {
+    uint64_t hash = 0;
+    for (size_t i = 0; i < BLOCK; i++) {
+        hash = hash * PRIME + data[i];
+    }
+    return hash;
+}
+
+class PatchWriter {
+public:
+    Bytes patch;
+    size_t copies = 0;
+    size_t copied = 0;
+    size_t literal = 0;
+
+    void copy(uint32_t offset, uint32_t length) {
+        uint8_t op[9] = { DeltaPatch::OP_COPY };
+        DeltaPatch::writeU32(op + 1, offset);
+        DeltaPatch::writeU32(op + 5, length);
+        patch.insert(patch.end(), op, op + sizeof(op));
+        copies++;
+        copied += length;
+    }
+
+    void data(const uint8_t* bytes, size_t length) {
+        if (length == 0) {
+            return;
+        }
+        uint8_t op[5] = { DeltaPatch::OP_DATA };
+        DeltaPatch::writeU32(op + 1, (uint32_t)length);
+        patch.insert(patch.end(), op, op + sizeof(op));
+        patch.insert(patch.end(), bytes, bytes + length);
+        literal += length;
+    }
+};
+
+void diff(const Bytes& base, const Bytes& image, PatchWriter& out) {
+    // First occurrence of every window in the base image
+    std::unordered_map<uint64_t, uint32_t> index;
+    if (base.size() >= BLOCK) {
+        index.reserve(base.size());
+        uint64_t power = 1;
+        for (size_t i = 1; i < BLOCK; i++) {
+            power *= PRIME;
+        }
+        uint64_t hash = windowHash(base.data());
+        for (size_t i = 0;; i++) {
+            index.emplace(hash, (uint32_t)i);
+            if (i + BLOCK >= base.size()) {
+                break;
+            }
+            hash = (hash - base[i] * power) * PRIME + base[i + BLOCK];
+        }
+    }
+
+    size_t pending = 0;   // start of bytes not covered by an op yet
+    size_t i = 0;
+    while (i + BLOCK <= image.size()) {
+        auto hit = index.find(windowHash(image.data() + i));
+        if (hit == index.end() || memcmp(base.data() + hit->second, image.data() + i, BLOCK) != 0) {
+            i++;
+            continue;
+        }
+        size_t from = hit->second;
+        size_t start = i;
+        while (start > pending && from > 0 && base[from - 1] == image[start - 1]) {
+            start--;
+            from--;
+        }
+        size_t length = i - start + BLOCK;
+        while (start + length < image.size() && from + length < base.size() &&
+               base[from + length] == image[start + length]) {
+            length++;
+        }
+        out.data(image.data() + pending, start - pending);
+        out.copy((uint32_t)from, (uint32_t)length);
+        i = pending = start + length;
+    }
+    out.data(image.data() + pending, image.size() - pending);
+}
+
+// Rebuilds the image from the patch as the firmware would
+bool apply(const Bytes& base, const Bytes& patch, Bytes& image) {
+    DeltaPatch decoder;
+    size_t pos = 0;
+    for (;;) {
+        size_t consumed;
+        DeltaPatch::Op op;
+        DeltaPatch::Result result = decoder.feed(patch.data() + pos, patch.size() - pos, consumed, op);
+        pos += consumed;
+        switch (result) {
+            case DeltaPatch::COPY:
+                if (op.offset > base.size() || op.length > base.size() - op.offset) {
+                    return false;
+                }
+                image.insert(image.end(), base.begin() + op.offset, base.begin() + op.offset + op.length);
+                break;
+            case DeltaPatch::DATA:
+                image.insert(image.end(), op.data, op.data + op.length);
+                break;
+            case DeltaPatch::END:
+                return pos == patch.size();
+            default:
+                return false;
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s BASE.bin NEW.bin PATCH\n", argv[0]);
+        return 2;
+    }
+    Bytes base;
+    Bytes image;
+    if (!readFile(argv[1], base) || !readFile(argv[2], image)) {
+        return 1;
+    }
+    // The node checks the patch against the ELF hash in its app description
+    if (base.size() < ELF_SHA_OFFSET + 32 || readU32(base.data() + APP_DESC_OFFSET) != APP_DESC_MAGIC) {
+        fprintf(stderr, "%s is not an ESP32 app image\n", argv[1]);
+        return 1;
+    }
+    if (image.empty() || image[0] != 0xE9) {
+        fprintf(stderr, "%s is not an ESP32 app image\n", argv[2]);
+        return 1;
+    }
+
+    PatchWriter out;
+    out.patch.insert(out.patch.end(), DeltaPatch::MAGIC, DeltaPatch::MAGIC + sizeof(DeltaPatch::MAGIC));
+    out.patch.insert(out.patch.end(), base.begin() + ELF_SHA_OFFSET, base.begin() + ELF_SHA_OFFSET + 32);
+    uint8_t size[4];
+    DeltaPatch::writeU32(size, (uint32_t)image.size());
+    out.patch.insert(out.patch.end(), size, size + sizeof(size));
+    diff(base, image, out);
+    out.patch.push_back(DeltaPatch::OP_END);
+
+    Bytes rebuilt;
+    if (!apply(base, out.patch, rebuilt) || rebuilt != image) {
+        fprintf(stderr, "patch does not rebuild %s\n", argv[2]);
+        return 1;
+    }
+
+    FILE* file = fopen(argv[3], "wb");
+    if (file == nullptr || fwrite(out.patch.data(), 1, out.patch.size(), file) != out.patch.size()) {
+        fprintf(stderr, "cannot write %s\n", argv[3]);
+        if (file != nullptr) {
+            fclose(file);
+        }
+        return 1;
+    }
+    fclose(file);
+
+    printf("image %zu B, patch %zu B (%.1f%%): %zu copies of %zu B, %zu B literal\n",
+           image.size(), out.patch.size(), 100.0 * out.patch.size() / image.size(),
+           out.copies, out.copied, out.literal);
+    return 0;
+}
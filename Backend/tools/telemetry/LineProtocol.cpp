@@ -0,0 +1,130 @@
+#include "LineProtocol.h"
+#include "TelemetrySerializer.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+class LineBuffer {
+private:
+    char* buffer;
+    size_t capacity;
+    size_t pos;
+    bool overflow;
+
+public:
+    LineBuffer(char* buf, size_t size)
+        : buffer(buf), capacity(size), pos(0), overflow(size == 0) {}
+
+    void append(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        if (overflow) {
+            return;
+        }
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buffer + pos, capacity - pos, fmt, args);
+        va_end(args);
+        if (n < 0 || (size_t)n >= capacity - pos) {
+            overflow = true;
+            return;
+        }
+        pos += n;
+    }
+
+    void raw(const char* text, size_t n) {
+        if (overflow || n >= capacity - pos) {
+            overflow = true;
+            return;
+        }
+        memcpy(buffer + pos, text, n);
+        pos += n;
+    }
+
+    // sep, key and '=' without a printf round trip; keys need no escaping
+    void key(char sep, const char* name) {
+        raw(&sep, 1);
+        raw(name, strlen(name));
+        raw("=", 1);
+    }
+
+    // Integer field value with its 'i' suffix
+    void integer(long long v) {
+        char digits[24];
+        char* p = digits + sizeof(digits);
+        *--p = 'i';
+        unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : (unsigned long long)v;
+        do {
+            *--p = (char)('0' + u % 10);
+            u /= 10;
+        } while (u > 0);
+        if (v < 0) {
+            *--p = '-';
+        }
+        raw(p, digits + sizeof(digits) - p);
+    }
+
+    size_t length() const { return overflow ? 0 : pos; }
+};
+
+}  // namespace
+
+size_t LineProtocol::format(const SensorData& data, const char* measurement, const char* tags,
+                            int64_t timestampNs, char* buffer, size_t size, uint32_t fieldMask) {
+    LineBuffer line(buffer, size);
+    line.append("%s", measurement);
+    if (tags != nullptr && tags[0] != '\0') {
+        line.append(",%s", tags);
+    }
+
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(&data);
+    char sep = ' ';
+    for (size_t i = 0; i < TelemetrySerializer::FIELD_COUNT; i++) {
+        if (!(fieldMask & (1u << i))) {
+            continue;
+        }
+        const TelemetryField& field = TelemetrySerializer::FIELDS[i];
+        const uint8_t* p = base + field.offset;
+
+        switch (field.type) {
+            case TelemetryFieldType::Float: {
+                float v;
+                memcpy(&v, p, sizeof(v));
+                if (!isfinite(v)) {
+                    continue;
+                }
+                line.key(sep, field.key);
+                line.append("%.2f", v);
+                break;
+            }
+            case TelemetryFieldType::U8:
+                line.key(sep, field.key);
+                line.integer(*p);
+                break;
+            case TelemetryFieldType::U16: {
+                uint16_t v;
+                memcpy(&v, p, sizeof(v));
+                line.key(sep, field.key);
+                line.integer(v);
+                break;
+            }
+            case TelemetryFieldType::Int: {
+                int32_t v;
+                memcpy(&v, p, sizeof(v));
+                line.key(sep, field.key);
+                line.integer(v);
+                break;
+            }
+        }
+        sep = ',';
+    }
+
+    if (sep == ' ') {
+        return 0;
+    }
+    if (timestampNs > 0) {
+        line.append(" %lld", (long long)timestampNs);
+    }
+    return line.length();
+}
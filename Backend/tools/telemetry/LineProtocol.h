@@ -0,0 +1,24 @@
+#ifndef LINE_PROTOCOL_H
+#define LINE_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+#include "TelemetrySerializer.h"
+
+// InfluxDB line protocol for one SensorData sample, e.g.
+//   garden,node=esp32-a soil_temperature=21.46,soil_moisture=512i,... 1700000000000000000
+// Field names and order come from TelemetrySerializer::FIELDS so they stay
+// aligned with the JSON payload. NaN/inf fields are omitted because
+// InfluxDB rejects them, as are fields outside fieldMask (bit n: FIELDS[n]).
+class LineProtocol {
+public:
+    // tags may be nullptr or "k=v,k2=v2"; timestampNs <= 0 lets the server stamp it.
+    // Returns the line length (no trailing newline), or 0 if it does not fit
+    // or has no fields left to write.
+    static size_t format(const SensorData& data, const char* measurement, const char* tags,
+                         int64_t timestampNs, char* buffer, size_t size,
+                         uint32_t fieldMask = TelemetrySerializer::ALL_FIELDS);
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include "TelemetryParser.h"
+#include "TelemetrySerializer.h"
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+const int MAX_DEPTH = 16;
+
+class Cursor {
+private:
+    const char* p;
+    const char* end;
+
+public:
+    Cursor(const char* json, size_t length) : p(json), end(json + length) {}
+
+    const char* position() const { return p; }
+    void rewind(const char* to) { p = to; }
+
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+            p++;
+        }
+    }
+
+    bool atEnd() {
+        skipSpace();
+        return p == end;
+    }
+
+    bool peek(char c) {
+        skipSpace();
+        return p < end && *p == c;
+    }
+
+    bool consume(char c) {
+        if (!peek(c)) {
+            return false;
+        }
+        p++;
+        return true;
+    }
+
+    bool consumeWord(const char* word) {
+        size_t length = strlen(word);
+        if ((size_t)(end - p) < length || memcmp(p, word, length) != 0) {
+            return false;
+        }
+        p += length;
+        return true;
+    }
+
+    // Span of a string's raw contents, escapes left as they are
+    bool string(const char*& text, size_t& length) {
+        if (!consume('"')) {
+            return false;
+        }
+        text = p;
+        while (p < end && *p != '"') {
+            if (*p == '\\') {
+                p++;
+            }
+            p++;
+        }
+        if (p >= end) {
+            return false;
+        }
+        length = p - text;
+        p++;
+        return true;
+    }
+
+    // JSON numbers plus the firmware's nan/inf and null, which read as NaN
+    bool number(double& value) {
+        skipSpace();
+        bool negative = p < end && *p == '-';
+        if (negative) {
+            p++;
+        }
+        if (p < end && (*p == 'n' || *p == 'i')) {
+            if (consumeWord("nan") || consumeWord("null")) {
+                value = NAN;
+                return true;
+            }
+            if (consumeWord("inf")) {
+                value = negative ? -INFINITY : INFINITY;
+                return true;
+            }
+            return false;
+        }
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + (*p - '0');
+            } else {
+                exponent++;
+            }
+        }
+        if (p < end && *p == '.') {
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+                if (mantissa < 100000000000000000ull) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    exponent--;
+                }
+            }
+        }
+        if (digits == 0) {
+            return false;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            bool negativeExponent = p < end && *p == '-';
+            if (p < end && (*p == '-' || *p == '+')) {
+                p++;
+            }
+            int e = 0;
+            int exponentDigits = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; p++, exponentDigits++) {
+                if (e < 1000) {
+                    e = e * 10 + (*p - '0');
+                }
+            }
+            if (exponentDigits == 0) {
+                return false;
+            }
+            exponent += negativeExponent ? -e : e;
+        }
+
+        static const double POWERS[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10 };
+        double v = (double)mantissa;
+        if (exponent >= 0 && exponent <= 10) {
+            v *= POWERS[exponent];
+        } else if (exponent < 0 && exponent >= -10) {
+            v /= POWERS[-exponent];
+        } else {
+            v *= pow(10.0, exponent);
+        }
+        value = negative ? -v : v;
+        return true;
+    }
+
+    bool skipValue(int depth) {
+        if (depth > MAX_DEPTH) {
+            return false;
+        }
+        skipSpace();
+        if (p >= end) {
+            return false;
+        }
+        if (*p == '"') {
+            const char* text;
+            size_t length;
+            return string(text, length);
+        }
+        if (*p == '{' || *p == '[') {
+            char close = *p == '{' ? '}' : ']';
+            bool object = *p == '{';
+            p++;
+            if (consume(close)) {
+                return true;
+            }
+            do {
+                if (object) {
+                    const char* key;
+                    size_t length;
+                    if (!string(key, length) || !consume(':')) {
+                        return false;
+                    }
+                }
+                if (!skipValue(depth + 1)) {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(close);
+        }
+        if (consumeWord("true") || consumeWord("false")) {
+            return true;
+        }
+        double ignored;
+        return number(ignored);
+    }
+};
+
+bool keyIs(const char* key, size_t length, const char* name) {
+    return strlen(name) == length && memcmp(key, name, length) == 0;
+}
+
+// The firmware writes fields in table order, so the one after the last
+// match is tried first
+int fieldIndex(const char* key, size_t length, size_t expected) {
+    if (expected < TelemetrySerializer::FIELD_COUNT &&
+        keyIs(key, length, TelemetrySerializer::FIELDS[expected].key)) {
+        return (int)expected;
+    }
+    for (size_t i = 0; i < TelemetrySerializer::FIELD_COUNT; i++) {
+        if (keyIs(key, length, TelemetrySerializer::FIELDS[i].key)) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Integer fields only take finite values in range; anything else is
+// treated as not reported
+bool store(const TelemetryField& field, double v, SensorData& data) {
+    uint8_t* p = reinterpret_cast<uint8_t*>(&data) + field.offset;
+    switch (field.type) {
+        case TelemetryFieldType::Float: {
+            float f = (float)v;
+            memcpy(p, &f, sizeof(f));
+            return true;
+        }
+        case TelemetryFieldType::U8:
+            if (!(v >= 0 && v <= 255)) {
+                return false;
+            }
+            *p = (uint8_t)v;
+            return true;
+        case TelemetryFieldType::U16: {
+            if (!(v >= 0 && v <= 65535)) {
+                return false;
+            }
+            uint16_t u = (uint16_t)v;
+            memcpy(p, &u, sizeof(u));
+            return true;
+        }
+        case TelemetryFieldType::Int: {
+            if (!(v >= -2147483648.0 && v <= 2147483647.0)) {
+                return false;
+            }
+            int32_t i = (int32_t)v;
+            memcpy(p, &i, sizeof(i));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool storeU32(double v, uint32_t& out) {
+    if (!(v >= 0 && v <= 4294967295.0)) {
+        return false;
+    }
+    out = (uint32_t)v;
+    return true;
+}
+
+bool parseObject(Cursor& cursor, ParsedSample& sample) {
+    memset(&sample, 0, sizeof(sample));
+    if (!cursor.consume('{')) {
+        return false;
+    }
+    if (cursor.consume('}')) {
+        return true;
+    }
+    size_t expected = 0;
+    do {
+        const char* key;
+        size_t length;
+        if (!cursor.string(key, length) || !cursor.consume(':')) {
+            return false;
+        }
+
+        int index = fieldIndex(key, length, expected);
+        bool isSeq = index < 0 && keyIs(key, length, "seq");
+        bool isTs = index < 0 && !isSeq && keyIs(key, length, "ts");
+        if (index < 0 && !isSeq && !isTs) {
+            if (!cursor.skipValue(0)) {
+                return false;
+            }
+            continue;
+        }
+
+        double v;
+        if (!cursor.number(v)) {
+            return false;
+        }
+        if (index >= 0) {
+            expected = index + 1;
+            if (store(TelemetrySerializer::FIELDS[index], v, sample.data)) {
+                sample.fieldMask |= 1u << index;
+            }
+        } else if (isSeq) {
+            sample.hasSeq = storeU32(v, sample.seq);
+        } else if (!storeU32(v, sample.timestamp)) {
+            sample.timestamp = 0;
+        }
+    } while (cursor.consume(','));
+    return cursor.consume('}');
+}
+
+}  // namespace
+
+bool TelemetryParser::parse(const char* json, size_t length, ParsedSample& sample) {
+    Cursor cursor(json, length);
+    return parseObject(cursor, sample) && cursor.atEnd();
+}
+
+int TelemetryParser::parsePayload(const char* json, size_t length, SampleCallback callback, void* context) {
+    Cursor cursor(json, length);
+    const char* start = cursor.position();
+    ParsedSample sample;
+
+    const char* key;
+    size_t keyLength;
+    bool batch = cursor.consume('{') && cursor.string(key, keyLength) &&
+                 keyIs(key, keyLength, "samples") && cursor.consume(':') && cursor.peek('[');
+    if (!batch) {
+        cursor.rewind(start);
+        if (!parseObject(cursor, sample) || !cursor.atEnd()) {
+            return -1;
+        }
+        callback(sample, context);
+        return 1;
+    }
+
+    int count = 0;
+    cursor.consume('[');
+    if (!cursor.consume(']')) {
+        do {
+            if (!parseObject(cursor, sample)) {
+                return -1;
+            }
+            callback(sample, context);
+            count++;
+        } while (cursor.consume(','));
+        if (!cursor.consume(']')) {
+            return -1;
+        }
+    }
+    return cursor.consume('}') && cursor.atEnd() ? count : -1;
+}
@@ -0,0 +1,36 @@
+#ifndef TELEMETRY_PARSER_H
+#define TELEMETRY_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+
+// A sample read back from the firmware's telemetry JSON. Delta payloads
+// carry only the fields that changed; fieldMask (bit n: FIELDS[n]) says
+// which members of data were present.
+struct ParsedSample {
+    SensorData data;
+    uint32_t fieldMask;
+    uint32_t seq;
+    uint32_t timestamp;     // Unix seconds, 0 if absent or not yet synced
+    bool hasSeq;
+};
+
+// Reads TelemetrySerializer output in place: no copies, no allocation, and
+// the payload need not be NUL-terminated. Accepts the bare nan/inf tokens
+// the firmware writes for missing readings (they parse as NaN/inf) and
+// skips keys it does not know, so newer payloads still load.
+class TelemetryParser {
+public:
+    typedef void (*SampleCallback)(const ParsedSample& sample, void* context);
+
+    // One sample object; false if it is not well-formed
+    static bool parse(const char* json, size_t length, ParsedSample& sample);
+
+    // A single sample, or a {"samples":[...]} batch: calls back once per
+    // sample, oldest first. Returns the number of samples, -1 if malformed
+    // (samples before the error have already been delivered).
+    static int parsePayload(const char* json, size_t length, SampleCallback callback, void* context);
+};
+
+#endif
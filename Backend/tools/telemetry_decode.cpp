@@ -0,0 +1,116 @@
+// Converts binary telemetry records (/home/sensors/<id>/bin) back to the JSON
+// payload published on /home/sensors/<id>, or to InfluxDB line protocol.
+//
+// Reads one hex-encoded record per line from stdin, which is what
+//   mosquitto_sub -t /home/sensors/+/bin -F %x
+// prints. Malformed lines are reported on stderr and skipped.
+//
+// Usage: telemetry_decode [--influx] [--measurement NAME] [--tags k=v,...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "SensorData.h"
+#include "TelemetryRecord.h"
+#include "TelemetrySerializer.h"
+#include "telemetry/LineProtocol.h"
+
+namespace {
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Returns the decoded byte count, or -1 on a malformed line
+int parseHex(const std::string& line, uint8_t* out, size_t size) {
+    size_t n = 0;
+    int high = -1;
+    for (char c : line) {
+        if (c == ' ' || c == '\r' || c == '\t') {
+            continue;
+        }
+        int v = hexValue(c);
+        if (v < 0) {
+            return -1;
+        }
+        if (high < 0) {
+            high = v;
+            continue;
+        }
+        if (n >= size) {
+            return -1;
+        }
+        out[n++] = (uint8_t)((high << 4) | v);
+        high = -1;
+    }
+    return high < 0 ? (int)n : -1;
+}
+
+void usage(const char* argv0) {
+    fprintf(stderr, "Usage: %s [--influx] [--measurement NAME] [--tags k=v,...]\n", argv0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    bool influx = false;
+    const char* measurement = "garden";
+    const char* tags = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--influx") == 0) {
+            influx = true;
+        } else if (strcmp(argv[i], "--measurement") == 0 && i + 1 < argc) {
+            measurement = argv[++i];
+        } else if (strcmp(argv[i], "--tags") == 0 && i + 1 < argc) {
+            tags = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    char line[4096];
+    char output[1024];
+    uint8_t record[256];
+    unsigned long lineNumber = 0;
+    unsigned long errors = 0;
+
+    while (fgets(line, sizeof(line), stdin) != nullptr) {
+        lineNumber++;
+        std::string text(line);
+        while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+            text.pop_back();
+        }
+        if (text.empty()) {
+            continue;
+        }
+
+        int length = parseHex(text, record, sizeof(record));
+        SensorData data = {};
+        if (length < 0 || !TelemetryRecord::decode(record, length, data)) {
+            fprintf(stderr, "line %lu: not a telemetry record (version 1-%u)\n",
+                    lineNumber, (unsigned)TelemetryRecord::VERSION);
+            errors++;
+            continue;
+        }
+
+        size_t n = influx
+            ? LineProtocol::format(data, measurement, tags, 0, output, sizeof(output))
+            : TelemetrySerializer::serialize(data, output, sizeof(output));
+        if (n == 0) {
+            fprintf(stderr, "line %lu: output buffer too small\n", lineNumber);
+            errors++;
+            continue;
+        }
+        fwrite(output, 1, n, stdout);
+        fputc('\n', stdout);
+    }
+
+    return errors == 0 ? 0 : 1;
+}
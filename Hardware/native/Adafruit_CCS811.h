@@ -0,0 +1,25 @@
+#ifndef NATIVE_ADAFRUIT_CCS811_H
+#define NATIVE_ADAFRUIT_CCS811_H
+
+#include <Arduino.h>
+#include "FakeDevices.h"
+
+class Adafruit_CCS811 {
+private:
+    uint16_t eco2 = 0;
+    uint16_t voc = 0;
+
+public:
+    bool begin(uint8_t address = 0x5A) { return true; }
+    bool available() { return true; }
+    // 0 on success, like the real driver
+    uint8_t readData() {
+        eco2 = FakeDevices::co2(millis());
+        voc = FakeDevices::tvoc(millis());
+        return 0;
+    }
+    uint16_t geteCO2() { return eco2; }
+    uint16_t getTVOC() { return voc; }
+};
+
+#endif
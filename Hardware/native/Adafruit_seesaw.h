@@ -0,0 +1,15 @@
+#ifndef NATIVE_ADAFRUIT_SEESAW_H
+#define NATIVE_ADAFRUIT_SEESAW_H
+
+#include <Arduino.h>
+#include "FakeDevices.h"
+
+// STEMMA soil sensor
+class Adafruit_seesaw {
+public:
+    bool begin(uint8_t address = 0x49) { return true; }
+    float getTemp() { return FakeDevices::soilTemperature(millis()); }
+    uint16_t touchRead(uint8_t pin) { return FakeDevices::soilMoisture(millis()); }
+};
+
+#endif
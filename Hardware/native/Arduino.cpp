@@ -0,0 +1,222 @@
+#include "Arduino.h"
+#include "Wire.h"
+#include "FakeDevices.h"
+#include "HeapStats.h"
+#include "VirtualClock.h"
+#include "esp_adc_cal.h"
+#include "esp_sleep.h"
+#include <thread>
+
+HardwareSerial Serial(0);
+HardwareSerial Serial2(2);
+TwoWire Wire;
+EspClass ESP;
+
+bool HardwareSerial::echo = false;
+
+String::String(long v, int base) {
+    char buf[24];
+    if (base == HEX) {
+        snprintf(buf, sizeof(buf), "%lx", (unsigned long)v);
+    } else {
+        snprintf(buf, sizeof(buf), "%ld", v);
+    }
+    text = buf;
+}
+
+String::String(unsigned long v, int base) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lx" : "%lu", v);
+    text = buf;
+}
+
+String::String(double v, int decimals) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    text = buf;
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (n < size && write(buffer[n])) {
+        n++;
+    }
+    return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (n < 0) {
+        return 0;
+    }
+    return write(reinterpret_cast<const uint8_t*>(buf), (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    bytesWritten++;
+    if (port == 0 && echo) {
+        fputc(c, stdout);
+    }
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    bytesWritten += size;
+    if (port == 0 && echo) {
+        fwrite(buffer, 1, size, stdout);
+    }
+    return size;
+}
+
+int HardwareSerial::available() {
+    return port == 1 ? FakeDevices::sdsAvailable(millis()) : 0;
+}
+
+int HardwareSerial::read() {
+    return port == 1 ? FakeDevices::sdsRead(millis()) : -1;
+}
+
+unsigned long millis() {
+    return (unsigned long)(VirtualClock::nowMicros() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)VirtualClock::nowMicros();
+}
+
+void delay(unsigned long ms) {
+    VirtualClock::sleepFor((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    VirtualClock::sleepFor(us);
+}
+
+void yield() {
+}
+
+void pinMode(int pin, int mode) {
+}
+
+void digitalWrite(int pin, int value) {
+    FakeDevices::pins[pin & 63] = value;
+}
+
+int digitalRead(int pin) {
+    return FakeDevices::pins[pin & 63];
+}
+
+int analogRead(int pin) {
+    return FakeDevices::analog(pin, millis());
+}
+
+void analogReadResolution(uint8_t bits) {
+}
+
+void analogSetPinAttenuation(uint8_t pin, adc_attenuation_t attenuation) {
+}
+
+// A chip with two-point eFuse data: 142 mV at count 0 to 3139 mV at 4095,
+// the typical 11 dB curve, taken as a straight line
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten, adc_bits_width_t width,
+                                             uint32_t defaultVref, esp_adc_cal_characteristics_t* chars) {
+    chars->coeff_a = 3139 - 142;
+    chars->coeff_b = 142;
+    return ESP_ADC_CAL_VAL_EFUSE_TP;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t raw, const esp_adc_cal_characteristics_t* chars) {
+    return chars->coeff_b + raw * chars->coeff_a / 4095;
+}
+
+long random(long max) {
+    return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max) {
+    return max > min ? min + rand() % (max - min) : min;
+}
+
+void configTime(long gmtOffset, int daylightOffset, const char* server1,
+                const char* server2, const char* server3) {
+}
+
+void EspClass::restart() {
+    fprintf(stderr, "ESP.restart() at %lu ms\n", millis());
+    fflush(stdout);
+    _Exit(3);
+}
+
+uint32_t EspClass::getFreeHeap() {
+    // The ESP32 has roughly 300 KB of heap after WiFi starts
+    uint64_t used = HeapStats::inUse();
+    return used < 300000 ? (uint32_t)(300000 - used) : 0;
+}
+
+// ---- Deep sleep ----
+
+namespace {
+uint64_t sleepTimerMicros = 0;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+    return ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+int esp_sleep_enable_timer_wakeup(uint64_t micros) {
+    sleepTimerMicros = micros;
+    return 0;
+}
+
+void esp_deep_sleep_start() {
+    fprintf(stderr, "esp_deep_sleep_start() at %lu ms for %llu ms\n", millis(),
+            (unsigned long long)(sleepTimerMicros / 1000));
+    fflush(stdout);
+    _Exit(0);
+}
+
+// ---- FreeRTOS ----
+
+namespace {
+
+struct TaskStart {
+    void (*task)(void*);
+    void* parameter;
+};
+
+}  // namespace
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stackDepth,
+                                   void* parameter, UBaseType_t priority,
+                                   TaskHandle_t* handle, BaseType_t core) {
+    VirtualClock::join();
+    TaskStart start = { task, parameter };
+    std::thread thread([start]() { start.task(start.parameter); });
+    if (handle != nullptr) {
+        *handle = reinterpret_cast<TaskHandle_t>(thread.native_handle());
+    }
+    thread.detach();
+    return pdPASS;
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)millis();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment) {
+    *previousWake += increment;
+    VirtualClock::sleepUntil((uint64_t)*previousWake * 1000);
+}
+
+uint64_t EspClass::getEfuseMac() {
+    // 24:0a:c4:12:34:56, first octet in the low byte as on the chip
+    return 0x563412c40a24ULL;
+}
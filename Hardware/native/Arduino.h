@@ -0,0 +1,154 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Host stand-in for the parts of the ESP32 Arduino core the firmware uses.
+// Time comes from VirtualClock; sensors, radio and flash are the fakes
+// alongside this file.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdarg.h>
+#include <time.h>
+#include <string>
+#include "FreeRTOS.h"
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define DEC 10
+#define HEX 16
+#define SERIAL_8N1 0x800001c
+
+class String {
+private:
+    std::string text;
+
+public:
+    String(const char* s = "") : text(s ? s : "") {}
+    String(const std::string& s) : text(s) {}
+    String(char c) : text(1, c) {}
+    String(int v, int base = DEC) : String((long)v, base) {}
+    String(unsigned v, int base = DEC) : String((unsigned long)v, base) {}
+    String(long v, int base = DEC);
+    String(unsigned long v, int base = DEC);
+    String(float v, int decimals = 2) : String((double)v, decimals) {}
+    String(double v, int decimals = 2);
+
+    const char* c_str() const { return text.c_str(); }
+    unsigned length() const { return (unsigned)text.size(); }
+
+    String& operator+=(const String& s) { text += s.text; return *this; }
+    String& operator+=(const char* s) { text += s; return *this; }
+    String& operator+=(char c) { text += c; return *this; }
+    friend String operator+(const String& a, const String& b) { return String(a.text + b.text); }
+    friend String operator+(const String& a, const char* b) { return String(a.text + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.text); }
+
+    bool operator==(const String& s) const { return text == s.text; }
+    bool operator==(const char* s) const { return text == s; }
+    bool operator!=(const String& s) const { return text != s.text; }
+    bool operator!=(const char* s) const { return text != s; }
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v, int base = DEC) { return print(String(v, base)); }
+    size_t print(unsigned v, int base = DEC) { return print(String(v, base)); }
+    size_t print(long v, int base = DEC) { return print(String(v, base)); }
+    size_t print(unsigned long v, int base = DEC) { return print(String(v, base)); }
+    size_t print(double v, int decimals = 2) { return print(String(v, decimals)); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& v) { return print(v) + println(); }
+    template <typename T> size_t println(const T& v, int format) { return print(v, format) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int peek() { return -1; }
+};
+
+// Serial (port 0) goes to stdout when echo is on; other ports are silent
+class HardwareSerial : public Stream {
+private:
+    int port;
+
+public:
+    static bool echo;
+    uint64_t bytesWritten = 0;   // what the UART would have had to send
+
+    explicit HardwareSerial(int uart) : port(uart) {}
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int rxPin = -1, int txPin = -1) {}
+    void end() {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    // Port 1 receives the fake SDS011's frames
+    int available() override;
+    int read() override;
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial2;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+int analogRead(int pin);
+void analogReadResolution(uint8_t bits);
+
+typedef enum {
+    ADC_0db,
+    ADC_2_5db,
+    ADC_6db,
+    ADC_11db
+} adc_attenuation_t;
+
+void analogSetPinAttenuation(uint8_t pin, adc_attenuation_t attenuation);
+
+long random(long max);
+long random(long min, long max);
+
+void configTime(long gmtOffset, int daylightOffset, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
+
+class EspClass {
+public:
+    void restart();
+    uint32_t getFreeHeap();
+    uint64_t getEfuseMac();
+};
+
+extern EspClass ESP;
+
+// Firmware entry points, called by the host main()
+void setup();
+void loop();
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef NATIVE_DFROBOT_C4001_H
+#define NATIVE_DFROBOT_C4001_H
+
+#include <Arduino.h>
+#include "FakeDevices.h"
+
+// C4001 mmWave radar over UART
+class DFRobot_C4001_UART {
+public:
+    DFRobot_C4001_UART(Stream* serial, uint32_t baud, uint8_t rxPin = 0, uint8_t txPin = 0) {}
+    bool begin() { return true; }
+    uint8_t getTargetNumber() { return FakeDevices::targetCount(millis()); }
+    float getTargetSpeed() { return FakeDevices::targetSpeed(millis()); }
+    float getTargetRange() { return FakeDevices::targetRange(millis()); }
+    uint32_t getTargetEnergy() { return FakeDevices::targetEnergy(millis()); }
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef NATIVE_DHT_H
+#define NATIVE_DHT_H
+
+#include <Arduino.h>
+#include "FakeDevices.h"
+
+#define DHT11 11
+
+class DHT {
+public:
+    DHT(uint8_t pin, uint8_t type, uint8_t count = 6) {}
+    void begin(uint8_t usec = 55) {}
+    float readTemperature(bool fahrenheit = false, bool force = false) {
+        return FakeDevices::airTemperature(millis());
+    }
+    float readHumidity(bool force = false) { return FakeDevices::humidity(millis()); }
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "FakeBroker.h"
+
+FakeBroker Broker;
+
+void FakeBroker::publish(const char* topic, const uint8_t* payload, size_t length, bool retain) {
+    TopicStats& stats = topics[topic];
+    stats.messages++;
+    stats.bytes += length;
+    if (retain) {
+        retained[topic].assign(reinterpret_cast<const char*>(payload), length);
+    }
+}
+
+void FakeBroker::inject(const char* topic, const char* payload) {
+    Message message = { topic, payload };
+    inbound.push_back(message);
+}
+
+uint32_t FakeBroker::totalMessages() const {
+    uint32_t total = 0;
+    for (const auto& entry : topics) {
+        total += entry.second.messages;
+    }
+    return total;
+}
+
+uint64_t FakeBroker::totalBytes() const {
+    uint64_t total = 0;
+    for (const auto& entry : topics) {
+        total += entry.second.bytes;
+    }
+    return total;
+}
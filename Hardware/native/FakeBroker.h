@@ -0,0 +1,41 @@
+#ifndef FAKE_BROKER_H
+#define FAKE_BROKER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <map>
+#include <string>
+
+// In-memory MQTT broker shared by every PubSubClient in the process.
+// Keeps per-topic traffic counters and retained messages, and queues
+// messages injected by the host (e.g. commands) for delivery on the
+// subscriber's next loop().
+class FakeBroker {
+public:
+    struct TopicStats {
+        uint32_t messages;
+        uint64_t bytes;
+    };
+
+    struct Message {
+        std::string topic;
+        std::string payload;
+    };
+
+    std::map<std::string, TopicStats> topics;
+    std::map<std::string, std::string> retained;
+    std::deque<Message> inbound;
+    uint32_t connects = 0;
+    bool available = true;
+
+    void publish(const char* topic, const uint8_t* payload, size_t length, bool retain);
+    void inject(const char* topic, const char* payload);
+
+    uint32_t totalMessages() const;
+    uint64_t totalBytes() const;
+};
+
+extern FakeBroker Broker;
+
+#endif
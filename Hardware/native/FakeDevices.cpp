@@ -0,0 +1,153 @@
+#include "FakeDevices.h"
+#include <math.h>
+#include <stddef.h>
+
+namespace {
+
+const double DAY = 86400000.0;
+const double PI = 3.14159265358979;
+
+// Position in the daily cycle, -1..1, peaking mid-afternoon
+double daily(unsigned long now) {
+    return sin(2 * PI * (now / DAY - 0.375));
+}
+
+// Deterministic noise in -1..1 for a given time bucket and source
+double noise(unsigned long now, uint32_t source, unsigned long bucketMillis) {
+    uint32_t x = (uint32_t)(now / bucketMillis) * 2654435761u ^ source * 40503u;
+    x ^= x >> 13;
+    x *= 0x5bd1e995;
+    x ^= x >> 15;
+    return (x & 0xFFFF) / 32767.5 - 1.0;
+}
+
+// SDS011 UART state: pending bytes and when the next frame is due
+bool sdsAwake = false;
+unsigned long sdsNextFrame = 0;
+uint32_t sdsFrameNumber = 0;
+uint8_t sdsBytes[64];
+size_t sdsHead = 0;
+size_t sdsCount = 0;
+
+void sdsPush(uint8_t byte) {
+    if (sdsCount < sizeof(sdsBytes)) {   // a full UART buffer drops bytes too
+        sdsBytes[(sdsHead + sdsCount++) % sizeof(sdsBytes)] = byte;
+    }
+}
+
+void sdsFrame(float pm25, float pm10) {
+    uint32_t n = ++sdsFrameNumber;
+    if (n % 17 == 0) {
+        sdsPush(0x00);
+        sdsPush(0xAA);
+        sdsPush(0x42);
+    }
+    uint16_t small = (uint16_t)(pm25 * 10 + 0.5f);
+    uint16_t large = (uint16_t)(pm10 * 10 + 0.5f);
+    uint8_t frame[10] = { 0xAA, 0xC0, (uint8_t)small, (uint8_t)(small >> 8),
+                          (uint8_t)large, (uint8_t)(large >> 8), 0x12, 0x34, 0, 0xAB };
+    for (int i = 2; i < 8; i++) {
+        frame[8] += frame[i];
+    }
+    if (n % 11 == 0) {
+        frame[8] ^= 0x5A;
+    }
+    size_t length = n % 23 == 0 ? 6 : sizeof(frame);
+    for (size_t i = 0; i < length; i++) {
+        sdsPush(frame[i]);
+    }
+}
+
+void sdsGenerate(unsigned long now) {
+    while (sdsAwake && (long)(now - sdsNextFrame) >= 0) {
+        sdsFrame(FakeDevices::pm25(sdsNextFrame), FakeDevices::pm10(sdsNextFrame));
+        sdsNextFrame += 1000;
+    }
+}
+
+}  // namespace
+
+namespace FakeDevices {
+
+int pins[64];
+
+int analog(int pin, unsigned long now) {
+    return 310 + (int)(40 * daily(now) + 12 * noise(now, pin, 1000));
+}
+
+float soilTemperature(unsigned long now) {
+    return (float)(17.5 + 2.5 * daily(now - 7200000) + 0.05 * noise(now, 1, 10000));
+}
+
+uint16_t soilMoisture(unsigned long now) {
+    // Dries out over the day, watered back up at midnight
+    double dry = fmod(now, DAY) / DAY;
+    return (uint16_t)(820 - 260 * dry + 4 * noise(now, 2, 10000));
+}
+
+float airTemperature(unsigned long now) {
+    return (float)(19.0 + 6.0 * daily(now) + 0.3 * noise(now, 3, 2000));
+}
+
+float humidity(unsigned long now) {
+    return (float)(60.0 - 15.0 * daily(now) + 1.0 * noise(now, 4, 2000));
+}
+
+uint16_t co2(unsigned long now) {
+    return (uint16_t)(520 + 120 * (1 - daily(now)) + 15 * noise(now, 5, 1000));
+}
+
+uint16_t tvoc(unsigned long now) {
+    return (uint16_t)(18 + 12 * (1 - daily(now)) + 3 * noise(now, 6, 1000));
+}
+
+uint8_t targetCount(unsigned long now) {
+    // Someone passes by for a minute every now and then
+    return noise(now, 7, 60000) > 0.6 ? 1 : 0;
+}
+
+float targetSpeed(unsigned long now) {
+    return (float)(0.4 + 0.3 * noise(now, 8, 200));
+}
+
+float targetRange(unsigned long now) {
+    return (float)(2.5 + 1.5 * noise(now, 9, 5000));
+}
+
+uint32_t targetEnergy(unsigned long now) {
+    return (uint32_t)(1500 + 500 * noise(now, 10, 1000));
+}
+
+float pm25(unsigned long now) {
+    return (float)(9.0 + 4.0 * daily(now + 21600000) + 0.8 * noise(now, 11, 1000));
+}
+
+float pm10(unsigned long now) {
+    return pm25(now) * 1.6f + (float)(0.5 * noise(now, 12, 1000));
+}
+
+void sdsPower(bool awake, unsigned long now) {
+    sdsGenerate(now);
+    if (awake && !sdsAwake) {
+        sdsNextFrame = now + 1000;
+    }
+    sdsAwake = awake;
+}
+
+int sdsAvailable(unsigned long now) {
+    sdsGenerate(now);
+    return (int)sdsCount;
+}
+
+int sdsRead(unsigned long now) {
+    sdsGenerate(now);
+    if (sdsCount == 0) {
+        return -1;
+    }
+    uint8_t byte = sdsBytes[sdsHead];
+    sdsHead = (sdsHead + 1) % sizeof(sdsBytes);
+    sdsCount--;
+    return byte;
+}
+
+}  // namespace FakeDevices
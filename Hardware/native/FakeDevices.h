@@ -0,0 +1,37 @@
+#ifndef FAKE_DEVICES_H
+#define FAKE_DEVICES_H
+
+#include <stdint.h>
+
+// A simulated garden for the host build: every fake sensor reads from here.
+// Values follow slow daily cycles plus a little deterministic noise, so
+// filters, deadbands and statistics see realistic input.
+namespace FakeDevices {
+
+extern int pins[64];
+
+// 12-bit ADC reading of an analog pin (the MQ-8 on pin 34)
+int analog(int pin, unsigned long nowMillis);
+
+float soilTemperature(unsigned long nowMillis);
+uint16_t soilMoisture(unsigned long nowMillis);
+float airTemperature(unsigned long nowMillis);
+float humidity(unsigned long nowMillis);
+uint16_t co2(unsigned long nowMillis);
+uint16_t tvoc(unsigned long nowMillis);
+uint8_t targetCount(unsigned long nowMillis);
+float targetSpeed(unsigned long nowMillis);
+float targetRange(unsigned long nowMillis);
+uint32_t targetEnergy(unsigned long nowMillis);
+float pm25(unsigned long nowMillis);
+float pm10(unsigned long nowMillis);
+
+// The SDS011's UART: while awake it reports a frame a second, with the
+// odd corrupt, truncated or noise-prefixed one mixed in
+void sdsPower(bool awake, unsigned long nowMillis);
+int sdsAvailable(unsigned long nowMillis);
+int sdsRead(unsigned long nowMillis);
+
+}  // namespace FakeDevices
+
+#endif
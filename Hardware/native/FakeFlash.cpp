@@ -0,0 +1,206 @@
+#include "esp_ota_ops.h"
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace FakeFlash {
+
+namespace {
+
+const uint32_t PARTITION_SIZE = 0x140000;
+const size_t SYNTHETIC_SIZE = 600 * 1024;
+const uint8_t IMAGE_MAGIC = 0xE9;
+const uint32_t APP_DESC_MAGIC = 0xABCD5432;
+
+const esp_partition_t PARTITIONS[2] = {
+    { ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, PARTITION_SIZE, "app0", false },
+    { ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x150000, PARTITION_SIZE, "app1", false },
+};
+
+struct Flash {
+    std::vector<uint8_t> contents[2];
+    size_t imageLength[2] = { 0, 0 };
+    int running = 0;
+    int boot = 0;
+    int writing = -1;
+    size_t writeOffset = 0;
+    esp_app_desc_t description;
+};
+
+// A stand-in firmware: image magic, an app description with an ELF hash,
+// then filler
+std::string syntheticImage() {
+    std::string image(SYNTHETIC_SIZE, '\0');
+    uint32_t seed = 0x2545F491;
+    for (size_t i = 0; i < image.size(); i++) {
+        seed = seed * 1664525 + 1013904223;
+        image[i] = (char)(seed >> 24);
+    }
+    image[0] = (char)IMAGE_MAGIC;
+    esp_app_desc_t app;
+    memset(&app, 0, sizeof(app));
+    app.magic_word = APP_DESC_MAGIC;
+    strcpy(app.project_name, "garden");
+    strcpy(app.version, "native");
+    for (size_t i = 0; i < sizeof(app.app_elf_sha256); i++) {
+        app.app_elf_sha256[i] = (uint8_t)(i * 7 + 1);
+    }
+    memcpy(&image[APP_DESC_OFFSET], &app, sizeof(app));
+    return image;
+}
+
+Flash& flash() {
+    static Flash state;
+    static bool ready = false;
+    if (!ready) {
+        ready = true;
+        for (int i = 0; i < 2; i++) {
+            state.contents[i].assign(PARTITION_SIZE, 0xFF);
+        }
+        std::string image = syntheticImage();
+        memcpy(state.contents[0].data(), image.data(), image.size());
+        state.imageLength[0] = image.size();
+    }
+    return state;
+}
+
+int indexOf(const esp_partition_t* partition) {
+    for (int i = 0; i < 2; i++) {
+        if (partition == &PARTITIONS[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+}  // namespace
+
+void begin() {
+    flash();
+}
+
+void setRunningImage(const std::string& image) {
+    Flash& f = flash();
+    std::vector<uint8_t>& contents = f.contents[f.running];
+    size_t length = image.size() < contents.size() ? image.size() : contents.size();
+    std::fill(contents.begin(), contents.end(), 0xFF);
+    memcpy(contents.data(), image.data(), length);
+    f.imageLength[f.running] = length;
+}
+
+std::string runningImage() {
+    Flash& f = flash();
+    return std::string(f.contents[f.running].begin(), f.contents[f.running].begin() + f.imageLength[f.running]);
+}
+
+std::string partitionContents(const esp_partition_t* partition, size_t length) {
+    int index = indexOf(partition);
+    if (index < 0) {
+        return std::string();
+    }
+    const std::vector<uint8_t>& contents = flash().contents[index];
+    return std::string(contents.begin(), contents.begin() + (length < contents.size() ? length : contents.size()));
+}
+
+void bootSelected() {
+    flash().running = flash().boot;
+}
+
+}  // namespace FakeFlash
+
+using namespace FakeFlash;
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label) {
+    for (const esp_partition_t& partition : PARTITIONS) {
+        if (partition.type == type &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || partition.subtype == subtype) &&
+            (label == nullptr || strcmp(partition.label, label) == 0)) {
+            return &partition;
+        }
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    int index = indexOf(partition);
+    if (index < 0 || src_offset > partition->size || size > partition->size - src_offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(dst, flash().contents[index].data() + src_offset, size);
+    return ESP_OK;
+}
+
+const esp_partition_t* esp_ota_get_running_partition() {
+    return &PARTITIONS[flash().running];
+}
+
+const esp_partition_t* esp_ota_get_boot_partition() {
+    return &PARTITIONS[flash().boot];
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+    return &PARTITIONS[1 - flash().running];
+}
+
+const esp_app_desc_t* esp_ota_get_app_description() {
+    Flash& f = flash();
+    memcpy(&f.description, f.contents[f.running].data() + APP_DESC_OFFSET, sizeof(f.description));
+    return &f.description;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle) {
+    Flash& f = flash();
+    int index = indexOf(partition);
+    if (index < 0 || index == f.running || f.writing >= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::fill(f.contents[index].begin(), f.contents[index].end(), 0xFF);
+    f.imageLength[index] = 0;
+    f.writing = index;
+    f.writeOffset = 0;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    Flash& f = flash();
+    if (handle != 1 || f.writing < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (size > PARTITION_SIZE - f.writeOffset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(f.contents[f.writing].data() + f.writeOffset, data, size);
+    f.writeOffset += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    Flash& f = flash();
+    if (handle != 1 || f.writing < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int index = f.writing;
+    f.writing = -1;
+    if (f.writeOffset == 0 || f.contents[index][0] != IMAGE_MAGIC) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    f.imageLength[index] = f.writeOffset;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    flash().writing = -1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+    Flash& f = flash();
+    int index = indexOf(partition);
+    if (index < 0 || f.contents[index][0] != IMAGE_MAGIC) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    f.boot = index;
+    return ESP_OK;
+}
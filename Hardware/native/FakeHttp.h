@@ -0,0 +1,24 @@
+#ifndef FAKE_HTTP_H
+#define FAKE_HTTP_H
+
+#include <stdint.h>
+#include <string>
+
+// File server on the simulated LAN at HOST:PORT, answering HTTP GETs from
+// WiFiClient with what the host registered. The body trickles out at
+// BYTES_PER_MS of simulated time, roughly what an ESP32 sustains while it
+// also writes the data to flash.
+namespace FakeHttp {
+
+extern const char* HOST;
+const uint16_t PORT = 8000;
+const unsigned long CONNECT_MILLIS = 5;
+const unsigned long BYTES_PER_MS = 150;
+
+void serve(const std::string& path, const std::string& body);
+// Whole response (status line, headers and body) for a request
+std::string respond(const std::string& request);
+
+}  // namespace FakeHttp
+
+#endif
@@ -0,0 +1,55 @@
+#include "HeapStats.h"
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <stdlib.h>
+
+namespace {
+
+std::atomic<uint64_t> used(0);
+std::atomic<uint64_t> highest(0);
+std::atomic<uint64_t> count(0);
+
+// Each block carries its size in front, padded to keep the alignment
+const size_t HEADER = alignof(std::max_align_t);
+
+void* allocate(size_t size) {
+    unsigned char* block = static_cast<unsigned char*>(malloc(size + HEADER));
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    uint64_t now = used.fetch_add(size) + size;
+    uint64_t top = highest.load();
+    while (now > top && !highest.compare_exchange_weak(top, now)) {
+    }
+    count++;
+    return block + HEADER;
+}
+
+void release(void* p) {
+    if (p == nullptr) {
+        return;
+    }
+    unsigned char* block = static_cast<unsigned char*>(p) - HEADER;
+    used.fetch_sub(*reinterpret_cast<size_t*>(block));
+    free(block);
+}
+
+}  // namespace
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+
+namespace HeapStats {
+
+uint64_t inUse() { return used.load(); }
+uint64_t peak() { return highest.load(); }
+uint64_t allocations() { return count.load(); }
+void resetPeak() { highest.store(used.load()); }
+
+}  // namespace HeapStats
@@ -0,0 +1,19 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include <stdint.h>
+
+// Counts every operator new/delete in the host build (the firmware's own
+// allocations plus the fakes'), standing in for the ESP32 heap monitor
+namespace HeapStats {
+
+uint64_t inUse();
+uint64_t peak();
+uint64_t allocations();
+
+// Restarts peak tracking from the current level
+void resetPeak();
+
+}  // namespace HeapStats
+
+#endif
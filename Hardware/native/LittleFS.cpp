@@ -0,0 +1,58 @@
+#include "LittleFS.h"
+
+LittleFSFS LittleFS;
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    if (!data || pos >= data->size()) {
+        return 0;
+    }
+    size_t n = data->size() - pos < size ? data->size() - pos : size;
+    memcpy(buffer, data->data() + pos, n);
+    pos += n;
+    return n;
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    if (!data || !writable) {
+        return 0;
+    }
+    if (pos + size > data->size()) {
+        data->resize(pos + size);
+    }
+    memcpy(data->data() + pos, buffer, size);
+    pos += size;
+    return size;
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+    if (!data) {
+        return false;
+    }
+    size_t base = mode == SeekSet ? 0 : mode == SeekCur ? pos : data->size();
+    size_t target = base + position;
+    if (target > data->size()) {
+        return false;
+    }
+    pos = target;
+    return true;
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+    std::string name(path);
+    bool exists = files.count(name) != 0;
+
+    if (strcmp(mode, "w") == 0) {
+        files[name] = std::make_shared<std::vector<uint8_t> >();
+        return File(files[name], 0, true);
+    }
+    if (strcmp(mode, "a") == 0) {
+        if (!exists) {
+            files[name] = std::make_shared<std::vector<uint8_t> >();
+        }
+        return File(files[name], files[name]->size(), true);
+    }
+    if (!exists) {
+        return File();
+    }
+    return File(files[name], 0, strcmp(mode, "r+") == 0);
+}
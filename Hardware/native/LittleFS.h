@@ -0,0 +1,49 @@
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+// Flash file system held in memory for the life of the process
+class File {
+private:
+    std::shared_ptr<std::vector<uint8_t> > data;
+    size_t pos = 0;
+    bool writable = false;
+
+public:
+    File() {}
+    File(std::shared_ptr<std::vector<uint8_t> > contents, size_t position, bool canWrite)
+        : data(contents), pos(position), writable(canWrite) {}
+
+    size_t read(uint8_t* buffer, size_t size);
+    size_t write(const uint8_t* buffer, size_t size);
+    bool seek(uint32_t position, SeekMode mode = SeekSet);
+    size_t position() const { return pos; }
+    size_t size() const { return data ? data->size() : 0; }
+    int available() { return (int)(size() - pos); }
+    void flush() {}
+    void close() { data.reset(); }
+    operator bool() const { return (bool)data; }
+};
+
+class LittleFSFS {
+private:
+    std::map<std::string, std::shared_ptr<std::vector<uint8_t> > > files;
+
+public:
+    bool begin(bool formatOnFail = false) { return true; }
+    File open(const char* path, const char* mode = "r");
+    bool exists(const char* path) { return files.count(path) != 0; }
+    bool remove(const char* path) { return files.erase(path) != 0; }
+    bool format() { files.clear(); return true; }
+};
+
+extern LittleFSFS LittleFS;
+
+#endif
@@ -0,0 +1,82 @@
+#include "mdns.h"
+#include <Arduino.h>
+
+struct mdns_search_once_s {
+    unsigned long startedAt;
+    uint32_t timeout;
+    size_t maxResults;
+};
+
+namespace {
+
+// IDF keeps a handful of searches; one is all the firmware ever runs
+mdns_search_once_t search;
+bool searchInUse = false;
+
+uint32_t hosts[FakeMdns::MAX_HOSTS];   // lwIP byte order
+size_t hostCount = 0;
+
+// The answers handed out, one result per host
+mdns_result_t answers[FakeMdns::MAX_HOSTS];
+mdns_ip_addr_t answerAddresses[FakeMdns::MAX_HOSTS];
+
+}  // namespace
+
+namespace FakeMdns {
+
+void advertise(const uint8_t address[4]) {
+    if (hostCount < MAX_HOSTS) {
+        memcpy(&hosts[hostCount++], address, sizeof(uint32_t));
+    }
+}
+
+void clear() {
+    hostCount = 0;
+}
+
+}  // namespace FakeMdns
+
+esp_err_t mdns_init() {
+    return ESP_OK;
+}
+
+mdns_search_once_t* mdns_query_async_new(const char* name, const char* service_type,
+                                         const char* proto, uint16_t type,
+                                         uint32_t timeout, size_t max_results) {
+    if (searchInUse) {
+        return nullptr;
+    }
+    searchInUse = true;
+    search.startedAt = millis();
+    search.timeout = timeout;
+    search.maxResults = max_results;
+    return &search;
+}
+
+bool mdns_query_async_get_results(mdns_search_once_t* search, uint32_t timeout,
+                                  mdns_result_t** results) {
+    if (millis() - search->startedAt < search->timeout) {
+        return false;
+    }
+    *results = nullptr;
+    size_t count = hostCount < search->maxResults ? hostCount : search->maxResults;
+    for (size_t i = count; i-- > 0;) {
+        memset(&answerAddresses[i], 0, sizeof(answerAddresses[i]));
+        answerAddresses[i].addr.type = ESP_IPADDR_TYPE_V4;
+        answerAddresses[i].addr.u_addr.ip4.addr = hosts[i];
+        memset(&answers[i], 0, sizeof(answers[i]));
+        answers[i].port = 1883;
+        answers[i].addr = &answerAddresses[i];
+        answers[i].next = *results;
+        *results = &answers[i];
+    }
+    return true;
+}
+
+esp_err_t mdns_query_async_delete(mdns_search_once_t* search) {
+    searchInUse = false;
+    return ESP_OK;
+}
+
+void mdns_query_results_free(mdns_result_t* results) {
+}
@@ -0,0 +1,331 @@
+// Host entry point: runs the real setup()/loop() from src/main.cpp against
+// the fakes in this directory on simulated time, then benchmarks the hot
+// paths and prints a report.
+//
+// Usage: program [--seconds N] [--serial] [--command JSON]... [--outage AT:FOR]
+//                [--serve PATH=FILE]... [--image FILE]
+//   --seconds  simulated run time (default 3600)
+//   --serial   echo the firmware's Serial output
+//   --command  deliver JSON on the node's command topic once MQTT is up
+//   --outage   drop WiFi at AT seconds for FOR seconds
+//   --serve    offer FILE at http://192.168.1.5:8000PATH, e.g. for OTA
+//   --image    firmware image the node runs, for OTA delta patches
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_ota_ops.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <vector>
+
+#include "AlertEngine.h"
+#include "FakeBroker.h"
+#include "FakeHttp.h"
+#include "HeapStats.h"
+#include "VirtualClock.h"
+#include "MQTTManager.h"
+#include "SampleStore.h"
+#include "SensorManager.h"
+#include "SerialLogger.h"
+#include "TelemetryRecord.h"
+#include "TelemetrySerializer.h"
+
+extern SensorManager sensors;
+extern MQTTManager mqtt;
+extern SampleStore sampleStore;
+extern AlertEngine alerts;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t RESERVOIR = 1 << 18;
+
+// Loop latencies in ns; a uniform sample once more passes than fit
+struct Reservoir {
+    std::vector<uint32_t> values;
+    uint64_t seen = 0;
+    uint64_t total = 0;
+    uint32_t max = 0;
+
+    Reservoir() { values.reserve(RESERVOIR); }
+
+    void add(uint32_t v) {
+        seen++;
+        total += v;
+        max = std::max(max, v);
+        if (values.size() < RESERVOIR) {
+            values.push_back(v);
+        } else {
+            uint64_t slot = ((uint64_t)rand() << 16 ^ rand()) % seen;
+            if (slot < RESERVOIR) {
+                values[slot] = v;
+            }
+        }
+    }
+
+    uint32_t percentile(double p) {
+        if (values.empty()) {
+            return 0;
+        }
+        size_t k = (size_t)(p * (values.size() - 1));
+        std::nth_element(values.begin(), values.begin() + k, values.end());
+        return values[k];
+    }
+};
+
+double elapsedNs(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// ns per call of fn, over at least a few hundred ms of wall time
+template <typename Fn>
+double timeCalls(Fn fn, size_t& calls) {
+    calls = 0;
+    Clock::time_point start = Clock::now();
+    double ns;
+    do {
+        for (int i = 0; i < 1000; i++) {
+            fn();
+        }
+        calls += 1000;
+        ns = elapsedNs(start);
+    } while (ns < 3e8);
+    return ns / calls;
+}
+
+bool readFile(const char* path, std::string& contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return false;
+    }
+    std::ostringstream data;
+    data << file.rdbuf();
+    contents = data.str();
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    unsigned long seconds = 3600;
+    unsigned long outageAt = 0;
+    unsigned long outageFor = 0;
+    std::vector<const char*> commands;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--serial") == 0) {
+            HardwareSerial::echo = true;
+        } else if (strcmp(argv[i], "--command") == 0 && i + 1 < argc) {
+            commands.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--outage") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%lu:%lu", &outageAt, &outageFor) != 2) {
+                fprintf(stderr, "--outage expects AT:FOR in seconds\n");
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            const char* spec = argv[++i];
+            const char* equals = strchr(spec, '=');
+            std::string body;
+            if (equals == nullptr || spec[0] != '/' || !readFile(equals + 1, body)) {
+                fprintf(stderr, "--serve expects /PATH=FILE\n");
+                return 2;
+            }
+            FakeHttp::serve(std::string(spec, equals - spec), body);
+        } else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+            std::string image;
+            if (!readFile(argv[++i], image)) {
+                return 2;
+            }
+            FakeFlash::setRunningImage(image);
+        } else {
+            fprintf(stderr, "Usage: %s [--seconds N] [--serial] [--command JSON]... [--outage AT:FOR]\n"
+                            "          [--serve PATH=FILE]... [--image FILE]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    Reservoir latency;
+    FakeFlash::begin();
+    // Everything allocated so far belongs to the runner, not the firmware
+    uint64_t heapBaseline = HeapStats::inUse();
+    VirtualClock::join();
+
+    Clock::time_point wallStart = Clock::now();
+    setup();
+    // Queued until the firmware connects and subscribes; the topic is
+    // only known once setup() has read the device ID
+    for (const char* command : commands) {
+        Broker.inject(mqtt.topic(MQTTManager::TOPIC_COMMAND), command);
+    }
+    uint64_t heapAfterSetup = HeapStats::inUse() - heapBaseline;
+    HeapStats::resetPeak();
+    uint64_t allocationsBefore = HeapStats::allocations();
+
+    // ---- Simulated run: loop latency and steady-state heap ----
+    unsigned long endMillis = millis() + seconds * 1000;
+    while (millis() < endMillis) {
+        unsigned long now = millis();
+        if (outageFor > 0) {
+            WiFi.setLinkUp(now < outageAt * 1000 || now >= (outageAt + outageFor) * 1000);
+        }
+
+        uint64_t sleptBefore = VirtualClock::sleptNanos();
+        Clock::time_point start = Clock::now();
+        loop();
+        double busy = elapsedNs(start) - (double)(VirtualClock::sleptNanos() - sleptBefore);
+        latency.add(busy > 0 ? (uint32_t)std::min(busy, 4e9) : 0);
+    }
+    double wallSeconds = elapsedNs(wallStart) / 1e9;
+    uint64_t loopAllocations = HeapStats::allocations() - allocationsBefore;
+
+    printf("simulated %lu s in %.2f s wall (%.0fx)\n", seconds, wallSeconds, seconds / wallSeconds);
+    printf("\nloop() latency, excluding idle delay\n");
+    printf("  passes      %llu\n", (unsigned long long)latency.seen);
+    printf("  mean        %.1f us\n", latency.seen ? latency.total / 1e3 / latency.seen : 0.0);
+    printf("  p50         %.1f us\n", latency.percentile(0.50) / 1e3);
+    printf("  p99         %.1f us\n", latency.percentile(0.99) / 1e3);
+    printf("  p99.9       %.1f us\n", latency.percentile(0.999) / 1e3);
+    printf("  max         %.1f us\n", latency.max / 1e3);
+
+    printf("\nheap (operator new, firmware only)\n");
+    printf("  after setup %llu B\n", (unsigned long long)heapAfterSetup);
+    printf("  peak in run %llu B\n", (unsigned long long)(HeapStats::peak() - heapBaseline));
+    printf("  end of run  %llu B\n", (unsigned long long)(HeapStats::inUse() - heapBaseline));
+    printf("  allocations %.2f per loop pass\n",
+           latency.seen ? (double)loopAllocations / latency.seen : 0.0);
+
+    printf("\nbroker traffic (%u connects)\n", Broker.connects);
+    for (const auto& entry : Broker.topics) {
+        printf("  %-24s %7u msgs %10llu B  %6.1f B/msg\n", entry.first.c_str(),
+               entry.second.messages, (unsigned long long)entry.second.bytes,
+               (double)entry.second.bytes / entry.second.messages);
+    }
+    printf("  still queued on device: %u, dropped: %u\n",
+           (unsigned)sampleStore.size(), (unsigned)sampleStore.droppedCount());
+
+    // ---- Micro-benchmarks on a real snapshot ----
+    StoredSample sample;
+    sample.seq = 123456;
+    sample.timestamp = 1760000000;
+    sample.data = sensors.snapshot();
+    static StoredSample batch[SampleStore::MAX_BATCH];
+    for (size_t i = 0; i < SampleStore::MAX_BATCH; i++) {
+        batch[i] = sample;
+        batch[i].seq += i;
+    }
+    static char json[4096];
+    uint8_t record[TelemetryRecord::SIZE];
+    size_t calls;
+    size_t jsonLength = TelemetrySerializer::serialize(sample, json, sizeof(json));
+    size_t included = 0;
+
+    printf("\nserialization (host ns per call)\n");
+    double ns = timeCalls([&]() { TelemetrySerializer::serialize(sample, json, sizeof(json)); }, calls);
+    printf("  json sample     %8.1f ns  %4u B\n", ns, (unsigned)jsonLength);
+    ns = timeCalls([&]() { TelemetryRecord::encode(sample.data, record, sizeof(record)); }, calls);
+    printf("  binary record   %8.1f ns  %4u B\n", ns, (unsigned)TelemetryRecord::SIZE);
+    size_t batchLength = TelemetrySerializer::serializeBatch(batch, SampleStore::MAX_BATCH,
+                                                             json, sizeof(json), included);
+    ns = timeCalls([&]() {
+        TelemetrySerializer::serializeBatch(batch, SampleStore::MAX_BATCH, json, sizeof(json), included);
+    }, calls);
+    printf("  json batch      %8.1f ns  %4u B for %u samples\n", ns, (unsigned)batchLength,
+           (unsigned)included);
+
+    // ---- Alert rules: a full table, every kind, on the same snapshot ----
+    static const AlertEngine::Kind KINDS[] = {
+        AlertEngine::ALERT_ABOVE, AlertEngine::ALERT_BELOW,
+        AlertEngine::ALERT_RATE, AlertEngine::ALERT_ANOMALY
+    };
+    alerts.clear();
+    for (size_t i = 0; i < AlertEngine::MAX_RULES; i++) {
+        AlertEngine::Rule rule = { (uint8_t)(i % TelemetrySerializer::FIELD_COUNT), KINDS[i % 4], 3.0f, 0.05f };
+        alerts.add(rule);
+    }
+    AlertEngine::Event events[AlertEngine::MAX_RULES];
+    uint64_t alertClock = (uint64_t)sample.timestamp * 1000;
+    size_t alertEventCount = 0;
+    ns = timeCalls([&]() {
+        alertClock += 2000;
+        alertEventCount += alerts.evaluate(sample.data, alertClock, events, AlertEngine::MAX_RULES);
+    }, calls);
+    printf("\nalert rules (host ns per sample)\n");
+    printf("  %2u rules        %8.1f ns  %.1f ns per rule, %u events\n",
+           (unsigned)alerts.ruleCount(), ns, ns / alerts.ruleCount(), (unsigned)alertEventCount);
+
+    // ---- Logging: what a caller pays per line; flush() is its own task ----
+    // Lines go in bursts of half the ring with a flush in between, so only
+    // the full-ring case measures the drop path
+    bool echo = HardwareSerial::echo;
+    HardwareSerial::echo = false;
+    double flushNs = 0;
+    auto timeLines = [&](const std::function<void()>& line, double* flushPerLine) {
+        const size_t burst = SerialLogger::RING_LINES / 2;
+        double lineNs = 0;
+        double flushTotal = 0;
+        size_t lines = 0;
+        logger.flush(false);
+        Clock::time_point benchStart = Clock::now();
+        while (elapsedNs(benchStart) < 3e8) {
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < burst; i++) {
+                line();
+            }
+            lineNs += elapsedNs(start);
+            lines += burst;
+            start = Clock::now();
+            logger.flush(false);
+            flushTotal += elapsedNs(start);
+        }
+        if (flushPerLine != nullptr) {
+            *flushPerLine = flushTotal / lines;
+        }
+        return lineNs / lines;
+    };
+    printf("\nlogging (host ns per line)\n");
+    ns = timeLines([]() { logger.log(LOG_LEVEL_WARN, "Publish failed (state %d), %u queued", -3, 12u); }, &flushNs);
+    printf("  log()           %8.1f ns\n", ns);
+    ns = timeLines([]() { logger.println("Sensor read timeout"); }, nullptr);
+    printf("  println()       %8.1f ns\n", ns);
+    ns = timeLines([]() { LOG_DEBUG("Payload %u bytes", 327u); }, nullptr);
+    printf("  LOG_DEBUG       %8.1f ns%s\n", ns,
+           LOG_LEVEL >= LOG_LEVEL_DEBUG ? "" : "  (compiled out at this LOG_LEVEL)");
+    for (size_t i = 0; i < SerialLogger::RING_LINES; i++) {
+        logger.log(LOG_LEVEL_WARN, "filler %u", (unsigned)i);
+    }
+    ns = timeCalls([]() { logger.log(LOG_LEVEL_WARN, "Publish failed (state %d)", -3); }, calls);
+    printf("  log(), ring full %7.1f ns  (line dropped)\n", ns);
+    logger.flush(false);
+    printf("  flush to Serial %8.1f ns\n", flushNs);
+    HardwareSerial::echo = echo;
+
+    // ---- Publish path: MQTTManager through the fake client ----
+    WiFi.setLinkUp(true);
+    Broker.available = true;
+    if (mqtt.isConnected() || mqtt.connect()) {
+        uint64_t allocations = HeapStats::allocations();
+        uint64_t serialBytes = Serial.bytesWritten;
+        ns = timeCalls([&]() { mqtt.publish(sample, false); }, calls);
+        double serialPerPublish = (double)(Serial.bytesWritten - serialBytes) / calls;
+        printf("\npublish throughput (LOG_LEVEL %d)\n", LOG_LEVEL);
+        printf("  live sample     %8.0f msgs/s  %.0f ns per publish (%.2f allocations)\n",
+               1e9 / ns, ns, (double)(HeapStats::allocations() - allocations) / calls);
+        // 10 bits per byte at 115200 baud; the host discards it, the device waits
+        printf("  Serial output   %8.0f B per publish, %.2f ms of UART time\n",
+               serialPerPublish, serialPerPublish * 10 / 115200 * 1000);
+    } else {
+        printf("\npublish throughput (LOG_LEVEL %d): MQTT not connected\n", LOG_LEVEL);
+    }
+
+    fflush(stdout);
+    // The acquisition task never returns; leave without unwinding it
+    _Exit(0);
+}
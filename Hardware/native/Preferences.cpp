@@ -0,0 +1,66 @@
+#include "Preferences.h"
+
+namespace {
+
+std::map<std::string, std::vector<uint8_t> >& store() {
+    static std::map<std::string, std::vector<uint8_t> > entries;
+    return entries;
+}
+
+}  // namespace
+
+bool Preferences::begin(const char* name, bool ro) {
+    space = name;
+    readOnly = ro;
+    opened = true;
+    return true;
+}
+
+std::vector<uint8_t>* Preferences::find(const char* key) {
+    if (!opened) {
+        return nullptr;
+    }
+    auto it = store().find(space + "/" + key);
+    return it == store().end() ? nullptr : &it->second;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!opened || readOnly) {
+        return false;
+    }
+    return store().erase(space + "/" + key) > 0;
+}
+
+bool Preferences::clear() {
+    if (!opened || readOnly) {
+        return false;
+    }
+    std::string prefix = space + "/";
+    for (auto it = store().begin(); it != store().end();) {
+        it = it->first.compare(0, prefix.size(), prefix) == 0 ? store().erase(it) : std::next(it);
+    }
+    return true;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    std::vector<uint8_t>* value = find(key);
+    return value ? value->size() : 0;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t length) {
+    std::vector<uint8_t>* value = find(key);
+    if (value == nullptr || value->size() > length) {
+        return 0;
+    }
+    memcpy(buffer, value->data(), value->size());
+    return value->size();
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+    if (!opened || readOnly) {
+        return 0;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    store()[space + "/" + key].assign(bytes, bytes + length);
+    return length;
+}
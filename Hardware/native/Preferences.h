@@ -0,0 +1,32 @@
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// NVS key-value store held in memory for the life of the process, so it
+// survives the firmware's simulated restarts like the real flash does
+class Preferences {
+private:
+    std::string space;
+    bool readOnly = false;
+    bool opened = false;
+
+    std::vector<uint8_t>* find(const char* key);
+
+public:
+    bool begin(const char* name, bool readOnly = false);
+    void end() { opened = false; }
+
+    bool isKey(const char* key) { return find(key) != nullptr; }
+    bool remove(const char* key);
+    bool clear();
+
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buffer, size_t length);
+    size_t putBytes(const char* key, const void* value, size_t length);
+};
+
+#endif
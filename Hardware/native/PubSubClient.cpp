@@ -0,0 +1,101 @@
+#include "PubSubClient.h"
+#include <vector>
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass,
+                           const char* willTopic, uint8_t willQos, bool willRetain,
+                           const char* willMessage, bool cleanSession) {
+    if (WiFi.status() != WL_CONNECTED) {
+        lastState = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    if (!Broker.available) {
+        lastState = MQTT_CONNECT_UNAVAILABLE;
+        return false;
+    }
+    this->willTopic = willTopic ? willTopic : "";
+    this->willMessage = willMessage ? willMessage : "";
+    this->willRetain = willRetain;
+    if (cleanSession) {
+        subscriptions.clear();
+    }
+    Broker.connects++;
+    session = true;
+    lastState = MQTT_CONNECTED;
+    return true;
+}
+
+void PubSubClient::disconnect() {
+    session = false;
+    lastState = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected() {
+    if (session && (WiFi.status() != WL_CONNECTED || !Broker.available)) {
+        // The broker notices the dead socket and sends the will
+        session = false;
+        lastState = MQTT_CONNECTION_LOST;
+        if (!willTopic.empty()) {
+            Broker.publish(willTopic.c_str(), reinterpret_cast<const uint8_t*>(willMessage.data()),
+                           willMessage.size(), willRetain);
+        }
+    }
+    return session;
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+    if (!connected()) {
+        return false;
+    }
+    if (MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length > bufferSize) {
+        return false;
+    }
+    Broker.publish(topic, payload, length, retained);
+    return true;
+}
+
+bool PubSubClient::subscribe(const char* topic) {
+    if (!connected()) {
+        return false;
+    }
+    subscriptions.insert(topic);
+    return true;
+}
+
+bool PubSubClient::loop() {
+    if (!connected()) {
+        return false;
+    }
+    if (Broker.inbound.empty()) {
+        return true;
+    }
+    // Messages for topics nobody has subscribed to yet stay queued
+    std::deque<FakeBroker::Message> pending;
+    pending.swap(Broker.inbound);
+    for (FakeBroker::Message& message : pending) {
+        if (!callback || !subscribed(message.topic)) {
+            Broker.inbound.push_back(message);
+            continue;
+        }
+        std::vector<char> topic(message.topic.begin(), message.topic.end());
+        topic.push_back('\0');
+        std::vector<uint8_t> payload(message.payload.begin(), message.payload.end());
+        callback(topic.data(), payload.data(), (unsigned int)payload.size());
+    }
+    return true;
+}
+
+bool PubSubClient::subscribed(const std::string& topic) const {
+    // A shared subscription "$share/<group>/<filter>" receives the filter's
+    // messages; with one client the group never splits them
+    for (const std::string& filter : subscriptions) {
+        std::string plain = filter;
+        if (plain.compare(0, 7, "$share/") == 0) {
+            size_t slash = plain.find('/', 7);
+            plain = slash == std::string::npos ? std::string() : plain.substr(slash + 1);
+        }
+        if (plain == topic) {
+            return true;
+        }
+    }
+    return false;
+}
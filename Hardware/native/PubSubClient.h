@@ -0,0 +1,69 @@
+#ifndef NATIVE_PUBSUBCLIENT_H
+#define NATIVE_PUBSUBCLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <functional>
+#include <set>
+#include <string>
+#include "FakeBroker.h"
+
+#define MQTT_MAX_HEADER_SIZE 5
+
+#define MQTT_CONNECTION_TIMEOUT     -4
+#define MQTT_CONNECTION_LOST        -3
+#define MQTT_CONNECT_FAILED         -2
+#define MQTT_DISCONNECTED           -1
+#define MQTT_CONNECTED               0
+#define MQTT_CONNECT_UNAVAILABLE     3
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+// PubSubClient talking to the in-memory FakeBroker. Enforces the same
+// packet buffer limit as the real client, so oversized payloads fail here
+// exactly as they would on the device.
+class PubSubClient {
+private:
+    MQTT_CALLBACK_SIGNATURE;
+    std::set<std::string> subscriptions;
+    std::string willTopic;
+    std::string willMessage;
+    bool willRetain = false;
+    uint16_t bufferSize = 256;
+    bool session = false;
+    int lastState = MQTT_DISCONNECTED;
+
+    bool subscribed(const std::string& topic) const;
+
+public:
+    explicit PubSubClient(WiFiClient& client) {}
+
+    PubSubClient& setServer(const char* host, uint16_t port) { return *this; }
+    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) { this->callback = callback; return *this; }
+    PubSubClient& setSocketTimeout(uint16_t seconds) { return *this; }
+    PubSubClient& setKeepAlive(uint16_t seconds) { return *this; }
+    bool setBufferSize(uint16_t size) { bufferSize = size; return true; }
+    uint16_t getBufferSize() const { return bufferSize; }
+
+    bool connect(const char* id, const char* user, const char* pass,
+                 const char* willTopic, uint8_t willQos, bool willRetain,
+                 const char* willMessage, bool cleanSession = true);
+    void disconnect();
+    bool connected();
+    int state() { connected(); return lastState; }
+
+    bool publish(const char* topic, const char* payload) { return publish(topic, payload, false); }
+    bool publish(const char* topic, const char* payload, bool retained) {
+        return publish(topic, reinterpret_cast<const uint8_t*>(payload), strlen(payload), retained);
+    }
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length) {
+        return publish(topic, payload, length, false);
+    }
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained);
+
+    bool subscribe(const char* topic);
+    bool subscribe(const char* topic, uint8_t qos) { return subscribe(topic); }
+    bool loop();
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef NATIVE_SDS011_H
+#define NATIVE_SDS011_H
+
+#include <Arduino.h>
+#include "FakeDevices.h"
+
+// SDS011 particulate sensor commands; its readings arrive on the UART
+class SDS011 {
+public:
+    void begin(HardwareSerial* serial) {}
+    void sleep() { FakeDevices::sdsPower(false, millis()); }
+    void wakeup() { FakeDevices::sdsPower(true, millis()); }
+};
+
+#endif
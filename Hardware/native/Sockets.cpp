@@ -0,0 +1,169 @@
+#include "lwip/sockets.h"
+#include <Arduino.h>
+#include <string.h>
+
+namespace FakeLan {
+
+const uint8_t BROKER[4] = { 192, 168, 1, 77 };
+
+namespace {
+
+// Hosts that are up but run no broker
+const uint8_t REFUSING[] = { 1, 10, 23 };
+
+struct Socket {
+    bool open;
+    bool connecting;
+    bool accepts;
+    bool silent;
+    unsigned long startedAt;
+    unsigned long answerAt;
+};
+
+Socket sockets[MAX_SOCKETS];
+bool brokerUp = true;
+uint8_t broker[4] = { 192, 168, 1, 77 };
+unsigned long brokerAcceptMillis = ACCEPT_MILLIS;
+int socketLimit = MAX_SOCKETS;
+
+Socket* lookup(int s) {
+    int index = s - FIRST_FD;
+    if (index < 0 || index >= MAX_SOCKETS || !sockets[index].open) {
+        return nullptr;
+    }
+    return &sockets[index];
+}
+
+bool answered(const Socket& socket) {
+    return socket.connecting && !socket.silent && millis() - socket.startedAt >= socket.answerAt;
+}
+
+}  // namespace
+
+void setBrokerUp(bool up) {
+    brokerUp = up;
+}
+
+void setBroker(const uint8_t address[4], unsigned long acceptMillis) {
+    memcpy(broker, address, sizeof(broker));
+    brokerAcceptMillis = acceptMillis;
+}
+
+void setSocketLimit(int limit) {
+    socketLimit = limit < MAX_SOCKETS ? limit : MAX_SOCKETS;
+}
+
+int openSockets() {
+    int count = 0;
+    for (int i = 0; i < MAX_SOCKETS; i++) {
+        count += sockets[i].open ? 1 : 0;
+    }
+    return count;
+}
+
+void reset() {
+    brokerUp = true;
+    setBroker(BROKER);
+    socketLimit = MAX_SOCKETS;
+}
+
+}  // namespace FakeLan
+
+using namespace FakeLan;
+
+int lwip_socket(int domain, int type, int protocol) {
+    for (int i = 0; i < MAX_SOCKETS; i++) {
+        if (!sockets[i].open && openSockets() < socketLimit) {
+            memset(&sockets[i], 0, sizeof(sockets[i]));
+            sockets[i].open = true;
+            return FIRST_FD + i;
+        }
+    }
+    errno = ENFILE;
+    return -1;
+}
+
+int lwip_fcntl(int s, int cmd, int val) {
+    if (lookup(s) == nullptr) {
+        errno = EBADF;
+        return -1;
+    }
+    return 0;
+}
+
+int lwip_connect(int s, const struct sockaddr* name, socklen_t namelen) {
+    Socket* socket = lookup(s);
+    if (socket == nullptr) {
+        errno = EBADF;
+        return -1;
+    }
+    const struct sockaddr_in* target = (const struct sockaddr_in*)name;
+    uint8_t ip[4];
+    memcpy(ip, &target->sin_addr.s_addr, 4);
+
+    socket->connecting = true;
+    socket->startedAt = millis();
+    socket->silent = true;
+    if (memcmp(ip, broker, 4) == 0) {
+        socket->silent = !brokerUp;
+        socket->accepts = ntohs(target->sin_port) == 1883;
+        socket->answerAt = brokerAcceptMillis;
+    } else if (ip[0] == 192 && ip[1] == 168 && ip[2] == 1) {
+        for (size_t i = 0; i < sizeof(REFUSING); i++) {
+            if (ip[3] == REFUSING[i]) {
+                socket->silent = false;
+                socket->answerAt = REFUSE_MILLIS;
+            }
+        }
+    }
+    errno = EINPROGRESS;
+    return -1;
+}
+
+int lwip_select(int maxfdp1, fd_set* readset, fd_set* writeset, fd_set* exceptset,
+                struct timeval* timeout) {
+    int ready = 0;
+    for (int s = FIRST_FD; s < maxfdp1 && s < FIRST_FD + MAX_SOCKETS; s++) {
+        if (writeset == nullptr || !FD_ISSET(s, writeset)) {
+            continue;
+        }
+        Socket* socket = lookup(s);
+        if (socket != nullptr && answered(*socket)) {
+            ready++;
+        } else {
+            FD_CLR(s, writeset);
+        }
+    }
+    if (readset != nullptr) {
+        FD_ZERO(readset);
+    }
+    if (exceptset != nullptr) {
+        FD_ZERO(exceptset);
+    }
+    return ready;
+}
+
+int lwip_getsockopt(int s, int level, int optname, void* optval, socklen_t* optlen) {
+    Socket* socket = lookup(s);
+    if (socket == nullptr || level != SOL_SOCKET || optname != SO_ERROR || *optlen < sizeof(int)) {
+        errno = EBADF;
+        return -1;
+    }
+    int error = 0;
+    if (answered(*socket) && !socket->accepts) {
+        error = ECONNREFUSED;
+    }
+    memcpy(optval, &error, sizeof(error));
+    *optlen = sizeof(error);
+    return 0;
+}
+
+int lwip_close(int s) {
+    Socket* socket = lookup(s);
+    if (socket == nullptr) {
+        errno = EBADF;
+        return -1;
+    }
+    socket->open = false;
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "VirtualClock.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace {
+
+std::mutex mutex;
+std::condition_variable wake;
+uint64_t now = 0;
+int participants = 0;
+// Wake-up time per sleeping participant; fixed so sleeping never allocates
+const int MAX_SLEEPERS = 16;
+const uint64_t AWAKE = UINT64_MAX;
+uint64_t sleepers[MAX_SLEEPERS] = {};
+int sleeping = 0;
+thread_local uint64_t slept = 0;
+
+// With everyone asleep, jump to the earliest wake-up. Caller holds the lock.
+void advanceIfIdle() {
+    if (sleeping == 0 || sleeping < participants) {
+        return;
+    }
+    uint64_t earliest = AWAKE;
+    for (int i = 0; i < MAX_SLEEPERS; i++) {
+        if (sleepers[i] < earliest) {
+            earliest = sleepers[i];
+        }
+    }
+    now = earliest;
+    wake.notify_all();
+}
+
+}  // namespace
+
+namespace VirtualClock {
+
+uint64_t nowMicros() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return now;
+}
+
+void join() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (participants == 0) {
+        for (int i = 0; i < MAX_SLEEPERS; i++) {
+            sleepers[i] = AWAKE;
+        }
+    }
+    participants++;
+}
+
+void sleepUntil(uint64_t wakeMicros) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    if (wakeMicros <= now) {
+        return;
+    }
+    int slot = 0;
+    while (sleepers[slot] != AWAKE) {
+        slot++;
+    }
+    sleepers[slot] = wakeMicros;
+    sleeping++;
+    advanceIfIdle();
+    wake.wait(lock, [wakeMicros] { return now >= wakeMicros; });
+    sleepers[slot] = AWAKE;
+    sleeping--;
+    slept += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+void sleepFor(uint64_t micros) {
+    sleepUntil(nowMicros() + micros);
+}
+
+uint64_t sleptNanos() {
+    return slept;
+}
+
+}  // namespace VirtualClock
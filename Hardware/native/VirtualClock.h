@@ -0,0 +1,28 @@
+#ifndef VIRTUAL_CLOCK_H
+#define VIRTUAL_CLOCK_H
+
+#include <stdint.h>
+
+// Simulated time for the host build. millis()/micros() read it and
+// delay()/vTaskDelayUntil() wait on it. Time only moves when every
+// participating thread (the loop plus each fake FreeRTOS task) is asleep,
+// and then jumps straight to the earliest wake-up, so simulated hours pass
+// in seconds and idle time costs nothing.
+namespace VirtualClock {
+
+uint64_t nowMicros();
+
+// Adds a participant. A task's creator calls it on the task's behalf, so
+// time cannot run ahead before the new thread gets to its first sleep.
+void join();
+
+// Blocks the calling participant until simulated time reaches wakeMicros
+void sleepUntil(uint64_t wakeMicros);
+void sleepFor(uint64_t micros);
+
+// Wall-clock nanoseconds the calling thread has spent blocked in sleeps
+uint64_t sleptNanos();
+
+}  // namespace VirtualClock
+
+#endif
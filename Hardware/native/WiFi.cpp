@@ -0,0 +1,39 @@
+#include "WiFi.h"
+
+WiFiClass WiFi;
+
+String IPAddress::toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+    return String(buf);
+}
+
+const uint8_t WiFiClass::AP_BSSID[6] = { 0x24, 0x0A, 0xC4, 0x5E, 0x10, 0x01 };
+
+wl_status_t WiFiClass::begin(const char* name, const char* password, int32_t channelHint,
+                             const uint8_t* bssid, bool connect) {
+    ssid = name;
+    beginAt = millis();
+    started = connect;
+    // A directed join to a BSSID that is not there never completes
+    reachable = bssid == nullptr || memcmp(bssid, AP_BSSID, 6) == 0;
+    bool directed = bssid != nullptr && channelHint == AP_CHANNEL;
+    connectMillis = (directed ? 0 : SCAN_MILLIS) + ASSOCIATE_MILLIS + (staticIp ? 0 : DHCP_MILLIS);
+    return WL_DISCONNECTED;
+}
+
+bool WiFiClass::config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns) {
+    staticIp = local != IPAddress();
+    address = local;
+    return true;
+}
+
+wl_status_t WiFiClass::status() {
+    if (!started || !linkUp) {
+        return WL_DISCONNECTED;
+    }
+    if (!reachable) {
+        return millis() - beginAt >= SCAN_MILLIS ? WL_NO_SSID_AVAIL : WL_DISCONNECTED;
+    }
+    return millis() - beginAt >= connectMillis ? WL_CONNECTED : WL_DISCONNECTED;
+}
@@ -0,0 +1,102 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+#include <Arduino.h>
+#include <string>
+
+class IPAddress {
+private:
+    uint8_t bytes[4];
+
+public:
+    IPAddress() : bytes{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
+    explicit IPAddress(uint32_t address) { memcpy(bytes, &address, 4); }  // lwIP byte order
+
+    uint8_t operator[](int index) const { return bytes[index]; }
+    uint8_t& operator[](int index) { return bytes[index]; }
+    bool operator==(const IPAddress& other) const { return memcmp(bytes, other.bytes, 4) == 0; }
+    bool operator!=(const IPAddress& other) const { return !(*this == other); }
+    String toString() const;
+};
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+#define WIFI_OFF 0
+#define WIFI_STA 1
+
+// Station interface with one access point. Connecting takes a channel
+// scan (skipped when begin() names the right BSSID and channel), the
+// association itself and DHCP (skipped with a static config()).
+// setLinkUp(false) simulates the access point going away.
+class WiFiClass {
+private:
+    String ssid;
+    unsigned long beginAt = 0;
+    unsigned long connectMillis = 0;
+    bool started = false;
+    bool reachable = false;
+    bool linkUp = true;
+    bool staticIp = false;
+    IPAddress address;
+
+public:
+    static const unsigned long SCAN_MILLIS = 500;
+    static const unsigned long ASSOCIATE_MILLIS = 100;
+    static const unsigned long DHCP_MILLIS = 200;
+    static const int32_t AP_CHANNEL = 6;
+    static const uint8_t AP_BSSID[6];
+
+    void mode(int mode) {}
+    void disconnect(bool wifiOff = false, bool eraseAp = false) { started = false; }
+    wl_status_t begin(const char* name, const char* password = nullptr, int32_t channel = 0,
+                      const uint8_t* bssid = nullptr, bool connect = true);
+    // All zero addresses switch back to DHCP
+    bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns = IPAddress());
+    wl_status_t status();
+
+    String SSID() { return status() == WL_CONNECTED ? ssid : String(); }
+    int RSSI() { return status() == WL_CONNECTED ? -58 : 0; }
+    uint8_t* BSSID() { return status() == WL_CONNECTED ? const_cast<uint8_t*>(AP_BSSID) : nullptr; }
+    int32_t channel() { return status() == WL_CONNECTED ? AP_CHANNEL : 0; }
+    IPAddress localIP() { return staticIp ? address : IPAddress(192, 168, 1, 42); }
+    IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+    IPAddress gatewayIP() { return IPAddress(192, 168, 1, 1); }
+    IPAddress dnsIP() { return IPAddress(192, 168, 1, 1); }
+
+    // Host-only control
+    void setLinkUp(bool up) { linkUp = up; }
+};
+
+extern WiFiClass WiFi;
+
+// Plain TCP client. The only thing listening on the simulated network is
+// the file server in FakeHttp.h; the MQTT client never uses its socket.
+class WiFiClient {
+private:
+    std::string request;
+    std::string response;
+    size_t sent = 0;             // response bytes handed to the firmware
+    unsigned long openedAt = 0;
+    bool open = false;
+
+    size_t deliverable();
+
+public:
+    int connect(const IPAddress& ip, uint16_t port, int32_t timeoutMillis = 0) { return 0; }
+    int connect(const char* host, uint16_t port, int32_t timeoutMillis = 0);
+    size_t write(const uint8_t* data, size_t length);
+    int available();
+    int read();
+    int read(uint8_t* buffer, size_t length);
+    void stop();
+    uint8_t connected();
+};
+
+#endif
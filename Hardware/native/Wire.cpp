@@ -0,0 +1,91 @@
+#include "Wire.h"
+#include "FakeDevices.h"
+
+namespace {
+
+const uint8_t SOIL_ADDRESS = 0x36;
+const uint8_t AIR_QUALITY_ADDRESS = 0x5A;
+const unsigned long SOIL_TEMP_DELAY = 1000;
+const unsigned long SOIL_TOUCH_DELAY = 3000;
+
+void putBigEndian(uint8_t* out, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = (uint8_t)(value >> (8 * (bytes - 1 - i)));
+    }
+}
+
+}  // namespace
+
+TwoWire::Device* TwoWire::find(uint8_t at) {
+    for (Device& device : devices) {
+        if (device.address == at) {
+            return &device;
+        }
+    }
+    return nullptr;
+}
+
+void TwoWire::beginTransmission(uint8_t to) {
+    address = to;
+    requestLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (requestLength >= BUFFER_SIZE) {
+        return 0;
+    }
+    request[requestLength++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t length) {
+    size_t written = 0;
+    while (written < length && write(data[written])) {
+        written++;
+    }
+    return written;
+}
+
+// 0 on success, 2 for an address nobody answers, like the ESP32 core
+uint8_t TwoWire::endTransmission(bool sendStop) {
+    Device* device = find(address);
+    if (device == nullptr) {
+        return 2;
+    }
+    device->lastRegister[0] = requestLength > 0 ? request[0] : 0;
+    device->lastRegister[1] = requestLength > 1 ? request[1] : 0;
+    device->lastWriteMicros = micros();
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t from, uint8_t length) {
+    responseLength = 0;
+    responseRead = 0;
+    Device* device = find(from);
+    if (device == nullptr || length > BUFFER_SIZE) {
+        return 0;
+    }
+    const uint8_t* lastRegister = device->lastRegister;
+    for (size_t i = 0; i < length; i++) {
+        response[i] = 0xFF;
+    }
+    unsigned long now = millis();
+    unsigned long waited = micros() - device->lastWriteMicros;
+
+    if (from == SOIL_ADDRESS && lastRegister[0] == 0x00 && lastRegister[1] == 0x04) {
+        if (waited >= SOIL_TEMP_DELAY) {
+            int32_t raw = (int32_t)(FakeDevices::soilTemperature(now) * 65536.0f);
+            putBigEndian(response, (uint32_t)raw, 4);
+        }
+    } else if (from == SOIL_ADDRESS && lastRegister[0] == 0x0F && lastRegister[1] == 0x10) {
+        if (waited >= SOIL_TOUCH_DELAY) {
+            putBigEndian(response, FakeDevices::soilMoisture(now), 2);
+        }
+    } else if (from == AIR_QUALITY_ADDRESS && lastRegister[0] == 0x02) {
+        putBigEndian(response, FakeDevices::co2(now), 2);
+        putBigEndian(response + 2, FakeDevices::tvoc(now), 2);
+        response[4] = 0x98;   // FW_MODE | APP_VALID | DATA_READY
+    }
+    responseLength = length;
+    return length;
+}
@@ -0,0 +1,7 @@
+#ifndef NATIVE_ESP_ATTR_H
+#define NATIVE_ESP_ATTR_H
+
+// Host memory has no RTC region; such variables are ordinary globals
+#define RTC_DATA_ATTR
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef NATIVE_ESP_OTA_OPS_H
+#define NATIVE_ESP_OTA_OPS_H
+
+#include "esp_partition.h"
+#include <string>
+
+// The two app partitions of the default Arduino table (app0, app1) held in
+// memory, with the firmware running from app0. Like the real flash they
+// outlive the firmware's simulated restarts.
+typedef uint32_t esp_ota_handle_t;
+
+#define OTA_SIZE_UNKNOWN 0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES 0xfffffffe
+
+typedef struct {
+    uint32_t magic_word;
+    uint32_t secure_version;
+    uint32_t reserv1[2];
+    char version[32];
+    char project_name[32];
+    char time[16];
+    char date[16];
+    char idf_ver[32];
+    uint8_t app_elf_sha256[32];
+    uint32_t reserv2[20];
+} esp_app_desc_t;
+
+const esp_partition_t* esp_ota_get_running_partition();
+const esp_partition_t* esp_ota_get_boot_partition();
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from);
+const esp_app_desc_t* esp_ota_get_app_description();
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
+
+namespace FakeFlash {
+
+// Offset of esp_app_desc_t in an image: image header plus first segment header
+const size_t APP_DESC_OFFSET = 32;
+
+// Allocates both partitions; called before the runner takes its heap
+// baseline, so the fake does not count as firmware memory
+void begin();
+
+// Host-only control: the running firmware image (a synthetic one by
+// default), the other partition's contents, and a restart into whichever
+// partition is set to boot
+void setRunningImage(const std::string& image);
+std::string runningImage();
+std::string partitionContents(const esp_partition_t* partition, size_t length);
+void bootSelected();
+
+}  // namespace FakeFlash
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef NATIVE_ESP_SLEEP_H
+#define NATIVE_ESP_SLEEP_H
+
+#include <stdint.h>
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED = 0,
+    ESP_SLEEP_WAKEUP_TIMER = 4
+} esp_sleep_wakeup_cause_t;
+
+// The host process always starts from a cold boot
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+int esp_sleep_enable_timer_wakeup(uint64_t micros);
+// Ends the run like ESP.restart() does; a wake would be a fresh process
+void esp_deep_sleep_start() __attribute__((noreturn));
+
+#endif
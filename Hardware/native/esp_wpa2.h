@@ -0,0 +1,12 @@
+#ifndef NATIVE_ESP_WPA2_H
+#define NATIVE_ESP_WPA2_H
+
+#include <stdint.h>
+
+// WPA2-Enterprise credentials are accepted and ignored by the fake radio
+inline int esp_wifi_sta_wpa2_ent_set_identity(const uint8_t* identity, int length) { return 0; }
+inline int esp_wifi_sta_wpa2_ent_set_username(const uint8_t* username, int length) { return 0; }
+inline int esp_wifi_sta_wpa2_ent_set_password(const uint8_t* password, int length) { return 0; }
+inline int esp_wifi_sta_wpa2_ent_enable() { return 0; }
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef NATIVE_LWIP_SOCKETS_H
+#define NATIVE_LWIP_SOCKETS_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+// lwIP's socket calls over a simulated LAN, 192.168.1.0/24. The gateway
+// and a few other hosts refuse port 1883 at once, the broker (at
+// FakeLan::BROKER unless moved) accepts after a short handshake and every
+// other address stays silent, so a connect to it never completes.
+// Descriptors are taken from FIRST_FD up and never reach the host's own
+// sockets.
+namespace FakeLan {
+
+const int FIRST_FD = 512;
+const int MAX_SOCKETS = 16;    // CONFIG_LWIP_MAX_SOCKETS
+extern const uint8_t BROKER[4];
+
+const unsigned long ACCEPT_MILLIS = 6;
+const unsigned long REFUSE_MILLIS = 2;
+
+// Host-only controls. The broker stops answering, e.g. to test rediscovery
+void setBrokerUp(bool up);
+// Moves the broker, on or off the /24, and sets how long it takes to accept
+void setBroker(const uint8_t address[4], unsigned long acceptMillis = ACCEPT_MILLIS);
+// Sockets left over from what the rest of the firmware holds
+void setSocketLimit(int limit);
+int openSockets();
+// The broker back at BROKER and up, all MAX_SOCKETS available
+void reset();
+
+}  // namespace FakeLan
+
+int lwip_socket(int domain, int type, int protocol);
+int lwip_fcntl(int s, int cmd, int val);
+int lwip_connect(int s, const struct sockaddr* name, socklen_t namelen);
+int lwip_select(int maxfdp1, fd_set* readset, fd_set* writeset, fd_set* exceptset,
+                struct timeval* timeout);
+int lwip_getsockopt(int s, int level, int optname, void* optval, socklen_t* optlen);
+int lwip_close(int s);
+
+#endif
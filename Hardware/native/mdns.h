@@ -0,0 +1,59 @@
+#ifndef NATIVE_MDNS_H
+#define NATIVE_MDNS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// The ESP-IDF 4.4 asynchronous mDNS query API. A query ends after its
+// timeout with the hosts FakeMdns advertises, by default none.
+
+#define MDNS_TYPE_PTR 0x000C
+#define ESP_IPADDR_TYPE_V4 0
+
+typedef struct {
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+typedef struct {
+    union {
+        esp_ip4_addr_t ip4;
+    } u_addr;
+    uint8_t type;
+} esp_ip_addr_t;
+
+typedef struct mdns_ip_addr_s {
+    esp_ip_addr_t addr;
+    struct mdns_ip_addr_s* next;
+} mdns_ip_addr_t;
+
+typedef struct mdns_result_s {
+    struct mdns_result_s* next;
+    char* hostname;
+    uint16_t port;
+    mdns_ip_addr_t* addr;
+} mdns_result_t;
+
+typedef struct mdns_search_once_s mdns_search_once_t;
+
+esp_err_t mdns_init();
+mdns_search_once_t* mdns_query_async_new(const char* name, const char* service_type,
+                                         const char* proto, uint16_t type,
+                                         uint32_t timeout, size_t max_results);
+bool mdns_query_async_get_results(mdns_search_once_t* search, uint32_t timeout,
+                                  mdns_result_t** results);
+esp_err_t mdns_query_async_delete(mdns_search_once_t* search);
+void mdns_query_results_free(mdns_result_t* results);
+
+namespace FakeMdns {
+
+const size_t MAX_HOSTS = 4;
+
+// Host-only controls: a host answering _mqtt._tcp, up to MAX_HOSTS, and
+// none again
+void advertise(const uint8_t address[4]);
+void clear();
+
+}  // namespace FakeMdns
+
+#endif
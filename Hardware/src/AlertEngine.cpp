@@ -0,0 +1,228 @@
+#include "AlertEngine.h"
+#include "JsonWriter.h"
+#include "TelemetrySerializer.h"
+#include <esp_attr.h>
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+const uint32_t RTC_MAGIC = 0x32544C41;   // "ALT2"
+
+const float CLEAR_MARGIN = 0.02f;        // of the limit, for ABOVE and BELOW
+const float DEFAULT_ALPHA = 0.05f;
+// Floor under the deviation of a field that barely moves, relative to its mean
+const float MIN_RELATIVE_SIGMA = 0.01f;
+
+const char* KIND_NAMES[] = { "above", "below", "rate", "anomaly" };
+
+// Readings that flush a pending batch and wake the radio
+struct DefaultRule {
+    const char* field;
+    AlertEngine::Kind kind;
+    float limit;
+};
+
+const DefaultRule DEFAULT_RULES[] = {
+    { "co2",             AlertEngine::ALERT_ABOVE, 2000.0f },   // ppm
+    { "tvoc",            AlertEngine::ALERT_ABOVE, 1000.0f },   // ppb
+    { "pm25",            AlertEngine::ALERT_ABOVE, 55.5f },     // ug/m3, "unhealthy"
+    { "air_temperature", AlertEngine::ALERT_ABOVE, 40.0f },     // C
+};
+
+}  // namespace
+
+RTC_DATA_ATTR AlertEngine::RtcState AlertEngine::rtc;
+
+void AlertEngine::begin() {
+    if (rtc.magic != RTC_MAGIC || rtc.count > MAX_RULES) {
+        memset(&rtc, 0, sizeof(rtc));
+        rtc.magic = RTC_MAGIC;
+    }
+}
+
+void AlertEngine::setRules(const Rule* rules, size_t count) {
+    bool same = count == rtc.count;
+    for (size_t i = 0; i < count && same; i++) {
+        Rule rule = normalize(rules[i]);
+        const Rule& current = rtc.rules[i].rule;
+        same = rule.field == current.field && rule.kind == current.kind &&
+               rule.limit == current.limit && rule.alpha == current.alpha;
+    }
+    if (same) {
+        return;
+    }
+    clear();
+    for (size_t i = 0; i < count; i++) {
+        add(rules[i]);
+    }
+}
+
+void AlertEngine::clear() {
+    rtc.count = 0;
+}
+
+bool AlertEngine::isValid(const Rule& rule) {
+    return rule.field < TelemetrySerializer::FIELD_COUNT && rule.kind <= ALERT_ANOMALY && !isnan(rule.limit);
+}
+
+size_t AlertEngine::defaultRules(Rule* rules, size_t maxRules) {
+    size_t count = 0;
+    for (size_t i = 0; i < sizeof(DEFAULT_RULES) / sizeof(DEFAULT_RULES[0]) && count < maxRules; i++) {
+        Rule& rule = rules[count++];
+        rule.field = (uint8_t)TelemetrySerializer::fieldIndex(DEFAULT_RULES[i].field);
+        rule.kind = DEFAULT_RULES[i].kind;
+        rule.limit = DEFAULT_RULES[i].limit;
+        rule.alpha = DEFAULT_ALPHA;
+    }
+    return count;
+}
+
+// An anomaly weight outside (0, 1] becomes the default
+AlertEngine::Rule AlertEngine::normalize(const Rule& rule) {
+    Rule result = rule;
+    if (rule.kind == ALERT_ANOMALY && !(rule.alpha > 0.0f && rule.alpha <= 1.0f)) {
+        result.alpha = DEFAULT_ALPHA;
+    }
+    return result;
+}
+
+bool AlertEngine::add(const Rule& rule) {
+    if (rtc.count >= MAX_RULES || !isValid(rule)) {
+        return false;
+    }
+    RuleState& state = rtc.rules[rtc.count];
+    memset(&state, 0, sizeof(state));
+    state.rule = normalize(rule);
+    rtc.count++;
+    return true;
+}
+
+// Whether the rule's condition holds for this value; updates its history
+bool AlertEngine::check(RuleState& state, float value, uint64_t now, float& observed) {
+    const Rule& rule = state.rule;
+    observed = value;
+    switch (rule.kind) {
+        case ALERT_ABOVE:
+            return state.active ? value > rule.limit - fabsf(rule.limit) * CLEAR_MARGIN
+                                : value >= rule.limit;
+        case ALERT_BELOW:
+            return state.active ? value < rule.limit + fabsf(rule.limit) * CLEAR_MARGIN
+                                : value <= rule.limit;
+        case ALERT_RATE: {
+            // Nothing to compare with on the first reading, or when SNTP
+            // stepped the clock back; the rule stays as it was
+            bool first = state.samples == 0 || now <= state.lastAt;
+            uint64_t elapsed = now - state.lastAt;
+            float last = state.last;
+            state.last = value;
+            state.lastAt = now;
+            state.samples = 1;
+            if (first) {
+                return state.active;
+            }
+            observed = (value - last) * 1000.0f / (float)elapsed;
+            return rule.limit >= 0 ? observed >= rule.limit : observed <= rule.limit;
+        }
+        case ALERT_ANOMALY: {
+            float diff = value - state.mean;
+            float floor = state.mean * MIN_RELATIVE_SIGMA;
+            float variance = state.variance > floor * floor ? state.variance : floor * floor;
+            bool warm = state.samples >= ANOMALY_WARMUP;
+            bool anomalous = warm && diff * diff > rule.limit * rule.limit * variance;
+            if (anomalous) {
+                observed = diff / sqrtf(variance);
+            }
+            if (state.samples == 0) {
+                state.mean = value;
+            } else {
+                state.mean += rule.alpha * diff;
+                state.variance = (1.0f - rule.alpha) * (state.variance + rule.alpha * diff * diff);
+            }
+            if (state.samples < ANOMALY_WARMUP) {
+                state.samples++;
+            }
+            return anomalous;
+        }
+    }
+    return false;
+}
+
+size_t AlertEngine::evaluate(const SensorData& data, uint64_t epochMillis, Event* events, size_t maxEvents) {
+    size_t count = 0;
+    rtc.stats.evaluated++;
+    for (uint8_t i = 0; i < rtc.count; i++) {
+        RuleState& state = rtc.rules[i];
+        const TelemetryField& field = TelemetrySerializer::FIELDS[state.rule.field];
+        if (!(data.validMask & (1 << field.channel))) {
+            continue;
+        }
+        float value = TelemetrySerializer::numericValue(field, data);
+        if (isnan(value)) {
+            continue;
+        }
+        // Unset clock: the rate keeps its last timed reading until it is set
+        if (state.rule.kind == ALERT_RATE && epochMillis == 0) {
+            continue;
+        }
+        float observed;
+        bool holds = check(state, value, epochMillis, observed);
+        if (holds == state.active) {
+            continue;
+        }
+        state.active = holds;
+        if (holds) {
+            rtc.stats.raised++;
+        }
+        if (count < maxEvents) {
+            Event& event = events[count++];
+            event.seq = rtc.nextSeq++;
+            event.timestamp = (uint32_t)(epochMillis / 1000);
+            event.rule = i;
+            event.raised = holds;
+            event.value = value;
+            event.observed = observed;
+            event.definition = state.rule;
+        }
+    }
+    return count;
+}
+
+bool AlertEngine::parseKind(const char* name, Kind& kind) {
+    for (uint8_t i = 0; name != nullptr && i <= ALERT_ANOMALY; i++) {
+        if (strcmp(name, KIND_NAMES[i]) == 0) {
+            kind = (Kind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* AlertEngine::kindName(Kind kind) {
+    return kind <= ALERT_ANOMALY ? KIND_NAMES[kind] : "unknown";
+}
+
+size_t AlertEngine::serialize(const Event& event, char* buffer, size_t size) {
+    JsonWriter json(buffer, size);
+    json.beginObject();
+    json.key("seq");
+    json.value(event.seq);
+    json.key("ts");
+    json.value(event.timestamp);
+    json.key("rule");
+    json.value((uint32_t)event.rule);
+    json.key("field");
+    json.value(TelemetrySerializer::FIELDS[event.definition.field].key);
+    json.key("kind");
+    json.value(kindName(event.definition.kind));
+    json.key("state");
+    json.value(event.raised ? "raised" : "cleared");
+    json.key("value");
+    json.value(event.value);
+    json.key("observed");
+    json.value(event.observed);
+    json.key("limit");
+    json.value(event.definition.limit);
+    json.endObject();
+    return json.ok() ? json.length() : 0;
+}
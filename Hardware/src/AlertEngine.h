@@ -0,0 +1,118 @@
+#ifndef ALERT_ENGINE_H
+#define ALERT_ENGINE_H
+
+#include <Arduino.h>
+#include "SensorData.h"
+
+// Alert rules evaluated on the device against every sample, so an H2
+// spike or a CO2 jump is reported within one sample period instead of
+// after the trip through the backend.
+//
+// A rule watches one telemetry field (TelemetrySerializer::FIELDS index):
+//   ABOVE / BELOW  the value crosses limit; clears CLEAR_MARGIN back
+//   RATE           change per second reaches limit (a negative limit
+//                  watches for falls); timed on the wall clock, so it
+//                  waits until SNTP has set it
+//   ANOMALY        the value is more than limit standard deviations from
+//                  the field's EWMA mean; alpha weights each new sample
+// Evaluation is a fixed amount of work per rule, with no allocation. A
+// rule reports an event when its condition starts to hold and another
+// when it stops; fields whose sensor is stale are skipped.
+//
+// The rule table is stored with the device settings and handed over with
+// setRules(). Rules and their running state live in RTC slow memory, so in
+// SLEEP mode the baselines carry across wakes.
+class AlertEngine {
+public:
+    enum Kind : uint8_t {
+        ALERT_ABOVE,
+        ALERT_BELOW,
+        ALERT_RATE,
+        ALERT_ANOMALY
+    };
+
+    static const size_t MAX_RULES = 16;
+    static const uint16_t ANOMALY_WARMUP = 20;   // samples before it may fire
+
+    struct Rule {
+        uint8_t field;
+        Kind kind;
+        float limit;
+        float alpha;             // ANOMALY only
+    };
+
+    struct Event {
+        uint32_t seq;            // per event, so retries can be told apart
+        uint32_t timestamp;
+        uint8_t rule;
+        bool raised;             // false once the condition has cleared
+        float value;
+        float observed;          // value, change per s or deviations, by kind
+        Rule definition;
+    };
+
+    struct Stats {
+        uint32_t evaluated;      // samples
+        uint32_t raised;
+    };
+
+private:
+    struct RuleState {
+        Rule rule;
+        bool active;
+        uint16_t samples;
+        float last;
+        uint64_t lastAt;         // Unix time in ms of last, RATE only
+        float mean;
+        float variance;
+    };
+
+    struct RtcState {
+        uint32_t magic;
+        uint8_t count;
+        uint32_t nextSeq;
+        RuleState rules[MAX_RULES];
+        Stats stats;
+    };
+
+    static RtcState rtc;
+
+    static Rule normalize(const Rule& rule);
+    static bool check(RuleState& state, float value, uint64_t now, float& observed);
+
+public:
+    // Validates the RTC state, starting with no rules after a power cycle
+    void begin();
+
+    // Makes rules the rule table. When it is the table already running,
+    // e.g. on a wake from deep sleep, the rules keep their history.
+    void setRules(const Rule* rules, size_t count);
+    void clear();
+    // False when the table is full or the rule is malformed
+    bool add(const Rule& rule);
+    size_t ruleCount() const { return rtc.count; }
+    const Rule& getRule(size_t index) const { return rtc.rules[index].rule; }
+
+    // Runs every rule on one sample taken at epochMillis, Unix time in ms
+    // or 0 while the clock is unset. Awake and woken from deep sleep alike,
+    // so rates span sleeps. Up to maxEvents events are written to events;
+    // returns how many.
+    size_t evaluate(const SensorData& data, uint64_t epochMillis, Event* events, size_t maxEvents);
+
+    const Stats& getStats() const { return rtc.stats; }
+
+    // A known field and kind and a limit that is a number
+    static bool isValid(const Rule& rule);
+    // Writes the thresholds the firmware ships with; returns how many
+    static size_t defaultRules(Rule* rules, size_t maxRules);
+
+    // "above", "below", "rate", "anomaly"; false for anything else
+    static bool parseKind(const char* name, Kind& kind);
+    static const char* kindName(Kind kind);
+
+    // Writes the event as a JSON object. Returns the length, or 0 if the
+    // buffer is too small.
+    static size_t serialize(const Event& event, char* buffer, size_t size);
+};
+
+#endif
@@ -0,0 +1,268 @@
+#include "BrokerDiscovery.h"
+#include <lwip/sockets.h>
+#include <mdns.h>
+#include <errno.h>
+#include <string.h>
+
+namespace {
+
+// Addresses are kept as lwIP stores them: network byte order
+uint32_t toAddress(const IPAddress& ip) {
+    uint8_t bytes[4] = { ip[0], ip[1], ip[2], ip[3] };
+    uint32_t address;
+    memcpy(&address, bytes, sizeof(address));
+    return address;
+}
+
+uint32_t withHost(uint32_t address, uint8_t host) {
+    uint8_t bytes[4];
+    memcpy(bytes, &address, sizeof(bytes));
+    bytes[3] = host;
+    memcpy(&address, bytes, sizeof(address));
+    return address;
+}
+
+uint8_t hostOf(uint32_t address) {
+    uint8_t bytes[4];
+    memcpy(bytes, &address, sizeof(bytes));
+    return bytes[3];
+}
+
+}  // namespace
+
+BrokerDiscovery::BrokerDiscovery()
+    : state(IDLE)
+    , priorityCount(0)
+    , priorityNext(0)
+    , local(0)
+    , sweepBase(0)
+    , sweepNext(1)
+    , found(0)
+    , startedAt(0)
+    , finishedAt(0)
+    , probesStarted(0)
+    , mdnsSearch(nullptr) {
+    for (size_t i = 0; i < MAX_PROBES; i++) {
+        probes[i].fd = -1;
+    }
+}
+
+void BrokerDiscovery::start(const IPAddress& localIP, const IPAddress& gateway, const IPAddress& cached) {
+    cancel();
+    local = toAddress(localIP);
+    sweepBase = withHost(local, 0);
+    sweepNext = 1;
+    priorityCount = 0;
+    priorityNext = 0;
+    found = 0;
+    probesStarted = 0;
+    addPriority(toAddress(cached));
+    addPriority(toAddress(gateway));
+
+    // A query left over from the last search keeps its slot until it ends
+    if (reapMdns(false) && mdns_init() == ESP_OK) {
+        mdnsSearch = mdns_query_async_new(nullptr, "_mqtt", "_tcp", MDNS_TYPE_PTR,
+                                          MDNS_TIMEOUT, MAX_PRIORITY);
+    }
+    startedAt = millis();
+    state = RUNNING;
+}
+
+void BrokerDiscovery::addPriority(uint32_t address) {
+    if (address == 0 || address == local || priorityCount >= MAX_PRIORITY) {
+        return;
+    }
+    // The sweep may already have been there
+    if (withHost(address, 0) == sweepBase && hostOf(address) < sweepNext) {
+        return;
+    }
+    for (size_t i = 0; i < priorityCount; i++) {
+        if (priority[i] == address) {
+            return;
+        }
+    }
+    priority[priorityCount++] = address;
+}
+
+bool BrokerDiscovery::tried(uint32_t address) const {
+    if (address == local) {
+        return true;
+    }
+    for (size_t i = 0; i < priorityCount; i++) {
+        if (priority[i] == address) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BrokerDiscovery::nextCandidate(uint32_t& address) {
+    if (priorityNext < priorityCount) {
+        address = priority[priorityNext++];
+        return true;
+    }
+    while (sweepNext <= 254) {
+        address = withHost(sweepBase, (uint8_t)sweepNext++);
+        if (!tried(address)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Starts a connect on fd; false when it already ended and the slot is free
+bool BrokerDiscovery::openProbe(Probe& probe, int fd, uint32_t address, unsigned long now) {
+    probesStarted++;
+    lwip_fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    struct sockaddr_in target;
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_port = htons(MQTT_PORT);
+    target.sin_addr.s_addr = address;
+
+    if (lwip_connect(fd, (struct sockaddr*)&target, sizeof(target)) == 0) {
+        lwip_close(fd);
+        found = address;
+        finish(FOUND);
+        return false;
+    }
+    if (errno != EINPROGRESS) {
+        lwip_close(fd);
+        return false;
+    }
+    probe.fd = fd;
+    probe.address = address;
+    probe.started = now;
+    return true;
+}
+
+void BrokerDiscovery::closeProbe(Probe& probe) {
+    if (probe.fd >= 0) {
+        lwip_close(probe.fd);
+        probe.fd = -1;
+    }
+}
+
+// Collects the mDNS answers once the query is over; true when no query
+// is outstanding any more
+bool BrokerDiscovery::reapMdns(bool useResults) {
+    if (mdnsSearch == nullptr) {
+        return true;
+    }
+    mdns_result_t* results = nullptr;
+    if (!mdns_query_async_get_results(mdnsSearch, 0, &results)) {
+        return false;
+    }
+    for (mdns_result_t* r = results; useResults && r != nullptr; r = r->next) {
+        for (mdns_ip_addr_t* a = r->addr; a != nullptr; a = a->next) {
+            if (a->addr.type == ESP_IPADDR_TYPE_V4) {
+                addPriority(a->addr.u_addr.ip4.addr);
+            }
+        }
+    }
+    if (results != nullptr) {
+        mdns_query_results_free(results);
+    }
+    mdns_query_async_delete(mdnsSearch);
+    mdnsSearch = nullptr;
+    return true;
+}
+
+BrokerDiscovery::State BrokerDiscovery::step() {
+    if (state != RUNNING) {
+        reapMdns(false);
+        return state;
+    }
+    unsigned long now = millis();
+    reapMdns(true);
+
+    // A socket turns writable once its connect has an outcome; SO_ERROR
+    // tells an accept from a refusal
+    fd_set writable;
+    FD_ZERO(&writable);
+    int maxFd = -1;
+    for (size_t i = 0; i < MAX_PROBES; i++) {
+        if (probes[i].fd >= 0) {
+            FD_SET(probes[i].fd, &writable);
+            if (probes[i].fd > maxFd) {
+                maxFd = probes[i].fd;
+            }
+        }
+    }
+    if (maxFd >= 0) {
+        struct timeval zero = { 0, 0 };
+        if (lwip_select(maxFd + 1, nullptr, &writable, nullptr, &zero) > 0) {
+            for (size_t i = 0; i < MAX_PROBES; i++) {
+                if (probes[i].fd < 0 || !FD_ISSET(probes[i].fd, &writable)) {
+                    continue;
+                }
+                int error = 0;
+                socklen_t length = sizeof(error);
+                lwip_getsockopt(probes[i].fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error == 0) {
+                    found = probes[i].address;
+                    finish(FOUND);
+                    return state;
+                }
+                closeProbe(probes[i]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < MAX_PROBES; i++) {
+        if (probes[i].fd >= 0 && now - probes[i].started >= PROBE_TIMEOUT) {
+            closeProbe(probes[i]);
+        }
+    }
+    if (now - startedAt >= DISCOVERY_TIMEOUT) {
+        finish(FAILED);
+        return state;
+    }
+
+    bool exhausted = false;
+    bool open = false;
+    for (size_t i = 0; i < MAX_PROBES && state == RUNNING; i++) {
+        if (probes[i].fd >= 0) {
+            open = true;
+            continue;
+        }
+        if (exhausted) {
+            continue;
+        }
+        int fd = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (fd < 0) {
+            // Out of sockets; the rest wait for the next step
+            exhausted = priorityNext >= priorityCount && sweepNext > 254;
+            break;
+        }
+        uint32_t candidate;
+        if (!nextCandidate(candidate)) {
+            lwip_close(fd);
+            exhausted = true;
+            continue;
+        }
+        open |= openProbe(probes[i], fd, candidate, now);
+    }
+    // mDNS may still add candidates after the sweep is done
+    if (state == RUNNING && exhausted && !open && mdnsSearch == nullptr) {
+        finish(FAILED);
+    }
+    return state;
+}
+
+void BrokerDiscovery::finish(State result) {
+    for (size_t i = 0; i < MAX_PROBES; i++) {
+        closeProbe(probes[i]);
+    }
+    reapMdns(false);
+    finishedAt = millis();
+    state = result;
+}
+
+void BrokerDiscovery::cancel() {
+    if (state == RUNNING) {
+        finish(IDLE);
+    }
+    state = IDLE;
+}
@@ -0,0 +1,83 @@
+#ifndef BROKER_DISCOVERY_H
+#define BROKER_DISCOVERY_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+struct mdns_search_once_s;
+
+// Finds an MQTT broker on the local network without blocking.
+//
+// Candidates are probed with non-blocking TCP connects to port 1883, up to
+// MAX_PROBES at a time: first the cached broker and the gateway, then any
+// host answering an mDNS query for _mqtt._tcp, then a sweep of the /24
+// around our own address. On a LAN a live host answers within a few ms, so
+// each probe gets PROBE_TIMEOUT, and the whole search gives up after
+// DISCOVERY_TIMEOUT. The first host that accepts wins.
+//
+// step() does one round of bookkeeping and returns; call it often.
+class BrokerDiscovery {
+public:
+    static const size_t MAX_PROBES = 12;              // lwIP has 16 sockets
+    static const unsigned long PROBE_TIMEOUT = 250;   // ms
+    static const unsigned long DISCOVERY_TIMEOUT = 6000;
+    static const unsigned long MDNS_TIMEOUT = 1500;
+    static const uint16_t MQTT_PORT = 1883;
+
+    enum State {
+        IDLE,
+        RUNNING,
+        FOUND,
+        FAILED
+    };
+
+private:
+    static const size_t MAX_PRIORITY = 6;
+
+    struct Probe {
+        int fd;                  // -1 when the slot is free
+        uint32_t address;        // network byte order
+        unsigned long started;
+    };
+
+    State state;
+    Probe probes[MAX_PROBES];
+    uint32_t priority[MAX_PRIORITY];   // probed before the sweep
+    size_t priorityCount;
+    size_t priorityNext;
+    uint32_t local;
+    uint32_t sweepBase;                // x.y.z.0 of our /24
+    uint16_t sweepNext;                // next host number, 1..254
+    uint32_t found;
+    unsigned long startedAt;
+    unsigned long finishedAt;
+    uint16_t probesStarted;
+    // Outlives the search that started it when the broker answers first;
+    // IDF only frees a query once it has run its course
+    mdns_search_once_s* mdnsSearch;
+
+    bool nextCandidate(uint32_t& address);
+    bool tried(uint32_t address) const;
+    void addPriority(uint32_t address);
+    bool openProbe(Probe& probe, int fd, uint32_t address, unsigned long now);
+    void closeProbe(Probe& probe);
+    bool reapMdns(bool useResults);
+    void finish(State result);
+
+public:
+    BrokerDiscovery();
+    ~BrokerDiscovery() { cancel(); }
+
+    // Begins a search; cached is tried first unless it is 0.0.0.0
+    void start(const IPAddress& localIP, const IPAddress& gateway, const IPAddress& cached);
+    State step();
+    void cancel();
+
+    State getState() const { return state; }
+    IPAddress result() const { return IPAddress(found); }
+    // Length of the last finished search in ms, and probes it opened
+    unsigned long duration() const { return finishedAt - startedAt; }
+    uint16_t probeCount() const { return probesStarted; }
+};
+
+#endif
@@ -0,0 +1,380 @@
+#include "ConfigStore.h"
+#include <Preferences.h>
+#include <stddef.h>
+#include <string.h>
+#include "Diagnostics.h"
+#include "JsonWriter.h"
+#include "MQTTManager.h"
+#include "PowerManager.h"
+#include "SampleStore.h"
+#include "SensorManager.h"
+#include "WiFiManager.h"
+#include "WindowStats.h"
+
+namespace {
+
+const char* NAMESPACE = "config";
+const char* SLOT_KEYS[2] = { "slot0", "slot1" };
+const uint32_t DAY = 86400;                  // s
+const uint32_t DAY_MILLIS = DAY * 1000;
+const uint32_t MAX_PIN = 39;                 // highest ESP32 GPIO
+const uint32_t MAX_OUTPUT_PIN = 33;          // 34 to 39 are input only
+const uint16_t TABLES_SINCE = 2;             // alert rules and deadband policies
+
+constexpr size_t typeSize(ConfigStore::Type type) {
+    return type == ConfigStore::TYPE_U32 ? 4 : type == ConfigStore::TYPE_U16 ? 2 : 1;
+}
+
+// A member whose size does not match its schema type stops the build
+constexpr uint16_t checkedOffset(size_t offset, size_t size, ConfigStore::Type type) {
+    return size == typeSize(type) ? (uint16_t)offset : throw "config field type does not match its member";
+}
+
+#define CONFIG_FIELD(key, member, type, since, def, min, max) \
+    { key, ConfigStore::type, since, \
+      checkedOffset(offsetof(DeviceConfig, member), sizeof(((DeviceConfig*)nullptr)->member), ConfigStore::type), \
+      def, min, max }
+
+static_assert(SENSOR_CHANNEL_COUNT == 6, "the schema has a rate_ field per sensor channel");
+static_assert(SENSOR_FIELD_COUNT < 32, "stats_fields is a 32-bit mask");
+
+constexpr ConfigStore::Field FIELDS[] = {
+    CONFIG_FIELD("enable", enabled, TYPE_BOOL, 1, 1, 0, 1),
+    CONFIG_FIELD("logging", logging, TYPE_BOOL, 1, 1, 0, 1),
+    CONFIG_FIELD("binary", binary, TYPE_BOOL, 1, 0, 0, 1),
+    CONFIG_FIELD("radar_burst", radarBurst, TYPE_BOOL, 1, 1, 0, 1),
+    CONFIG_FIELD("interval", statusInterval, TYPE_U32, 1, 30, 1, DAY),
+    CONFIG_FIELD("batch_samples", batchSamples, TYPE_U16, 1, 0, 0, SampleStore::MAX_BATCH),
+    CONFIG_FIELD("batch_seconds", batchWindow, TYPE_U32, 1, 30, 1, DAY),
+    CONFIG_FIELD("rate_soil", periods[SENSOR_SOIL], TYPE_U32, 1,
+                 SensorManager::DEFAULT_SOIL_PERIOD, SensorManager::MIN_PERIOD, DAY_MILLIS),
+    CONFIG_FIELD("rate_dht", periods[SENSOR_DHT], TYPE_U32, 1,
+                 SensorManager::DEFAULT_DHT_PERIOD, SensorManager::MIN_DHT_PERIOD, DAY_MILLIS),
+    CONFIG_FIELD("rate_mq8", periods[SENSOR_MQ8], TYPE_U32, 1,
+                 SensorManager::DEFAULT_MQ8_PERIOD, SensorManager::MIN_PERIOD, DAY_MILLIS),
+    CONFIG_FIELD("rate_ccs811", periods[SENSOR_CCS811], TYPE_U32, 1,
+                 SensorManager::DEFAULT_CCS811_PERIOD, SensorManager::MIN_PERIOD, DAY_MILLIS),
+    CONFIG_FIELD("rate_radar", periods[SENSOR_RADAR], TYPE_U32, 1,
+                 SensorManager::DEFAULT_RADAR_PERIOD, SensorManager::MIN_PERIOD, DAY_MILLIS),
+    CONFIG_FIELD("rate_sds011", periods[SENSOR_SDS011], TYPE_U32, 1,
+                 SensorManager::DEFAULT_SDS_PERIOD, SensorManager::MIN_PERIOD, DAY_MILLIS),
+    CONFIG_FIELD("sds011_on", sdsOnTime, TYPE_U32, 1,
+                 SensorManager::DEFAULT_SDS_ON_TIME, SensorManager::MIN_SDS_ON_TIME, DAY_MILLIS),
+    CONFIG_FIELD("stats_window", statsWindow, TYPE_U32, 1,
+                 WindowStats::DEFAULT_WINDOW / 1000, WindowStats::MIN_WINDOW / 1000, DAY),
+    CONFIG_FIELD("stats_fields", statsFields, TYPE_U32, 1, 0, 0, (1UL << SENSOR_FIELD_COUNT) - 1),
+    CONFIG_FIELD("deadband", deadband, TYPE_BOOL, 1, 1, 0, 1),
+    CONFIG_FIELD("keyframe", keyframe, TYPE_U32, 1,
+                 DeadbandFilter::DEFAULT_KEYFRAME / 1000, DeadbandFilter::MIN_KEYFRAME / 1000, DAY),
+    CONFIG_FIELD("sleep", sleep, TYPE_BOOL, 1, 0, 0, 1),
+    CONFIG_FIELD("sleep_interval", sleepInterval, TYPE_U32, 1,
+                 PowerManager::DEFAULT_INTERVAL / 1000, PowerManager::MIN_INTERVAL / 1000, DAY),
+    CONFIG_FIELD("upload_every", uploadEvery, TYPE_U16, 1,
+                 PowerManager::DEFAULT_UPLOAD_EVERY, 1, PowerManager::RING_CAPACITY),
+    CONFIG_FIELD("mqtt_port", mqttPort, TYPE_U16, 1, MQTTManager::DEFAULT_PORT, 1, 65535),
+    CONFIG_FIELD("mqtt_buffer", mqttBuffer, TYPE_U16, 1,
+                 MQTTManager::MAX_BUFFER_SIZE, MQTTManager::MIN_BUFFER_SIZE, MQTTManager::MAX_BUFFER_SIZE),
+    CONFIG_FIELD("mqtt_retry", mqttRetryDelay, TYPE_U32, 1, 5000, 1000, 600000),
+    CONFIG_FIELD("wifi_retries", wifiRetries, TYPE_U8, 1, WiFiManager::DEFAULT_MAX_RETRIES, 1, 255),
+    CONFIG_FIELD("wifi_retry", wifiRetryDelay, TYPE_U32, 1, WiFiManager::DEFAULT_RETRY_DELAY, 1000, 600000),
+    CONFIG_FIELD("pin_led", ledPin, TYPE_U8, 1, 2, 0, MAX_OUTPUT_PIN),
+    CONFIG_FIELD("pin_dht", dhtPin, TYPE_U8, 1, 4, 0, MAX_PIN),
+    CONFIG_FIELD("pin_mq8", mq8Pin, TYPE_U8, 1, 34, 0, MAX_PIN),
+    CONFIG_FIELD("pin_radar_rx", radarRxPin, TYPE_U8, 1, 16, 0, MAX_PIN),
+    CONFIG_FIELD("pin_radar_tx", radarTxPin, TYPE_U8, 1, 17, 0, MAX_OUTPUT_PIN),
+    CONFIG_FIELD("pin_sds_rx", sdsRxPin, TYPE_U8, 1, 25, 0, MAX_PIN),
+    CONFIG_FIELD("pin_sds_tx", sdsTxPin, TYPE_U8, 1, 26, 0, MAX_OUTPUT_PIN),
+};
+
+const size_t FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+}  // namespace
+
+// Status adds it by reference
+const uint16_t ConfigStore::VERSION;
+
+ConfigStore::ConfigStore()
+    : pendingRejected(false)
+    , generation(0)
+    , slot(SLOT_COUNT - 1)
+    , stats{}
+{
+    loadDefaults(active);
+    memcpy(&pending, &active, sizeof(pending));
+    error[0] = '\0';
+}
+
+const ConfigStore::Field* ConfigStore::find(const char* key) {
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        if (strcmp(FIELDS[i].key, key) == 0) {
+            return &FIELDS[i];
+        }
+    }
+    return nullptr;
+}
+
+uint32_t ConfigStore::read(const DeviceConfig& values, const Field& field) {
+    const uint8_t* at = reinterpret_cast<const uint8_t*>(&values) + field.offset;
+    switch (field.type) {
+        case TYPE_U16: {
+            uint16_t value;
+            memcpy(&value, at, sizeof(value));
+            return value;
+        }
+        case TYPE_U32: {
+            uint32_t value;
+            memcpy(&value, at, sizeof(value));
+            return value;
+        }
+        default:
+            return *at;
+    }
+}
+
+void ConfigStore::write(DeviceConfig& values, const Field& field, uint32_t value) {
+    uint8_t* at = reinterpret_cast<uint8_t*>(&values) + field.offset;
+    switch (field.type) {
+        case TYPE_U16: {
+            uint16_t narrow = (uint16_t)value;
+            memcpy(at, &narrow, sizeof(narrow));
+            break;
+        }
+        case TYPE_U32:
+            memcpy(at, &value, sizeof(value));
+            break;
+        default:
+            *at = (uint8_t)value;
+            break;
+    }
+}
+
+void ConfigStore::loadDefaults(DeviceConfig& values) {
+    // Zeroed padding keeps records and comparisons byte-for-byte stable
+    memset(&values, 0, sizeof(values));
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        write(values, FIELDS[i], FIELDS[i].defaultValue);
+    }
+    values.alertCount = (uint8_t)AlertEngine::defaultRules(values.alertRules, AlertEngine::MAX_RULES);
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++) {
+        values.deadbandPolicies[i].delta = DeadbandFilter::defaultPolicy(i).delta;
+        values.deadbandPolicies[i].heartbeatMillis = DeadbandFilter::defaultPolicy(i).heartbeatMillis;
+    }
+}
+
+bool ConfigStore::rulesValid(const DeviceConfig& values) {
+    if (values.alertCount > AlertEngine::MAX_RULES) {
+        return false;
+    }
+    for (size_t i = 0; i < values.alertCount; i++) {
+        if (!AlertEngine::isValid(values.alertRules[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ConfigStore::policiesValid(const DeviceConfig& values) {
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++) {
+        if (!DeadbandFilter::isValid(values.deadbandPolicies[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t ConfigStore::crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+// Reads one slot into values; fields it predates or holds out of range
+// get their defaults
+bool ConfigStore::loadSlot(size_t index, DeviceConfig& values, uint32_t& recordGeneration) {
+    Record record;
+    memset(&record, 0, sizeof(record));
+    Preferences prefs;
+    if (!prefs.begin(NAMESPACE, true)) {
+        return false;
+    }
+    size_t length = prefs.getBytesLength(SLOT_KEYS[index]);
+    bool found = length >= sizeof(Header) && length <= sizeof(record) &&
+                prefs.getBytes(SLOT_KEYS[index], &record, length) == length;
+    prefs.end();
+    if (!found) {
+        return false;
+    }
+
+    Header& header = record.header;
+    uint32_t crc = header.crc;
+    header.crc = 0;
+    if (header.magic != MAGIC || header.version == 0 || header.version > VERSION ||
+        header.length != length - sizeof(Header) ||
+        crc32(reinterpret_cast<const uint8_t*>(&record), length) != crc) {
+        DIAG_WARN("Config: slot %u invalid", (unsigned)index);
+        return false;
+    }
+
+    loadDefaults(values);
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        const Field& field = FIELDS[i];
+        if (field.since > header.version) {
+            continue;
+        }
+        uint32_t value = read(record.values, field);
+        if (value < field.min || value > field.max) {
+            DIAG_WARN("Config: stored %s %u out of range, using %u",
+                      field.key, (unsigned)value, (unsigned)field.defaultValue);
+            continue;
+        }
+        write(values, field, value);
+    }
+    // Each table is kept or defaulted as a whole
+    if (header.version >= TABLES_SINCE) {
+        if (rulesValid(record.values)) {
+            values.alertCount = record.values.alertCount;
+            memcpy(values.alertRules, record.values.alertRules, sizeof(values.alertRules));
+        } else {
+            DIAG_WARN("Config: stored alert rules invalid, using defaults");
+        }
+        if (policiesValid(record.values)) {
+            memcpy(values.deadbandPolicies, record.values.deadbandPolicies, sizeof(values.deadbandPolicies));
+        } else {
+            DIAG_WARN("Config: stored deadband policies invalid, using defaults");
+        }
+    }
+    recordGeneration = header.generation;
+    return true;
+}
+
+void ConfigStore::begin() {
+    bool loaded = false;
+    DeviceConfig values;
+    for (size_t i = 0; i < SLOT_COUNT; i++) {
+        uint32_t recordGeneration;
+        if (loadSlot(i, values, recordGeneration) && (!loaded || recordGeneration > generation)) {
+            memcpy(&active, &values, sizeof(active));
+            generation = recordGeneration;
+            slot = i;
+            loaded = true;
+        }
+    }
+    if (!loaded) {
+        loadDefaults(active);
+        generation = 0;
+        slot = SLOT_COUNT - 1;
+    }
+    stats.defaulted = !loaded;
+    revert();
+    DIAG_INFO("Config: %s, generation %u", loaded ? "loaded" : "defaults", (unsigned)generation);
+}
+
+bool ConfigStore::set(const char* key, uint32_t value) {
+    const Field* field = find(key);
+    if (field == nullptr) {
+        snprintf(error, sizeof(error), "unknown key %s", key);
+        pendingRejected = true;
+        return false;
+    }
+    if (value < field->min || value > field->max) {
+        snprintf(error, sizeof(error), "%s must be %u to %u", key, (unsigned)field->min, (unsigned)field->max);
+        pendingRejected = true;
+        return false;
+    }
+    write(pending, *field, value);
+    return true;
+}
+
+void ConfigStore::reject(const char* reason) {
+    snprintf(error, sizeof(error), "%s", reason);
+    pendingRejected = true;
+}
+
+void ConfigStore::restoreDefaults() {
+    loadDefaults(pending);
+}
+
+void ConfigStore::revert() {
+    memcpy(&pending, &active, sizeof(pending));
+    pendingRejected = false;
+}
+
+bool ConfigStore::commit() {
+    // Typed changes through edit() are checked here
+    for (size_t i = 0; i < FIELD_COUNT && !pendingRejected; i++) {
+        uint32_t value = read(pending, FIELDS[i]);
+        if (value < FIELDS[i].min || value > FIELDS[i].max) {
+            snprintf(error, sizeof(error), "%s must be %u to %u",
+                     FIELDS[i].key, (unsigned)FIELDS[i].min, (unsigned)FIELDS[i].max);
+            pendingRejected = true;
+        }
+    }
+    if (!pendingRejected && !rulesValid(pending)) {
+        snprintf(error, sizeof(error), "invalid alert rule");
+        pendingRejected = true;
+    }
+    if (!pendingRejected && !policiesValid(pending)) {
+        snprintf(error, sizeof(error), "invalid deadband policy");
+        pendingRejected = true;
+    }
+    if (pendingRejected) {
+        stats.rejected++;
+        revert();
+        return false;
+    }
+    if (memcmp(&pending, &active, sizeof(pending)) == 0) {
+        return true;
+    }
+
+    Record record;
+    memset(&record, 0, sizeof(record));
+    record.header.magic = MAGIC;
+    record.header.version = VERSION;
+    record.header.length = sizeof(DeviceConfig);
+    record.header.generation = generation + 1;
+    memcpy(&record.values, &pending, sizeof(pending));
+    record.header.crc = crc32(reinterpret_cast<const uint8_t*>(&record), sizeof(record));
+
+    // The other slot: the active record stays intact until this one is whole
+    size_t target = (slot + 1) % SLOT_COUNT;
+    Preferences prefs;
+    bool written = prefs.begin(NAMESPACE, false);
+    if (written) {
+        written = prefs.putBytes(SLOT_KEYS[target], &record, sizeof(record)) == sizeof(record);
+        prefs.end();
+    }
+    if (!written) {
+        snprintf(error, sizeof(error), "NVS write failed");
+        stats.writeFailures++;
+        revert();
+        return false;
+    }
+
+    memcpy(&active, &pending, sizeof(active));
+    generation++;
+    slot = target;
+    stats.commits++;
+    DIAG_INFO("Config: generation %u in slot %u", (unsigned)generation, (unsigned)slot);
+    return true;
+}
+
+size_t ConfigStore::serialize(char* out, size_t size) const {
+    JsonWriter json(out, size);
+    json.beginObject();
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        json.key(FIELDS[i].key);
+        uint32_t value = read(active, FIELDS[i]);
+        if (FIELDS[i].type == TYPE_BOOL) {
+            json.value(value != 0);
+        } else {
+            json.value(value);
+        }
+    }
+    json.endObject();
+    return json.ok() ? json.length() : 0;
+}
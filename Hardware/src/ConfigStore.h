@@ -0,0 +1,152 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include "AlertEngine.h"
+#include "DeadbandFilter.h"
+#include "SensorData.h"
+
+// Settings that commands change, in the units the commands use. New fields
+// go at the end with ConfigStore::VERSION bumped and their "since" set to
+// it in the schema, so a record from older firmware still loads and only
+// the new fields take their defaults.
+struct DeviceConfig {
+    uint8_t enabled;                          // take samples at all
+    uint8_t logging;                          // log lines to Serial and <id>/logs
+    uint8_t binary;                           // also publish records to <id>/bin
+    uint8_t radarBurst;                       // presence-triggered radar tracks
+    uint32_t statusInterval;                  // s between status messages
+    uint16_t batchSamples;                    // per <id>/batch message, 0 or 1 is off
+    uint32_t batchWindow;                     // s the oldest sample waits for a batch
+    uint32_t periods[SENSOR_CHANNEL_COUNT];   // ms, in SensorChannel order
+    uint32_t sdsOnTime;                       // ms of each SDS011 cycle awake
+    uint32_t statsWindow;                     // s
+    uint32_t statsFields;                     // fields sent as window summaries
+    uint8_t deadband;                         // report-by-exception on the live topic
+    uint32_t keyframe;                        // s between full samples
+    uint8_t sleep;                            // deep-sleep power mode
+    uint32_t sleepInterval;                   // s between samples while sleeping
+    uint16_t uploadEvery;                     // samples per radio wake
+    uint16_t mqttPort;
+    uint16_t mqttBuffer;                      // bytes, from the next connect
+    uint32_t mqttRetryDelay;                  // ms between broker connects
+    uint8_t wifiRetries;                      // failed rounds before a restart
+    uint32_t wifiRetryDelay;                  // ms per attempt and between rounds
+    // Wiring, used from the next boot
+    uint8_t ledPin;
+    uint8_t dhtPin;
+    uint8_t mq8Pin;
+    uint8_t radarRxPin;
+    uint8_t radarTxPin;
+    uint8_t sdsRxPin;
+    uint8_t sdsTxPin;
+    // Tables, outside the schema; since version 2
+    uint8_t alertCount;
+    AlertEngine::Rule alertRules[AlertEngine::MAX_RULES];      // unused past alertCount are 0
+    DeadbandFilter::Policy deadbandPolicies[SENSOR_FIELD_COUNT];   // in TelemetrySerializer::FIELDS order
+};
+
+// DeviceConfig kept in NVS and described by a schema compiled into the
+// firmware: per field its key, type, default and allowed range.
+//
+// Changes collect in a pending copy (edit(), set()) and take effect with
+// commit(), all of them or none: a field out of range or a failed write
+// drops the whole change, and so does an invalid alert rule or deadband
+// policy in the tables. Records alternate between two NVS slots, each
+// with a generation and a CRC-32, and a commit only ever overwrites the
+// older one, so losing power mid-write leaves the previous settings.
+class ConfigStore {
+public:
+    static const uint16_t VERSION = 2;
+
+    enum Type : uint8_t {
+        TYPE_BOOL,
+        TYPE_U8,
+        TYPE_U16,
+        TYPE_U32
+    };
+
+    struct Field {
+        const char* key;
+        Type type;
+        uint8_t since;           // schema version that added it
+        uint16_t offset;         // in DeviceConfig
+        uint32_t defaultValue;
+        uint32_t min;
+        uint32_t max;
+    };
+
+    // Since boot
+    struct Stats {
+        uint16_t commits;
+        uint16_t rejected;       // unknown key or value out of range
+        uint16_t writeFailures;
+        bool defaulted;          // no valid record at boot
+    };
+
+private:
+    static const uint32_t MAGIC = 0x31474643;   // "CFG1"
+    static const size_t SLOT_COUNT = 2;
+
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t length;         // bytes of DeviceConfig that follow
+        uint32_t generation;     // the valid slot with the highest wins
+        uint32_t crc;            // CRC-32 of the record with this field 0
+    };
+
+    struct Record {
+        Header header;
+        DeviceConfig values;
+    };
+
+    DeviceConfig active;
+    DeviceConfig pending;
+    bool pendingRejected;
+    uint32_t generation;
+    size_t slot;                 // holds the active record
+    Stats stats;
+    char error[48];
+
+    static const Field* find(const char* key);
+    static uint32_t read(const DeviceConfig& values, const Field& field);
+    static void write(DeviceConfig& values, const Field& field, uint32_t value);
+    static void loadDefaults(DeviceConfig& values);
+    static bool rulesValid(const DeviceConfig& values);
+    static bool policiesValid(const DeviceConfig& values);
+    static uint32_t crc32(const uint8_t* data, size_t length);
+    bool loadSlot(size_t index, DeviceConfig& values, uint32_t& recordGeneration);
+
+public:
+    ConfigStore();
+
+    // Loads the newest valid record, or the defaults if there is none
+    void begin();
+
+    const DeviceConfig& get() const { return active; }
+    uint32_t getGeneration() const { return generation; }
+    const Stats& getStats() const { return stats; }
+    const char* lastError() const { return error; }
+
+    // The pending copy, for typed changes
+    DeviceConfig& edit() { return pending; }
+    // Changes a field by its key; an unknown key or a value out of range
+    // fails, and so will the commit
+    bool set(const char* key, uint32_t value);
+    // Fails the pending change, e.g. for a value of the wrong type
+    void reject(const char* reason);
+    // Every field back to its default, pending until commit()
+    void restoreDefaults();
+    // Makes the pending values the active ones and stores them; true also
+    // when nothing changed. On failure the pending changes are dropped.
+    bool commit();
+    void revert();
+
+    // Every field by key, e.g. {"enable": true, "interval": 30, ...}, which
+    // a {"config": ...} command takes back as is; returns the length, or 0
+    // if it does not fit
+    size_t serialize(char* out, size_t size) const;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "DeadbandFilter.h"
+#include "TelemetrySerializer.h"
+#include <math.h>
+
+// In SENSOR_DATA_FIELDS order: sensor noise floor or a bit above it
+const DeadbandFilter::Policy DeadbandFilter::DEFAULT_POLICIES[SENSOR_FIELD_COUNT] = {
+    { 0.2f,  600000 },   // soil_temperature, C
+    { 10.0f, 600000 },   // soil_moisture, raw capacitance
+    { 0.2f,  300000 },   // air_temperature, C
+    { 1.0f,  300000 },   // humidity, %
+    { 20.0f, 300000 },   // hydrogen_raw, ADC counts
+    { 0.02f, 300000 },   // hydrogen_voltage, V
+    { 25.0f, 300000 },   // co2, ppm
+    { 10.0f, 300000 },   // tvoc, ppb
+    { 0.0f,  300000 },   // target_count
+    { 0.1f,  300000 },   // target_speed, m/s
+    { 0.1f,  300000 },   // target_distance, m
+    { 50.0f, 300000 },   // target_energy
+    { 1.0f,  600000 },   // pm25, ug/m3
+    { 1.0f,  600000 },   // pm10, ug/m3
+};
+
+DeadbandFilter::DeadbandFilter()
+    : everSent(0)
+    , lastKeyframe(0)
+    , keyframeMillis(DEFAULT_KEYFRAME)
+    , enabled(true)
+    , keyframeForced(true)
+    , fieldsSampled(0)
+    , fieldsSent(0)
+{
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++) {
+        policies[i] = DEFAULT_POLICIES[i];
+        lastValue[i] = NAN;
+        lastSent[i] = 0;
+    }
+}
+
+void DeadbandFilter::setEnabled(bool on) {
+    if (on && !enabled) {
+        keyframeForced = true;
+    }
+    enabled = on;
+}
+
+void DeadbandFilter::setKeyframeInterval(unsigned long periodMillis) {
+    keyframeMillis = periodMillis < MIN_KEYFRAME ? MIN_KEYFRAME : periodMillis;
+}
+
+uint32_t DeadbandFilter::select(const SensorData& data, unsigned long now, bool& keyframe) const {
+    keyframe = !enabled || keyframeForced || now - lastKeyframe >= keyframeMillis;
+    if (keyframe) {
+        return TelemetrySerializer::ALL_FIELDS;
+    }
+
+    uint32_t fields = 0;
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++) {
+        const TelemetryField& field = TelemetrySerializer::FIELDS[i];
+        // A stale channel only repeats its cached value; the keyframe covers it
+        if (!(data.validMask & (1 << field.channel))) {
+            continue;
+        }
+
+        uint32_t bit = 1UL << i;
+        float value = TelemetrySerializer::numericValue(field, data);
+        float last = lastValue[i];
+        const Policy& policy = policies[i];
+
+        bool changed;
+        if (!(everSent & bit) || isnan(value) != isnan(last)) {
+            changed = true;
+        } else if (isnan(value)) {
+            changed = false;
+        } else if (policy.delta > 0) {
+            changed = fabsf(value - last) >= policy.delta;
+        } else {
+            changed = value != last;
+        }
+
+        if (changed || now - lastSent[i] >= policy.heartbeatMillis) {
+            fields |= bit;
+        }
+    }
+    return fields;
+}
+
+void DeadbandFilter::commit(const SensorData& data, uint32_t fields, bool keyframe, unsigned long now) {
+    fieldsSampled += SENSOR_FIELD_COUNT;
+
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++) {
+        uint32_t bit = 1UL << i;
+        if (!(fields & bit)) {
+            continue;
+        }
+        lastValue[i] = TelemetrySerializer::numericValue(TelemetrySerializer::FIELDS[i], data);
+        lastSent[i] = now;
+        everSent |= bit;
+        fieldsSent++;
+    }
+
+    if (keyframe) {
+        lastKeyframe = now;
+        keyframeForced = false;
+    }
+}
+
+float DeadbandFilter::compressionRatio() const {
+    return fieldsSent > 0 ? (float)fieldsSampled / fieldsSent : 1.0f;
+}
@@ -0,0 +1,75 @@
+#ifndef DEADBAND_FILTER_H
+#define DEADBAND_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+
+// Report-by-exception for the live telemetry topic. A field is reported
+// when it has moved more than its deadband since it was last reported, or
+// when its heartbeat interval has passed without a report. Every keyframe
+// interval the whole sample goes out so late subscribers converge.
+//
+// Field masks follow TelemetrySerializer::FIELDS (bit n = FIELDS[n]).
+class DeadbandFilter {
+public:
+    static const unsigned long DEFAULT_KEYFRAME = 300000;  // 5 min
+    static const unsigned long MIN_KEYFRAME = 10000;
+    static const uint32_t MAX_HEARTBEAT = 86400000;        // 1 day
+
+    struct Policy {
+        float delta;              // change that triggers a report, 0 = any change
+        uint32_t heartbeatMillis; // longest silence for the field
+    };
+
+private:
+    static const Policy DEFAULT_POLICIES[SENSOR_FIELD_COUNT];
+
+    Policy policies[SENSOR_FIELD_COUNT];
+    float lastValue[SENSOR_FIELD_COUNT];
+    unsigned long lastSent[SENSOR_FIELD_COUNT];
+    uint32_t everSent;            // fields reported at least once
+    unsigned long lastKeyframe;
+    unsigned long keyframeMillis;
+    bool enabled;
+    bool keyframeForced;
+
+    // Fields offered versus fields reported, for the compression ratio
+    uint32_t fieldsSampled;
+    uint32_t fieldsSent;
+
+public:
+    DeadbandFilter();
+
+    void setEnabled(bool on);
+    bool isEnabled() const { return enabled; }
+
+    void setKeyframeInterval(unsigned long periodMillis);
+    unsigned long getKeyframeInterval() const { return keyframeMillis; }
+
+    void setPolicy(size_t field, const Policy& policy) { policies[field] = policy; }
+    const Policy& getPolicy(size_t field) const { return policies[field]; }
+
+    // The noise floor of each sensor field
+    static const Policy& defaultPolicy(size_t field) { return DEFAULT_POLICIES[field]; }
+    // A delta of 0 or more, not NaN, and a heartbeat of at most MAX_HEARTBEAT
+    static bool isValid(const Policy& policy) {
+        return policy.delta >= 0.0f && policy.heartbeatMillis <= MAX_HEARTBEAT;
+    }
+
+    // The next report is a full keyframe, e.g. after a reconnect
+    void forceKeyframe() { keyframeForced = true; }
+
+    // Fields of data that need reporting now. Sets keyframe when the whole
+    // sample must go out (always, while the filter is disabled).
+    uint32_t select(const SensorData& data, unsigned long now, bool& keyframe) const;
+
+    // Records what select() chose once it has been published; call it for
+    // suppressed samples too (fields 0) so the ratio stays honest
+    void commit(const SensorData& data, uint32_t fields, bool keyframe, unsigned long now);
+
+    // Fields sampled per field sent, 1.0 without filtering
+    float compressionRatio() const;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "DeltaPatch.h"
+#include <string.h>
+
+const uint8_t DeltaPatch::MAGIC[4] = { 'G', 'D', 'P', '1' };
+
+DeltaPatch::DeltaPatch() {
+    reset();
+}
+
+void DeltaPatch::reset() {
+    headerFill = 0;
+    opFill = 0;
+    dataLeft = 0;
+    produced = 0;
+    finished = false;
+    failed = false;
+}
+
+uint32_t DeltaPatch::readU32(const uint8_t* bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+void DeltaPatch::writeU32(uint8_t* bytes, uint32_t value) {
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+size_t DeltaPatch::opSize() const {
+    switch (opBuffer[0]) {
+        case OP_COPY: return 9;
+        case OP_DATA: return 5;
+        default:      return 1;
+    }
+}
+
+DeltaPatch::Result DeltaPatch::feed(const uint8_t* input, size_t length, size_t& consumed, Op& op) {
+    consumed = 0;
+    if (failed) {
+        return ERROR;
+    }
+    if (finished) {
+        return END;
+    }
+
+    while (headerFill < HEADER_SIZE) {
+        if (consumed == length) {
+            return NEED_MORE;
+        }
+        header[headerFill++] = input[consumed++];
+        if (headerFill == sizeof(MAGIC) && memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+            failed = true;
+            return ERROR;
+        }
+    }
+
+    for (;;) {
+        // Literal bytes of a DATA op pass straight through
+        if (dataLeft > 0) {
+            if (consumed == length) {
+                return NEED_MORE;
+            }
+            size_t available = length - consumed;
+            op.offset = 0;
+            op.length = dataLeft < available ? dataLeft : (uint32_t)available;
+            op.data = input + consumed;
+            consumed += op.length;
+            dataLeft -= op.length;
+            return DATA;
+        }
+
+        if (opFill == 0) {
+            if (consumed == length) {
+                return NEED_MORE;
+            }
+            opBuffer[opFill++] = input[consumed++];
+            if (opBuffer[0] != OP_END && opBuffer[0] != OP_COPY && opBuffer[0] != OP_DATA) {
+                failed = true;
+                return ERROR;
+            }
+        }
+        size_t size = opSize();
+        while (opFill < size && consumed < length) {
+            opBuffer[opFill++] = input[consumed++];
+        }
+        if (opFill < size) {
+            return NEED_MORE;
+        }
+        opFill = 0;
+
+        if (opBuffer[0] == OP_END) {
+            // Ops must account for exactly the announced image
+            if (produced != imageSize()) {
+                failed = true;
+                return ERROR;
+            }
+            finished = true;
+            return END;
+        }
+
+        uint32_t opLength = readU32(opBuffer + (opBuffer[0] == OP_COPY ? 5 : 1));
+        if (opLength == 0 || opLength > imageSize() - produced) {
+            failed = true;
+            return ERROR;
+        }
+        produced += opLength;
+        if (opBuffer[0] == OP_COPY) {
+            op.offset = readU32(opBuffer + 1);
+            op.length = opLength;
+            op.data = nullptr;
+            return COPY;
+        }
+        dataLeft = opLength;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming decoder for firmware delta patches, shared with the host tool
+// that makes them (Backend/tools/ota_delta).
+//
+// A patch rebuilds the new image from the running one:
+//   header  "GDP1", ELF SHA-256 of the base image (32 bytes), new image size (u32)
+//   COPY    0x01, offset (u32), length (u32): bytes from the base image
+//   DATA    0x02, length (u32), then that many literal bytes
+//   END     0x00
+// Integers are little-endian. Ops cover the new image in order.
+//
+// feed() takes whatever arrived and stops at the first op; a COPY is left
+// to the caller to carry out in pieces, a DATA op points into the input
+// (possibly only part of it, the rest comes with later feeds).
+class DeltaPatch {
+public:
+    static const uint8_t MAGIC[4];
+    static const size_t HEADER_SIZE = 4 + 32 + 4;
+
+    enum OpCode : uint8_t {
+        OP_END = 0x00,
+        OP_COPY = 0x01,
+        OP_DATA = 0x02
+    };
+
+    enum Result {
+        NEED_MORE,   // input used up
+        COPY,        // copy op.length bytes from op.offset of the base image
+        DATA,        // write op.length bytes at op.data
+        END,
+        ERROR
+    };
+
+    struct Op {
+        uint32_t offset;
+        uint32_t length;
+        const uint8_t* data;
+    };
+
+private:
+    uint8_t header[HEADER_SIZE];
+    uint8_t opBuffer[9];     // op code and its arguments
+    size_t headerFill;
+    size_t opFill;
+    uint32_t dataLeft;       // literal bytes still to pass through
+    uint32_t produced;       // image bytes the ops so far account for
+    bool finished;
+    bool failed;
+
+    static uint32_t readU32(const uint8_t* bytes);
+    size_t opSize() const;
+
+public:
+    DeltaPatch();
+
+    void reset();
+    // Consumes input up to and including the next op; consumed is how much
+    Result feed(const uint8_t* input, size_t length, size_t& consumed, Op& op);
+
+    bool headerComplete() const { return headerFill == HEADER_SIZE; }
+    const uint8_t* baseSha256() const { return header + 4; }
+    uint32_t imageSize() const { return readU32(header + 36); }
+
+    static void writeU32(uint8_t* bytes, uint32_t value);
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <Arduino.h>
+
+// Compile-time diagnostic levels, selected per environment in platformio.ini
+// with -DLOG_LEVEL=<n>. Anything above the level is removed by the
+// preprocessor, format strings and arguments included.
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// DIAG_xxx print one line straight to Serial. They are for the managers
+// underneath SerialLogger (MQTT, WiFi, storage), which cannot log through
+// it without feeding their own output back into the log topic. Application
+// code uses the LOG_xxx macros from SerialLogger.h instead.
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define DIAG_ERROR(fmt, ...) Serial.printf("[E] " fmt "\n", ##__VA_ARGS__)
+#else
+#define DIAG_ERROR(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define DIAG_WARN(fmt, ...) Serial.printf("[W] " fmt "\n", ##__VA_ARGS__)
+#else
+#define DIAG_WARN(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define DIAG_INFO(fmt, ...) Serial.printf("[I] " fmt "\n", ##__VA_ARGS__)
+#else
+#define DIAG_INFO(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define DIAG_DEBUG(fmt, ...) Serial.printf("[D] " fmt "\n", ##__VA_ARGS__)
+#else
+#define DIAG_DEBUG(fmt, ...) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+#include "I2cBus.h"
+#include <string.h>
+
+I2cBus::I2cBus(TwoWire& wire)
+    : wire(wire)
+    , nextSequence(0)
+{
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+}
+
+void I2cBus::begin(uint32_t frequency) {
+    wire.setClock(frequency);
+    wire.setTimeOut(BUS_TIMEOUT);
+}
+
+bool I2cBus::submit(const Transaction& transaction, unsigned long timeoutMicros) {
+    for (size_t i = 0; i < MAX_TRANSACTIONS; i++) {
+        Slot& slot = slots[i];
+        if (slot.state != SLOT_FREE) {
+            continue;
+        }
+        slot.transaction = transaction;
+        slot.state = SLOT_QUEUED;
+        slot.sequence = nextSequence++;
+        slot.timeout = timeoutMicros;
+        return true;
+    }
+    stats.rejected++;
+    return false;
+}
+
+bool I2cBus::pending(uint8_t address) const {
+    for (size_t i = 0; i < MAX_TRANSACTIONS; i++) {
+        if (slots[i].state != SLOT_FREE && slots[i].transaction.address == address) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// An older transaction to the same device has to finish first
+bool I2cBus::blocked(size_t index) const {
+    const Slot& slot = slots[index];
+    for (size_t i = 0; i < MAX_TRANSACTIONS; i++) {
+        const Slot& other = slots[i];
+        if (i != index && other.state != SLOT_FREE &&
+            other.transaction.address == slot.transaction.address &&
+            (int32_t)(other.sequence - slot.sequence) < 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void I2cBus::finish(Slot& slot, Result result) {
+    slot.state = SLOT_FREE;
+    if (result == I2C_OK) {
+        stats.completed++;
+    } else {
+        stats.failed++;
+        if (result == I2C_TIMEOUT) {
+            stats.timeouts++;
+        }
+    }
+    // The slot is free before the callback so it may submit a follow-up
+    Transaction& t = slot.transaction;
+    if (t.completion != nullptr) {
+        t.completion(t.context, t, result);
+    }
+}
+
+void I2cBus::step(Slot& slot, unsigned long now) {
+    Transaction& t = slot.transaction;
+    if (slot.state == SLOT_QUEUED) {
+        slot.deadline = now + slot.timeout;
+    }
+    if (slot.state == SLOT_QUEUED && t.writeLength > 0) {
+        wire.beginTransmission(t.address);
+        wire.write(t.write, t.writeLength);
+        if (wire.endTransmission() != 0) {
+            finish(slot, I2C_NACK);
+            return;
+        }
+        slot.state = SLOT_WAITING;
+        slot.readyAt = now + t.delayMicros;
+        if (t.delayMicros > 0 || t.readLength == 0) {
+            if (t.readLength == 0) {
+                finish(slot, I2C_OK);
+            }
+            return;  // read on a later pass
+        }
+    }
+
+    size_t received = wire.requestFrom(t.address, t.readLength);
+    for (size_t i = 0; i < received && i < t.readLength; i++) {
+        t.read[i] = wire.read();
+    }
+    finish(slot, received == t.readLength ? I2C_OK : I2C_SHORT);
+}
+
+void I2cBus::service() {
+    unsigned long started = micros();
+    for (;;) {
+        // Oldest runnable step first
+        unsigned long now = micros();
+        Slot* next = nullptr;
+        for (size_t i = 0; i < MAX_TRANSACTIONS; i++) {
+            Slot& slot = slots[i];
+            if (slot.state == SLOT_FREE) {
+                continue;
+            }
+            if (slot.state == SLOT_WAITING && (long)(now - slot.deadline) >= 0) {
+                finish(slot, I2C_TIMEOUT);
+                continue;
+            }
+            bool ready = slot.state == SLOT_QUEUED || (long)(now - slot.readyAt) >= 0;
+            if (ready && !blocked(i) && (next == nullptr || (int32_t)(slot.sequence - next->sequence) < 0)) {
+                next = &slot;
+            }
+        }
+        if (next == nullptr) {
+            break;
+        }
+        step(*next, now);
+    }
+    uint32_t elapsed = micros() - started;
+    if (elapsed > stats.maxServiceMicros) {
+        stats.maxServiceMicros = elapsed;
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// Queues register reads for the devices on one I2C bus and runs them from
+// service() in short, bounded steps.
+//
+// A transaction writes a register address, waits the device's conversion
+// time and reads the result. The wait is not spent blocking: the write
+// is issued, the transaction parks, and the read happens on a later
+// service() once the delay has passed. Meanwhile other devices' steps run
+// back to back. Transactions to the same address run in submission order,
+// one at a time.
+//
+// Every transaction has a timeout, counted from its first step; one that
+// has not completed by then fails. Each Wire call is bounded by the bus timeout, so a
+// stuck device costs at most BUS_TIMEOUT per step. The result is
+// delivered through the completion callback, on the task calling
+// service().
+class I2cBus {
+public:
+    static const size_t MAX_TRANSACTIONS = 8;
+    static const size_t MAX_WRITE = 4;
+    static const size_t MAX_READ = 8;
+    static const uint16_t BUS_TIMEOUT = 10;          // ms, per Wire call
+    static const unsigned long DEFAULT_TIMEOUT = 100000;  // us from the first step
+
+    enum Result {
+        I2C_OK,
+        I2C_NACK,       // address or data not acknowledged
+        I2C_SHORT,      // fewer bytes than requested
+        I2C_TIMEOUT     // deadline passed
+    };
+
+    struct Transaction;
+    typedef void (*Completion)(void* context, const Transaction& transaction, Result result);
+
+    struct Transaction {
+        uint8_t address;
+        uint8_t write[MAX_WRITE];
+        uint8_t writeLength;
+        uint8_t read[MAX_READ];
+        uint8_t readLength;
+        uint16_t delayMicros;        // between the write and the read
+        uint8_t tag;                 // caller's own, e.g. which register
+        Completion completion;
+        void* context;
+    };
+
+    struct Stats {
+        uint32_t completed;
+        uint32_t failed;
+        uint32_t timeouts;
+        uint32_t rejected;           // submit() with the queue full
+        uint32_t maxServiceMicros;   // longest service() call
+    };
+
+private:
+    enum SlotState {
+        SLOT_FREE,
+        SLOT_QUEUED,                 // nothing sent yet
+        SLOT_WAITING                 // written, read due at readyAt
+    };
+
+    struct Slot {
+        Transaction transaction;
+        SlotState state;
+        uint32_t sequence;
+        unsigned long timeout;       // us
+        unsigned long deadline;      // micros(), set by the first step
+        unsigned long readyAt;       // micros()
+    };
+
+    TwoWire& wire;
+    Slot slots[MAX_TRANSACTIONS];
+    uint32_t nextSequence;
+    Stats stats;
+
+    bool blocked(size_t index) const;
+    void finish(Slot& slot, Result result);
+    void step(Slot& slot, unsigned long now);
+
+public:
+    explicit I2cBus(TwoWire& wire);
+
+    // Sets the clock and the per-call timeout on the underlying bus
+    void begin(uint32_t frequency);
+
+    // Copies the transaction into the queue; false when the queue is full
+    bool submit(const Transaction& transaction, unsigned long timeoutMicros = DEFAULT_TIMEOUT);
+
+    // True while a transaction to address is queued or in flight
+    bool pending(uint8_t address) const;
+
+    // Runs every step that is ready now, oldest first, and expires overdue
+    // transactions. Never waits for a device.
+    void service();
+
+    const Stats& getStats() const { return stats; }
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "JsonWriter.h"
+#include <math.h>
+
+JsonWriter::JsonWriter(char* buf, size_t size)
+    : buffer(buf)
+    , capacity(size)
+    , pos(0)
+    , overflow(size == 0)
+    , needComma(false)
+{
+    if (capacity > 0) {
+        buffer[0] = '\0';
+    }
+}
+
+void JsonWriter::put(char c) {
+    if (overflow) {
+        return;
+    }
+    // Always keep room for the terminating NUL
+    if (pos + 1 >= capacity) {
+        overflow = true;
+        buffer[pos] = '\0';
+        return;
+    }
+    buffer[pos++] = c;
+    buffer[pos] = '\0';
+}
+
+void JsonWriter::separator() {
+    if (needComma) {
+        put(',');
+    }
+    needComma = true;
+}
+
+void JsonWriter::beginObject() {
+    separator();
+    put('{');
+    needComma = false;
+}
+
+void JsonWriter::endObject() {
+    put('}');
+    needComma = true;
+}
+
+void JsonWriter::beginArray() {
+    separator();
+    put('[');
+    needComma = false;
+}
+
+void JsonWriter::endArray() {
+    put(']');
+    needComma = true;
+}
+
+void JsonWriter::key(const char* name) {
+    separator();
+    put('"');
+    raw(name);
+    put('"');
+    put(':');
+    needComma = false;
+}
+
+void JsonWriter::raw(const char* text) {
+    while (*text) {
+        put(*text++);
+    }
+}
+
+void JsonWriter::value(uint32_t v) {
+    separator();
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v > 0);
+    while (n > 0) {
+        put(digits[--n]);
+    }
+}
+
+void JsonWriter::value(int32_t v) {
+    if (v < 0) {
+        separator();
+        put('-');
+        needComma = false;
+        value((uint32_t)(-(int64_t)v));
+        return;
+    }
+    value((uint32_t)v);
+}
+
+void JsonWriter::value(bool v) {
+    separator();
+    raw(v ? "true" : "false");
+}
+
+void JsonWriter::value(const char* v) {
+    separator();
+    put('"');
+    for (; *v; v++) {
+        if (*v == '"' || *v == '\\') {
+            put('\\');
+            put(*v);
+        } else if ((uint8_t)*v < 0x20) {
+            put(' ');
+        } else {
+            put(*v);
+        }
+    }
+    put('"');
+}
+
+// Mirrors dtostrf() from the ESP32 Arduino core (what String(float) uses)
+// digit for digit, so payloads stay byte-identical to the old String-based
+// builder. Splitting off the integer part instead of scaling by the leading
+// power of ten rounds the last digit of large values differently.
+void JsonWriter::value(float v, uint8_t decimals) {
+    separator();
+    double number = v;
+
+    if (isnan(number)) {
+        raw("nan");
+        return;
+    }
+    if (isinf(number)) {
+        raw("inf");
+        return;
+    }
+
+    if (number < 0.0) {
+        put('-');
+        number = -number;
+    }
+
+    double rounding = 2.0;
+    for (uint8_t i = 0; i < decimals; i++) {
+        rounding *= 10.0;
+    }
+    number += 1.0 / rounding;
+
+    double tenpow = 1.0;
+    int digits = 1;
+    while (number >= 10.0 * tenpow) {
+        tenpow *= 10.0;
+        digits++;
+    }
+    number /= tenpow;
+
+    digits += decimals;
+    while (digits-- > 0) {
+        int digit = (int)number;
+        if (digit > 9) {
+            digit = 9;
+        }
+        put('0' + digit);
+        if (digits == decimals && decimals > 0) {
+            put('.');
+        }
+        number -= digit;
+        number *= 10.0;
+    }
+}
+
+void JsonWriter::fixed(int32_t scaled, uint8_t decimals) {
+    separator();
+    uint32_t magnitude = scaled < 0 ? (uint32_t)(-(int64_t)scaled) : (uint32_t)scaled;
+    if (scaled < 0) {
+        put('-');
+    }
+
+    uint32_t divisor = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+        divisor *= 10;
+    }
+
+    needComma = false;
+    value(magnitude / divisor);
+    if (decimals > 0) {
+        put('.');
+        uint32_t fraction = magnitude % divisor;
+        while (divisor > 1) {
+            divisor /= 10;
+            put('0' + (fraction / divisor) % 10);
+        }
+    }
+    needComma = true;
+}
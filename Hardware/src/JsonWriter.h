@@ -0,0 +1,44 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal JSON emitter writing into a caller-owned buffer.
+// Never allocates; once the buffer is exhausted every further call is
+// ignored and ok() reports false.
+class JsonWriter {
+private:
+    char* buffer;
+    size_t capacity;
+    size_t pos;
+    bool overflow;
+    bool needComma;
+
+    void put(char c);
+    void separator();
+
+public:
+    JsonWriter(char* buf, size_t size);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const char* name);
+
+    void value(float v, uint8_t decimals = 2);
+    void value(int32_t v);
+    void value(uint32_t v);
+    void value(bool v);
+    void value(const char* v);
+    // Integer holding a fixed-point value, e.g. fixed(153, 1) -> 15.3
+    void fixed(int32_t scaled, uint8_t decimals);
+    void raw(const char* text);
+
+    bool ok() const { return !overflow; }
+    size_t length() const { return pos; }
+    const char* c_str() const { return buffer; }
+};
+
+#endif
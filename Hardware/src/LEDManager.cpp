@@ -1,7 +1,7 @@
 #include "LEDManager.h"
 
-LEDManager::LEDManager(int pin, int blinkInterval)
-    : LED_PIN(pin)
+LEDManager::LEDManager(int blinkInterval)
+    : ledPin(-1)
     , LED_BLINK_INTERVAL(blinkInterval)
     , lastLedToggle(0)
     , ledState(false)
@@ -9,16 +9,17 @@ LEDManager::LEDManager(int pin, int blinkInterval)
 {
 }
 
-void LEDManager::begin() {
-    pinMode(LED_PIN, OUTPUT);
-    digitalWrite(LED_PIN, LOW);
+void LEDManager::begin(int pin) {
+    ledPin = pin;
+    pinMode(ledPin, OUTPUT);
+    digitalWrite(ledPin, LOW);
 }
 
 void LEDManager::blink(int count) {
     ledBlinkCount = count * 2; // Multiply by 2 because each blink is on+off
     lastLedToggle = millis();
     ledState = true;
-    digitalWrite(LED_PIN, HIGH);
+    digitalWrite(ledPin, HIGH);
 }
 
 void LEDManager::update() {
@@ -27,12 +28,12 @@ void LEDManager::update() {
         if (currentMillis - lastLedToggle >= LED_BLINK_INTERVAL) {
             lastLedToggle = currentMillis;
             ledState = !ledState;
-            digitalWrite(LED_PIN, ledState);
+            digitalWrite(ledPin, ledState);
             
             if (!ledState) {  // Just turned LED off
                 ledBlinkCount--;
                 if (ledBlinkCount == 0) {
-                    digitalWrite(LED_PIN, LOW);  // Ensure LED is off
+                    digitalWrite(ledPin, LOW);  // Ensure LED is off
                 }
             }
         }
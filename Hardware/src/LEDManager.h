@@ -5,15 +5,15 @@
 
 class LEDManager {
 private:
-    const int LED_PIN;
+    int ledPin;
     const int LED_BLINK_INTERVAL;
     unsigned long lastLedToggle;
     bool ledState;
     int ledBlinkCount;
 
 public:
-    LEDManager(int pin, int blinkInterval = 100);
-    void begin();
+    explicit LEDManager(int blinkInterval = 100);
+    void begin(int pin);
     void blink(int count);
     void update();
 };
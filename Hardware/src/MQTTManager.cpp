@@ -1,120 +1,124 @@
 #include "MQTTManager.h"
 
-MQTTManager::MQTTManager(WiFiManager& wifiMgr, const char* topic, int port)
+namespace {
+    // Suffixes under "<root>/<id>", in Topic order up to TOPIC_COMMAND
+    const char* const DEVICE_SUFFIXES[] = {
+        "", "/bin", "/replay", "/batch", "/status", "/logs",
+        "/stats", "/radar", "/alert", "/ota", "/config", "/command"
+    };
+}
+
+MQTTManager::MQTTManager(WiFiManager& wifiMgr, const char* root, int port)
     : client(espClient)
     , wifiManager(wifiMgr)
-    , mqtt_topic(topic)
+    , rootTopic(root)
     , mqtt_port(port)
 {
 }
 
+void MQTTManager::begin() {
+    // The factory MAC is unique per chip and survives reflashing; byte 0
+    // of the eFuse value is the first octet
+    uint64_t mac = ESP.getEfuseMac();
+    for (int i = 0; i < 6; i++) {
+        snprintf(deviceId + i * 2, sizeof(deviceId) - i * 2, "%02x", (unsigned)((mac >> (i * 8)) & 0xff));
+    }
+    snprintf(clientId, sizeof(clientId), "garden-%s", deviceId);
+
+    for (int i = 0; i <= TOPIC_COMMAND; i++) {
+        snprintf(topics[i], TOPIC_SIZE, "%s/%s%s", rootTopic, deviceId, DEVICE_SUFFIXES[i]);
+    }
+    if (MQTT_SHARE_GROUP[0] != '\0') {
+        snprintf(topics[TOPIC_FLEET_COMMAND], TOPIC_SIZE, "$share/%s/%s/command", MQTT_SHARE_GROUP, rootTopic);
+    } else {
+        snprintf(topics[TOPIC_FLEET_COMMAND], TOPIC_SIZE, "%s/command", rootTopic);
+    }
+    DIAG_INFO("MQTT: device %s, topics under %s", deviceId, topics[TOPIC_TELEMETRY]);
+}
+
+void MQTTManager::configure(int port, size_t bufferBytes) {
+    mqtt_port = port;
+    nextBufferSize = bufferBytes < MIN_BUFFER_SIZE ? MIN_BUFFER_SIZE :
+                     bufferBytes > MAX_BUFFER_SIZE ? MAX_BUFFER_SIZE : bufferBytes;
+}
+
 bool MQTTManager::connect() {
     // Check WiFi first
     if (!wifiManager.isWiFiConnected()) {
-        Serial.println("\n----- MQTT Connection Status -----");
-        Serial.println("Error: WiFi not connected");
-        Serial.println("Suggestion: Establish WiFi connection first");
-        Serial.println("----------------------");
+        DIAG_DEBUG("MQTT: WiFi not connected, establish WiFi first");
         return false;
     }
 
     if (!client.connected()) {
-        Serial.println("\n----- MQTT Connection Status -----");
-        
-        // Get the appropriate MQTT server based on current network
-        const char* mqtt_server = (WiFi.SSID() == String(ssid1)) ? mqtt_server1 : mqtt_server2;
-        
+        // Configured for this network, or found on it
+        currentBroker = wifiManager.brokerAddress();
+        if (currentBroker == nullptr) {
+            DIAG_DEBUG("MQTT: no broker known yet");
+            return false;
+        }
+
         // Set server every time before connecting
-        client.setServer(mqtt_server, mqtt_port);
-        
-        // Set larger buffer size for messages
-        client.setBufferSize(512);
-        
-        Serial.printf("Broker: %s:%d\n", mqtt_server, mqtt_port);
-        
-        // Create a random client ID
-        String clientId = "ESP32Client-";
-        clientId += String(random(0xffff), HEX);
-        
-        // Try to connect with more options
-        if (client.connect(clientId.c_str(), 
+        client.setServer(currentBroker, mqtt_port);
+
+        // The configured buffer size; payloads are sized by what the
+        // client actually has, so a failed resize keeps the old one
+        if (client.setBufferSize(nextBufferSize)) {
+            bufferSize = nextBufferSize;
+        }
+
+        // Bound how long a dead broker can hold up the loop
+        client.setSocketTimeout(SOCKET_TIMEOUT_S);
+
+        // The same ID on every connect, so a reconnect takes over the
+        // broker's old session instead of colliding with another node
+        if (client.connect(clientId,
                           nullptr,    // username
                           nullptr,    // password
-                          "/home/sensors/status",  // will topic
+                          topics[TOPIC_STATUS],  // will topic
                           1,         // will qos
                           true,      // will retain
                           "offline", // will message
                           true      // clean session
                           )) {
-            // Add small delay after connection
-            delay(100);
-            
-            Serial.println("Status: Connected Successfully");
-            Serial.println("Publishing online status...");
-            
-            // Publish with QoS 1 and retry
-            int retries = 3;
-            while (retries > 0 && !client.publish("/home/sensors/status", "online", true)) {
-                Serial.println("Status publish failed, retrying...");
-                delay(100);
-                retries--;
+            DIAG_INFO("MQTT: connected to %s:%d", currentBroker, mqtt_port);
+
+            if (!client.publish(topics[TOPIC_STATUS], "online", true)) {
+                DIAG_WARN("MQTT: status publish failed");
+            }
+
+            // Clean session drops subscriptions, so restore the command topics
+            for (size_t i = 0; i < subscriptionCount; i++) {
+                if (!client.subscribe(subscribedTopics[i])) {
+                    DIAG_WARN("MQTT: resubscribe to %s failed", subscribedTopics[i]);
+                }
             }
-            
-            Serial.println("----------------------");
             return true;
         }
-        
-        Serial.println("Status: Connection Failed");
-        Serial.printf("Client State: %d\n", client.state());
-        printConnectionState();
-        Serial.println("----------------------");
+
+        DIAG_WARN("MQTT: connect to %s:%d failed (%s)", currentBroker, mqtt_port, stateName(client.state()));
+        logConnectionState();
+        wifiManager.brokerFailed();
         return false;
     }
     return true;
 }
 
-bool MQTTManager::publish(const char* topic, const char* payload) {
-    // Check WiFi first
-    if (!wifiManager.isWiFiConnected()) {
-        Serial.println("\n----- MQTT Status -----");
-        Serial.println("Error: WiFi not connected");
-        Serial.println("Suggestion: Establish WiFi connection first");
-        Serial.println("----------------------");
+bool MQTTManager::publish(const char* topic, const char* payload, bool retained) {
+    if (!wifiManager.isWiFiConnected() || !client.connected()) {
+        DIAG_DEBUG("MQTT: not connected, %s dropped", topic);
         return false;
     }
 
-    // Check connection state
-    if (!client.connected()) {
-        Serial.println("\n----- MQTT Status -----");
-        Serial.printf("Connection Check Failed - State: %d\n", client.state());
-        printConnectionState();
-        return false;
-    }
+    bool success = client.publish(topic, payload, retained);
 
-    bool success = client.publish(topic, payload);
-    
-    Serial.println("\n----- MQTT Status -----");
     if (success) {
-        Serial.println("Status: Published Successfully");
-        Serial.printf("Broker: %s:%d\n", 
-            (WiFi.SSID() == String(ssid1)) ? mqtt_server1 : mqtt_server2, 
-            mqtt_port);
-        Serial.printf("Topic: %s\n", topic);
-        Serial.printf("Payload Size: %d bytes\n", strlen(payload));
-        Serial.println("Payload: ");
-        Serial.println(payload);
+        DIAG_DEBUG("MQTT: published %u bytes to %s via %s:%d\n%s",
+            (unsigned)strlen(payload), topic, currentBroker, mqtt_port, payload);
     } else {
-        Serial.println("Status: Publish Failed");
-        Serial.printf("Broker: %s:%d\n", 
-            (WiFi.SSID() == String(ssid1)) ? mqtt_server1 : mqtt_server2, 
-            mqtt_port);
-        Serial.printf("Topic: %s\n", topic);
-        Serial.printf("Payload Size: %d bytes\n", strlen(payload));
-        Serial.printf("Client State: %d\n", client.state());
-        printConnectionState();
+        DIAG_WARN("MQTT: publish to %s failed (%s)", topic, stateName(client.state()));
+        logConnectionState();
     }
-    Serial.println("----------------------");
-    
+
     return success;
 }
 
@@ -123,173 +127,193 @@ void MQTTManager::loop() {
 }
 
 bool MQTTManager::subscribe(const char* topic, void (*callback)(const char*)) {
-    // Check WiFi first
-    if (!wifiManager.isWiFiConnected()) {
-        Serial.println("\n----- MQTT Subscription -----");
-        Serial.println("Error: WiFi not connected");
-        Serial.println("Suggestion: Establish WiFi connection first");
-        Serial.println("----------------------");
-        return false;
+    // Store the callback and topic (resubscribed after every reconnect)
+    bool known = false;
+    for (size_t i = 0; i < subscriptionCount; i++) {
+        known = known || strcmp(subscribedTopics[i], topic) == 0;
+    }
+    if (!known) {
+        if (subscriptionCount == MAX_SUBSCRIPTIONS) {
+            DIAG_ERROR("MQTT: no room to subscribe to %s", topic);
+            return false;
+        }
+        subscribedTopics[subscriptionCount++] = topic;
     }
-
-    Serial.println("\n----- MQTT Subscription -----");
-    Serial.printf("Topic: %s\n", topic);
-    
-    // Store the callback
     messageCallback = callback;
-    
+
     // Set the callback wrapper that will call our stored callback
     client.setCallback([this](char* topic, byte* payload, unsigned int length) {
-        Serial.println("\n----- MQTT Message Received -----");
-        Serial.printf("Topic: %s\n", topic);
-        
         // Create null-terminated string from payload
-        char message[length + 1];
+        if (length > MAX_BUFFER_SIZE) {
+            DIAG_ERROR("MQTT: dropped %u bytes on %s, larger than the buffer", length, topic);
+            return;
+        }
+        char* message = messageBuffer;
         memcpy(message, payload, length);
         message[length] = '\0';
-        
-        Serial.printf("Payload Size: %d bytes\n", length);
-        Serial.println("Payload: ");
-        Serial.println(message);
-        Serial.println("----------------------");
-        
+
+        DIAG_DEBUG("MQTT: received %u bytes on %s\n%s", length, topic, message);
+
         // Call the stored callback
         if (messageCallback) {
             messageCallback(message);
         }
     });
-    
+
+    // Without a connection, connect() subscribes later
+    if (!wifiManager.isWiFiConnected() || !client.connected()) {
+        DIAG_DEBUG("MQTT: %s will be subscribed once connected", topic);
+        return false;
+    }
+
     // Subscribe to the topic
     bool success = client.subscribe(topic);
     if (success) {
-        Serial.println("Status: Subscribed Successfully");
+        DIAG_INFO("MQTT: subscribed to %s", topic);
     } else {
-        Serial.println("Status: Subscription Failed");
-        Serial.printf("Client State: %d\n", client.state());
-        printConnectionState();
+        DIAG_WARN("MQTT: subscribe to %s failed (%s)", topic, stateName(client.state()));
+        logConnectionState();
     }
-    Serial.println("----------------------");
-    
+
     return success;
 }
 
-void MQTTManager::printConnectionState() {
-    switch (client.state()) {
-        case -4: 
-            Serial.println("Error: Connection Timeout");
-            Serial.println("Suggestion: Check broker availability and network latency");
-            break;
-        case -3: 
-            Serial.println("Error: Connection Lost");
-            Serial.println("Suggestion: Check network stability and WiFi signal strength");
-            break;
-        case -2: 
-            Serial.println("Error: Connection Failed");
-            Serial.println("Suggestion: Verify broker address and port");
-            break;
-        case -1: 
-            Serial.println("Error: Disconnected");
-            Serial.println("Suggestion: Check if broker is running and accessible");
-            break;
-        case 0: 
-            Serial.println("Status: Connected");
-            Serial.println("Note: Client is connected but publish failed");
-            break;
-        case 1: 
-            Serial.println("Error: Bad Protocol");
-            Serial.println("Suggestion: Check MQTT protocol version compatibility");
-            break;
-        case 2: 
-            Serial.println("Error: Bad Client ID");
-            Serial.println("Suggestion: Verify client ID is unique and acceptable");
-            break;
-        case 3: 
-            Serial.println("Error: Broker Unavailable");
-            Serial.println("Suggestion: Verify broker is running and accepting connections");
-            break;
-        case 4: 
-            Serial.println("Error: Bad Credentials");
-            Serial.println("Suggestion: Check username and password if required");
-            break;
-        case 5: 
-            Serial.println("Error: Unauthorized");
-            Serial.println("Suggestion: Verify access rights for topic");
-            break;
-        default: 
-            Serial.println("Error: Unknown");
-            Serial.println("Suggestion: Check logs on broker side");
-            break;
+const char* MQTTManager::stateName(int state) {
+    switch (state) {
+        case -4: return "connection timeout";
+        case -3: return "connection lost";
+        case -2: return "connect failed";
+        case -1: return "disconnected";
+        case 0:  return "connected";
+        case 1:  return "bad protocol";
+        case 2:  return "bad client ID";
+        case 3:  return "broker unavailable";
+        case 4:  return "bad credentials";
+        case 5:  return "unauthorized";
+        default: return "unknown";
     }
 }
 
-bool MQTTManager::publish(const SensorData& data) {
-    // Check WiFi first
-    if (!wifiManager.isWiFiConnected()) {
-        Serial.println("\n----- MQTT Telemetry Status -----");
-        Serial.println("Error: WiFi not connected");
-        Serial.println("Suggestion: Establish WiFi connection first");
-        Serial.println("----------------------");
-        return false;
+void MQTTManager::logConnectionState() {
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    const char* suggestion;
+    switch (client.state()) {
+        case -4: suggestion = "Check broker availability and network latency"; break;
+        case -3: suggestion = "Check network stability and WiFi signal strength"; break;
+        case -2: suggestion = "Verify broker address and port"; break;
+        case -1: suggestion = "Check if broker is running and accessible"; break;
+        case 0:  suggestion = "Client is connected but publish failed"; break;
+        case 1:  suggestion = "Check MQTT protocol version compatibility"; break;
+        case 2:  suggestion = "Verify client ID is unique and acceptable"; break;
+        case 3:  suggestion = "Verify broker is running and accepting connections"; break;
+        case 4:  suggestion = "Check username and password if required"; break;
+        case 5:  suggestion = "Verify access rights for topic"; break;
+        default: suggestion = "Check logs on broker side"; break;
     }
+    DIAG_DEBUG("MQTT: state %d, %s", client.state(), suggestion);
+#endif
+}
 
-    // Check connection state
-    if (!client.connected()) {
-        Serial.println("\n----- MQTT Telemetry Status -----");
-        Serial.printf("Connection Check Failed - State: %d\n", client.state());
-        printConnectionState();
+bool MQTTManager::checkTelemetryLink() {
+    if (!wifiManager.isWiFiConnected() || !client.connected()) {
+        DIAG_DEBUG("MQTT: telemetry link down (%s)", stateName(client.state()));
         return false;
     }
+    return true;
+}
 
-    String jsonPayload = "{";
-    jsonPayload += "\"soil_temperature\":" + String(data.soilTemp) + ",";
-    jsonPayload += "\"soil_moisture\":" + String(data.soilMoisture) + ",";
-    jsonPayload += "\"air_temperature\":" + String(data.airTemp) + ",";
-    jsonPayload += "\"humidity\":" + String(data.humidity) + ",";
-    jsonPayload += "\"hydrogen_raw\":" + String(data.h2Value) + ",";
-    jsonPayload += "\"hydrogen_voltage\":" + String(data.h2Voltage) + ",";
-    jsonPayload += "\"co2\":" + String(data.co2) + ",";
-    jsonPayload += "\"tvoc\":" + String(data.tvoc) + ",";
-    jsonPayload += "\"target_count\":" + String(data.targetCount) + ",";
-    jsonPayload += "\"target_speed\":" + String(data.speed) + ",";
-    jsonPayload += "\"target_distance\":" + String(data.distance) + ",";
-    jsonPayload += "\"target_energy\":" + String(data.energy) + ",";
-    jsonPayload += "\"pm25\":" + String(data.pm25) + ",";
-    jsonPayload += "\"pm10\":" + String(data.pm10);
-    jsonPayload += "}";
-
-    // Check payload size against new buffer size
-    if (jsonPayload.length() > 512) {
-        Serial.println("\n----- MQTT Telemetry Status -----");
-        Serial.printf("Payload Size Error: %d bytes (max: %d)\n", 
-            jsonPayload.length(), 512);
+bool MQTTManager::sendTelemetry(const char* topic, size_t payloadLength, bool retained, int retries) {
+    if (payloadLength == 0) {
+        DIAG_ERROR("MQTT: telemetry payload exceeds %d bytes", (int)maxPayload());
         return false;
     }
 
-    Serial.println("\n----- MQTT Telemetry Status -----");
-    Serial.printf("Publishing to topic: %s\n", mqtt_topic);
-    Serial.printf("Payload (%d bytes):\n%s\n", jsonPayload.length(), jsonPayload.c_str());
+    DIAG_DEBUG("MQTT: %s (%d bytes)\n%s", topic, (int)payloadLength, payloadBuffer);
 
     // Try publishing with retries
-    int retries = 3;
     bool success = false;
-    
+
     while (retries > 0 && !success) {
-        success = client.publish(mqtt_topic, jsonPayload.c_str(), true);
+        success = client.publish(topic, payloadBuffer, retained);
         if (!success) {
-            Serial.printf("Publish attempt failed, %d retries remaining\n", retries-1);
-            delay(100);
             retries--;
+            DIAG_DEBUG("MQTT: publish attempt failed, %d retries remaining", retries);
         }
     }
-    
-    if (success) {
-        Serial.println("Status: Telemetry Published Successfully");
-    } else {
-        Serial.println("Status: Telemetry Publish Failed after all retries");
-        Serial.printf("Client State: %d\n", client.state());
-        printConnectionState();
+
+    if (!success) {
+        DIAG_WARN("MQTT: telemetry to %s failed (%s)", topic, stateName(client.state()));
+        logConnectionState();
+    }
+
+    return success;
+}
+
+bool MQTTManager::publish(const SensorData& data) {
+    if (!checkTelemetryLink()) {
+        return false;
+    }
+
+    size_t payloadLength = TelemetrySerializer::serialize(data, payloadBuffer, maxPayload());
+    return sendTelemetry(topics[TOPIC_TELEMETRY], payloadLength, true, 3);
+}
+
+bool MQTTManager::publish(const StoredSample& sample, bool replay) {
+    if (!checkTelemetryLink()) {
+        return false;
+    }
+
+    size_t payloadLength = TelemetrySerializer::serialize(sample, payloadBuffer, maxPayload(), fieldMask);
+    if (replay) {
+        // Backlog goes to its own topic, unretained, so it never replaces
+        // the latest reading; a failure ends the batch and is retried later
+        return sendTelemetry(topics[TOPIC_REPLAY], payloadLength, false, 1);
+    }
+    // A failed live sample stays queued, so no need to retry in place
+    return sendTelemetry(topics[TOPIC_TELEMETRY], payloadLength, true, 1);
+}
+
+bool MQTTManager::publishDelta(const StoredSample& sample, uint32_t fields, bool keyframe) {
+    if (!checkTelemetryLink()) {
+        return false;
+    }
+
+    size_t payloadLength = TelemetrySerializer::serialize(sample, payloadBuffer, maxPayload(),
+        fields & fieldMask);
+    return sendTelemetry(topics[TOPIC_TELEMETRY], payloadLength, keyframe, 1);
+}
+
+bool MQTTManager::publishBatch(const StoredSample* samples, size_t count, size_t& sent) {
+    sent = 0;
+    if (!checkTelemetryLink()) {
+        return false;
     }
-    Serial.println("----------------------");
 
+    size_t included;
+    size_t payloadLength = TelemetrySerializer::serializeBatch(samples, count,
+        payloadBuffer, maxPayload(), included, fieldMask);
+    // Unretained like replays; a failed batch stays queued and is resent whole
+    if (!sendTelemetry(topics[TOPIC_BATCH], payloadLength, false, 1)) {
+        return false;
+    }
+    sent = included;
+    return true;
+}
+
+bool MQTTManager::publishBinary(const SensorData& data) {
+    if (!wifiManager.isWiFiConnected() || !client.connected()) {
+        return false;
+    }
+
+    size_t length = TelemetryRecord::encode(data, recordBuffer, sizeof(recordBuffer));
+    if (length == 0) {
+        return false;
+    }
+
+    bool success = client.publish(topics[TOPIC_BINARY], recordBuffer, length, true);
+    if (!success) {
+        DIAG_WARN("MQTT: binary publish to %s failed (%s)", topics[TOPIC_BINARY], stateName(client.state()));
+        logConnectionState();
+    }
     return success;
-} 
\ No newline at end of file
+}
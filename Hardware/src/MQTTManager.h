@@ -6,27 +6,109 @@
 #include <Arduino.h>
 #include "WiFiManager.h"
 #include "SensorManager.h"
-#include "secrets.h"
+#include "TelemetrySerializer.h"
+#include "TelemetryRecord.h"
+#include "Diagnostics.h"
+
+// Build with -DMQTT_SHARE_GROUP=\"<group>\" to take fleet commands as a
+// shared subscription: the broker hands each one to a single member of the
+// group instead of every node
+#ifndef MQTT_SHARE_GROUP
+#define MQTT_SHARE_GROUP ""
+#endif
 
 class MQTTManager {
+public:
+    // Every node publishes under "<root>/<device id>", so retained samples
+    // and wills from different nodes never overwrite each other
+    enum Topic {
+        TOPIC_TELEMETRY,      // <root>/<id>
+        TOPIC_BINARY,         // <root>/<id>/bin
+        TOPIC_REPLAY,         // <root>/<id>/replay
+        TOPIC_BATCH,          // <root>/<id>/batch
+        TOPIC_STATUS,         // <root>/<id>/status
+        TOPIC_LOGS,           // <root>/<id>/logs
+        TOPIC_STATS,          // <root>/<id>/stats
+        TOPIC_RADAR,          // <root>/<id>/radar
+        TOPIC_ALERT,          // <root>/<id>/alert
+        TOPIC_OTA,            // <root>/<id>/ota
+        TOPIC_CONFIG,         // <root>/<id>/config
+        TOPIC_COMMAND,        // <root>/<id>/command, this node only
+        TOPIC_FLEET_COMMAND,  // <root>/command, or $share/<group>/<root>/command
+        TOPIC_COUNT
+    };
+
+    static const uint16_t DEFAULT_PORT = 1883;
+    // Client buffer; the largest has room for a batch of ~12 samples, the
+    // smallest still for a status message or a long radar track
+    static const size_t MAX_BUFFER_SIZE = 4096;
+    static const size_t MIN_BUFFER_SIZE = 2048;
+
 private:
+    static const size_t TOPIC_SIZE = 64;
+    static const size_t ID_SIZE = 13;                // 12 hex digits of the MAC
+    static const size_t CLIENT_ID_SIZE = 24;
+    static const size_t MAX_SUBSCRIPTIONS = 2;
+    // What is left of the client buffer after the fixed header and topic
+    static const size_t MAX_PAYLOAD = MAX_BUFFER_SIZE - MQTT_MAX_HEADER_SIZE - 2 - TOPIC_SIZE;
+    static const uint16_t SOCKET_TIMEOUT_S = 2;
+
     WiFiClient espClient;
     PubSubClient client;
     WiFiManager& wifiManager;
-    const char* mqtt_topic;
-    const int mqtt_port;
+    const char* rootTopic;
+    int mqtt_port;
+    size_t bufferSize = MAX_BUFFER_SIZE;       // the client's, set at connect
+    size_t nextBufferSize = MAX_BUFFER_SIZE;   // configured, for the next connect
+    const char* currentBroker = nullptr;  // chosen once per connect()
     void (*messageCallback)(const char*) = nullptr;
+    // Resubscribed after every reconnect
+    const char* subscribedTopics[MAX_SUBSCRIPTIONS] = {};
+    size_t subscriptionCount = 0;
+    char payloadBuffer[MAX_PAYLOAD];
+    // An inbound message, terminated; PubSubClient never hands over more
+    // than its buffer
+    char messageBuffer[MAX_BUFFER_SIZE + 1];
+    char deviceId[ID_SIZE] = "";
+    char clientId[CLIENT_ID_SIZE] = "";
+    char topics[TOPIC_COUNT][TOPIC_SIZE] = {};
+    uint8_t recordBuffer[TelemetryRecord::SIZE];
+    uint32_t fieldMask = TelemetrySerializer::ALL_FIELDS;
     
-    void printConnectionState();
+    static const char* stateName(int state);
+    void logConnectionState();
+    bool checkTelemetryLink();
+    bool sendTelemetry(const char* topic, size_t payloadLength, bool retained, int retries);
 
 public:
-    MQTTManager(WiFiManager& wifiMgr, const char* topic, int port = 1883);
+    MQTTManager(WiFiManager& wifiMgr, const char* root, int port = DEFAULT_PORT);
+    // Derives the device ID from the factory MAC in eFuse and builds the
+    // client ID and every topic; call once at boot before publishing
+    void begin();
+    const char* topic(Topic which) const { return topics[which]; }
+    const char* getDeviceId() const { return deviceId; }
+    // Broker port and client buffer size, used from the next connect
+    void configure(int port, size_t bufferBytes);
+    // Longest payload a publish can carry with the current buffer
+    size_t maxPayload() const { return bufferSize - MQTT_MAX_HEADER_SIZE - 2 - TOPIC_SIZE; }
     bool connect();
     bool publish(const SensorData& data);
+    bool publish(const StoredSample& sample, bool replay);
+    // Live sample limited to the given fields: a keyframe is retained, a
+    // delta is not, so late subscribers always start from a full sample
+    bool publishDelta(const StoredSample& sample, uint32_t fields, bool keyframe);
+    bool publishBinary(const SensorData& data);
+    // Publishes as many of the samples as fit in one message to
+    // "<root>/<id>/batch"; sent is how many went out (0 on failure)
+    bool publishBatch(const StoredSample* samples, size_t count, size_t& sent);
+    // Fields included in stored-sample and batch JSON (binary records
+    // always carry every field)
+    void setFieldMask(uint32_t mask) { fieldMask = mask; }
     void loop();
     bool isConnected() { return client.connected(); }
+    // Up to MAX_SUBSCRIPTIONS topics, all delivered to the same callback
     bool subscribe(const char* topic, void (*callback)(const char*));
-    bool publish(const char* topic, const char* payload);
+    bool publish(const char* topic, const char* payload, bool retained = false);
 };
 
 #endif
\ No newline at end of file
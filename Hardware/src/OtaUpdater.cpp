@@ -0,0 +1,607 @@
+#include "OtaUpdater.h"
+#include "Diagnostics.h"
+#include "JsonWriter.h"
+#include <Preferences.h>
+#include <esp_partition.h>
+#include <string.h>
+#include <strings.h>
+
+namespace {
+    const char* TRIAL_NAMESPACE = "ota";
+    const char* TRIAL_KEY = "trial";
+    const uint32_t TRIAL_MAGIC = 0x4f544131;   // "OTA1"
+    const uint8_t IMAGE_MAGIC = 0xE9;          // first byte of every app image
+    const uint16_t DEFAULT_PORT = 80;
+
+    int hexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+}
+
+#ifdef CONFIG_APP_ROLLBACK_ENABLE
+// With bootloader rollback built in, Arduino would mark every new image
+// valid at boot; confirm() does that once the image has proved itself
+extern "C" bool verifyRollbackLater() {
+    return true;
+}
+#endif
+
+OtaUpdater::OtaUpdater()
+    : state(IDLE)
+    , trial(TRIAL_NONE)
+    , port(DEFAULT_PORT)
+    , handle(0)
+    , flashOpen(false)
+    , running(nullptr)
+    , target(nullptr)
+    , formatKnown(false)
+    , bufferPos(0)
+    , bufferLength(0)
+    , copyOffset(0)
+    , copyLeft(0)
+    , lineLength(0)
+    , httpStatus(0)
+    , contentLength(0)
+    , lastByteAt(0) {
+    error[0] = '\0';
+    host[0] = '\0';
+    path[0] = '\0';
+    memset(&progress, 0, sizeof(progress));
+}
+
+void OtaUpdater::begin(bool countBoot) {
+    running = esp_ota_get_running_partition();
+    TrialRecord record;
+    if (running == nullptr || !loadTrial(record)) {
+        return;
+    }
+
+    if (!record.rolledBack && strcmp(record.target, running->label) == 0) {
+        trial = TRIAL_PENDING;
+        if (countBoot) {
+            record.boots++;
+            saveTrial(record);
+        }
+        DIAG_INFO("OTA: %s on trial, boot %u", running->label, (unsigned)record.boots);
+        if (record.boots > MAX_TRIAL_BOOTS) {
+            rollback(record, "too many restarts");
+        }
+        return;
+    }
+
+    // Back on the old firmware, switched by rollback() or by the bootloader
+    // refusing the new image
+    if (strcmp(record.previous, running->label) == 0) {
+        trial = TRIAL_ROLLED_BACK;
+        DIAG_WARN("OTA: update to %s rolled back", record.target);
+    }
+    clearTrial();
+}
+
+bool OtaUpdater::check(const char* url, const char* sha256Hex) {
+    if (busy()) {
+        snprintf(error, sizeof(error), "update already running");
+        return false;
+    }
+    if (trial == TRIAL_PENDING) {
+        snprintf(error, sizeof(error), "current firmware not confirmed");
+        return false;
+    }
+    if (url == nullptr || !parseUrl(url)) {
+        snprintf(error, sizeof(error), "need an http:// URL");
+        return false;
+    }
+    if (sha256Hex == nullptr || strlen(sha256Hex) != 2 * sizeof(expectedSha)) {
+        snprintf(error, sizeof(error), "need a SHA-256 in hex");
+        return false;
+    }
+    for (size_t i = 0; i < 2 * sizeof(expectedSha); i++) {
+        if (hexDigit(sha256Hex[i]) < 0) {
+            snprintf(error, sizeof(error), "need a SHA-256 in hex");
+            return false;
+        }
+    }
+    if (esp_ota_get_running_partition() == nullptr || esp_ota_get_next_update_partition(nullptr) == nullptr) {
+        snprintf(error, sizeof(error), "no OTA partition");
+        return false;
+    }
+    return true;
+}
+
+bool OtaUpdater::start(const char* url, const char* sha256Hex) {
+    if (!check(url, sha256Hex)) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(expectedSha); i++) {
+        expectedSha[i] = (uint8_t)(hexDigit(sha256Hex[2 * i]) << 4 | hexDigit(sha256Hex[2 * i + 1]));
+    }
+    running = esp_ota_get_running_partition();
+    target = esp_ota_get_next_update_partition(nullptr);
+
+    error[0] = '\0';
+    memset(&progress, 0, sizeof(progress));
+    progress.startedAt = millis();
+    lastByteAt = progress.startedAt;
+    patch.reset();
+    formatKnown = false;
+    bufferPos = 0;
+    bufferLength = 0;
+    copyLeft = 0;
+    lineLength = 0;
+    httpStatus = 0;
+    contentLength = 0;
+    state = CONNECTING;
+    DIAG_INFO("OTA: fetching http://%s:%u%s into %s", host, (unsigned)port, path, target->label);
+    return true;
+}
+
+// http://host[:port]/path
+bool OtaUpdater::parseUrl(const char* url) {
+    static const char SCHEME[] = "http://";
+    if (strncmp(url, SCHEME, sizeof(SCHEME) - 1) != 0) {
+        return false;
+    }
+    const char* start = url + sizeof(SCHEME) - 1;
+    const char* slash = strchr(start, '/');
+    const char* end = slash != nullptr ? slash : start + strlen(start);
+    const char* colon = (const char*)memchr(start, ':', end - start);
+    const char* hostEnd = colon != nullptr ? colon : end;
+    if (hostEnd == start || (size_t)(hostEnd - start) >= sizeof(host)) {
+        return false;
+    }
+    memcpy(host, start, hostEnd - start);
+    host[hostEnd - start] = '\0';
+
+    port = DEFAULT_PORT;
+    if (colon != nullptr) {
+        long value = strtol(colon + 1, nullptr, 10);
+        if (value <= 0 || value > 65535) {
+            return false;
+        }
+        port = (uint16_t)value;
+    }
+    int n = snprintf(path, sizeof(path), "%s", slash != nullptr ? slash : "/");
+    return n > 0 && (size_t)n < sizeof(path);
+}
+
+OtaUpdater::State OtaUpdater::step(unsigned long now) {
+    switch (state) {
+        case CONNECTING:
+            sendRequest(now);
+            break;
+        case HEADERS:
+            readHeaders(now);
+            break;
+        case DOWNLOADING:
+            download(now);
+            break;
+        default:
+            return state;
+    }
+    if ((state == HEADERS || state == DOWNLOADING) && now - lastByteAt >= STALL_TIMEOUT) {
+        fail("download stalled");
+    }
+    if (state != READY && state != FAILED) {
+        progress.elapsed = now - progress.startedAt;
+    }
+    return state;
+}
+
+// The connect blocks for up to CONNECT_TIMEOUT; the server is on the LAN
+void OtaUpdater::sendRequest(unsigned long now) {
+    if (!client.connect(host, port, CONNECT_TIMEOUT)) {
+        fail("cannot connect");
+        return;
+    }
+    // HTTP/1.0: the server closes the connection after the body
+    int n = snprintf(line, sizeof(line), "GET %s HTTP/1.0\r\nHost: %s\r\n\r\n", path, host);
+    if (n <= 0 || (size_t)n >= sizeof(line) ||
+        client.write(reinterpret_cast<const uint8_t*>(line), n) != (size_t)n) {
+        fail("request failed");
+        return;
+    }
+    lastByteAt = now;
+    state = HEADERS;
+}
+
+void OtaUpdater::readHeaders(unsigned long now) {
+    // Read a byte at a time so no body byte is taken early
+    for (size_t budget = 0; budget < LINE_SIZE * 4 && client.available() > 0; budget++) {
+        int c = client.read();
+        if (c < 0) {
+            break;
+        }
+        lastByteAt = now;
+        progress.received++;
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            if (lineLength < sizeof(line) - 1) {
+                line[lineLength++] = (char)c;
+            }
+            continue;
+        }
+        line[lineLength] = '\0';
+
+        if (lineLength == 0) {
+            if (httpStatus != 200) {
+                snprintf(error, sizeof(error), "HTTP status %d", httpStatus);
+                fail(error);
+            } else {
+                state = DOWNLOADING;
+            }
+            return;
+        }
+        if (httpStatus == 0) {
+            // Status line: HTTP/1.x NNN reason
+            const char* space = strchr(line, ' ');
+            httpStatus = space != nullptr ? atoi(space + 1) : -1;
+        } else if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            contentLength = (uint32_t)strtoul(line + 15, nullptr, 10);
+        }
+        lineLength = 0;
+    }
+    if (!client.connected() && client.available() <= 0) {
+        fail("connection closed");
+    }
+}
+
+void OtaUpdater::download(unsigned long now) {
+    size_t budget = CHUNK_SIZE;
+    if (copyLeft > 0) {
+        budget -= continueCopy(budget);
+        if (copyLeft > 0 || state != DOWNLOADING) {
+            return;
+        }
+    }
+    if (bufferPos == bufferLength && !receive(now)) {
+        return;
+    }
+    if (!formatKnown && !detectFormat()) {
+        return;
+    }
+
+    if (!progress.delta) {
+        if (writeImage(buffer + bufferPos, bufferLength - bufferPos)) {
+            bufferPos = bufferLength;
+            if (progress.written == progress.total) {
+                finish();
+            }
+        }
+        return;
+    }
+
+    while (budget > 0 && bufferPos < bufferLength && state == DOWNLOADING) {
+        bool hadHeader = patch.headerComplete();
+        size_t consumed;
+        DeltaPatch::Op op;
+        DeltaPatch::Result result = patch.feed(buffer + bufferPos, bufferLength - bufferPos, consumed, op);
+        bufferPos += consumed;
+
+        if (!hadHeader && patch.headerComplete()) {
+            const esp_app_desc_t* app = esp_ota_get_app_description();
+            if (memcmp(patch.baseSha256(), app->app_elf_sha256, sizeof(app->app_elf_sha256)) != 0) {
+                fail("patch is for other firmware");
+                return;
+            }
+            if (!openFlash(patch.imageSize())) {
+                return;
+            }
+        }
+
+        switch (result) {
+            case DeltaPatch::NEED_MORE:
+                break;
+            case DeltaPatch::COPY:
+                if (op.offset > running->size || op.length > running->size - op.offset) {
+                    fail("patch reads past the image");
+                    return;
+                }
+                copyOffset = op.offset;
+                copyLeft = op.length;
+                budget -= continueCopy(budget);
+                break;
+            case DeltaPatch::DATA:
+                if (!writeImage(op.data, op.length)) {
+                    return;
+                }
+                budget -= op.length < budget ? op.length : budget;
+                break;
+            case DeltaPatch::END:
+                finish();
+                return;
+            case DeltaPatch::ERROR:
+                fail("corrupt patch");
+                return;
+        }
+    }
+}
+
+// Refills the receive buffer; false if nothing came
+bool OtaUpdater::receive(unsigned long now) {
+    int available = client.available();
+    if (available <= 0) {
+        if (!client.connected()) {
+            fail("connection closed");
+        }
+        return false;
+    }
+    size_t wanted = (size_t)available < sizeof(buffer) ? (size_t)available : sizeof(buffer);
+    int n = client.read(buffer, wanted);
+    if (n <= 0) {
+        return false;
+    }
+    bufferPos = 0;
+    bufferLength = (size_t)n;
+    progress.received += n;
+    lastByteAt = now;
+    return true;
+}
+
+// A full image starts with the app image magic; anything else must be a patch
+bool OtaUpdater::detectFormat() {
+    formatKnown = true;
+    if (buffer[bufferPos] == IMAGE_MAGIC) {
+        progress.delta = false;
+        if (contentLength == 0) {
+            fail("no Content-Length");
+            return false;
+        }
+        return openFlash(contentLength);
+    }
+    if (buffer[bufferPos] == DeltaPatch::MAGIC[0]) {
+        progress.delta = true;
+        return true;  // the flash is opened once the patch header gives the size
+    }
+    fail("not an image or patch");
+    return false;
+}
+
+bool OtaUpdater::openFlash(uint32_t size) {
+    if (size == 0 || size > target->size) {
+        fail("image does not fit");
+        return false;
+    }
+    // Sequential writes erase sector by sector as the image arrives, instead
+    // of the whole partition up front
+    if (esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &handle) != ESP_OK) {
+        fail("cannot open partition");
+        return false;
+    }
+    flashOpen = true;
+    progress.total = size;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+    return true;
+}
+
+bool OtaUpdater::writeImage(const uint8_t* data, size_t length) {
+    if (length > progress.total - progress.written) {
+        fail("image longer than announced");
+        return false;
+    }
+    if (esp_ota_write(handle, data, length) != ESP_OK) {
+        fail("flash write failed");
+        return false;
+    }
+    mbedtls_sha256_update_ret(&sha, data, length);
+    progress.written += length;
+    return true;
+}
+
+// Copies part of a COPY op from the running partition; returns the bytes done
+size_t OtaUpdater::continueCopy(size_t budget) {
+    size_t done = 0;
+    while (copyLeft > 0 && done < budget) {
+        size_t n = copyLeft;
+        if (n > sizeof(copyBuffer)) n = sizeof(copyBuffer);
+        if (n > budget - done) n = budget - done;
+        if (esp_partition_read(running, copyOffset, copyBuffer, n) != ESP_OK) {
+            fail("cannot read running image");
+            return done;
+        }
+        if (!writeImage(copyBuffer, n)) {
+            return done;
+        }
+        copyOffset += n;
+        copyLeft -= n;
+        done += n;
+    }
+    return done;
+}
+
+void OtaUpdater::finish() {
+    client.stop();
+    if (progress.written != progress.total) {
+        fail("image shorter than announced");
+        return;
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    if (memcmp(digest, expectedSha, sizeof(digest)) != 0) {
+        fail("SHA-256 mismatch");
+        return;
+    }
+    flashOpen = false;
+    // esp_ota_end also checks the image structure and its own checksum
+    if (esp_ota_end(handle) != ESP_OK) {
+        fail("image rejected");
+        return;
+    }
+
+    TrialRecord record;
+    memset(&record, 0, sizeof(record));
+    record.magic = TRIAL_MAGIC;
+    snprintf(record.previous, sizeof(record.previous), "%s", running->label);
+    snprintf(record.target, sizeof(record.target), "%s", target->label);
+    saveTrial(record);
+    if (esp_ota_set_boot_partition(target) != ESP_OK) {
+        clearTrial();
+        fail("cannot set boot partition");
+        return;
+    }
+    progress.elapsed = millis() - progress.startedAt;
+    state = READY;
+    DIAG_INFO("OTA: %u bytes verified in %lu ms, %s boots next",
+        (unsigned)progress.written, progress.elapsed, target->label);
+}
+
+void OtaUpdater::fail(const char* reason) {
+    if (reason != error) {
+        snprintf(error, sizeof(error), "%s", reason);
+    }
+    client.stop();
+    closeFlash();
+    copyLeft = 0;
+    progress.elapsed = millis() - progress.startedAt;
+    state = FAILED;
+    DIAG_WARN("OTA: failed, %s", error);
+}
+
+void OtaUpdater::closeFlash() {
+    if (flashOpen) {
+        esp_ota_abort(handle);
+        mbedtls_sha256_free(&sha);
+        flashOpen = false;
+    }
+}
+
+void OtaUpdater::cancel() {
+    if (busy() && state != READY) {
+        fail("cancelled");
+    }
+}
+
+void OtaUpdater::restart() {
+    if (restartHook) {
+        restartHook();
+    }
+    ESP.restart();
+}
+
+void OtaUpdater::confirm() {
+    if (trial != TRIAL_PENDING) {
+        return;
+    }
+    clearTrial();
+#ifdef CONFIG_APP_ROLLBACK_ENABLE
+    esp_ota_mark_app_valid_cancel_rollback();
+#endif
+    trial = TRIAL_CONFIRMED;
+    DIAG_INFO("OTA: %s confirmed", running->label);
+}
+
+void OtaUpdater::checkTrial(unsigned long now) {
+    if (trial != TRIAL_PENDING || now < TRIAL_TIMEOUT) {
+        return;
+    }
+    TrialRecord record;
+    if (loadTrial(record)) {
+        rollback(record, "never connected");
+    }
+}
+
+void OtaUpdater::rollback(const TrialRecord& record, const char* reason) {
+    const esp_partition_t* previous = esp_partition_find_first(ESP_PARTITION_TYPE_APP,
+        ESP_PARTITION_SUBTYPE_ANY, record.previous);
+    if (previous == nullptr || esp_ota_set_boot_partition(previous) != ESP_OK) {
+        // Nothing to go back to; keep what runs rather than loop
+        DIAG_ERROR("OTA: cannot roll back to %s", record.previous);
+        clearTrial();
+        trial = TRIAL_NONE;
+        return;
+    }
+    TrialRecord rolled = record;
+    rolled.rolledBack = 1;
+    saveTrial(rolled);
+    DIAG_WARN("OTA: %s, rolling back to %s", reason, record.previous);
+    restart();
+}
+
+bool OtaUpdater::loadTrial(TrialRecord& record) {
+    Preferences prefs;
+    if (!prefs.begin(TRIAL_NAMESPACE, true)) {
+        return false;
+    }
+    bool valid = prefs.getBytesLength(TRIAL_KEY) == sizeof(record) &&
+                 prefs.getBytes(TRIAL_KEY, &record, sizeof(record)) == sizeof(record) &&
+                 record.magic == TRIAL_MAGIC;
+    prefs.end();
+    return valid;
+}
+
+void OtaUpdater::saveTrial(const TrialRecord& record) {
+    Preferences prefs;
+    if (prefs.begin(TRIAL_NAMESPACE, false)) {
+        prefs.putBytes(TRIAL_KEY, &record, sizeof(record));
+        prefs.end();
+    }
+}
+
+void OtaUpdater::clearTrial() {
+    Preferences prefs;
+    if (prefs.begin(TRIAL_NAMESPACE, false)) {
+        prefs.remove(TRIAL_KEY);
+        prefs.end();
+    }
+}
+
+float OtaUpdater::throughput() const {
+    return progress.elapsed ? (float)progress.received / progress.elapsed : 0.0f;
+}
+
+size_t OtaUpdater::serialize(char* out, size_t size) const {
+    JsonWriter json(out, size);
+    json.beginObject();
+    json.key("state");
+    json.value(stateName(state));
+    json.key("trial");
+    json.value(trialName(trial));
+    if (state != IDLE) {
+        json.key("delta");
+        json.value(progress.delta);
+        json.key("received");
+        json.value(progress.received);
+        json.key("written");
+        json.value(progress.written);
+        json.key("total");
+        json.value(progress.total);
+        json.key("ms");
+        json.value((uint32_t)progress.elapsed);
+        json.key("kBps");
+        json.value(throughput(), 1);
+    }
+    if (state == FAILED) {
+        json.key("error");
+        json.value(error);
+    }
+    json.endObject();
+    return json.ok() ? json.length() : 0;
+}
+
+const char* OtaUpdater::stateName(State state) {
+    switch (state) {
+        case IDLE:        return "idle";
+        case CONNECTING:  return "connecting";
+        case HEADERS:     return "requesting";
+        case DOWNLOADING: return "downloading";
+        case READY:       return "ready";
+        case FAILED:      return "failed";
+        default:          return "unknown";
+    }
+}
+
+const char* OtaUpdater::trialName(Trial trial) {
+    switch (trial) {
+        case TRIAL_NONE:        return "none";
+        case TRIAL_PENDING:     return "pending";
+        case TRIAL_CONFIRMED:   return "confirmed";
+        case TRIAL_ROLLED_BACK: return "rolled_back";
+        default:                return "unknown";
+    }
+}
@@ -0,0 +1,160 @@
+#ifndef OTA_UPDATER_H
+#define OTA_UPDATER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+#include "DeltaPatch.h"
+
+// Firmware update over HTTP into the inactive OTA partition, without
+// blocking the loop.
+//
+// start() takes an http:// URL and the SHA-256 of the image that should end
+// up in flash. The body is either a full image or a DeltaPatch against the
+// running firmware, told apart by its first byte. step() moves at most
+// CHUNK_SIZE bytes per call from the socket, or for a patch COPY from the
+// running partition, into flash and hashes them on the way. Once the hash
+// matches, the new partition is set to boot and a trial is recorded in NVS;
+// the caller restarts when it has reported the result.
+//
+// The new firmware then runs on trial. confirm() once it is connected makes
+// it permanent; if it boots more than MAX_TRIAL_BOOTS times or stays
+// unconnected for TRIAL_TIMEOUT, it switches back to the previous partition.
+class OtaUpdater {
+public:
+    static const size_t CHUNK_SIZE = 4096;
+    static const size_t URL_SIZE = 128;
+    static const unsigned long CONNECT_TIMEOUT = 3000;   // ms
+    static const unsigned long STALL_TIMEOUT = 10000;    // ms without a byte
+    static const unsigned long TRIAL_TIMEOUT = 120000;   // ms from boot to connected
+    static const uint8_t MAX_TRIAL_BOOTS = 3;
+
+    enum State {
+        IDLE,
+        CONNECTING,
+        HEADERS,       // reading the HTTP response head
+        DOWNLOADING,
+        READY,         // verified and set to boot; restart() to run it
+        FAILED
+    };
+
+    enum Trial {
+        TRIAL_NONE,
+        TRIAL_PENDING,      // this firmware has not been confirmed yet
+        TRIAL_CONFIRMED,
+        TRIAL_ROLLED_BACK   // a newer image failed and we are back on this one
+    };
+
+    struct Progress {
+        uint32_t received;        // bytes off the wire
+        uint32_t written;         // image bytes in flash
+        uint32_t total;           // image size, 0 until known
+        unsigned long startedAt;
+        unsigned long elapsed;    // ms, up to now or to the end
+        bool delta;
+    };
+
+private:
+    static const size_t COPY_BLOCK = 1024;
+    static const size_t LINE_SIZE = 128;
+    static const size_t HOST_SIZE = 64;
+    static const size_t LABEL_SIZE = 17;
+
+    // NVS record of an update on trial, so it survives the restarts
+    struct TrialRecord {
+        uint32_t magic;
+        uint8_t boots;
+        uint8_t rolledBack;
+        char previous[LABEL_SIZE];
+        char target[LABEL_SIZE];
+    };
+
+    State state;
+    Trial trial;
+    char error[48];
+    WiFiClient client;
+    char host[HOST_SIZE];
+    uint16_t port;
+    char path[URL_SIZE];
+    uint8_t expectedSha[32];
+    mbedtls_sha256_context sha;
+    esp_ota_handle_t handle;
+    bool flashOpen;
+    const esp_partition_t* running;
+    const esp_partition_t* target;
+    DeltaPatch patch;
+    bool formatKnown;
+    uint8_t buffer[CHUNK_SIZE];       // received, not yet written
+    size_t bufferPos;
+    size_t bufferLength;
+    uint8_t copyBuffer[COPY_BLOCK];
+    uint32_t copyOffset;
+    uint32_t copyLeft;
+    char line[LINE_SIZE];
+    size_t lineLength;
+    int httpStatus;
+    uint32_t contentLength;
+    Progress progress;
+    unsigned long lastByteAt;
+    void (*restartHook)() = nullptr;
+
+    bool parseUrl(const char* url);
+    void sendRequest(unsigned long now);
+    void readHeaders(unsigned long now);
+    void download(unsigned long now);
+    bool receive(unsigned long now);
+    bool detectFormat();
+    bool openFlash(uint32_t size);
+    bool writeImage(const uint8_t* data, size_t length);
+    size_t continueCopy(size_t budget);
+    void finish();
+    void fail(const char* reason);
+    void closeFlash();
+
+    static bool loadTrial(TrialRecord& record);
+    static void saveTrial(const TrialRecord& record);
+    static void clearTrial();
+    void rollback(const TrialRecord& record, const char* reason);
+
+public:
+    OtaUpdater();
+
+    // Picks up an update on trial; countBoot is false for wakes that only
+    // take a sample, which never get far enough to prove anything
+    void begin(bool countBoot);
+
+    // Returns false, with lastError() set, if the request is unusable or an
+    // update is already running
+    bool check(const char* url, const char* sha256Hex);
+    // check(), then begins the download
+    bool start(const char* url, const char* sha256Hex);
+    State step(unsigned long now);
+    void cancel();
+    void restart();
+
+    // Connected: the firmware on trial is good
+    void confirm();
+    // Rolls back a trial that has not been confirmed within TRIAL_TIMEOUT
+    void checkTrial(unsigned long now);
+
+    void setRestartHook(void (*hook)()) { restartHook = hook; }
+
+    State getState() const { return state; }
+    Trial getTrial() const { return trial; }
+    bool busy() const { return state != IDLE && state != FAILED; }
+    const Progress& getProgress() const { return progress; }
+    const char* lastError() const { return error; }
+    // kB/s off the wire
+    float throughput() const;
+
+    // {"state": ..., "trial": ..., "received": ..., "written": ..., "total": ...,
+    //  "ms": ..., "kBps": ..., "delta": ..., "error": ...}; returns the
+    // length, or 0 if it does not fit
+    size_t serialize(char* out, size_t size) const;
+
+    static const char* stateName(State state);
+    static const char* trialName(Trial trial);
+};
+
+#endif
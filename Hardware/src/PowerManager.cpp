@@ -0,0 +1,119 @@
+#include "PowerManager.h"
+#include <esp_attr.h>
+#include <esp_sleep.h>
+#include <string.h>
+
+namespace {
+
+const uint32_t RTC_MAGIC = 0x31575052;   // "RPW1"
+
+}  // namespace
+
+RTC_DATA_ATTR PowerManager::RtcState PowerManager::rtc;
+
+PowerManager::PowerManager()
+    : timerWake(false)
+    , radioUp(false)
+    , radioStart(0)
+{
+}
+
+void PowerManager::begin() {
+    timerWake = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+    if (rtc.magic != RTC_MAGIC || rtc.count > RING_CAPACITY || rtc.head >= RING_CAPACITY) {
+        memset(&rtc, 0, sizeof(rtc));
+        rtc.magic = RTC_MAGIC;
+        rtc.mode = POWER_CONTINUOUS;
+        rtc.uploadEvery = DEFAULT_UPLOAD_EVERY;
+        rtc.intervalMillis = DEFAULT_INTERVAL;
+        timerWake = false;
+    }
+    if (timerWake) {
+        rtc.stats.wakes++;
+    }
+}
+
+void PowerManager::setMode(Mode mode) {
+    rtc.mode = mode;
+}
+
+void PowerManager::setInterval(unsigned long intervalMillis) {
+    rtc.intervalMillis = intervalMillis < MIN_INTERVAL ? MIN_INTERVAL : intervalMillis;
+}
+
+void PowerManager::setUploadEvery(uint16_t samples) {
+    if (samples < 1) {
+        samples = 1;
+    }
+    rtc.uploadEvery = samples > RING_CAPACITY ? RING_CAPACITY : samples;
+}
+
+void PowerManager::record(const SensorData& data, uint32_t timestamp) {
+    if (rtc.count == RING_CAPACITY) {
+        rtc.head = (rtc.head + 1) % RING_CAPACITY;
+        rtc.count--;
+        rtc.stats.dropped++;
+    }
+    Slot& slot = rtc.ring[(rtc.head + rtc.count) % RING_CAPACITY];
+    slot.timestamp = timestamp;
+    TelemetryRecord::encode(data, slot.record, sizeof(slot.record));
+    rtc.count++;
+}
+
+bool PowerManager::take(SensorData& data, uint32_t& timestamp) {
+    while (rtc.count > 0) {
+        const Slot& slot = rtc.ring[rtc.head];
+        rtc.head = (rtc.head + 1) % RING_CAPACITY;
+        rtc.count--;
+        if (TelemetryRecord::decode(slot.record, sizeof(slot.record), data)) {
+            timestamp = slot.timestamp;
+            rtc.stats.uploaded++;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PowerManager::uploadDue(bool alert) const {
+    return alert || rtc.count >= rtc.uploadEvery || rtc.count == RING_CAPACITY;
+}
+
+void PowerManager::radioOn() {
+    if (!radioUp) {
+        radioUp = true;
+        radioStart = millis();
+        if (timerWake) {
+            rtc.stats.uploadWakes++;
+        }
+    }
+}
+
+void PowerManager::sleep() {
+    unsigned long awake = millis();
+    if (radioUp && timerWake) {
+        rtc.stats.radioMillis += awake - radioStart;
+    }
+    // Wakes stay on the sample grid however long this one took
+    unsigned long sleepMillis = awake + MIN_SLEEP < rtc.intervalMillis ? rtc.intervalMillis - awake : MIN_SLEEP;
+    // The boot that entered SLEEP mode is not part of the cycle
+    if (timerWake) {
+        rtc.stats.awakeMicros += (uint64_t)awake * 1000;
+    }
+    rtc.stats.sleptMicros += (uint64_t)sleepMillis * 1000;
+    
+    esp_sleep_enable_timer_wakeup((uint64_t)sleepMillis * 1000);
+    esp_deep_sleep_start();
+}
+
+float PowerManager::dutyCycle() const {
+    uint64_t total = rtc.stats.awakeMicros + rtc.stats.sleptMicros;
+    return total ? 100.0f * rtc.stats.awakeMicros / total : 100.0f;
+}
+
+uint32_t PowerManager::averageWakeMillis() const {
+    return rtc.stats.wakes ? (uint32_t)(rtc.stats.awakeMicros / 1000 / rtc.stats.wakes) : 0;
+}
+
+float PowerManager::samplesPerRadioSecond() const {
+    return rtc.stats.radioMillis ? rtc.stats.uploaded * 1000.0f / rtc.stats.radioMillis : 0.0f;
+}
@@ -0,0 +1,108 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "SensorData.h"
+#include "TelemetryRecord.h"
+
+// Low-power operating mode for battery or solar nodes.
+//
+// In SLEEP mode the ESP32 deep-sleeps between samples. Each timer wake
+// reads the sensors that are cheap to bring back, appends the sample to a
+// ring in RTC memory and goes straight back to sleep. Only every
+// uploadEvery samples, when a sample crosses an alert threshold, or when
+// the ring is full does a wake bring up WiFi and MQTT to upload the ring.
+//
+// The mode, the ring and the energy statistics all live in RTC slow
+// memory: they survive deep sleep and software restarts but not a power
+// cycle, which falls back to CONTINUOUS.
+class PowerManager {
+public:
+    enum Mode : uint8_t {
+        POWER_CONTINUOUS,
+        POWER_SLEEP
+    };
+
+    static const size_t RING_CAPACITY = 48;
+    static const unsigned long DEFAULT_INTERVAL = 60000;     // ms between samples
+    static const unsigned long MIN_INTERVAL = 5000;
+    static const uint16_t DEFAULT_UPLOAD_EVERY = 15;         // samples per radio wake
+    static const unsigned long MIN_SLEEP = 100;              // ms
+
+    // Since the RTC state was last reset
+    struct Stats {
+        uint32_t wakes;
+        uint32_t uploadWakes;
+        uint64_t awakeMicros;    // during timer wakes
+        uint64_t sleptMicros;
+        uint32_t radioMillis;
+        uint32_t uploaded;       // ring samples handed to the upload path
+        uint32_t dropped;        // overwritten in a full ring
+    };
+
+private:
+    struct Slot {
+        uint32_t timestamp;
+        uint8_t record[TelemetryRecord::SIZE];
+    };
+
+    struct RtcState {
+        uint32_t magic;
+        Mode mode;
+        uint16_t uploadEvery;
+        uint32_t intervalMillis;
+        uint8_t head;
+        uint8_t count;
+        Slot ring[RING_CAPACITY];
+        Stats stats;
+    };
+
+    static RtcState rtc;
+
+    bool timerWake;
+    bool radioUp;
+    unsigned long radioStart;    // millis() the radio came up
+
+public:
+    PowerManager();
+
+    // Validates the RTC state (resetting it after a power cycle) and
+    // records why the chip is running
+    void begin();
+
+    Mode getMode() const { return rtc.mode; }
+    void setMode(Mode mode);
+    unsigned long getInterval() const { return rtc.intervalMillis; }
+    void setInterval(unsigned long intervalMillis);
+    uint16_t getUploadEvery() const { return rtc.uploadEvery; }
+    void setUploadEvery(uint16_t samples);
+
+    // True when this boot is a timer wake-up in SLEEP mode
+    bool isSampleWake() const { return timerWake && rtc.mode == POWER_SLEEP; }
+
+    // Appends a sample to the RTC ring, overwriting the oldest when full
+    void record(const SensorData& data, uint32_t timestamp);
+    // Removes the oldest sample; false when the ring is empty
+    bool take(SensorData& data, uint32_t& timestamp);
+    size_t pending() const { return rtc.count; }
+
+    // Whether this wake should bring the radio up for an upload
+    bool uploadDue(bool alert) const;
+
+    // Call when WiFi is started, for the radio-on statistics
+    void radioOn();
+
+    // Deep-sleeps until the next sample is due, counted from this boot.
+    // Does not return.
+    void sleep();
+
+    const Stats& getStats() const { return rtc.stats; }
+    // Share of time awake, in percent
+    float dutyCycle() const;
+    // Average length of a wake in ms
+    uint32_t averageWakeMillis() const;
+    // Uploaded samples per second of radio time
+    float samplesPerRadioSecond() const;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "RadarTrack.h"
+#include "JsonWriter.h"
+#include <math.h>
+
+namespace {
+
+int16_t centimetresSigned(float metres) {
+    float cm = roundf(metres * 100.0f);
+    return cm > 32767.0f ? 32767 : cm < -32768.0f ? -32768 : (int16_t)cm;
+}
+
+uint16_t centimetres(float metres) {
+    float cm = roundf(metres * 100.0f);
+    return cm > 65535.0f ? 65535 : cm < 0.0f ? 0 : (uint16_t)cm;
+}
+
+}  // namespace
+
+RadarTrack::RadarTrack() {
+    begin(0);
+}
+
+void RadarTrack::begin(unsigned long now) {
+    count = 0;
+    stride = 1;
+    samples = 0;
+    startMillis = now;
+    lastMillis = now;
+    peakSpeed = 0;
+    minRange = 0;
+    maxRange = 0;
+    maxEnergy = 0;
+    maxTargets = 0;
+}
+
+void RadarTrack::decimate() {
+    for (size_t i = 0; i < count / 2; i++) {
+        points[i] = points[2 * i];
+    }
+    count /= 2;
+    stride *= 2;
+}
+
+void RadarTrack::add(unsigned long now, uint8_t targets, float speed, float range, uint32_t energy) {
+    lastMillis = now;
+    if (samples == 0 || range < minRange) {
+        minRange = range;
+    }
+    if (samples == 0 || range > maxRange) {
+        maxRange = range;
+    }
+    if (fabsf(speed) > fabsf(peakSpeed)) {
+        peakSpeed = speed;
+    }
+    if (energy > maxEnergy) {
+        maxEnergy = energy;
+    }
+    if (targets > maxTargets) {
+        maxTargets = targets;
+    }
+
+    if (samples++ % stride != 0) {
+        return;
+    }
+    if (count == MAX_POINTS) {
+        decimate();
+        if ((samples - 1) % stride != 0) {
+            return;
+        }
+    }
+    unsigned long offset = now - startMillis;
+    Point& p = points[count++];
+    p.offsetMillis = offset > 0xFFFF ? 0xFFFF : (uint16_t)offset;
+    p.rangeCm = centimetres(range);
+    p.speedCms = centimetresSigned(speed);
+}
+
+size_t RadarTrack::serialize(uint32_t endTimestamp, char* buffer, size_t size) const {
+    unsigned long duration = durationMillis();
+    uint32_t durationSeconds = (duration + 500) / 1000;
+
+    JsonWriter json(buffer, size);
+    json.beginObject();
+    json.key("start");
+    json.value(endTimestamp > durationSeconds ? endTimestamp - durationSeconds : (uint32_t)0);
+    json.key("end");
+    json.value(endTimestamp);
+    json.key("duration_ms");
+    json.value((uint32_t)duration);
+    json.key("samples");
+    json.value(samples);
+    json.key("targets");
+    json.value((uint32_t)maxTargets);
+    json.key("peak_speed");
+    json.value(peakSpeed);
+    json.key("min_range");
+    json.value(minRange);
+    json.key("max_range");
+    json.value(maxRange);
+    json.key("max_energy");
+    json.value(maxEnergy);
+    json.key("track");
+    json.beginArray();
+    for (size_t i = 0; i < count; i++) {
+        json.beginArray();
+        json.value((uint32_t)points[i].offsetMillis);
+        json.value((uint32_t)points[i].rangeCm);
+        json.value((int32_t)points[i].speedCms);
+        json.endArray();
+    }
+    json.endArray();
+    json.endObject();
+    return json.ok() ? json.length() : 0;
+}
@@ -0,0 +1,58 @@
+#ifndef RADAR_TRACK_H
+#define RADAR_TRACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One motion event seen by the C4001: the radar readings taken at burst
+// rate from the first detection until the target has been gone for a while.
+// Points live in a fixed buffer; once it is full every other point is
+// dropped and only every second sample is kept from then on, so a long
+// event keeps its whole shape at a coarser resolution. Peaks and extremes
+// are taken over every sample, kept or not.
+class RadarTrack {
+public:
+    static const size_t MAX_POINTS = 128;
+
+    struct Point {
+        uint16_t offsetMillis;   // since the start of the track
+        uint16_t rangeCm;
+        int16_t speedCms;        // signed as the radar reports it
+    };
+
+private:
+    Point points[MAX_POINTS];
+    size_t count;
+    uint16_t stride;             // keep every stride-th sample
+    uint32_t samples;
+    unsigned long startMillis;
+    unsigned long lastMillis;
+    float peakSpeed;             // largest magnitude, sign kept
+    float minRange;
+    float maxRange;
+    uint32_t maxEnergy;
+    uint8_t maxTargets;
+
+    void decimate();
+
+public:
+    RadarTrack();
+
+    void begin(unsigned long now);
+    void add(unsigned long now, uint8_t targets, float speed, float range, uint32_t energy);
+
+    unsigned long durationMillis() const { return lastMillis - startMillis; }
+    // millis() of the last detection
+    unsigned long lastSeenMillis() const { return lastMillis; }
+    uint32_t sampleCount() const { return samples; }
+    size_t pointCount() const { return count; }
+
+    // {"start":..,"end":..,"duration_ms":..,"samples":..,"targets":..,
+    //  "peak_speed":..,"min_range":..,"max_range":..,"max_energy":..,
+    //  "track":[[ms,range_cm,speed_cm_s],...]} with start derived from
+    // endTimestamp (Unix time or 0). Returns the length, or 0 if the buffer
+    // is too small.
+    size_t serialize(uint32_t endTimestamp, char* buffer, size_t size) const;
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "SampleStore.h"
+
+SampleStore::SampleStore(const char* filePath)
+    : path(filePath)
+    , ramHead(0)
+    , ramCount(0)
+    , header{}
+    , flashReady(false)
+    , headerDirty(false)
+    , nextSeq(0)
+{
+}
+
+bool SampleStore::begin() {
+    if (!LittleFS.begin(true)) {  // format on first use
+        Serial.println("SampleStore: LittleFS mount failed, buffering in RAM only");
+        return false;
+    }
+
+    File file = LittleFS.open(path, "r");
+    bool opened = file;
+    bool valid = false;
+    if (opened) {
+        valid = file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header)
+            && header.magic == MAGIC
+            && header.version == FORMAT_VERSION
+            && header.slotSize == SLOT_SIZE
+            && header.capacity == FLASH_CAPACITY
+            && header.head < FLASH_CAPACITY
+            && header.count <= FLASH_CAPACITY;
+        file.close();
+    }
+
+    if (!valid) {
+        uint32_t seqReserved = (opened && header.magic == MAGIC) ? header.seqReserved : 0;
+        header = {};
+        header.seqReserved = seqReserved;
+        if (!resetFile()) {
+            Serial.println("SampleStore: cannot create queue file, buffering in RAM only");
+            return false;
+        }
+    }
+
+    // Never reuse a sequence number handed out before the last reboot
+    nextSeq = header.seqReserved;
+    header.seqReserved = nextSeq + SEQ_RESERVE;
+    flashReady = writeHeader();
+
+    Serial.printf("SampleStore: %u samples pending from flash, next seq %u\n",
+        (unsigned)header.count, (unsigned)nextSeq);
+    return flashReady;
+}
+
+bool SampleStore::resetFile() {
+    header.magic = MAGIC;
+    header.version = FORMAT_VERSION;
+    header.slotSize = SLOT_SIZE;
+    header.capacity = FLASH_CAPACITY;
+    header.head = 0;
+    header.count = 0;
+
+    File file = LittleFS.open(path, "w");
+    if (!file) {
+        return false;
+    }
+    bool ok = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+    file.close();
+    return ok;
+}
+
+bool SampleStore::writeHeader() {
+    File file = LittleFS.open(path, "r+");
+    if (!file) {
+        return false;
+    }
+    bool ok = file.seek(0)
+        && file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+    file.close();
+    headerDirty = !ok;
+    return ok;
+}
+
+void SampleStore::dropOldestRam() {
+    ramHead = (ramHead + 1) % RAM_CAPACITY;
+    ramCount--;
+    header.dropped++;
+}
+
+bool SampleStore::spill(size_t n) {
+    if (!flashReady || n == 0) {
+        return false;
+    }
+
+    File file = LittleFS.open(path, "r+");
+    if (!file) {
+        return false;
+    }
+
+    uint8_t slot[SLOT_SIZE];
+    size_t written = 0;
+    for (; written < n && ramCount > 0; written++) {
+        const StoredSample& sample = ram[ramHead];
+
+        if (header.count == FLASH_CAPACITY) {
+            // Flash ring full: overwrite the oldest sample
+            header.head = (header.head + 1) % FLASH_CAPACITY;
+            header.count--;
+            header.dropped++;
+        }
+
+        memcpy(slot, &sample.seq, 4);
+        memcpy(slot + 4, &sample.timestamp, 4);
+        TelemetryRecord::encode(sample.data, slot + 8, TelemetryRecord::SIZE);
+
+        uint32_t index = (header.head + header.count) % FLASH_CAPACITY;
+        if (!file.seek(sizeof(Header) + index * SLOT_SIZE)
+            || file.write(slot, SLOT_SIZE) != SLOT_SIZE) {
+            break;
+        }
+        header.count++;
+        ramHead = (ramHead + 1) % RAM_CAPACITY;
+        ramCount--;
+    }
+
+    bool ok = file.seek(0)
+        && file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+    file.close();
+    headerDirty = !ok;
+    return ok && written > 0;
+}
+
+uint32_t SampleStore::push(const SensorData& data, uint32_t timestamp) {
+    if (ramCount == RAM_CAPACITY && !spill(RAM_CAPACITY / 2)) {
+        dropOldestRam();
+    }
+
+    if (nextSeq >= header.seqReserved) {
+        header.seqReserved = nextSeq + SEQ_RESERVE;
+        if (flashReady) {
+            writeHeader();
+        }
+    }
+
+    StoredSample& slot = ram[(ramHead + ramCount) % RAM_CAPACITY];
+    slot.seq = nextSeq++;
+    slot.timestamp = timestamp;
+    slot.data = data;
+    ramCount++;
+    return slot.seq;
+}
+
+size_t SampleStore::peek(StoredSample* out, size_t max) {
+    size_t n = 0;
+
+    if (header.count > 0 && flashReady) {
+        File file = LittleFS.open(path, "r");
+        uint8_t slot[SLOT_SIZE];
+        while (file && n < max && n < header.count) {
+            // Peeked samples are not removed, so read relative to the head
+            uint32_t index = (header.head + n) % FLASH_CAPACITY;
+            bool read = file.seek(sizeof(Header) + index * SLOT_SIZE)
+                && file.read(slot, SLOT_SIZE) == SLOT_SIZE;
+            if (!read) {
+                break;
+            }
+            StoredSample& sample = out[n];
+            memcpy(&sample.seq, slot, 4);
+            memcpy(&sample.timestamp, slot + 4, 4);
+            if (!TelemetryRecord::decode(slot + 8, TelemetryRecord::SIZE, sample.data)) {
+                // Corrupt slot at the head: drop it so replay cannot stall
+                if (n == 0) {
+                    header.head = (header.head + 1) % FLASH_CAPACITY;
+                    header.count--;
+                    header.dropped++;
+                    headerDirty = true;
+                    continue;
+                }
+                break;
+            }
+            n++;
+        }
+        if (file) {
+            file.close();
+        }
+        if (n < header.count) {
+            // Flash samples must go out before anything newer in RAM
+            return n;
+        }
+    }
+
+    for (size_t i = 0; i < ramCount && n < max; i++) {
+        out[n++] = ram[(ramHead + i) % RAM_CAPACITY];
+    }
+    return n;
+}
+
+void SampleStore::discard(size_t n) {
+    size_t fromFlash = n < header.count ? n : header.count;
+    if (fromFlash > 0) {
+        header.head = (header.head + fromFlash) % FLASH_CAPACITY;
+        header.count -= fromFlash;
+        headerDirty = true;
+        n -= fromFlash;
+    }
+
+    size_t fromRam = n < ramCount ? n : ramCount;
+    ramHead = (ramHead + fromRam) % RAM_CAPACITY;
+    ramCount -= fromRam;
+
+    if (headerDirty && flashReady) {
+        writeHeader();
+    }
+}
+
+void SampleStore::persist() {
+    if (ramCount > 0) {
+        spill(ramCount);
+    } else if (headerDirty && flashReady) {
+        writeHeader();
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef SAMPLE_STORE_H
+#define SAMPLE_STORE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "SensorData.h"
+#include "TelemetryRecord.h"
+
+// Store-and-forward queue for samples that have not reached the broker yet.
+//
+// New samples land in a small RAM ring. When it fills up (link down) the
+// oldest half is spilled to a fixed-size ring file on LittleFS, so a long
+// outage or a restart does not lose data. Samples always leave the queue
+// oldest first: flash entries before RAM entries.
+class SampleStore {
+public:
+    static const size_t RAM_CAPACITY = 64;
+    static const uint32_t FLASH_CAPACITY = 5400;   // 3 h at the 2 s cadence
+    static const size_t MAX_BATCH = 20;
+
+private:
+    static const uint32_t MAGIC = 0x31515347;      // "GSQ1"
+    static const uint16_t FORMAT_VERSION = 1;
+    static const uint32_t SEQ_RESERVE = 1024;      // seq numbers claimed per header write
+    static const size_t SLOT_SIZE = 8 + TelemetryRecord::SIZE;
+
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t slotSize;
+        uint32_t capacity;
+        uint32_t head;          // oldest flash slot
+        uint32_t count;         // flash slots in use
+        uint32_t seqReserved;   // seq numbers below this may have been used
+        uint32_t dropped;
+    };
+
+    const char* path;
+    StoredSample ram[RAM_CAPACITY];
+    size_t ramHead;
+    size_t ramCount;
+    Header header;
+    bool flashReady;
+    bool headerDirty;
+    uint32_t nextSeq;
+
+    bool resetFile();
+    bool writeHeader();
+    bool spill(size_t n);
+    void dropOldestRam();
+
+public:
+    explicit SampleStore(const char* filePath = "/samples.q");
+
+    bool begin();
+
+    // Queues a sample and returns its sequence number
+    uint32_t push(const SensorData& data, uint32_t timestamp);
+
+    // Copies up to max of the oldest samples without removing them
+    size_t peek(StoredSample* out, size_t max);
+
+    // Removes the n oldest samples (after they were published)
+    void discard(size_t n);
+
+    // Moves everything still in RAM to flash, e.g. before a restart
+    void persist();
+
+    size_t size() const { return ramCount + header.count; }
+    size_t flashCount() const { return header.count; }
+    uint32_t droppedCount() const { return header.dropped; }
+    bool isPersistent() const { return flashReady; }
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "Scheduler.h"
+#include <limits.h>
+
+Scheduler::Scheduler()
+    : taskCount(0)
+{
+}
+
+int Scheduler::add(const char* name, TaskFunction function, unsigned long periodMillis,
+                   unsigned long budgetMicros) {
+    if (taskCount >= MAX_TASKS) {
+        return -1;
+    }
+
+    Task& task = tasks[taskCount];
+    task.name = name;
+    task.function = function;
+    task.periodMillis = periodMillis;
+    task.budgetMicros = budgetMicros;
+    task.lastRun = millis() - periodMillis;  // due immediately
+    task.enabled = true;
+    task.stats = {};
+    return taskCount++;
+}
+
+void Scheduler::setPeriod(int id, unsigned long periodMillis) {
+    if (id >= 0 && (size_t)id < taskCount) {
+        tasks[id].periodMillis = periodMillis;
+    }
+}
+
+void Scheduler::setEnabled(int id, bool enabled) {
+    if (id >= 0 && (size_t)id < taskCount) {
+        tasks[id].enabled = enabled;
+    }
+}
+
+unsigned long Scheduler::run() {
+    unsigned long nextDue = ULONG_MAX;
+
+    for (size_t i = 0; i < taskCount; i++) {
+        Task& task = tasks[i];
+        if (!task.enabled) {
+            continue;
+        }
+
+        unsigned long now = millis();
+        unsigned long elapsed = now - task.lastRun;
+        if (elapsed < task.periodMillis) {
+            unsigned long wait = task.periodMillis - elapsed;
+            if (wait < nextDue) {
+                nextDue = wait;
+            }
+            continue;
+        }
+
+        unsigned long late = elapsed - task.periodMillis;
+        if (late > task.stats.maxLateMillis) {
+            task.stats.maxLateMillis = late;
+        }
+
+        // Keep the cadence unless we fell a whole period behind
+        task.lastRun = late < task.periodMillis ? now - late : now;
+
+        unsigned long start = micros();
+        task.function();
+        unsigned long runtime = micros() - start;
+
+        task.stats.runs++;
+        task.stats.totalMicros += runtime;
+        if (runtime > task.stats.maxMicros) {
+            task.stats.maxMicros = runtime;
+        }
+        if (runtime > task.budgetMicros) {
+            task.stats.overruns++;
+        }
+
+        if (task.periodMillis < nextDue) {
+            nextDue = task.periodMillis;
+        }
+    }
+
+    return nextDue == ULONG_MAX ? 0 : nextDue;
+}
+
+void Scheduler::resetStats() {
+    for (size_t i = 0; i < taskCount; i++) {
+        tasks[i].stats = {};
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+// Cooperative run-to-completion scheduler for the Arduino loop task.
+//
+// Tasks live in a fixed table and must return quickly; anything slow has to
+// be written as a state machine that does one step per call. Each task has
+// a period and a run-time budget; runs over budget are counted so slow
+// steps show up in the status message.
+class Scheduler {
+public:
+    static const size_t MAX_TASKS = 10;
+
+    typedef void (*TaskFunction)();
+
+    struct TaskStats {
+        uint32_t runs;
+        uint32_t totalMicros;
+        uint32_t maxMicros;
+        uint32_t overruns;      // runs that exceeded the budget
+        uint32_t maxLateMillis; // worst start delay past the due time
+    };
+
+private:
+    struct Task {
+        const char* name;
+        TaskFunction function;
+        unsigned long periodMillis;
+        unsigned long budgetMicros;
+        unsigned long lastRun;
+        bool enabled;
+        TaskStats stats;
+    };
+
+    Task tasks[MAX_TASKS];
+    size_t taskCount;
+
+public:
+    Scheduler();
+
+    // Returns the task id, or -1 if the table is full
+    int add(const char* name, TaskFunction function, unsigned long periodMillis,
+            unsigned long budgetMicros);
+
+    void setPeriod(int id, unsigned long periodMillis);
+    void setEnabled(int id, bool enabled);
+
+    // Runs every task that is due once; returns milliseconds until the next one
+    unsigned long run();
+
+    size_t count() const { return taskCount; }
+    const char* name(size_t index) const { return tasks[index].name; }
+    const TaskStats& stats(size_t index) const { return tasks[index].stats; }
+    void resetStats();
+};
+
+#endif
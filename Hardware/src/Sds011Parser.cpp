@@ -0,0 +1,87 @@
+#include "Sds011Parser.h"
+
+namespace {
+
+const uint8_t FRAME_HEAD = 0xAA;
+const uint8_t FRAME_TAIL = 0xAB;
+const uint8_t DATA_COMMAND = 0xC0;
+const uint8_t REPLY_COMMAND = 0xC5;
+
+}  // namespace
+
+Sds011Parser::Sds011Parser()
+    : length(0)
+    , pm25(0)
+    , pm10(0)
+    , readingMillis(0)
+    , hasReading(false)
+    , frames(0)
+    , badFrames(0)
+{
+}
+
+// Drops the rejected frame and restarts from the next plausible frame
+// start inside it, so a frame that began within the bad one is not lost
+void Sds011Parser::resync() {
+    badFrames++;
+    size_t start = 1;
+    for (;;) {
+        while (start < length && frame[start] != FRAME_HEAD) {
+            start++;
+        }
+        if (start + 1 < length && frame[start + 1] != DATA_COMMAND && frame[start + 1] != REPLY_COMMAND) {
+            start++;
+            continue;
+        }
+        break;
+    }
+    size_t kept = 0;
+    for (size_t i = start; i < length; i++) {
+        frame[kept++] = frame[i];
+    }
+    length = kept;
+}
+
+bool Sds011Parser::feed(uint8_t byte, unsigned long now) {
+    if (length == 0 && byte != FRAME_HEAD) {
+        return false;  // noise between frames
+    }
+    frame[length++] = byte;
+    if (length == 2 && byte != DATA_COMMAND && byte != REPLY_COMMAND) {
+        resync();
+        return false;
+    }
+    if (length < FRAME_SIZE) {
+        return false;
+    }
+
+    uint8_t sum = 0;
+    for (size_t i = 2; i < 8; i++) {
+        sum += frame[i];
+    }
+    if (frame[FRAME_SIZE - 1] != FRAME_TAIL || frame[8] != sum) {
+        resync();
+        return false;
+    }
+    length = 0;
+    if (frame[1] != DATA_COMMAND) {
+        return false;
+    }
+
+    pm25 = (frame[2] | frame[3] << 8) / 10.0f;
+    pm10 = (frame[4] | frame[5] << 8) / 10.0f;
+    readingMillis = now;
+    hasReading = true;
+    frames++;
+    return true;
+}
+
+bool Sds011Parser::latest(float& pm25Out, float& pm10Out, unsigned long& atMillis) const {
+    if (!hasReading) {
+        return false;
+    }
+    pm25Out = pm25;
+    pm10Out = pm10;
+    atMillis = readingMillis;
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef SDS011_PARSER_H
+#define SDS011_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Incremental decoder for the SDS011's UART stream. Bytes are fed in as
+// they arrive, in any split; a reading is taken from every complete data
+// frame whose checksum matches:
+//
+//   AA C0 PM25_lo PM25_hi PM10_lo PM10_hi ID_lo ID_hi CHK AB
+//
+// with CHK the low byte of the sum of the six data bytes and the values
+// in tenths of ug/m3. Command replies (AA C5 ...) are skipped. After a bad
+// frame the decoder resynchronises on the next AA, so one corrupt byte
+// costs at most one frame.
+class Sds011Parser {
+public:
+    static const size_t FRAME_SIZE = 10;
+
+private:
+    uint8_t frame[FRAME_SIZE];
+    size_t length;               // bytes of the current frame so far
+
+    float pm25;
+    float pm10;
+    unsigned long readingMillis;
+    bool hasReading;
+
+    uint32_t frames;             // valid data frames
+    uint32_t badFrames;          // checksum or framing errors
+
+    void resync();
+
+public:
+    Sds011Parser();
+
+    // Discards a partial frame, e.g. when the sensor is put to sleep
+    void reset() { length = 0; }
+
+    // Returns true when byte completes a valid data frame
+    bool feed(uint8_t byte, unsigned long now);
+
+    // Latest valid reading and when it was decoded; false before the first
+    bool latest(float& pm25Out, float& pm10Out, unsigned long& atMillis) const;
+
+    uint32_t frameCount() const { return frames; }
+    uint32_t badFrameCount() const { return badFrames; }
+};
+
+#endif
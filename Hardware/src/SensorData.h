@@ -0,0 +1,73 @@
+#ifndef SENSOR_DATA_H
+#define SENSOR_DATA_H
+
+#include <stdint.h>
+
+// Independently sampled sensors, in the order used for validity bits and ages
+enum SensorChannel : uint8_t {
+    SENSOR_SOIL,
+    SENSOR_DHT,
+    SENSOR_MQ8,
+    SENSOR_CCS811,
+    SENSOR_RADAR,
+    SENSOR_SDS011,
+    SENSOR_CHANNEL_COUNT
+};
+
+// Age value for a channel that has never produced a reading
+static const uint16_t SENSOR_AGE_UNKNOWN = 0xFFFF;
+
+struct SensorData {
+    float soilTemp;
+    uint16_t soilMoisture;
+    float airTemp;
+    float humidity;
+    int h2Value;
+    float h2Voltage;
+    uint16_t co2;
+    uint16_t tvoc;
+    uint8_t targetCount;
+    float speed;
+    float distance;
+    uint16_t energy;
+    float pm25;
+    float pm10;
+
+    // Freshness of the cached readings the fields above were taken from
+    uint8_t validMask;                                // bit n: channel n is fresh
+    uint8_t faultMask;                                // bit n: channel n's last reading was rejected
+    uint16_t ageDeciseconds[SENSOR_CHANNEL_COUNT];    // time since last good read
+};
+
+// A sample as queued for upload: seq increases monotonically across reboots
+// so the backend can drop duplicates from replays; timestamp is Unix time in
+// seconds, or 0 if the clock was not yet set when the sample was taken.
+struct StoredSample {
+    uint32_t seq;
+    uint32_t timestamp;
+    SensorData data;
+};
+
+// Telemetry field list: JSON key, SensorData member, value type, source
+// channel. Order here is the order fields appear in the published payload.
+#define SENSOR_DATA_FIELDS(X) \
+    X("soil_temperature", soilTemp,     Float, SENSOR_SOIL)   \
+    X("soil_moisture",    soilMoisture, U16,   SENSOR_SOIL)   \
+    X("air_temperature",  airTemp,      Float, SENSOR_DHT)    \
+    X("humidity",         humidity,     Float, SENSOR_DHT)    \
+    X("hydrogen_raw",     h2Value,      Int,   SENSOR_MQ8)    \
+    X("hydrogen_voltage", h2Voltage,    Float, SENSOR_MQ8)    \
+    X("co2",              co2,          U16,   SENSOR_CCS811) \
+    X("tvoc",             tvoc,         U16,   SENSOR_CCS811) \
+    X("target_count",     targetCount,  U8,    SENSOR_RADAR)  \
+    X("target_speed",     speed,        Float, SENSOR_RADAR)  \
+    X("target_distance",  distance,     Float, SENSOR_RADAR)  \
+    X("target_energy",    energy,       U16,   SENSOR_RADAR)  \
+    X("pm25",             pm25,         Float, SENSOR_SDS011) \
+    X("pm10",             pm10,         Float, SENSOR_SDS011)
+
+#define SENSOR_DATA_COUNT_FIELD(name, member, kind, channel) + 1
+static const uint8_t SENSOR_FIELD_COUNT = 0 SENSOR_DATA_FIELDS(SENSOR_DATA_COUNT_FIELD);
+#undef SENSOR_DATA_COUNT_FIELD
+
+#endif
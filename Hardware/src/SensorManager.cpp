@@ -1,101 +1,511 @@
 #include "SensorManager.h"
 
-SensorManager::SensorManager(int dhtPin, int mq8Pin, int rxPin, int txPin, int sdsRx, int sdsTx)
-    : dht(dhtPin, DHT11)
-    , MQ8_PIN(mq8Pin)
-    , DHTPIN(dhtPin)
-    , RX_PIN(rxPin)
-    , TX_PIN(txPin)
-    , SDS_RX_PIN(sdsRx)
-    , SDS_TX_PIN(sdsTx)
-    , radar(&Serial2, 9600, rxPin, txPin)
+namespace {
+
+const uint8_t SOIL_ADDRESS = 0x36;
+const uint8_t SOIL_STATUS_BASE = 0x00;
+const uint8_t SOIL_STATUS_TEMP = 0x04;
+const uint8_t SOIL_TOUCH_BASE = 0x0F;
+const uint8_t SOIL_TOUCH_CHANNEL = 0x10;
+const uint16_t SOIL_TEMP_DELAY = 1000;    // us between request and read
+const uint16_t SOIL_TOUCH_DELAY = 3000;
+
+const uint8_t AIR_QUALITY_ADDRESS = 0x5A;
+const uint8_t AIR_QUALITY_RESULT = 0x02;  // eCO2, TVOC, STATUS
+const uint8_t AIR_QUALITY_DATA_READY = 0x08;
+const uint8_t AIR_QUALITY_ERROR = 0x01;
+
+// Plausible range, median window, Kalman q and r, readings before stuck.
+// Limits are the sensors' datasheet ranges; outside them a reading is a
+// wiring, bus or sensor fault rather than weather.
+const SignalConditioner::Config SOIL_TEMP_SIGNAL     = { -40.0f,   85.0f, 3, 0.01f, 0.25f,   0 };
+const SignalConditioner::Config SOIL_MOISTURE_SIGNAL = { 200.0f, 2000.0f, 3, 4.0f,  25.0f,   0 };
+// The DHT11 has 1 C / 1 % steps: a spike filter, nothing to smooth
+const SignalConditioner::Config AIR_TEMP_SIGNAL      = {   0.0f,   50.0f, 3, 0.0f,  0.0f,    0 };
+const SignalConditioner::Config HUMIDITY_SIGNAL      = {   0.0f,  100.0f, 3, 0.0f,  0.0f,    0 };
+// Raw 12-bit counts; a pinned top rail means the divider or sensor is gone,
+// and a live MQ-8 never holds one value for a minute
+const SignalConditioner::Config H2_SIGNAL            = {   0.0f, 4094.0f, 5, 4.0f,  100.0f, 60 };
+// The CCS811 reports 400 ppm eCO2 at its floor; zeros mean no real result
+const SignalConditioner::Config CO2_SIGNAL           = { 400.0f, 8192.0f, 3, 0.0f,  0.0f,    0 };
+const SignalConditioner::Config TVOC_SIGNAL          = {   0.0f, 1187.0f, 3, 0.0f,  0.0f,    0 };
+const SignalConditioner::Config PM_SIGNAL            = {   0.0f,  999.9f, 3, 0.0f,  0.0f,    0 };
+
+enum I2cTag {
+    TAG_SOIL_TEMP,
+    TAG_SOIL_MOISTURE,
+    TAG_CCS811
+};
+
+}  // namespace
+
+const char* const SensorManager::CHANNEL_NAMES[SENSOR_CHANNEL_COUNT] = {
+    "soil", "dht", "mq8", "ccs811", "radar", "sds011"
+};
+
+SensorManager::SensorManager()
+    : dht(0, DHT11)
+    , radar(&Serial2, 9600, 0, 0)
     , sdsSerial(1)
+    , i2c(Wire)
+    , pins{}
+    , cache{}
+    , soilTempReading(0)
+    , soilTempValid(false)
+    , soilTempSignal(SOIL_TEMP_SIGNAL)
+    , soilMoistureSignal(SOIL_MOISTURE_SIGNAL)
+    , airTempSignal(AIR_TEMP_SIGNAL)
+    , humiditySignal(HUMIDITY_SIGNAL)
+    , h2Signal(H2_SIGNAL)
+    , co2Signal(CO2_SIGNAL)
+    , tvocSignal(TVOC_SIGNAL)
+    , pm25Signal(PM_SIGNAL)
+    , pm10Signal(PM_SIGNAL)
+    , faultMask(0)
+    , faultCounts{}
+    , sdsOnTime(DEFAULT_SDS_ON_TIME)
+    , sdsCycleStart(0)
+    , sdsWokeAt(0)
+    , sdsState(SDS_ASLEEP)
+    , burstEnabled(true)
+    , capturing(false)
+    , trackReady(false)
+    , lastTarget(0)
+    , tracksDropped(0)
 {
+    const unsigned long defaults[SENSOR_CHANNEL_COUNT] = {
+        DEFAULT_SOIL_PERIOD, DEFAULT_DHT_PERIOD, DEFAULT_MQ8_PERIOD,
+        DEFAULT_CCS811_PERIOD, DEFAULT_RADAR_PERIOD, DEFAULT_SDS_PERIOD
+    };
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        channels[i] = {defaults[i], 0, 0, false};
+    }
+    cache.pm25 = -1;
+    cache.pm10 = -1;
+}
+
+void SensorManager::setPins(const Pins& wiring) {
+    pins = wiring;
+    // The drivers take their pins when they are constructed
+    dht = DHT(pins.dht, DHT11);
+    radar = DFRobot_C4001_UART(&Serial2, 9600, pins.radarRx, pins.radarTx);
 }
 
 bool SensorManager::begin() {
     Wire.begin(22, 21);
-    Serial2.begin(9600, SERIAL_8N1, RX_PIN, TX_PIN);
+    Serial2.begin(9600, SERIAL_8N1, pins.radarRx, pins.radarTx);
+    i2c.begin(I2C_FREQUENCY);
     dht.begin();
+    esp_adc_cal_value_t calibration = beginAdc();
+    Serial.printf("ADC calibration: %s\n",
+                  calibration == ESP_ADC_CAL_VAL_EFUSE_TP ? "eFuse two-point" :
+                  calibration == ESP_ADC_CAL_VAL_EFUSE_VREF ? "eFuse Vref" : "default Vref");
     
     // Initialize SDS011 with proper Serial configuration
-    sdsSerial.begin(9600, SERIAL_8N1, SDS_RX_PIN, SDS_TX_PIN);
+    sdsSerial.begin(9600, SERIAL_8N1, pins.sdsRx, pins.sdsTx);
     delay(100);  // Give serial time to stabilize
     sds.begin(&sdsSerial);  // Remove pin parameters, they're already set in serial begin
     
-    // Wake up the SDS011 sensor
-    sds.wakeup();
-    delay(3000); // Allow SDS011 to stabilize
+    // Start asleep; pollSds() wakes it at the start of each duty cycle
+    sds.sleep();
     
     if (!ccs.begin()) {
         Serial.println("Failed to start CCS811!");
         return false;
     }
+    // No waiting for the first result: reads only count once the
+    // CCS811 flags new data
     
-    while(!ccs.available());
-    
-    if (!ss.begin(0x36)) {
+    if (!ss.begin(SOIL_ADDRESS)) {
         Serial.println("ERROR! seesaw not found");
         return false;
     }
     
+    unsigned long now = millis();
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        channels[i].lastPoll = now - channels[i].period;  // poll right away
+    }
+    sdsCycleStart = now;
+    
     return true;
 }
 
-SensorData SensorManager::readSensors() {
-    SensorData data = {};
+SensorData SensorManager::sampleOnce() {
+    Wire.begin(22, 21);
+    i2c.begin(I2C_FREQUENCY);
+    dht.begin();
+    beginAdc();
     
-    // Read soil sensor
-    data.soilTemp = ss.getTemp();
-    data.soilMoisture = ss.touchRead(0);
+    pollSoil();
+    pollCcs811();
+    if (pollDht()) {
+        markValid(SENSOR_DHT);
+    }
+    if (pollMq8()) {
+        markValid(SENSOR_MQ8);
+    }
     
-    // Read DHT11
-    data.humidity = dht.readHumidity();
-    data.airTemp = dht.readTemperature();
+    unsigned long started = millis();
+    i2c.service();
+    while ((i2c.pending(SOIL_ADDRESS) || i2c.pending(AIR_QUALITY_ADDRESS)) &&
+           millis() - started < SAMPLE_ONCE_TIMEOUT) {
+        delay(1);
+        i2c.service();
+    }
+    return snapshot();
+}
+
+void SensorManager::update() {
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        SensorChannel channel = (SensorChannel)i;
+        Channel& state = channels[i];
+        // The SDS011 state machine runs every second; its period is the duty cycle
+        unsigned long interval = channel == SENSOR_SDS011 ? SDS_POLL_PERIOD : state.period;
+        if (channel == SENSOR_RADAR && capturing && interval > RADAR_BURST_PERIOD) {
+            interval = RADAR_BURST_PERIOD;
+        }
+        
+        unsigned long now = millis();
+        if (now - state.lastPoll < interval) {
+            continue;
+        }
+        state.lastPoll = now;
+        
+        if (poll(channel, now)) {
+            state.lastValid = now;
+            state.everValid = true;
+        }
+    }
     
-    // Read MQ-8
-    data.h2Value = analogRead(MQ8_PIN);
-    data.h2Voltage = data.h2Value * (5.0 / 4095.0);
+    // I2C channels only queued their reads above; run them as one sweep
+    i2c.service();
+}
+
+void SensorManager::markValid(SensorChannel channel) {
+    channels[channel].lastValid = millis();
+    channels[channel].everValid = true;
+}
+
+// Records whether a channel's reading made it through conditioning
+bool SensorManager::conditioned(SensorChannel channel, bool good) {
+    if (good) {
+        faultMask &= ~(1 << channel);
+    } else {
+        faultMask |= 1 << channel;
+        faultCounts[channel]++;
+    }
+    return good;
+}
+
+// The MQ-8 pin at 11 dB reads up to about 3.1 V; the eFuse calibration
+// (two-point or Vref, whichever this chip has) corrects the ADC's gain
+// and offset when converting counts to millivolts
+esp_adc_cal_value_t SensorManager::beginAdc() {
+    analogReadResolution(12);
+    analogSetPinAttenuation(pins.mq8, ADC_11db);
+    return esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12,
+                                    DEFAULT_VREF, &adcCalibration);
+}
+
+// Completions from the I2C queue, on the task that calls update()
+void SensorManager::onI2c(void* context, const I2cBus::Transaction& t, I2cBus::Result result) {
+    SensorManager* self = static_cast<SensorManager*>(context);
+    bool ok = result == I2cBus::I2C_OK;
+    switch (t.tag) {
+        case TAG_SOIL_TEMP: {
+            int32_t raw = (int32_t)((uint32_t)t.read[0] << 24 | (uint32_t)t.read[1] << 16 |
+                                    (uint32_t)t.read[2] << 8 | t.read[3]);
+            self->soilTempReading = raw / 65536.0f;
+            self->soilTempValid = ok;
+            break;
+        }
+        case TAG_SOIL_MOISTURE: {
+            uint16_t moisture = (uint16_t)(t.read[0] << 8 | t.read[1]);
+            if (ok && self->soilTempValid && moisture != 0xFFFF) {
+                float temp, level;
+                bool good = self->soilTempSignal.add(self->soilTempReading, temp) == SignalConditioner::FAULT_NONE &&
+                            self->soilMoistureSignal.add(moisture, level) == SignalConditioner::FAULT_NONE;
+                if (self->conditioned(SENSOR_SOIL, good)) {
+                    self->cache.soilTemp = temp;
+                    self->cache.soilMoisture = (uint16_t)lroundf(level);
+                    self->markValid(SENSOR_SOIL);
+                }
+            }
+            self->soilTempValid = false;
+            break;
+        }
+        case TAG_CCS811: {
+            uint8_t status = t.read[4];
+            if (!ok || !(status & AIR_QUALITY_DATA_READY)) {
+                break;  // nothing new yet
+            }
+            float co2, tvoc;
+            bool good = !(status & AIR_QUALITY_ERROR) &&
+                        self->co2Signal.add((uint16_t)(t.read[0] << 8 | t.read[1]), co2) == SignalConditioner::FAULT_NONE &&
+                        self->tvocSignal.add((uint16_t)(t.read[2] << 8 | t.read[3]), tvoc) == SignalConditioner::FAULT_NONE;
+            if (self->conditioned(SENSOR_CCS811, good)) {
+                self->cache.co2 = (uint16_t)lroundf(co2);
+                self->cache.tvoc = (uint16_t)lroundf(tvoc);
+                self->markValid(SENSOR_CCS811);
+            }
+            break;
+        }
+    }
+}
+
+bool SensorManager::poll(SensorChannel channel, unsigned long now) {
+    switch (channel) {
+        case SENSOR_SOIL:   return pollSoil();
+        case SENSOR_DHT:    return pollDht();
+        case SENSOR_MQ8:    return pollMq8();
+        case SENSOR_CCS811: return pollCcs811();
+        case SENSOR_RADAR:  return pollRadar(now);
+        case SENSOR_SDS011: return pollSds(now);
+        default:            return false;
+    }
+}
+
+// Queues the temperature and moisture reads; onI2c() updates the cache
+bool SensorManager::pollSoil() {
+    if (i2c.pending(SOIL_ADDRESS)) {
+        return false;  // the last pair is still in flight
+    }
+    I2cBus::Transaction t = {};
+    t.address = SOIL_ADDRESS;
+    t.write[0] = SOIL_STATUS_BASE;
+    t.write[1] = SOIL_STATUS_TEMP;
+    t.writeLength = 2;
+    t.readLength = 4;
+    t.delayMicros = SOIL_TEMP_DELAY;
+    t.tag = TAG_SOIL_TEMP;
+    t.completion = onI2c;
+    t.context = this;
+    i2c.submit(t);
     
-    // Read CCS811
-    if(ccs.available() && !ccs.readData()) {
-        data.co2 = ccs.geteCO2();
-        data.tvoc = ccs.getTVOC();
+    t.write[0] = SOIL_TOUCH_BASE;
+    t.write[1] = SOIL_TOUCH_CHANNEL;
+    t.readLength = 2;
+    t.delayMicros = SOIL_TOUCH_DELAY;
+    t.tag = TAG_SOIL_MOISTURE;
+    i2c.submit(t);
+    return false;
+}
+
+bool SensorManager::pollDht() {
+    float humidity, temp;
+    SignalConditioner::Fault humidityFault = humiditySignal.add(dht.readHumidity(), humidity);
+    SignalConditioner::Fault tempFault = airTempSignal.add(dht.readTemperature(), temp);
+    if (!conditioned(SENSOR_DHT, humidityFault == SignalConditioner::FAULT_NONE &&
+                                 tempFault == SignalConditioner::FAULT_NONE)) {
+        return false;  // keep the last good reading
+    }
+    cache.humidity = humidity;
+    cache.airTemp = temp;
+    return true;
+}
+
+// Averages MQ8_OVERSAMPLE conversions against the ADC's noise, filters the
+// counts and converts them with the chip's calibration
+bool SensorManager::pollMq8() {
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < MQ8_OVERSAMPLE; i++) {
+        sum += analogRead(pins.mq8);
+    }
+    float counts;
+    if (!conditioned(SENSOR_MQ8, h2Signal.add((float)sum / MQ8_OVERSAMPLE, counts) == SignalConditioner::FAULT_NONE)) {
+        return false;
+    }
+    cache.h2Value = (int)lroundf(counts);
+    cache.h2Voltage = esp_adc_cal_raw_to_voltage(cache.h2Value, &adcCalibration) / 1000.0f;
+    return true;
+}
+
+// Reads the result registers with their status byte in one transaction;
+// onI2c() only takes them when the data-ready flag is set
+bool SensorManager::pollCcs811() {
+    if (i2c.pending(AIR_QUALITY_ADDRESS)) {
+        return false;
+    }
+    I2cBus::Transaction t = {};
+    t.address = AIR_QUALITY_ADDRESS;
+    t.write[0] = AIR_QUALITY_RESULT;
+    t.writeLength = 1;
+    t.readLength = 5;
+    t.tag = TAG_CCS811;
+    t.completion = onI2c;
+    t.context = this;
+    i2c.submit(t);
+    return false;
+}
+
+bool SensorManager::pollRadar(unsigned long now) {
+    cache.targetCount = radar.getTargetNumber();
+    uint32_t energy = 0;
+    if (cache.targetCount > 0) {
+        cache.speed = radar.getTargetSpeed();
+        cache.distance = radar.getTargetRange();
+        energy = radar.getTargetEnergy();
+        cache.energy = energy;
+    } else {
+        cache.speed = 0;
+        cache.distance = 0;
+        cache.energy = 0;
+    }
+    if (burstEnabled) {
+        captureRadar(now, energy);
+    }
+    return true;
+}
+
+// Starts a track on the first detection, extends it while the target stays
+// and closes it once the target has been gone for TRACK_HOLD
+void SensorManager::captureRadar(unsigned long now, uint32_t energy) {
+    bool present = cache.targetCount > 0;
+    if (present) {
+        lastTarget = now;
+        if (!capturing) {
+            if (trackReady) {
+                tracksDropped++;    // the previous one was never collected
+                trackReady = false;
+            }
+            track.begin(now);
+            capturing = true;
+        }
+        track.add(now, cache.targetCount, cache.speed, cache.distance, energy);
     }
+    if (capturing && (now - lastTarget >= TRACK_HOLD || track.durationMillis() >= MAX_TRACK)) {
+        capturing = false;
+        trackReady = true;
+    }
+}
+
+void SensorManager::setRadarBurst(bool enabled) {
+    burstEnabled = enabled;
+    if (!enabled) {
+        capturing = false;
+        trackReady = false;
+    }
+}
+
+bool SensorManager::takeTrack(RadarTrack& out) {
+    if (!trackReady) {
+        return false;
+    }
+    out = track;
+    trackReady = false;
+    return true;
+}
+
+// Duty cycle: asleep -> warming -> sampling -> asleep. The sensor is awake
+// for sdsOnTime at the start of every period and its readings only count
+// once the fan has run for SDS_WARMUP.
+bool SensorManager::pollSds(unsigned long now) {
+    unsigned long period = channels[SENSOR_SDS011].period;
+    if (now - sdsCycleStart >= period) {
+        sdsCycleStart = now;
+    }
+    bool shouldRun = period <= sdsOnTime || now - sdsCycleStart < sdsOnTime;
     
-    // Read Radar
-    data.targetCount = radar.getTargetNumber();
-    if (data.targetCount > 0) {
-        data.speed = radar.getTargetSpeed();
-        data.distance = radar.getTargetRange();
-        data.energy = radar.getTargetEnergy();
+    if (shouldRun && sdsState == SDS_ASLEEP) {
+        sds.wakeup();
+        sdsState = SDS_WARMING;
+        sdsWokeAt = now;
+    } else if (!shouldRun && sdsState != SDS_ASLEEP) {
+        sds.sleep();
+        sdsState = SDS_ASLEEP;
+    }
+    if (sdsState == SDS_WARMING && now - sdsWokeAt >= SDS_WARMUP) {
+        sdsState = SDS_SAMPLING;
+        // Readings from the last cycle are minutes old
+        pm25Signal.reset();
+        pm10Signal.reset();
     }
     
-    // Read SDS011
-    int retries = 3;
-    while (retries > 0) {
-        int error = sds.read(&data.pm25, &data.pm10);
-        if (!error && data.pm25 >= 0 && data.pm10 >= 0) {
-            break;  // Successful reading
+    return drainSds(now);
+}
+
+// Feeds whatever the UART holds to the frame parser without waiting for
+// more. Outside SDS_SAMPLING the bytes are read and discarded so warm-up
+// readings and stale frames never reach the cache.
+bool SensorManager::drainSds(unsigned long now) {
+    bool fresh = false;
+    int available = sdsSerial.available();
+    while (available-- > 0) {
+        int byte = sdsSerial.read();
+        if (byte < 0) {
+            break;
         }
-        retries--;
-        if (retries > 0) {
-            delay(1000);  // Wait 1 second between retries
-            sds.wakeup(); // Ensure sensor is awake
-            delay(100);   // Short delay after wakeup
+        if (sdsState == SDS_SAMPLING && sdsParser.feed((uint8_t)byte, now)) {
+            fresh = true;
         }
     }
-    
-    if (retries == 0) {
-        data.pm25 = -1;
-        data.pm10 = -1;
-        Serial.println("Error reading from SDS011 after multiple attempts");
+    if (sdsState != SDS_SAMPLING) {
+        sdsParser.reset();
+        return false;
+    }
+    if (!fresh) {
+        return false;
+    }
+    float pm25, pm10;
+    unsigned long at;
+    sdsParser.latest(pm25, pm10, at);
+    bool good = pm25Signal.add(pm25, pm25) == SignalConditioner::FAULT_NONE &&
+                pm10Signal.add(pm10, pm10) == SignalConditioner::FAULT_NONE;
+    if (!conditioned(SENSOR_SDS011, good)) {
+        return false;
+    }
+    cache.pm25 = pm25;
+    cache.pm10 = pm10;
+    return true;
+}
+
+unsigned long SensorManager::staleAfter(SensorChannel channel) const {
+    if (channel == SENSOR_SDS011) {
+        unsigned long period = channels[channel].period;
+        // Sleeping between cycles is expected; stale once a cycle is missed
+        return period <= sdsOnTime ? STALE_PERIODS * SDS_POLL_PERIOD : period + sdsOnTime;
     }
+    return STALE_PERIODS * channels[channel].period;
+}
+
+SensorData SensorManager::snapshot() const {
+    SensorData data = cache;
+    data.validMask = 0;
+    data.faultMask = faultMask;
     
+    unsigned long now = millis();
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        const Channel& state = channels[i];
+        if (!state.everValid) {
+            data.ageDeciseconds[i] = SENSOR_AGE_UNKNOWN;
+            continue;
+        }
+        
+        unsigned long age = now - state.lastValid;
+        unsigned long deciseconds = age / 100;
+        data.ageDeciseconds[i] = deciseconds < SENSOR_AGE_UNKNOWN ? deciseconds : SENSOR_AGE_UNKNOWN - 1;
+        if (age <= staleAfter((SensorChannel)i) && !(faultMask & (1 << i))) {
+            data.validMask |= 1 << i;
+        }
+    }
     return data;
 }
 
+bool SensorManager::setPeriod(SensorChannel channel, unsigned long periodMillis) {
+    if (channel >= SENSOR_CHANNEL_COUNT) {
+        return false;
+    }
+    unsigned long minimum = channel == SENSOR_DHT ? MIN_DHT_PERIOD : MIN_PERIOD;
+    channels[channel].period = periodMillis < minimum ? minimum : periodMillis;
+    return true;
+}
+
+void SensorManager::setSdsOnTime(unsigned long onMillis) {
+    sdsOnTime = onMillis < MIN_SDS_ON_TIME ? MIN_SDS_ON_TIME : onMillis;
+}
+
 void SensorManager::printReadings(const SensorData& data) {
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
     Serial.println("\n----- Sensor Readings -----");
     
     Serial.println("\n----- DHT11 Readings -----");
@@ -134,4 +544,7 @@ void SensorManager::printReadings(const SensorData& data) {
     } else {
         Serial.println("Failed to read from SDS011 sensor!");
     }
-} 
\ No newline at end of file
+#else
+    (void)data;  // readings dump is debug-only
+#endif
+}
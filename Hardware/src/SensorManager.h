@@ -7,45 +7,172 @@
 #include "Adafruit_CCS811.h"
 #include "DFRobot_C4001.h"
 #include <SDS011.h>
-
-struct SensorData {
-    float soilTemp;
-    uint16_t soilMoisture;
-    float airTemp;
-    float humidity;
-    int h2Value;
-    float h2Voltage;
-    uint16_t co2;
-    uint16_t tvoc;
-    uint8_t targetCount;
-    float speed;
-    float distance;
-    uint16_t energy;
-    float pm25;
-    float pm10;
-};
+#include "SensorData.h"
+#include "RadarTrack.h"
+#include "Sds011Parser.h"
+#include "I2cBus.h"
+#include "SignalConditioner.h"
+#include <esp_adc_cal.h>
+#include "Diagnostics.h"
 
 class SensorManager {
+public:
+    // SDS011 duty cycle: asleep, fan warming up, or reporting readings
+    enum SdsState {
+        SDS_ASLEEP,
+        SDS_WARMING,
+        SDS_SAMPLING
+    };
+
+    // GPIO wiring
+    struct Pins {
+        uint8_t dht;
+        uint8_t mq8;
+        uint8_t radarRx;
+        uint8_t radarTx;
+        uint8_t sdsRx;
+        uint8_t sdsTx;
+    };
+
+    // Default poll periods (ms). The DHT11 cannot deliver more than 1 Hz and
+    // the SDS011 is duty-cycled: awake for SDS_ON_TIME out of every period.
+    static const unsigned long DEFAULT_SOIL_PERIOD = 10000;
+    static const unsigned long DEFAULT_DHT_PERIOD = 2000;
+    static const unsigned long DEFAULT_MQ8_PERIOD = 1000;
+    static const unsigned long DEFAULT_CCS811_PERIOD = 1000;
+    static const unsigned long DEFAULT_RADAR_PERIOD = 200;
+    static const unsigned long DEFAULT_SDS_PERIOD = 300000;
+    static const unsigned long DEFAULT_SDS_ON_TIME = 30000;
+    static const unsigned long SDS_WARMUP = 20000;      // fan spin-up before readings count
+    static const unsigned long SDS_POLL_PERIOD = 1000;  // SDS011 reports once a second
+    // Shorter than the warm-up would never yield a reading
+    static const unsigned long MIN_SDS_ON_TIME = SDS_WARMUP + SDS_POLL_PERIOD;
+    static const unsigned long MIN_DHT_PERIOD = 1000;
+    static const unsigned long MIN_PERIOD = 50;
+
 private:
+    static const unsigned long STALE_PERIODS = 3;       // missed polls before a value is stale
+    // Burst capture: while a target is present the radar is polled as fast
+    // as the C4001 refreshes its target list, until it has been gone for
+    // TRACK_HOLD or the track reaches MAX_TRACK
+    static const unsigned long RADAR_BURST_PERIOD = 50;
+    static const unsigned long TRACK_HOLD = 1000;
+    static const unsigned long MAX_TRACK = 60000;
+    static const uint32_t I2C_FREQUENCY = 100000;
+    static const unsigned long SAMPLE_ONCE_TIMEOUT = 50;   // ms for the I2C reads
+    static const uint8_t MQ8_OVERSAMPLE = 16;              // ADC reads averaged per poll
+    static const uint32_t DEFAULT_VREF = 1100;             // mV, for chips without eFuse data
+
+    struct Channel {
+        unsigned long period;
+        unsigned long lastPoll;
+        unsigned long lastValid;
+        bool everValid;
+    };
+
+    // The seesaw and CCS811 drivers only bring the devices up; their
+    // readings go through the transaction queue on the shared bus
     Adafruit_seesaw ss;
     DHT dht;
     Adafruit_CCS811 ccs;
     DFRobot_C4001_UART radar;
-    SDS011 sds;
+    SDS011 sds;                  // only used to send sleep/wake commands
     HardwareSerial sdsSerial;
+    Sds011Parser sdsParser;
+    I2cBus i2c;
+
+    Pins pins;
+
+    Channel channels[SENSOR_CHANNEL_COUNT];
+    SensorData cache;
+    float soilTempReading;       // first half of a soil read, kept for the second
+    bool soilTempValid;
     
-    const int MQ8_PIN;
-    const int DHTPIN;
-    const int RX_PIN;
-    const int TX_PIN;
-    const int SDS_RX_PIN;
-    const int SDS_TX_PIN;
+    // Every reading passes through its signal's conditioner on the way into
+    // the cache. A channel whose last reading was rejected has its bit set
+    // in faultMask and is reported not valid until a good one arrives.
+    SignalConditioner soilTempSignal;
+    SignalConditioner soilMoistureSignal;
+    SignalConditioner airTempSignal;
+    SignalConditioner humiditySignal;
+    SignalConditioner h2Signal;
+    SignalConditioner co2Signal;
+    SignalConditioner tvocSignal;
+    SignalConditioner pm25Signal;
+    SignalConditioner pm10Signal;
+    uint8_t faultMask;
+    uint32_t faultCounts[SENSOR_CHANNEL_COUNT];
+    esp_adc_cal_characteristics_t adcCalibration;
+
+    unsigned long sdsOnTime;
+    unsigned long sdsCycleStart;
+    unsigned long sdsWokeAt;
+    SdsState sdsState;
+
+    RadarTrack track;
+    bool burstEnabled;
+    bool capturing;
+    bool trackReady;             // finished, waiting for takeTrack()
+    unsigned long lastTarget;
+    uint32_t tracksDropped;
+
+    bool poll(SensorChannel channel, unsigned long now);
+    void markValid(SensorChannel channel);
+    bool conditioned(SensorChannel channel, bool good);
+    esp_adc_cal_value_t beginAdc();
+    static void onI2c(void* context, const I2cBus::Transaction& transaction, I2cBus::Result result);
+    bool pollSoil();
+    bool pollDht();
+    bool pollMq8();
+    bool pollCcs811();
+    bool pollRadar(unsigned long now);
+    void captureRadar(unsigned long now, uint32_t energy);
+    bool pollSds(unsigned long now);
+    bool drainSds(unsigned long now);
+    unsigned long staleAfter(SensorChannel channel) const;
 
 public:
-    SensorManager(int dhtPin, int mq8Pin, int rxPin, int txPin, int sdsRx, int sdsTx);
+    static const char* const CHANNEL_NAMES[SENSOR_CHANNEL_COUNT];
+
+    SensorManager();
+    // Before begin() or sampleOnce()
+    void setPins(const Pins& wiring);
     bool begin();
-    SensorData readSensors();
+
+    // Polls every sensor whose period has elapsed; call it often
+    void update();
+    
+    // For a deep-sleep wake instead of begin()/update(): reads once the
+    // sensors that need no set-up after the ESP32 slept (soil, DHT, MQ-8
+    // and the still-running CCS811) and returns them as a snapshot. The
+    // radar and SDS011 are left alone and reported not valid.
+    SensorData sampleOnce();
+
+    // Latest cached value of every sensor plus validity flags and ages
+    SensorData snapshot() const;
+
+    // Period of one channel in ms; for the SDS011 this is the duty cycle
+    bool setPeriod(SensorChannel channel, unsigned long periodMillis);
+    unsigned long getPeriod(SensorChannel channel) const { return channels[channel].period; }
+    void setSdsOnTime(unsigned long onMillis);
+    unsigned long getSdsOnTime() const { return sdsOnTime; }
+    SdsState getSdsState() const { return sdsState; }
+    // Latest SDS011 reading taken after warm-up, with frame statistics
+    const Sds011Parser& getSdsParser() const { return sdsParser; }
+    const I2cBus::Stats& getI2cStats() const { return i2c.getStats(); }
+    // Readings rejected by conditioning since boot (NaN, out of range, stuck)
+    uint32_t faultCount(SensorChannel channel) const { return faultCounts[channel]; }
+
+    // Presence-triggered radar tracks. The periodic radar fields in
+    // snapshot() are unaffected either way.
+    void setRadarBurst(bool enabled);
+    bool isRadarBurst() const { return burstEnabled; }
+    // Copies out the last finished track; false if there is none
+    bool takeTrack(RadarTrack& out);
+    // Finished tracks overwritten before they were taken
+    uint32_t droppedTracks() const { return tracksDropped; }
+
     void printReadings(const SensorData& data);
 };
 
-#endif 
\ No newline at end of file
+#endif
@@ -0,0 +1,112 @@
+#include "SerialLogger.h"
+#include <stdarg.h>
+
+namespace {
+
+const char LEVEL_TAGS[] = { '-', 'E', 'W', 'I', 'D' };
+
+}  // namespace
+
+size_t SerialLogger::write(uint8_t c) {
+    if (c == '\r') {
+        return 1;
+    }
+
+    if (c != '\n') {
+        if (pendingLength < sizeof(pending) - 1) {
+            pending[pendingLength++] = c;
+        }
+        return 1;
+    }
+
+    enqueue(LOG_LEVEL_INFO, pending, pendingLength);
+    pendingLength = 0;
+    return 1;
+}
+
+void SerialLogger::log(uint8_t level, const char* format, ...) {
+    char text[LINE_LENGTH];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    if (n < 0) {
+        return;
+    }
+    size_t length = (size_t)n < sizeof(text) ? (size_t)n : sizeof(text) - 1;
+    enqueue(level, text, length);
+}
+
+void SerialLogger::enqueue(uint8_t level, const char* text, size_t length) {
+    LogLine line;
+    line.timestamp = millis();
+    line.level = level;
+    if (length >= sizeof(line.text)) {
+        length = sizeof(line.text) - 1;
+    }
+    memcpy(line.text, text, length);
+    line.text[length] = '\0';
+
+    ring.push(line);  // full ring counts a drop instead of waiting
+}
+
+bool SerialLogger::appendToBatch(const char* text, size_t length) {
+    if (batchLength + length + 1 >= sizeof(batch)) {
+        return false;
+    }
+    memcpy(batch + batchLength, text, length);
+    batchLength += length;
+    batch[batchLength++] = '\n';
+    batch[batchLength] = '\0';
+    return true;
+}
+
+void SerialLogger::publishBatch() {
+    if (batchLength > 0) {
+        batch[batchLength - 1] = '\0';  // no trailing newline
+        mqtt.publish(logTopic, batch);
+    }
+    batchLength = 0;
+    lastPublish = millis();
+}
+
+void SerialLogger::flush(bool mqttEnabled) {
+    char formatted[LINE_LENGTH + 24];
+    bool batching = mqttEnabled && mqtt.isConnected();
+    if (!batching) {
+        batchLength = 0;
+    }
+
+    uint32_t drops = ring.dropCount();
+    if (drops != reportedDrops) {
+        int n = snprintf(formatted, sizeof(formatted), "[W] %u log lines dropped",
+            (unsigned)(drops - reportedDrops));
+        if (!batching || appendToBatch(formatted, n)) {
+            Serial.println(formatted);
+            reportedDrops = drops;
+        }
+    }
+
+    // At most RING_LINES lines per call, so a flush is bounded
+    LogLine* line;
+    while ((line = ring.front()) != nullptr) {
+        uint8_t level = line->level <= LOG_LEVEL_DEBUG ? line->level : LOG_LEVEL_DEBUG;
+        int n = snprintf(formatted, sizeof(formatted), "%lu.%03lu [%c] %s",
+            (unsigned long)(line->timestamp / 1000), (unsigned long)(line->timestamp % 1000),
+            LEVEL_TAGS[level], line->text);
+        size_t length = n < 0 ? 0 : (size_t)n < sizeof(formatted) ? (size_t)n : sizeof(formatted) - 1;
+
+        if (batching && !appendToBatch(formatted, length)) {
+            // Batch full: lines wait in the ring (and may be dropped) until
+            // the rate limit allows the next MQTT message
+            break;
+        }
+        Serial.println(formatted);
+        ring.popFront();
+    }
+
+    if (batching && batchLength > 0 && millis() - lastPublish >= PUBLISH_INTERVAL) {
+        publishBatch();
+    }
+}
@@ -3,45 +3,88 @@
 
 #include <Arduino.h>
 #include "MQTTManager.h"
+#include "SpscQueue.h"
+#include "Diagnostics.h"
 
+// Logging never blocks the caller: lines are formatted into a fixed ring
+// and written out later by flush(), which runs as its own scheduler task.
+// Serial gets every line on the next flush; MQTT gets them batched into at
+// most one message per PUBLISH_INTERVAL. When the ring is full new lines
+// are dropped and counted.
+//
+// The ring has a single producer: log from the loop task (core 1) only.
 class SerialLogger : public Print {
+public:
+    static const size_t LINE_LENGTH = 96;
+    static const size_t RING_LINES = 32;
+
 private:
+    static const unsigned long PUBLISH_INTERVAL = 1000;  // Publish at most every second
+    static const size_t BATCH_SIZE = 440;                 // fits the MQTT packet buffer
+
+    struct LogLine {
+        uint32_t timestamp;   // millis()
+        uint8_t level;
+        char text[LINE_LENGTH];
+    };
+
     MQTTManager& mqtt;
     const char* logTopic;
-    char buffer[256];
-    size_t bufferIndex = 0;
+    SpscQueue<LogLine, RING_LINES> ring;
+
+    // Line being assembled through the Print interface
+    char pending[LINE_LENGTH];
+    size_t pendingLength = 0;
+
+    char batch[BATCH_SIZE];
+    size_t batchLength = 0;
     unsigned long lastPublish = 0;
-    const unsigned long PUBLISH_INTERVAL = 1000; // Publish every second
+    uint32_t reportedDrops = 0;
+
+    void enqueue(uint8_t level, const char* text, size_t length);
+    bool appendToBatch(const char* text, size_t length);
+    void publishBatch();
 
 public:
-    SerialLogger(MQTTManager& mqttManager, const char* topic) 
+    SerialLogger(MQTTManager& mqttManager, const char* topic)
         : mqtt(mqttManager), logTopic(topic) {}
 
-    virtual size_t write(uint8_t c) override {
-        Serial.write(c); // Still write to regular serial
-
-        // Add to buffer
-        if (bufferIndex < sizeof(buffer) - 1) {
-            buffer[bufferIndex++] = c;
-        }
-
-        // Publish if newline or buffer full or interval elapsed
-        if (c == '\n' || bufferIndex >= sizeof(buffer) - 1 || 
-            (millis() - lastPublish > PUBLISH_INTERVAL && bufferIndex > 0)) {
-            publish();
-        }
-
-        return 1;
-    }
-
-    void publish() {
-        if (bufferIndex > 0) {
-            buffer[bufferIndex] = '\0';
-            mqtt.publish(logTopic, buffer);
-            bufferIndex = 0;
-            lastPublish = millis();
-        }
-    }
+    // Print interface: each completed line is logged at INFO
+    virtual size_t write(uint8_t c) override;
+
+    void log(uint8_t level, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+    // Writes queued lines to Serial and, if mqttEnabled, batches them to
+    // the log topic. Bounded to one batch per call.
+    void flush(bool mqttEnabled);
+
+    uint32_t droppedCount() const { return ring.dropCount(); }
 };
 
-#endif 
\ No newline at end of file
+extern SerialLogger logger;
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logger.log(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logger.log(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logger.log(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logger.log(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+#include "SignalConditioner.h"
+#include <math.h>
+
+SignalConditioner::SignalConditioner(const Config& settings)
+    : config(settings)
+    , faults(0)
+{
+    if (config.medianWindow < 1) {
+        config.medianWindow = 1;
+    } else if (config.medianWindow > MAX_MEDIAN) {
+        config.medianWindow = MAX_MEDIAN;
+    }
+    reset();
+}
+
+void SignalConditioner::reset() {
+    windowCount = 0;
+    windowNext = 0;
+    lastRaw = 0;
+    repeats = 0;
+    estimate = 0;
+    variance = 0;
+    primed = false;
+}
+
+// Insertion sort of at most MAX_MEDIAN values; a short history while the
+// window fills uses what there is
+int32_t SignalConditioner::median() const {
+    int32_t sorted[MAX_MEDIAN];
+    for (uint8_t i = 0; i < windowCount; i++) {
+        int32_t value = window[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    return sorted[windowCount / 2];
+}
+
+SignalConditioner::Fault SignalConditioner::add(float raw, float& out) {
+    Fault fault = FAULT_NONE;
+    if (isnan(raw)) {
+        fault = FAULT_NAN;
+    } else if (raw < config.min || raw > config.max) {
+        fault = FAULT_RANGE;
+    }
+    if (fault != FAULT_NONE) {
+        repeats = 0;
+        faults++;
+        return fault;
+    }
+
+    int32_t fixed = (int32_t)lroundf(raw * 100.0f);
+    if (repeats == 0 || fixed != lastRaw) {
+        repeats = 1;
+    } else if (repeats < 0xFFFF) {
+        repeats++;
+    }
+    lastRaw = fixed;
+    if (config.stuckReadings > 0 && repeats >= config.stuckReadings) {
+        faults++;
+        return FAULT_STUCK;
+    }
+
+    window[windowNext] = fixed;
+    windowNext = (windowNext + 1) % config.medianWindow;
+    if (windowCount < config.medianWindow) {
+        windowCount++;
+    }
+    float value = median() / 100.0f;
+
+    if (config.processNoise > 0) {
+        if (!primed) {
+            estimate = value;
+            variance = config.measurementNoise;
+            primed = true;
+        } else {
+            variance += config.processNoise;
+            float gain = variance / (variance + config.measurementNoise);
+            estimate += gain * (value - estimate);
+            variance *= 1.0f - gain;
+        }
+        value = estimate;
+    }
+    out = value;
+    return FAULT_NONE;
+}
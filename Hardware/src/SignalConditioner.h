@@ -0,0 +1,61 @@
+#ifndef SIGNAL_CONDITIONER_H
+#define SIGNAL_CONDITIONER_H
+
+#include <stdint.h>
+
+// Clean-up for one sensor signal, applied to every raw reading before it
+// reaches the sample cache:
+//   1. fault checks: NaN, outside [min, max], or the same raw value for
+//      stuckReadings readings in a row (a dead or disconnected sensor)
+//   2. the median of the last medianWindow good readings, which drops
+//      single-reading spikes
+//   3. a scalar Kalman filter that smooths the noise floor but still
+//      follows real changes
+// The stuck check and the median work on integer hundredths, the fixed
+// point TelemetryRecord uses. Each step is a fixed amount of work.
+class SignalConditioner {
+public:
+    enum Fault : uint8_t {
+        FAULT_NONE,
+        FAULT_NAN,
+        FAULT_RANGE,
+        FAULT_STUCK
+    };
+
+    static const uint8_t MAX_MEDIAN = 5;
+
+    struct Config {
+        float min;
+        float max;
+        uint8_t medianWindow;      // readings, odd; 1 passes them through
+        float processNoise;        // Kalman q per reading; 0 turns it off
+        float measurementNoise;    // Kalman r, variance of the raw signal
+        uint16_t stuckReadings;    // 0 turns the stuck check off
+    };
+
+private:
+    Config config;
+    int32_t window[MAX_MEDIAN];    // last good readings, hundredths
+    uint8_t windowCount;
+    uint8_t windowNext;
+    int32_t lastRaw;
+    uint16_t repeats;
+    float estimate;
+    float variance;
+    bool primed;
+    uint32_t faults;
+
+    int32_t median() const;
+
+public:
+    explicit SignalConditioner(const Config& config);
+
+    // Conditions one reading into out. A faulty reading leaves out alone
+    // and does not reach the filters.
+    Fault add(float raw, float& out);
+    // Forgets the history, e.g. after the sensor was powered down
+    void reset();
+    uint32_t faultCount() const { return faults; }
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free single-producer/single-consumer ring of fixed capacity.
+//
+// Exactly one task may call push() and exactly one other task may call
+// pop(); the statistics accessors may be read from anywhere. A full queue
+// rejects the new item and counts it as dropped rather than blocking the
+// producer.
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+private:
+    T items[N];
+    std::atomic<uint32_t> head;      // next slot to read, owned by the consumer
+    std::atomic<uint32_t> tail;      // next slot to write, owned by the producer
+    std::atomic<uint32_t> drops;
+    std::atomic<uint32_t> highWater;
+
+public:
+    SpscQueue() : head(0), tail(0), drops(0), highWater(0) {}
+
+    bool push(const T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t h = head.load(std::memory_order_acquire);
+        if (t - h >= N) {
+            drops.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+
+        uint32_t depth = t + 1 - h;
+        if (depth > highWater.load(std::memory_order_relaxed)) {
+            highWater.store(depth, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    bool pop(T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t t = tail.load(std::memory_order_acquire);
+        if (h == t) {
+            return false;
+        }
+
+        item = items[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: look at the oldest item without removing it
+    T* front() {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &items[h & (N - 1)];
+    }
+
+    // Consumer side: remove the item returned by front()
+    void popFront() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Approximate when called from a third task; exact for producer/consumer
+    size_t size() const {
+        uint32_t h = head.load(std::memory_order_acquire);
+        uint32_t t = tail.load(std::memory_order_acquire);
+        uint32_t depth = t - h;
+        return depth > N ? N : depth;
+    }
+
+    static size_t capacity() { return N; }
+    uint32_t dropCount() const { return drops.load(std::memory_order_relaxed); }
+    uint32_t highWaterMark() const { return highWater.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "TelemetryRecord.h"
+#include <math.h>
+
+namespace {
+
+const int32_t FIXED_NAN = INT32_MIN;
+const int32_t FIXED_INF = INT32_MAX;
+
+class RecordWriter {
+private:
+    uint8_t* out;
+
+public:
+    explicit RecordWriter(uint8_t* buffer) : out(buffer) {}
+
+    void u8(uint8_t v) { *out++ = v; }
+
+    void u16(uint16_t v) {
+        *out++ = v & 0xff;
+        *out++ = v >> 8;
+    }
+
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; i++) {
+            *out++ = (v >> (8 * i)) & 0xff;
+        }
+    }
+
+    void fixed(float v) {
+        int32_t encoded;
+        if (isnan(v)) {
+            encoded = FIXED_NAN;
+        } else if (isinf(v) || fabsf(v) >= 21474836.0f) {
+            encoded = v > 0 ? FIXED_INF : -FIXED_INF;
+        } else {
+            // Round half away from zero, like dtostrf() in the JSON path
+            double scaled = (double)v * 100.0;
+            encoded = (int32_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+        }
+        u32((uint32_t)encoded);
+    }
+};
+
+class RecordReader {
+private:
+    const uint8_t* in;
+
+public:
+    explicit RecordReader(const uint8_t* buffer) : in(buffer) {}
+
+    uint8_t u8() { return *in++; }
+
+    uint16_t u16() {
+        uint16_t v = in[0] | (in[1] << 8);
+        in += 2;
+        return v;
+    }
+
+    uint32_t u32() {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++) {
+            v |= (uint32_t)in[i] << (8 * i);
+        }
+        in += 4;
+        return v;
+    }
+
+    float fixed() {
+        int32_t v = (int32_t)u32();
+        if (v == FIXED_NAN) {
+            return NAN;
+        }
+        if (v == FIXED_INF) {
+            return INFINITY;
+        }
+        if (v == -FIXED_INF) {
+            return -INFINITY;
+        }
+        return (float)(v / 100.0);
+    }
+};
+
+}  // namespace
+
+size_t TelemetryRecord::encode(const SensorData& data, uint8_t* buffer, size_t size) {
+    if (size < SIZE) {
+        return 0;
+    }
+
+    int h2 = data.h2Value;
+    if (h2 > INT16_MAX) h2 = INT16_MAX;
+    if (h2 < INT16_MIN) h2 = INT16_MIN;
+
+    RecordWriter w(buffer);
+    w.u8(VERSION);
+    w.u8(data.validMask);
+    w.fixed(data.soilTemp);
+    w.u16(data.soilMoisture);
+    w.fixed(data.airTemp);
+    w.fixed(data.humidity);
+    w.u16((uint16_t)(int16_t)h2);
+    w.fixed(data.h2Voltage);
+    w.u16(data.co2);
+    w.u16(data.tvoc);
+    w.u8(data.targetCount);
+    w.fixed(data.speed);
+    w.fixed(data.distance);
+    w.u16(data.energy);
+    w.fixed(data.pm25);
+    w.fixed(data.pm10);
+    for (size_t i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        w.u16(data.ageDeciseconds[i]);
+    }
+    return SIZE;
+}
+
+bool TelemetryRecord::decode(const uint8_t* buffer, size_t length, SensorData& data) {
+    uint8_t version = length > 0 ? buffer[0] : 0;
+    if ((version == VERSION && length < SIZE) || (version == 1 && length < V1_SIZE)
+        || (version != VERSION && version != 1)) {
+        return false;
+    }
+
+    RecordReader r(buffer + 2);
+    data.soilTemp = r.fixed();
+    data.soilMoisture = r.u16();
+    data.airTemp = r.fixed();
+    data.humidity = r.fixed();
+    data.h2Value = (int16_t)r.u16();
+    data.h2Voltage = r.fixed();
+    data.co2 = r.u16();
+    data.tvoc = r.u16();
+    data.targetCount = r.u8();
+    data.speed = r.fixed();
+    data.distance = r.fixed();
+    data.energy = r.u16();
+    data.pm25 = r.fixed();
+    data.pm10 = r.fixed();
+    // Faults are not recorded; a faulty channel is simply not valid
+    data.faultMask = 0;
+
+    if (version == 1) {
+        data.validMask = (1 << SENSOR_CHANNEL_COUNT) - 1;
+        for (size_t i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            data.ageDeciseconds[i] = SENSOR_AGE_UNKNOWN;
+        }
+        return true;
+    }
+
+    data.validMask = buffer[1];
+    for (size_t i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        data.ageDeciseconds[i] = r.u16();
+    }
+    return true;
+}
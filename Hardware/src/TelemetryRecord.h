@@ -0,0 +1,46 @@
+#ifndef TELEMETRY_RECORD_H
+#define TELEMETRY_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+
+// Fixed-layout binary encoding of one SensorData sample.
+//
+// Layout (little-endian, version 2, 57 bytes):
+//   u8  version
+//   u8  valid mask (bit per SensorChannel)
+//   i32 soil_temperature  x100
+//   u16 soil_moisture
+//   i32 air_temperature   x100
+//   i32 humidity          x100
+//   i16 hydrogen_raw
+//   i32 hydrogen_voltage  x100
+//   u16 co2
+//   u16 tvoc
+//   u8  target_count
+//   i32 target_speed      x100
+//   i32 target_distance   x100
+//   u16 target_energy
+//   i32 pm25              x100
+//   i32 pm10              x100
+//   u16 age[6]            0.1 s, 0xFFFF = never read
+//
+// Floats are stored in hundredths, matching the two decimals of the JSON
+// payload. NaN is stored as INT32_MIN and +/-inf as INT32_MAX / -INT32_MAX.
+// Version 1 records (45 bytes, flags 0, no ages) still decode, with every
+// channel reported valid and of unknown age.
+class TelemetryRecord {
+public:
+    static const uint8_t VERSION = 2;
+    static const size_t SIZE = 57;
+    static const size_t V1_SIZE = 45;
+
+    // Returns SIZE, or 0 if the buffer is too small
+    static size_t encode(const SensorData& data, uint8_t* buffer, size_t size);
+
+    // Returns false on a short buffer or an unknown version
+    static bool decode(const uint8_t* buffer, size_t length, SensorData& data);
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "TelemetrySerializer.h"
+#include <stddef.h>
+#include <string.h>
+
+#define TELEMETRY_FIELD_ENTRY(name, member, kind, channel) \
+    { name, TelemetryFieldType::kind, channel, (uint16_t)offsetof(SensorData, member) },
+
+const TelemetryField TelemetrySerializer::FIELDS[] = {
+    SENSOR_DATA_FIELDS(TELEMETRY_FIELD_ENTRY)
+};
+
+const size_t TelemetrySerializer::FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+#undef TELEMETRY_FIELD_ENTRY
+
+// Catch a field list that disagrees with the struct member types
+#define TELEMETRY_FIELD_CHECK(name, member, kind, channel) \
+    static_assert(sizeof(((SensorData*)0)->member) == \
+        (TelemetryFieldType::kind == TelemetryFieldType::U8 ? 1 : \
+         TelemetryFieldType::kind == TelemetryFieldType::U16 ? 2 : 4), \
+        "SENSOR_DATA_FIELDS type mismatch for " name);
+SENSOR_DATA_FIELDS(TELEMETRY_FIELD_CHECK)
+#undef TELEMETRY_FIELD_CHECK
+
+static_assert(SENSOR_FIELD_COUNT <= 32, "field masks hold at most 32 fields");
+
+int TelemetrySerializer::fieldIndex(const char* key) {
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        if (strcmp(FIELDS[i].key, key) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+float TelemetrySerializer::numericValue(const TelemetryField& field, const SensorData& data) {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(&data) + field.offset;
+
+    switch (field.type) {
+        case TelemetryFieldType::Float: {
+            float v;
+            memcpy(&v, base, sizeof(v));
+            return v;
+        }
+        case TelemetryFieldType::U8:
+            return *base;
+        case TelemetryFieldType::U16: {
+            uint16_t v;
+            memcpy(&v, base, sizeof(v));
+            return v;
+        }
+        case TelemetryFieldType::Int: {
+            int32_t v;
+            memcpy(&v, base, sizeof(v));
+            return (float)v;
+        }
+    }
+    return 0;
+}
+
+void TelemetrySerializer::writeField(JsonWriter& json, const TelemetryField& field, const SensorData& data) {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(&data) + field.offset;
+    json.key(field.key);
+
+    switch (field.type) {
+        case TelemetryFieldType::Float: {
+            float v;
+            memcpy(&v, base, sizeof(v));
+            json.value(v);
+            break;
+        }
+        case TelemetryFieldType::U8:
+            json.value((uint32_t)*base);
+            break;
+        case TelemetryFieldType::U16: {
+            uint16_t v;
+            memcpy(&v, base, sizeof(v));
+            json.value((uint32_t)v);
+            break;
+        }
+        case TelemetryFieldType::Int: {
+            int32_t v;
+            memcpy(&v, base, sizeof(v));
+            json.value(v);
+            break;
+        }
+    }
+}
+
+void TelemetrySerializer::writeFields(JsonWriter& json, const SensorData& data, uint32_t fieldMask) {
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        if (fieldMask & (1UL << i)) {
+            writeField(json, FIELDS[i], data);
+        }
+    }
+}
+
+void TelemetrySerializer::writeFreshness(JsonWriter& json, const SensorData& data) {
+    json.key("valid");
+    json.value((uint32_t)data.validMask);
+    if (data.faultMask != 0) {
+        json.key("fault");
+        json.value((uint32_t)data.faultMask);
+    }
+    json.key("age");
+    json.beginArray();
+    for (size_t i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        uint16_t age = data.ageDeciseconds[i];
+        if (age == SENSOR_AGE_UNKNOWN) {
+            json.value((int32_t)-1);
+        } else {
+            json.fixed(age, 1);
+        }
+    }
+    json.endArray();
+}
+
+size_t TelemetrySerializer::serialize(const SensorData& data, char* buffer, size_t size) {
+    JsonWriter json(buffer, size);
+    json.beginObject();
+    writeFields(json, data);
+    writeFreshness(json, data);
+    json.endObject();
+    return json.ok() ? json.length() : 0;
+}
+
+size_t TelemetrySerializer::serialize(const StoredSample& sample, char* buffer, size_t size,
+                                      uint32_t fieldMask) {
+    JsonWriter json(buffer, size);
+    json.beginObject();
+    writeFields(json, sample.data, fieldMask);
+    writeFreshness(json, sample.data);
+    json.key("seq");
+    json.value(sample.seq);
+    json.key("ts");
+    json.value(sample.timestamp);
+    json.endObject();
+    return json.ok() ? json.length() : 0;
+}
+
+size_t TelemetrySerializer::serializeBatch(const StoredSample* samples, size_t count,
+                                           char* buffer, size_t size, size_t& included,
+                                           uint32_t fieldMask) {
+    static const char HEAD[] = "{\"samples\":[";
+    static const char TAIL[] = "]}";
+    const size_t headLength = sizeof(HEAD) - 1;
+    const size_t tailLength = sizeof(TAIL) - 1;
+
+    included = 0;
+    if (size <= headLength + tailLength) {
+        return 0;
+    }
+    memcpy(buffer, HEAD, headLength);
+    size_t pos = headLength;
+
+    // Each sample is written in place; one that does not fit is cut off at
+    // the end of the previous one, so the batch is always complete JSON
+    for (size_t i = 0; i < count; i++) {
+        size_t comma = i > 0 ? 1 : 0;
+        if (pos + comma + tailLength >= size) {
+            break;
+        }
+        size_t length = serialize(samples[i], buffer + pos + comma, size - pos - comma - tailLength, fieldMask);
+        if (length == 0) {
+            break;
+        }
+        if (comma) {
+            buffer[pos] = ',';
+        }
+        pos += comma + length;
+        included++;
+    }
+
+    if (included == 0) {
+        buffer[0] = '\0';
+        return 0;
+    }
+    memcpy(buffer + pos, TAIL, tailLength + 1);
+    return pos + tailLength;
+}
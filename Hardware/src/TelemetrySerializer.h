@@ -0,0 +1,64 @@
+#ifndef TELEMETRY_SERIALIZER_H
+#define TELEMETRY_SERIALIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+#include "JsonWriter.h"
+
+enum class TelemetryFieldType : uint8_t {
+    Float,
+    U8,
+    U16,
+    Int
+};
+
+struct TelemetryField {
+    const char* key;
+    TelemetryFieldType type;
+    SensorChannel channel;
+    uint16_t offset;
+};
+
+class TelemetrySerializer {
+public:
+    // Field table generated from SENSOR_DATA_FIELDS, lives in flash
+    static const TelemetryField FIELDS[];
+    static const size_t FIELD_COUNT;
+
+    // Field masks: bit n selects FIELDS[n]
+    static const uint32_t ALL_FIELDS = 0xFFFFFFFF;
+
+    // Index of the field with this JSON key, or -1
+    static int fieldIndex(const char* key);
+
+    // Any field's value as a float (NaN stays NaN)
+    static float numericValue(const TelemetryField& field, const SensorData& data);
+
+    // Writes the telemetry JSON object into buffer (NUL-terminated).
+    // Returns the payload length, or 0 if the buffer is too small.
+    static size_t serialize(const SensorData& data, char* buffer, size_t size);
+
+    // Same object followed by "seq" and "ts" for store-and-forward uploads;
+    // only the fields in fieldMask are written
+    static size_t serialize(const StoredSample& sample, char* buffer, size_t size,
+                            uint32_t fieldMask = ALL_FIELDS);
+
+    // {"samples":[...]} holding as many of the given samples (each as above)
+    // as fit, oldest first. Sets included to that number; returns the
+    // payload length, or 0 if not even the first sample fits.
+    static size_t serializeBatch(const StoredSample* samples, size_t count,
+                                 char* buffer, size_t size, size_t& included,
+                                 uint32_t fieldMask = ALL_FIELDS);
+
+    // Appends the telemetry fields to an already open JSON object
+    static void writeFields(JsonWriter& json, const SensorData& data, uint32_t fieldMask = ALL_FIELDS);
+    static void writeField(JsonWriter& json, const TelemetryField& field, const SensorData& data);
+
+    // Appends "valid" (channel bitmask), "fault" (channels whose last
+    // reading was rejected, only when there are any) and "age" (seconds
+    // per channel, -1 if never read) after the fields
+    static void writeFreshness(JsonWriter& json, const SensorData& data);
+};
+
+#endif
@@ -1,16 +1,113 @@
 #include "WiFiManager.h"
 #include "esp_wpa2.h"
 #include <Arduino.h>
+#include <Preferences.h>
+#include <string.h>
+
+namespace {
+
+const char* LINK_NAMESPACE = "wifi";
+const char* LINK_KEY = "link";
+const char* BROKER_KEYS[2] = { "broker0", "broker1" };
+
+void toBytes(const IPAddress& address, uint8_t* out) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = address[i];
+    }
+}
+
+IPAddress fromBytes(const uint8_t* bytes) {
+    return IPAddress(bytes[0], bytes[1], bytes[2], bytes[3]);
+}
+
+}  // namespace
+
+const uint16_t WiFiManager::CONNECT_LIMITS[CONNECT_BUCKETS - 1] = { 250, 500, 1000, 2000, 5000 };
 
 WiFiManager::WiFiManager() 
     : currentNetwork(0)
+    , linkLoaded(false)
+    , linkValid(false)
+    , fastAttempt(false)
+    , fastJoins(0)
+    , roundStart(0)
+    , brokerNetwork(-1)
+    , brokerKnown(false)
+    , discoveryFailedAt(0)
     , isConnected(false)
     , lastConnectionAttempt(0)
-    , retryCount(0) {
+    , retryCount(0)
+    , maxRetries(DEFAULT_MAX_RETRIES)
+    , retryDelay(DEFAULT_RETRY_DELAY)
+    , connecting(false)
+    , attemptStart(0)
+    , networksTried(0) {
     // Initialize networks array with nullptr
     for (int i = 0; i < 2; i++) {
         networks[i] = {nullptr, nullptr, nullptr, nullptr, false};
     }
+    memset(&link, 0, sizeof(link));
+    memset(&connectStats, 0, sizeof(connectStats));
+    memset(&discoveryStats, 0, sizeof(discoveryStats));
+    memset(broker, 0, sizeof(broker));
+    brokerText[0] = '\0';
+}
+
+void WiFiManager::loadLink() {
+    linkLoaded = true;
+    Preferences prefs;
+    if (!prefs.begin(LINK_NAMESPACE, true)) {
+        return;
+    }
+    linkValid = prefs.getBytesLength(LINK_KEY) == sizeof(link) &&
+                prefs.getBytes(LINK_KEY, &link, sizeof(link)) == sizeof(link) &&
+                link.version == LINK_CACHE_VERSION && link.network < 2;
+    prefs.end();
+}
+
+// Records the association just made; flash is only written when it changed
+void WiFiManager::saveLink() {
+    uint8_t* bssid = WiFi.BSSID();
+    if (bssid == nullptr) {
+        return;
+    }
+    LinkCache current;
+    memset(&current, 0, sizeof(current));
+    current.version = LINK_CACHE_VERSION;
+    current.network = (uint8_t)currentNetwork;
+    memcpy(current.bssid, bssid, sizeof(current.bssid));
+    current.channel = WiFi.channel();
+    toBytes(WiFi.localIP(), current.ip);
+    toBytes(WiFi.gatewayIP(), current.gateway);
+    toBytes(WiFi.subnetMask(), current.subnet);
+    toBytes(WiFi.dnsIP(), current.dns);
+    if (linkValid && memcmp(&current, &link, sizeof(link)) == 0) {
+        return;
+    }
+    
+    Preferences prefs;
+    if (prefs.begin(LINK_NAMESPACE, false)) {
+        prefs.putBytes(LINK_KEY, &current, sizeof(current));
+        prefs.end();
+    }
+    link = current;
+    linkValid = true;
+}
+
+void WiFiManager::recordConnect(bool fast, unsigned long elapsed) {
+    size_t bucket = 0;
+    while (bucket < CONNECT_BUCKETS - 1 && elapsed > CONNECT_LIMITS[bucket]) {
+        bucket++;
+    }
+    uint16_t* counts = fast ? connectStats.fast : connectStats.full;
+    if (counts[bucket] < 0xFFFF) {
+        counts[bucket]++;
+    }
+}
+
+void WiFiManager::setRetryPolicy(int rounds, unsigned long delayMillis) {
+    maxRetries = rounds;
+    retryDelay = delayMillis;
 }
 
 void WiFiManager::addEnterpriseNetwork(int index, const char* ssid, const char* password, 
@@ -27,80 +124,155 @@ void WiFiManager::addRegularNetwork(int index, const char* ssid, const char* pas
     }
 }
 
-bool WiFiManager::connectToNetwork(const NetworkCredentials& network) {
-    WiFi.disconnect(true);
+// With a hint: joins the cached BSSID on its channel with the cached lease
+// as a static address. Without: clears any static address, scans and
+// asks DHCP.
+void WiFiManager::beginConnect(const NetworkCredentials& network, const LinkCache* hint) {
+    // Turning the radio off costs its restart; the fast path keeps it on
+    WiFi.disconnect(hint == nullptr);
     WiFi.mode(WIFI_STA);
+    if (hint != nullptr) {
+        WiFi.config(fromBytes(hint->ip), fromBytes(hint->gateway),
+                    fromBytes(hint->subnet), fromBytes(hint->dns));
+    } else {
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());
+    }
+    int32_t channel = hint != nullptr ? hint->channel : 0;
+    const uint8_t* bssid = hint != nullptr ? hint->bssid : nullptr;
 
     if (network.isEnterprise) {
         esp_wifi_sta_wpa2_ent_set_identity((uint8_t *)network.identity, strlen(network.identity));
         esp_wifi_sta_wpa2_ent_set_username((uint8_t *)network.identity, strlen(network.identity));
         esp_wifi_sta_wpa2_ent_set_password((uint8_t *)network.password, strlen(network.password));
         esp_wifi_sta_wpa2_ent_enable();
-        WiFi.begin(network.ssid);
+        WiFi.begin(network.ssid, nullptr, channel, bssid);
     } else {
-        WiFi.begin(network.ssid, network.password);
+        WiFi.begin(network.ssid, network.password, channel, bssid);
     }
     
-    unsigned long startAttempt = millis();
-    while (WiFi.status() != WL_CONNECTED && millis() - startAttempt < RETRY_DELAY) {
-        delay(500);
-        Serial.print(".");
+    Serial.printf("Connecting to %s%s...\n", network.ssid, hint != nullptr ? " (cached)" : "");
+    connecting = true;
+    fastAttempt = hint != nullptr;
+    attemptStart = millis();
+}
+
+// Directed join using the cached association; false when there is none
+bool WiFiManager::startFastConnect() {
+    if (!linkLoaded) {
+        loadLink();
     }
-    Serial.println();
-    
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.printf("Connected to %s\n", network.ssid);
-        Serial.printf("IP address: %s\n", WiFi.localIP().toString().c_str());
-        return true;
+    if (!linkValid || fastJoins >= MAX_FAST_JOINS || networks[link.network].ssid == nullptr) {
+        return false;
+    }
+    currentNetwork = link.network;
+    beginConnect(networks[currentNetwork], &link);
+    return true;
+}
+
+// Starts the next configured network of this round; false when none is left
+bool WiFiManager::startNextNetwork() {
+    while (networksTried < 2) {
+        int index = (currentNetwork + networksTried) % 2;
+        networksTried++;
+        
+        if (networks[index].ssid != nullptr) {
+            currentNetwork = index;
+            beginConnect(networks[index], nullptr);
+            return true;
+        }
     }
-    
-    Serial.printf("Failed to connect to %s\n", network.ssid);
     return false;
 }
 
+void WiFiManager::roundFailed() {
+    connecting = false;
+    retryCount++;
+    if (retryCount >= maxRetries) {
+        Serial.println("Max retry count reached. Will reset ESP32...");
+        if (restartHook) {
+            restartHook();
+        }
+        delay(1000);
+        ESP.restart();
+    }
+}
+
 bool WiFiManager::connect() {
     // If already connected, return true
     if (isConnected && WiFi.status() == WL_CONNECTED) {
         return true;
     }
     
-    // Check if enough time has passed since last attempt
-    if (millis() - lastConnectionAttempt < RETRY_DELAY) {
+    if (!connecting) {
+        // Check if enough time has passed since last attempt
+        if (lastConnectionAttempt != 0 && millis() - lastConnectionAttempt < retryDelay) {
+            return false;
+        }
+        
+        lastConnectionAttempt = millis();
+        roundStart = lastConnectionAttempt;
+        networksTried = 0;
+        if (!startFastConnect() && !startNextNetwork()) {
+            roundFailed();
+        }
         return false;
     }
     
-    lastConnectionAttempt = millis();
+    wl_status_t status = WiFi.status();
+    if (status == WL_CONNECTED) {
+        const NetworkCredentials& network = networks[currentNetwork];
+        Serial.printf("Connected to %s\n", network.ssid);
+        Serial.printf("IP address: %s\n", WiFi.localIP().toString().c_str());
+        recordConnect(fastAttempt, millis() - roundStart);
+        if (fastAttempt) {
+            fastJoins++;
+        } else {
+            fastJoins = 0;
+            saveLink();
+        }
+        connecting = false;
+        isConnected = true;
+        retryCount = 0;
+        return true;
+    }
     
-    // Try each configured network
-    for (int i = 0; i < 2; i++) {
-        currentNetwork = (currentNetwork + i) % 2;
-        
-        if (networks[currentNetwork].ssid == nullptr) {
-            continue;
+    if (fastAttempt) {
+        // The AP moved, changed channel or is gone: fall back to the full
+        // path right away rather than waiting out the normal timeout
+        bool failed = status == WL_NO_SSID_AVAIL || status == WL_CONNECT_FAILED;
+        if (!failed && millis() - attemptStart < FAST_TIMEOUT) {
+            return false;
         }
-        
-        if (connectToNetwork(networks[currentNetwork])) {
-            isConnected = true;
-            retryCount = 0;
-            return true;
+        Serial.printf("Cached join to %s failed, scanning\n", networks[currentNetwork].ssid);
+        connectStats.fastFailed++;
+        networksTried = 0;
+        if (!startNextNetwork()) {
+            lastConnectionAttempt = millis();
+            roundFailed();
         }
+        return false;
     }
     
-    // If we get here, all connection attempts failed
-    retryCount++;
-    if (retryCount >= MAX_RETRY_COUNT) {
-        Serial.println("Max retry count reached. Will reset ESP32...");
-        delay(1000);
-        ESP.restart();
+    if (millis() - attemptStart < retryDelay) {
+        return false;
     }
     
+    Serial.printf("Failed to connect to %s\n", networks[currentNetwork].ssid);
+    if (!startNextNetwork()) {
+        // All configured networks failed this round
+        lastConnectionAttempt = millis();
+        roundFailed();
+    }
     return false;
 }
 
 bool WiFiManager::checkConnection() {
     if (WiFi.status() != WL_CONNECTED) {
+        if (isConnected) {
+            Serial.println("WiFi connection lost!");
+        }
         isConnected = false;
-        Serial.println("WiFi connection lost!");
+        discovery.cancel();
         return false;
     }
     return true;
@@ -109,77 +281,98 @@ bool WiFiManager::checkConnection() {
 void WiFiManager::disconnect() {
     WiFi.disconnect();
     isConnected = false;
+    discovery.cancel();
     Serial.println("WiFi disconnected");
 }
 
-IPAddress WiFiManager::getDefaultGateway() const {
-    tcpip_adapter_ip_info_t ip_info;
-    tcpip_adapter_get_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info);
-    return IPAddress(ip_info.gw.addr);
+void WiFiManager::setBroker(const uint8_t* address) {
+    memcpy(broker, address, sizeof(broker));
+    snprintf(brokerText, sizeof(brokerText), "%u.%u.%u.%u",
+             broker[0], broker[1], broker[2], broker[3]);
+    brokerKnown = true;
 }
 
-String WiFiManager::getCurrentMqttServer() const {
-    if (!isConnected) {
-        return String();
-    }
+// Picks up the broker the last search on this network found
+void WiFiManager::loadBroker() {
+    brokerNetwork = currentNetwork;
+    brokerKnown = false;
+    memset(broker, 0, sizeof(broker));
+    discovery.cancel();
+    discoveryFailedAt = 0;
     
-    if (networks[currentNetwork].mqtt_server != nullptr) {
-        return String(networks[currentNetwork].mqtt_server);
+    Preferences prefs;
+    if (!prefs.begin(LINK_NAMESPACE, true)) {
+        return;
     }
-    
-    // If no MQTT server specified, scan for one
-    String scannedServer = scanForMQTTServer();
-    if (scannedServer.length() > 0) {
-        Serial.printf("Found MQTT server at: %s\n", scannedServer.c_str());
-        return scannedServer;
+    uint8_t address[4];
+    if (prefs.getBytesLength(BROKER_KEYS[currentNetwork]) == sizeof(address) &&
+        prefs.getBytes(BROKER_KEYS[currentNetwork], address, sizeof(address)) == sizeof(address)) {
+        setBroker(address);
     }
-    
-    // If no server found, return gateway IP as fallback
-    return getDefaultGateway().toString();
+    prefs.end();
 }
 
-bool WiFiManager::testMQTTConnection(const IPAddress& ip) const {
-    WiFiClient testClient;
-    if (testClient.connect(ip, 1883, 1000)) {  // 1 second timeout
-        testClient.stop();
-        return true;
+void WiFiManager::saveBroker(const IPAddress& address) {
+    uint8_t bytes[4];
+    toBytes(address, bytes);
+    if (memcmp(bytes, broker, sizeof(bytes)) != 0) {
+        Preferences prefs;
+        if (prefs.begin(LINK_NAMESPACE, false)) {
+            prefs.putBytes(BROKER_KEYS[currentNetwork], bytes, sizeof(bytes));
+            prefs.end();
+        }
     }
-    return false;
+    setBroker(bytes);
 }
 
-String WiFiManager::scanForMQTTServer() const {
+const char* WiFiManager::brokerAddress() {
     if (!isConnected) {
-        return String();
+        return nullptr;
     }
-
-    // First try gateway IP
-    IPAddress gateway = getDefaultGateway();
-    if (testMQTTConnection(gateway)) {
-        return gateway.toString();
+    const char* configured = networks[currentNetwork].mqtt_server;
+    if (configured != nullptr && configured[0] != '\0') {
+        return configured;
+    }
+    if (brokerNetwork != currentNetwork) {
+        loadBroker();
+    }
+    if (brokerKnown) {
+        return brokerText;
     }
-
-    // Get our IP and subnet mask
-    IPAddress localIP = WiFi.localIP();
-    IPAddress subnet = WiFi.subnetMask();
     
-    // Calculate network address
-    IPAddress network(
-        localIP[0] & subnet[0],
-        localIP[1] & subnet[1],
-        localIP[2] & subnet[2],
-        localIP[3] & subnet[3]
-    );
-
-    // Scan first 20 addresses in the subnet
-    for (int i = 1; i <= 20; i++) {
-        IPAddress testIP(network[0], network[1], network[2], network[3] + i);
-        if (testIP != localIP) {  // Skip our own IP
-            Serial.printf("Testing IP: %s\n", testIP.toString().c_str());
-            if (testMQTTConnection(testIP)) {
-                return testIP.toString();
-            }
+    BrokerDiscovery::State state = discovery.step();
+    if (state == BrokerDiscovery::IDLE) {
+        if (discoveryFailedAt == 0 || millis() - discoveryFailedAt >= DISCOVERY_RETRY) {
+            Serial.println("Searching for an MQTT broker...");
+            discovery.start(WiFi.localIP(), WiFi.gatewayIP(), fromBytes(broker));
         }
+        return nullptr;
+    }
+    if (state == BrokerDiscovery::RUNNING) {
+        return nullptr;
     }
     
-    return String();
+    discoveryStats.searches++;
+    discoveryStats.lastMillis = (uint16_t)discovery.duration();
+    discoveryStats.lastProbes = discovery.probeCount();
+    if (state == BrokerDiscovery::FOUND) {
+        saveBroker(discovery.result());
+        Serial.printf("Found MQTT broker at %s in %lu ms\n", brokerText, discovery.duration());
+    } else {
+        Serial.printf("No MQTT broker found (%u hosts probed)\n", discovery.probeCount());
+        discoveryStats.failures++;
+        discoveryFailedAt = millis();
+    }
+    discovery.cancel();
+    return brokerKnown ? brokerText : nullptr;
+}
+
+void WiFiManager::brokerFailed() {
+    const char* configured = networks[currentNetwork].mqtt_server;
+    if ((configured != nullptr && configured[0] != '\0') || !brokerKnown) {
+        return;
+    }
+    // The address stays behind as the first candidate of the next search
+    brokerKnown = false;
+    discoveryFailedAt = 0;
 }
@@ -3,11 +3,46 @@
 
 #include <WiFi.h>
 #include "esp_wpa2.h"
+#include "BrokerDiscovery.h"
 
 class WiFiManager {
+public:
+    // Time-to-connect histogram buckets, upper bounds in ms; the last
+    // bucket takes everything slower
+    static const size_t CONNECT_BUCKETS = 6;
+    static const uint16_t CONNECT_LIMITS[CONNECT_BUCKETS - 1];
+
+    // Counts since boot, measured from the start of a connection round to
+    // the link coming up. A round that fell back from the fast path counts
+    // as full, including the time the fast attempt took.
+    struct ConnectStats {
+        uint16_t fast[CONNECT_BUCKETS];
+        uint16_t full[CONNECT_BUCKETS];
+        uint16_t fastFailed;
+    };
+
+    // Broker searches since boot; the last one's length and probe count
+    struct DiscoveryStats {
+        uint16_t searches;
+        uint16_t failures;
+        uint16_t lastMillis;
+        uint16_t lastProbes;
+    };
+
+    // Failed rounds before the ESP32 restarts; the delay bounds each
+    // attempt and separates the rounds
+    static const int DEFAULT_MAX_RETRIES = 3;
+    static const unsigned long DEFAULT_RETRY_DELAY = 5000;
+
 private:
-    static const int MAX_RETRY_COUNT = 3;
-    static const unsigned long RETRY_DELAY = 5000; // 5 seconds
+    static const unsigned long FAST_TIMEOUT = 1500; // directed join with a static lease
+    static const uint8_t LINK_CACHE_VERSION = 1;
+    // The cached lease is reused without asking DHCP; after this many fast
+    // joins a full one renews it before the router's lease can run out
+    static const int MAX_FAST_JOINS = 10;
+    // A network without a configured server searches again this long
+    // after a search came up empty
+    static const unsigned long DISCOVERY_RETRY = 30000;
     
     struct NetworkCredentials {
         const char* ssid;
@@ -17,20 +52,64 @@ private:
         bool isEnterprise;
     };
     
+    // The last good association and lease, kept in NVS so a reconnect,
+    // even after a restart, can skip the scan and DHCP
+    struct LinkCache {
+        uint8_t version;
+        uint8_t network;
+        uint8_t bssid[6];
+        int32_t channel;
+        uint8_t ip[4];
+        uint8_t gateway[4];
+        uint8_t subnet[4];
+        uint8_t dns[4];
+    };
+    
     NetworkCredentials networks[2];
     int currentNetwork;
     
+    LinkCache link;
+    bool linkLoaded;
+    bool linkValid;
+    bool fastAttempt;            // the attempt in progress uses the cache
+    int fastJoins;               // since the last full connect
+    unsigned long roundStart;
+    ConnectStats connectStats;
+    
+    // Broker found on the current network, or loaded from NVS where the
+    // last search on it left one
+    BrokerDiscovery discovery;
+    int brokerNetwork;           // network broker belongs to, -1 before any
+    uint8_t broker[4];
+    bool brokerKnown;            // false while a search replaces it
+    char brokerText[16];
+    unsigned long discoveryFailedAt;
+    DiscoveryStats discoveryStats;
+    
     bool isConnected;
     unsigned long lastConnectionAttempt;
     int retryCount;
+    int maxRetries;
+    unsigned long retryDelay;
+    void (*restartHook)() = nullptr;
+    
+    // Association in progress; connect() polls it instead of spinning
+    bool connecting;
+    unsigned long attemptStart;
+    int networksTried;
 
-    bool connectToNetwork(const NetworkCredentials& network);
+    void beginConnect(const NetworkCredentials& network, const LinkCache* hint);
+    bool startNextNetwork();
+    bool startFastConnect();
+    void loadLink();
+    void saveLink();
+    void recordConnect(bool fast, unsigned long millis);
+    void loadBroker();
+    void saveBroker(const IPAddress& address);
+    void setBroker(const uint8_t* address);
+    void roundFailed();
     void resetConnectionStatus();
 
-    IPAddress getDefaultGateway() const;
-
-    bool testMQTTConnection(const IPAddress& ip) const;
-
 public:
     WiFiManager();
     
@@ -39,16 +118,29 @@ public:
     void addRegularNetwork(int index, const char* ssid, const char* password, 
                           const char* mqtt_server);
     
+    // Non-blocking: starts or advances a connection attempt and returns
+    // true once connected. Call it repeatedly from the main loop.
     bool connect();
+    void setRetryPolicy(int rounds, unsigned long delayMillis);
+    // Called right before the retry limit restarts the ESP32
+    void setRestartHook(void (*hook)()) { restartHook = hook; }
     bool checkConnection();
     void disconnect();
     
     bool isWiFiConnected() const { return isConnected; }
+    const ConnectStats& getConnectStats() const { return connectStats; }
+    const DiscoveryStats& getDiscoveryStats() const { return discoveryStats; }
     String getCurrentSSID() const { return WiFi.SSID(); }
     int getRSSI() const { return WiFi.RSSI(); }
     IPAddress getLocalIP() const { return WiFi.localIP(); }
-    String getCurrentMqttServer() const;
-    String scanForMQTTServer() const;
+    
+    // The broker for the current network: its configured server, else the
+    // one a search found. nullptr while none is known; each call advances
+    // the search, so keep calling it.
+    const char* brokerAddress();
+    // The found broker did not take a connection; search again, trying it
+    // first. Does nothing for a configured server.
+    void brokerFailed();
 };
 
 #endif
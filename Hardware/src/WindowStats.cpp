@@ -0,0 +1,104 @@
+#include "WindowStats.h"
+#include "TelemetrySerializer.h"
+#include "JsonWriter.h"
+#include <math.h>
+
+WindowStats::WindowStats()
+    : fieldMask(0)
+    , windowMillis(DEFAULT_WINDOW)
+    , windowStart(0)
+    , startTimestamp(0)
+{
+    reset(0, 0);
+}
+
+void WindowStats::setFields(uint32_t mask) {
+    // Fields that were not collected so far start from scratch
+    uint32_t added = mask & ~fieldMask;
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++) {
+        if (added & (1UL << i)) {
+            fields[i] = Accumulator();
+        }
+    }
+    fieldMask = mask;
+}
+
+void WindowStats::setWindow(unsigned long periodMillis) {
+    windowMillis = periodMillis < MIN_WINDOW ? MIN_WINDOW : periodMillis;
+}
+
+void WindowStats::add(const SensorData& data) {
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++) {
+        if (!(fieldMask & (1UL << i))) {
+            continue;
+        }
+        const TelemetryField& field = TelemetrySerializer::FIELDS[i];
+        if (!(data.validMask & (1 << field.channel))) {
+            continue;
+        }
+        float x = TelemetrySerializer::numericValue(field, data);
+        if (isnan(x)) {
+            continue;
+        }
+
+        Accumulator& acc = fields[i];
+        if (acc.count == 0) {
+            acc.min = x;
+            acc.max = x;
+        } else {
+            if (x < acc.min) acc.min = x;
+            if (x > acc.max) acc.max = x;
+        }
+        acc.count++;
+        double delta = x - acc.mean;
+        acc.mean += delta / acc.count;
+        acc.m2 += delta * (x - acc.mean);
+    }
+}
+
+WindowStats::Summary WindowStats::summary(size_t field) const {
+    const Accumulator& acc = fields[field];
+    Summary s;
+    s.count = acc.count;
+    s.min = acc.min;
+    s.max = acc.max;
+    s.mean = (float)acc.mean;
+    s.stddev = acc.count > 1 ? (float)sqrt(acc.m2 / (acc.count - 1)) : 0.0f;
+    return s;
+}
+
+void WindowStats::reset(unsigned long now, uint32_t timestamp) {
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++) {
+        fields[i] = Accumulator();
+    }
+    windowStart = now;
+    startTimestamp = timestamp;
+}
+
+size_t WindowStats::serialize(uint32_t endTimestamp, char* buffer, size_t size) const {
+    JsonWriter json(buffer, size);
+    json.beginObject();
+    json.key("start");
+    json.value(startTimestamp);
+    json.key("end");
+    json.value(endTimestamp);
+    json.key("stats");
+    json.beginObject();
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++) {
+        if (!(fieldMask & (1UL << i)) || fields[i].count == 0) {
+            continue;
+        }
+        Summary s = summary(i);
+        json.key(TelemetrySerializer::FIELDS[i].key);
+        json.beginArray();
+        json.value(s.count);
+        json.value(s.min);
+        json.value(s.max);
+        json.value(s.mean);
+        json.value(s.stddev, 3);
+        json.endArray();
+    }
+    json.endObject();
+    json.endObject();
+    return json.ok() ? json.length() : 0;
+}
@@ -0,0 +1,65 @@
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+
+// Per-field min/max/mean/stddev over a time window, for the fields that are
+// summarised instead of sent raw. Constant memory and no allocation: each
+// field keeps a running count, extremes and Welford mean/M2, so a window of
+// any length costs the same. Only fresh readings (validMask) are counted.
+class WindowStats {
+public:
+    static const unsigned long DEFAULT_WINDOW = 300000;  // 5 min
+    static const unsigned long MIN_WINDOW = 10000;
+
+    struct Summary {
+        uint32_t count;
+        float min;
+        float max;
+        float mean;
+        float stddev;   // sample standard deviation, 0 below two readings
+    };
+
+private:
+    struct Accumulator {
+        uint32_t count;
+        float min;
+        float max;
+        double mean;
+        double m2;      // sum of squared deviations from the mean
+    };
+
+    Accumulator fields[SENSOR_FIELD_COUNT];
+    uint32_t fieldMask;
+    unsigned long windowMillis;
+    unsigned long windowStart;
+    uint32_t startTimestamp;
+
+public:
+    WindowStats();
+
+    // Bit n selects TelemetrySerializer::FIELDS[n]; 0 turns summaries off
+    void setFields(uint32_t mask);
+    uint32_t getFields() const { return fieldMask; }
+    bool enabled() const { return fieldMask != 0; }
+
+    void setWindow(unsigned long periodMillis);
+    unsigned long getWindow() const { return windowMillis; }
+
+    void add(const SensorData& data);
+    Summary summary(size_t field) const;
+
+    bool due(unsigned long now) const { return now - windowStart >= windowMillis; }
+
+    // Starts a new, empty window; timestamp is Unix time or 0
+    void reset(unsigned long now, uint32_t timestamp);
+
+    // {"start":..,"end":..,"stats":{"<key>":[count,min,max,mean,stddev],...}}
+    // for the selected fields with at least one reading. Returns the
+    // length, or 0 if the buffer is too small.
+    size_t serialize(uint32_t endTimestamp, char* buffer, size_t size) const;
+};
+
+#endif
@@ -3,50 +3,429 @@
 #include "LEDManager.h"
 #include "secrets.h"
 #include "SerialLogger.h"
+#include "SampleStore.h"
+#include "Scheduler.h"
+#include "SpscQueue.h"
+#include "WindowStats.h"
+#include "DeadbandFilter.h"
+#include "PowerManager.h"
+#include "AlertEngine.h"
+#include "OtaUpdater.h"
+#include "ConfigStore.h"
 #include <ArduinoJson.h>
+#include <sys/time.h>
 
-// Pin definitions
-#define LED_PIN 2
-#define DHTPIN 4
-#define MQ8_PIN 34
-#define RX_PIN 16
-#define TX_PIN 17
-#define SDS_RX_PIN 25
-#define SDS_TX_PIN 26
+// MQTT topic root; each node publishes under "<root>/<device id>"
+const char* TOPIC_ROOT = "/home/sensors";
 
-// MQTT Topics
-const char* COMMAND_TOPIC = "/home/sensors/command";
-const char* STATUS_TOPIC = "/home/sensors/status";
-const char* LOG_TOPIC = "/home/sensors/logs";
+// Settings that survive a restart, pins included; commands change them
+// through config and every module reads the active ones
+ConfigStore config;
+const DeviceConfig& settings = config.get();
 
 // Create managers
-SensorManager sensors(DHTPIN, MQ8_PIN, RX_PIN, TX_PIN, SDS_RX_PIN, SDS_TX_PIN);
+SensorManager sensors;
 WiFiManager wifiManager;
-MQTTManager mqtt(wifiManager, "/home/sensors");
-LEDManager led(LED_PIN);
-SerialLogger logger(mqtt, LOG_TOPIC);
+MQTTManager mqtt(wifiManager, TOPIC_ROOT);
+LEDManager led;
+SerialLogger logger(mqtt, mqtt.topic(MQTTManager::TOPIC_LOGS));
+SampleStore sampleStore;
+Scheduler scheduler;
+WindowStats windowStats;   // fields summarised per window instead of sent raw
+DeadbandFilter deadband;   // report-by-exception on the live topic
+PowerManager power;
+AlertEngine alerts;
+OtaUpdater ota;
+
+// Samples handed from the acquisition task (core 0) to the network side (core 1)
+struct AcquiredSample {
+    uint64_t takenAt;      // Unix time in ms, 0 before SNTP; seconds are the timestamp
+    SensorData data;
+};
+SpscQueue<AcquiredSample, 16> acquired;
+
+// Alert events waiting for their own publish; never batched. Only the
+// network side (core 1) touches it.
+SpscQueue<AlertEngine::Event, 8> alertEvents;
+
+// Finished radar tracks, same handoff; they are large, so only a couple wait
+struct AcquiredTrack {
+    uint32_t endTimestamp;
+    RadarTrack track;
+};
+SpscQueue<AcquiredTrack, 2> radarTracks;
+TaskHandle_t acquisitionHandle = nullptr;
 
 // Device state
-bool deviceEnabled = true;
-unsigned long statusInterval = 30000; // Status update every 30 seconds
 unsigned long lastStatusUpdate = 0;
-bool loggingEnabled = true;
+uint32_t latestSeq = 0;       // Sequence number of the newest sample
+bool online = false;          // WiFi and MQTT both up
+unsigned long lastMqttAttempt = 0;
+int statusTaskId = -1;
+bool configUnsent = false;    // <device>/config does not show the active settings yet
+OtaUpdater::State otaReported = OtaUpdater::IDLE;   // last state sent on the OTA topic
+OtaUpdater::Trial otaTrialReported = OtaUpdater::TRIAL_NONE;
+unsigned long otaReportedAt = 0;
+
+// Low-power mode: a wake that only came up to upload the RTC ring leaves
+// the sensors and the acquisition task off
+bool uploadWake = false;
+unsigned long sleepModeSince = 0;  // when this boot started heading for sleep
+unsigned long onlineSince = 0;
+unsigned long statusSentAt = 0;    // final status of the wake, 0 if not yet sent
+
+// Batch mode: up to settings.batchSamples samples per message on
+// <device>/batch, sent once that many are queued or the oldest has waited
+// settings.batchWindow. 0 or 1 keeps one publish per sample.
+unsigned long batchStarted = 0;   // when the first unsent sample was queued
+bool alertPending = false;        // a sample that raised an alert is waiting
+
+// Task periods and run-time budgets
+const unsigned long NETWORK_PERIOD = 10;       // ms, bounds MQTT keep-alive/command latency
+const unsigned long LED_PERIOD = 10;
+const unsigned long SENSOR_PERIOD = 20;        // finest per-sensor rate resolution
+const unsigned long SAMPLE_PERIOD = 2000;
+const unsigned long DRAIN_PERIOD = 50;
+const unsigned long LOG_PERIOD = 100;
+const unsigned long UPLOAD_PERIOD = 500;
+const unsigned long STATS_PERIOD = 1000;
+const unsigned long RADAR_PERIOD = 200;
+const unsigned long POWER_PERIOD = 100;
+const unsigned long OTA_PERIOD = 20;           // a flash chunk per pass while updating
+const unsigned long OTA_REPORT_PERIOD = 2000;  // progress messages during a download
+const unsigned long OTA_RESTART_DELAY = 1000;  // for the "ready" report to leave
+const unsigned long COMMAND_WINDOW = 2000;     // ms online before sleeping, for commands
+const unsigned long SLEEP_FLUSH = 200;         // ms for the last publishes to leave
+const unsigned long MAX_UPLOAD_AWAKE = 30000;  // give up on the upload and sleep
+const unsigned long MAX_IDLE = 10;             // ms the loop may sleep between passes
+
+// Unix time once NTP has synced, 0 before that
+// Unix time in ms, or 0 while SNTP has not set the clock. Unlike millis()
+// it carries on across deep sleep.
+uint64_t currentEpochMillis() {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    return now.tv_sec > 1600000000 ? (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000 : 0;
+}
+
+uint32_t currentTimestamp() {
+    return (uint32_t)(currentEpochMillis() / 1000);
+}
+
+// {"rates": {"radar": 100, "sds011": 600000, "sds011_on": 30000, ...}} in ms
+void applyRates(JsonObject rates, DeviceConfig& pending) {
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        const char* name = SensorManager::CHANNEL_NAMES[i];
+        if (rates.containsKey(name)) {
+            pending.periods[i] = rates[name].as<uint32_t>();
+        }
+    }
+    if (rates.containsKey("sds011_on")) {
+        pending.sdsOnTime = rates["sds011_on"].as<uint32_t>();
+    }
+}
+
+// {"batch": {"samples": 10, "seconds": 60}}; samples 0 turns batching off
+void applyBatch(JsonObject batch, DeviceConfig& pending) {
+    if (batch.containsKey("samples")) {
+        size_t samples = batch["samples"].as<unsigned int>();
+        pending.batchSamples = samples < SampleStore::MAX_BATCH ? samples : SampleStore::MAX_BATCH;
+    }
+    if (batch.containsKey("seconds")) {
+        uint32_t seconds = batch["seconds"].as<uint32_t>();
+        pending.batchWindow = seconds > 0 ? seconds : 1;
+    }
+}
+
+// {"stats": {"window": 300, "fields": ["soil_moisture", "pm25"]}}; window in
+// seconds, an empty field list sends everything raw again
+void applyStats(JsonObject stats, DeviceConfig& pending) {
+    if (stats.containsKey("window")) {
+        pending.statsWindow = stats["window"].as<uint32_t>();
+    }
+    if (stats.containsKey("fields")) {
+        uint32_t mask = 0;
+        for (JsonVariant key : stats["fields"].as<JsonArray>()) {
+            int index = TelemetrySerializer::fieldIndex(key.as<const char*>());
+            if (index < 0) {
+                LOG_WARN("Unknown stats field: %s", key.as<const char*>());
+                continue;
+            }
+            mask |= 1UL << index;
+        }
+        pending.statsFields = mask;
+    }
+}
+
+// {"deadband": {"enable": true, "keyframe": 300, "fields": {"pm25": [1.0, 600]}}};
+// per field [delta, heartbeat in s], keyframe interval in s
+void applyDeadband(JsonObject request, DeviceConfig& pending) {
+    if (request.containsKey("enable")) {
+        pending.deadband = request["enable"].as<bool>();
+    }
+    if (request.containsKey("keyframe")) {
+        pending.keyframe = request["keyframe"].as<uint32_t>();
+    }
+    if (request.containsKey("fields")) {
+        for (JsonPair entry : request["fields"].as<JsonObject>()) {
+            int index = TelemetrySerializer::fieldIndex(entry.key().c_str());
+            JsonArray values = entry.value().as<JsonArray>();
+            uint32_t heartbeat = values[1].as<uint32_t>();
+            DeadbandFilter::Policy policy;
+            policy.delta = values[0].as<float>();
+            policy.heartbeatMillis = heartbeat * 1000;
+            if (index < 0 || values.size() != 2 || heartbeat > DeadbandFilter::MAX_HEARTBEAT / 1000 ||
+                !DeadbandFilter::isValid(policy)) {
+                char reason[48];
+                snprintf(reason, sizeof(reason), "bad deadband field %s", entry.key().c_str());
+                config.reject(reason);
+                return;
+            }
+            pending.deadbandPolicies[index] = policy;
+        }
+    }
+}
+
+// {"power": {"mode": "sleep", "interval": 60, "upload_every": 15}}, in s
+void applyPower(JsonObject request, DeviceConfig& pending) {
+    if (request.containsKey("interval")) {
+        pending.sleepInterval = request["interval"].as<uint32_t>();
+    }
+    if (request.containsKey("upload_every")) {
+        pending.uploadEvery = request["upload_every"].as<uint16_t>();
+    }
+    if (request.containsKey("mode")) {
+        const char* mode = request["mode"].as<const char*>();
+        if (mode != nullptr && strcmp(mode, "sleep") == 0) {
+            pending.sleep = true;
+        } else if (mode != nullptr && strcmp(mode, "continuous") == 0) {
+            pending.sleep = false;
+        } else {
+            LOG_WARN("Power mode must be \"sleep\" or \"continuous\"");
+        }
+    }
+}
+
+// {"alerts": [["co2", "above", 2000], ["hydrogen_raw", "anomaly", 6, 0.05]]}
+// replaces the rule table; per rule [field, kind, limit, EWMA weight for
+// "anomaly"]. {"alerts": "default"} restores the built-in thresholds.
+void applyAlerts(JsonVariant rules, DeviceConfig& pending) {
+    if (rules.is<const char*>() && strcmp(rules.as<const char*>(), "default") == 0) {
+        memset(pending.alertRules, 0, sizeof(pending.alertRules));
+        pending.alertCount = (uint8_t)AlertEngine::defaultRules(pending.alertRules, AlertEngine::MAX_RULES);
+        return;
+    }
+    if (!rules.is<JsonArray>() || rules.size() > AlertEngine::MAX_RULES) {
+        config.reject("alerts must be \"default\" or up to 16 rules");
+        return;
+    }
+    memset(pending.alertRules, 0, sizeof(pending.alertRules));
+    pending.alertCount = 0;
+    for (JsonVariant entry : rules.as<JsonArray>()) {
+        AlertEngine::Rule& rule = pending.alertRules[pending.alertCount];
+        const char* field = entry[0].as<const char*>();
+        int index = field != nullptr ? TelemetrySerializer::fieldIndex(field) : -1;
+        rule.field = (uint8_t)index;
+        rule.limit = entry[2].as<float>();
+        rule.alpha = entry.size() > 3 ? entry[3].as<float>() : 0.0f;
+        if (index < 0 || entry.size() < 3 || !AlertEngine::parseKind(entry[1].as<const char*>(), rule.kind) ||
+            !AlertEngine::isValid(rule)) {
+            char reason[48];
+            snprintf(reason, sizeof(reason), "bad alert rule %s", field != nullptr ? field : "?");
+            config.reject(reason);
+            return;
+        }
+        pending.alertCount++;
+    }
+}
+
+// Runs the alert rules on a sample and queues its events; true if one was raised
+bool evaluateAlerts(const SensorData& data, uint64_t takenAt) {
+    AlertEngine::Event events[AlertEngine::MAX_RULES];
+    size_t count = alerts.evaluate(data, takenAt, events, AlertEngine::MAX_RULES);
+    bool raised = false;
+    for (size_t i = 0; i < count; i++) {
+        alertEvents.push(events[i]);
+        raised |= events[i].raised;
+    }
+    return raised;
+}
+
+// {"config": {"rate_dht": 5000, "mqtt_port": 1884}} sets fields by their
+// key in the schema; {"config": "defaults"} restores every default
+void applySettings(JsonVariant request, DeviceConfig& pending) {
+    if (request.is<const char*>()) {
+        if (strcmp(request.as<const char*>(), "defaults") == 0) {
+            config.restoreDefaults();
+        } else {
+            config.reject("config must be an object or \"defaults\"");
+        }
+        return;
+    }
+    for (JsonPair entry : request.as<JsonObject>()) {
+        JsonVariant value = entry.value();
+        if (value.is<bool>()) {
+            config.set(entry.key().c_str(), value.as<bool>() ? 1 : 0);
+        } else if (value.is<uint32_t>()) {
+            config.set(entry.key().c_str(), value.as<uint32_t>());
+        } else {
+            config.reject("config values must be numbers or booleans");
+        }
+    }
+}
+
+// Hands the active settings to the modules that own them; previous is what
+// was active before, nullptr at boot. Pins are only read at boot.
+void applyConfig(const DeviceConfig* previous) {
+    scheduler.setPeriod(statusTaskId, settings.statusInterval * 1000);
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        sensors.setPeriod((SensorChannel)i, settings.periods[i]);
+    }
+    sensors.setSdsOnTime(settings.sdsOnTime);
+    sensors.setRadarBurst(settings.radarBurst);
+    
+    windowStats.setWindow(settings.statsWindow * 1000);
+    if (previous == nullptr || previous->statsFields != settings.statsFields) {
+        if (!windowStats.enabled() && settings.statsFields != 0) {
+            windowStats.reset(millis(), currentTimestamp());
+        }
+        windowStats.setFields(settings.statsFields);
+        mqtt.setFieldMask(TelemetrySerializer::ALL_FIELDS & ~settings.statsFields);
+    }
+    deadband.setEnabled(settings.deadband);
+    deadband.setKeyframeInterval(settings.keyframe * 1000);
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++) {
+        deadband.setPolicy(i, settings.deadbandPolicies[i]);
+    }
+    alerts.setRules(settings.alertRules, settings.alertCount);
+    
+    power.setInterval(settings.sleepInterval * 1000);
+    power.setUploadEvery(settings.uploadEvery);
+    power.setMode(settings.sleep ? PowerManager::POWER_SLEEP : PowerManager::POWER_CONTINUOUS);
+    
+    mqtt.configure(settings.mqttPort, settings.mqttBuffer);
+    wifiManager.setRetryPolicy(settings.wifiRetries, settings.wifiRetryDelay);
+    
+    if (previous == nullptr) {
+        return;
+    }
+    if (previous->ledPin != settings.ledPin || previous->dhtPin != settings.dhtPin ||
+        previous->mq8Pin != settings.mq8Pin || previous->radarRxPin != settings.radarRxPin ||
+        previous->radarTxPin != settings.radarTxPin || previous->sdsRxPin != settings.sdsRxPin ||
+        previous->sdsTxPin != settings.sdsTxPin) {
+        LOG_INFO("New pins take effect after a restart");
+    }
+    // An upload wake leaving SLEEP mode restarts to bring the sensors up
+    if (previous->sleep && !settings.sleep && uploadWake) {
+        sampleStore.persist();
+        ESP.restart();
+    }
+}
+
+// {"ota": {"url": "http://192.168.1.5:8000/fw.bin", "sha256": "<hex>"}}
+// fetches a full image or a delta patch; the SHA-256 is of the image it
+// produces. {"ota": "cancel"} stops a download.
+bool isOtaCancel(JsonVariant request) {
+    return request.is<const char*>() && strcmp(request.as<const char*>(), "cancel") == 0;
+}
+
+// Turns down a request that cannot start, before anything else in the
+// command takes effect
+void checkOta(JsonVariant request) {
+    if (!isOtaCancel(request) &&
+        !ota.check(request["url"].as<const char*>(), request["sha256"].as<const char*>())) {
+        config.reject(ota.lastError());
+    }
+}
+
+void applyOta(JsonVariant request) {
+    if (isOtaCancel(request)) {
+        ota.cancel();
+        return;
+    }
+    if (!ota.start(request["url"].as<const char*>(), request["sha256"].as<const char*>())) {
+        LOG_WARN("OTA not started: %s", ota.lastError());
+    }
+}
 
 void handleCommand(const char* payload) {
-    StaticJsonDocument<200> doc;
+    StaticJsonDocument<1024> doc;   // room for a full alert rule table
     DeserializationError error = deserializeJson(doc, payload);
     
     if (error) {
-        logger.println("Failed to parse command");
+        LOG_WARN("Failed to parse command: %s", error.c_str());
         return;
     }
     
+    // Settings collect in the pending copy and are committed together below;
+    // actions wait for the commit, so a rejected command changes nothing
+    DeviceConfig& pending = config.edit();
+    
     if (doc.containsKey("enable")) {
-        deviceEnabled = doc["enable"].as<bool>();
+        pending.enabled = doc["enable"].as<bool>();
     }
     
     if (doc.containsKey("interval")) {
-        statusInterval = doc["interval"].as<unsigned long>() * 1000; // Convert to milliseconds
+        pending.statusInterval = doc["interval"].as<uint32_t>();  // seconds
+    }
+    
+    if (doc.containsKey("logging")) {
+        pending.logging = doc["logging"].as<bool>();
+    }
+    
+    if (doc.containsKey("binary")) {
+        pending.binary = doc["binary"].as<bool>();
+    }
+    
+    if (doc.containsKey("rates")) {
+        applyRates(doc["rates"].as<JsonObject>(), pending);
+    }
+    
+    if (doc.containsKey("batch")) {
+        applyBatch(doc["batch"].as<JsonObject>(), pending);
+    }
+    
+    if (doc.containsKey("stats")) {
+        applyStats(doc["stats"].as<JsonObject>(), pending);
+    }
+    
+    if (doc.containsKey("deadband")) {
+        applyDeadband(doc["deadband"].as<JsonObject>(), pending);
+    }
+    
+    if (doc.containsKey("radar_burst")) {
+        pending.radarBurst = doc["radar_burst"].as<bool>();
+    }
+    
+    if (doc.containsKey("power")) {
+        applyPower(doc["power"].as<JsonObject>(), pending);
+    }
+    
+    if (doc.containsKey("config")) {
+        applySettings(doc["config"], pending);
+    }
+    
+    if (doc.containsKey("alerts")) {
+        applyAlerts(doc["alerts"], pending);
+    }
+    
+    if (doc.containsKey("ota")) {
+        checkOta(doc["ota"]);
+    }
+    
+    DeviceConfig previous = settings;
+    uint32_t generation = config.getGeneration();
+    if (!config.commit()) {
+        LOG_WARN("Command rejected: %s", config.lastError());
+        return;
+    }
+    
+    if (config.getGeneration() != generation) {
+        if (previous.logging != settings.logging) {
+            LOG_INFO("%s", settings.logging ? "Logging enabled" : "Logging disabled");
+        }
+        applyConfig(&previous);
+        configUnsent = true;
     }
     
     if (doc.containsKey("led")) {
@@ -54,97 +433,553 @@ void handleCommand(const char* payload) {
         led.blink(blinkCount);
     }
     
-    if (doc.containsKey("logging")) {
-        loggingEnabled = doc["logging"].as<bool>();
-        logger.println(loggingEnabled ? "Logging enabled" : "Logging disabled");
+    if (doc.containsKey("ota")) {
+        applyOta(doc["ota"]);
     }
 }
 
 void publishStatus() {
-    StaticJsonDocument<200> doc;
-    doc["enabled"] = deviceEnabled;
-    doc["interval"] = statusInterval / 1000;
+    // Static: the document has outgrown what the loop task's stack should hold
+    static StaticJsonDocument<3072> doc;
+    doc.clear();
+    doc["enabled"] = (bool)settings.enabled;
+    doc["interval"] = settings.statusInterval;
+    doc["binary"] = (bool)settings.binary;
+    
+    // Stored settings (in full on <device>/config): [schema version,
+    // generation, changes rejected, failed writes]
+    const ConfigStore::Stats& configStats = config.getStats();
+    JsonArray stored = doc.createNestedArray("config");
+    stored.add(ConfigStore::VERSION);
+    stored.add(config.getGeneration());
+    stored.add(configStats.rejected);
+    stored.add(configStats.writeFailures);
+    
+    // Batch mode: [samples per message, window in s]
+    JsonArray batch = doc.createNestedArray("batch");
+    batch.add(settings.batchSamples);
+    batch.add(settings.batchWindow);
+    
+    // Window statistics: [window in s, summarised field mask]
+    JsonArray stats = doc.createNestedArray("stats");
+    stats.add(windowStats.getWindow() / 1000);
+    stats.add(windowStats.getFields());
+    
+    // Report-by-exception: [enabled, keyframe interval in s, fields sampled per field sent]
+    JsonArray rbe = doc.createNestedArray("deadband");
+    rbe.add(deadband.isEnabled());
+    rbe.add(deadband.getKeyframeInterval() / 1000);
+    rbe.add(deadband.compressionRatio());
     doc["wifi_strength"] = WiFi.RSSI();
+    
+    // Power: [sleep mode, duty cycle %, average wake ms, samples per radio-on s]
+    JsonArray energy = doc.createNestedArray("power");
+    energy.add(power.getMode() == PowerManager::POWER_SLEEP);
+    energy.add(power.dutyCycle());
+    energy.add(power.averageWakeMillis());
+    energy.add(power.samplesPerRadioSecond());
+    
+    // Time to connect, counts per bucket (<=250, 500, 1000, 2000, 5000 ms, slower)
+    const WiFiManager::ConnectStats& connects = wifiManager.getConnectStats();
+    JsonObject link = doc.createNestedObject("connect");
+    JsonArray fast = link.createNestedArray("fast");
+    JsonArray full = link.createNestedArray("full");
+    for (size_t i = 0; i < WiFiManager::CONNECT_BUCKETS; i++) {
+        fast.add(connects.fast[i]);
+        full.add(connects.full[i]);
+    }
+    link["fast_failed"] = connects.fastFailed;
+    
+    // Broker search: [searches, failed, last search ms, hosts it probed]
+    const WiFiManager::DiscoveryStats& discovery = wifiManager.getDiscoveryStats();
+    JsonArray search = doc.createNestedArray("broker");
+    search.add(discovery.searches);
+    search.add(discovery.failures);
+    search.add(discovery.lastMillis);
+    search.add(discovery.lastProbes);
     doc["uptime"] = millis() / 1000;
+    doc["queued"] = sampleStore.size();
+    doc["dropped"] = sampleStore.droppedCount();
+    doc["log_dropped"] = logger.droppedCount();
+    
+    // Alert rules: [rules, samples evaluated, alerts raised, events dropped]
+    const AlertEngine::Stats& alertStats = alerts.getStats();
+    JsonArray rules = doc.createNestedArray("alerts");
+    rules.add(alerts.ruleCount());
+    rules.add(alertStats.evaluated);
+    rules.add(alertStats.raised);
+    rules.add(alertEvents.dropCount());
+    
+    // Firmware update: [state, trial, image bytes written, image size, kB/s]
+    const OtaUpdater::Progress& update = ota.getProgress();
+    JsonArray firmware = doc.createNestedArray("ota");
+    firmware.add((int)ota.getState());
+    firmware.add((int)ota.getTrial());
+    firmware.add(update.written);
+    firmware.add(update.total);
+    firmware.add(ota.throughput());
+    
+    // Acquisition queue: [high-water mark, dropped samples]
+    JsonArray queue = doc.createNestedArray("acq");
+    queue.add(acquired.highWaterMark());
+    queue.add(acquired.dropCount());
     
-    char status[200];
+    // Radar burst capture: [enabled, tracks overwritten, tracks dropped at the queue]
+    JsonArray radar = doc.createNestedArray("radar");
+    radar.add(sensors.isRadarBurst());
+    radar.add(sensors.droppedTracks());
+    radar.add(radarTracks.dropCount());
+    
+    // Sensor poll periods in ms, in SensorChannel order, then the SDS011 on-time
+    JsonArray rates = doc.createNestedArray("rates");
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        rates.add(sensors.getPeriod((SensorChannel)i));
+    }
+    rates.add(sensors.getSdsOnTime());
+    
+    // SDS011: [duty-cycle state, valid frames, rejected frames]
+    JsonArray sds = doc.createNestedArray("sds");
+    sds.add((int)sensors.getSdsState());
+    sds.add(sensors.getSdsParser().frameCount());
+    sds.add(sensors.getSdsParser().badFrameCount());
+    
+    // Readings rejected by conditioning, in SensorChannel order
+    JsonArray faults = doc.createNestedArray("faults");
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        faults.add(sensors.faultCount((SensorChannel)i));
+    }
+    
+    // I2C queue: [completed, failed, timed out, longest sweep in us]
+    const I2cBus::Stats& bus = sensors.getI2cStats();
+    JsonArray i2c = doc.createNestedArray("i2c");
+    i2c.add(bus.completed);
+    i2c.add(bus.failed);
+    i2c.add(bus.timeouts);
+    i2c.add(bus.maxServiceMicros);
+    
+    // Per task since the last report: [runs, avg us, max us, overruns, max late ms]
+    JsonObject tasks = doc.createNestedObject("tasks");
+    for (size_t i = 0; i < scheduler.count(); i++) {
+        const Scheduler::TaskStats& stats = scheduler.stats(i);
+        JsonArray entry = tasks.createNestedArray(scheduler.name(i));
+        entry.add(stats.runs);
+        entry.add(stats.runs ? stats.totalMicros / stats.runs : 0);
+        entry.add(stats.maxMicros);
+        entry.add(stats.overruns);
+        entry.add(stats.maxLateMillis);
+    }
+    scheduler.resetStats();
+    
+    static char status[1536];
     serializeJson(doc, status);
-    mqtt.publish(STATUS_TOPIC, status);
+    mqtt.publish(mqtt.topic(MQTTManager::TOPIC_STATUS), status);
 }
 
-void setup() {
-    Serial.begin(115200);
-    while (!Serial) delay(10);
+// Retains the active settings on <device>/config, in the form a
+// {"config": ...} command takes
+bool publishConfig() {
+    static char payload[1024];
+    if (config.serialize(payload, sizeof(payload)) == 0) {
+        LOG_ERROR("Config exceeds %u bytes", (unsigned)sizeof(payload));
+        return true;  // would not fit next time either
+    }
+    return mqtt.publish(mqtt.topic(MQTTManager::TOPIC_CONFIG), payload, true);
+}
+
+// Advances the WiFi/MQTT link state machines and services the MQTT client.
+// Each step is non-blocking apart from the bounded MQTT connect itself.
+void networkTask() {
+    wifiManager.checkConnection();
+    if (!wifiManager.connect()) {
+        online = false;
+        return;
+    }
+
+    if (mqtt.isConnected()) {
+        mqtt.loop();
+        online = true;
+        if (configUnsent) {
+            configUnsent = !publishConfig();
+        }
+        return;
+    }
+
+    online = false;
+    // Without a configured server this runs the broker search, a step per call
+    if (wifiManager.brokerAddress() == nullptr) {
+        return;
+    }
+    if (millis() - lastMqttAttempt < settings.mqttRetryDelay) {
+        return;
+    }
+    lastMqttAttempt = millis();
+    LOG_INFO("Attempting to reconnect MQTT...");
+    online = mqtt.connect();
+    if (online) {
+        deadband.forceKeyframe();
+        configUnsent = true;
+    }
+}
+
+void ledTask() {
+    led.update();
+}
+
+// Runs pinned to core 0: polls whichever sensors are due at their own rates
+// and hands a snapshot to core 1 every SAMPLE_PERIOD. Slow I2C/UART reads
+// here never hold up the MQTT client. Touches nothing but the sensors and
+// the queue.
+void acquisitionTask(void*) {
+    TickType_t lastWake = xTaskGetTickCount();
+    unsigned long lastSample = millis() - SAMPLE_PERIOD;
     
-    // Initialize WiFiManager
-    wifiManager.addEnterpriseNetwork(0, ssid1, password1, identity1, mqtt_server1);
-    wifiManager.addRegularNetwork(1, ssid2, password2, mqtt_server2);
+    for (;;) {
+        sensors.update();
+        
+        unsigned long now = millis();
+        if (now - lastSample >= SAMPLE_PERIOD) {
+            lastSample = now;
+            if (settings.enabled) {
+                AcquiredSample sample = { currentEpochMillis(), sensors.snapshot() };
+                acquired.push(sample);  // full queue counts a drop, never blocks
+            }
+        }
+        
+        static AcquiredTrack finished;
+        if (sensors.takeTrack(finished.track) && settings.enabled) {
+            // The track ends at its last detection, TRACK_HOLD or more before
+            // it is collected here
+            uint64_t epochMillis = currentEpochMillis();
+            unsigned long sinceEnd = millis() - finished.track.lastSeenMillis();
+            finished.endTimestamp = epochMillis > sinceEnd ? (uint32_t)((epochMillis - sinceEnd) / 1000) : 0;
+            radarTracks.push(finished);
+        }
+        
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(SENSOR_PERIOD));
+    }
+}
+
+// Publishes queued alert events, oldest first. An event leaves the queue
+// only once its publish went through.
+void publishAlerts() {
+    char payload[256];
+    while (online) {
+        AlertEngine::Event* next = alertEvents.front();
+        if (next == nullptr) {
+            return;
+        }
+        if (AlertEngine::serialize(*next, payload, sizeof(payload)) == 0) {
+            LOG_ERROR("Alert event exceeds %u bytes", (unsigned)sizeof(payload));
+        } else if (!mqtt.publish(mqtt.topic(MQTTManager::TOPIC_ALERT), payload)) {
+            return;
+        }
+        alertEvents.popFront();
+    }
+}
+
+// Moves acquired samples into the store; it keeps them even while offline.
+// Alerts they raise go out right away, ahead of any batching.
+void drainTask() {
+    AcquiredSample sample;
+    while (acquired.pop(sample)) {
+        sensors.printReadings(sample.data);
+        if (sampleStore.size() == 0) {
+            batchStarted = millis();
+        }
+        if (evaluateAlerts(sample.data, sample.takenAt)) {
+            alertPending = true;
+        }
+        if (windowStats.enabled()) {
+            windowStats.add(sample.data);
+        }
+        latestSeq = sampleStore.push(sample.data, (uint32_t)(sample.takenAt / 1000));
+        
+        if (online && settings.binary) {
+            mqtt.publishBinary(sample.data);
+        }
+    }
+    publishAlerts();
+}
+
+// Writes queued log lines out; the only place logging touches Serial/MQTT
+void logTask() {
+    logger.flush(settings.logging);
+}
+
+void statusTask() {
+    if (online) {
+        publishStatus();
+        lastStatusUpdate = millis();
+    }
+}
+
+// Publishes the window summary once the window is over. While offline the
+// window simply grows until the summary can be sent.
+void statsTask() {
+    if (!windowStats.enabled() || !online || !windowStats.due(millis())) {
+        return;
+    }
     
-    if (!wifiManager.connect()) {
-        logger.println("Initial WiFi connection failed");
+    static char summary[1024];
+    uint32_t now = currentTimestamp();
+    if (windowStats.serialize(now, summary, sizeof(summary)) == 0) {
+        LOG_ERROR("Window summary exceeds %u bytes", (unsigned)sizeof(summary));
+    } else if (!mqtt.publish(mqtt.topic(MQTTManager::TOPIC_STATS), summary)) {
+        return;  // keep the window, retry on the next pass
+    }
+    windowStats.reset(millis(), now);
+}
+
+// Publishes finished radar tracks as events. A track stays queued until the
+// publish succeeds; if more arrive meanwhile the queue counts them as dropped.
+void radarTask() {
+    static char payload[3072];
+    while (online) {
+        AcquiredTrack* next = radarTracks.front();
+        if (next == nullptr) {
+            return;
+        }
+        // A track the MQTT buffer cannot take is dropped, not retried
+        size_t limit = sizeof(payload) < mqtt.maxPayload() ? sizeof(payload) : mqtt.maxPayload();
+        if (next->track.serialize(next->endTimestamp, payload, limit) == 0) {
+            LOG_ERROR("Radar track exceeds %u bytes", (unsigned)limit);
+        } else if (!mqtt.publish(mqtt.topic(MQTTManager::TOPIC_RADAR), payload)) {
+            return;
+        }
+        radarTracks.popFront();
+    }
+}
+
+// Steps a running update and reports on the OTA topic: every state change,
+// every OTA_REPORT_PERIOD while downloading, and how a trial ended. Being
+// online proves a new firmware good; a verified image boots once its
+// report is out.
+void otaTask() {
+    unsigned long now = millis();
+    OtaUpdater::State state = ota.step(now);
+    if (online) {
+        ota.confirm();
     }
+    ota.checkTrial(now);
     
-    if (!sensors.begin()) {
-        logger.println("Failed to initialize sensors!");
-        while(1) delay(1000);
+    bool report = state != otaReported || ota.getTrial() != otaTrialReported ||
+                  (ota.busy() && now - otaReportedAt >= OTA_REPORT_PERIOD);
+    if (report && online) {
+        char payload[256];
+        if (ota.serialize(payload, sizeof(payload)) == 0) {
+            LOG_ERROR("OTA report exceeds %u bytes", (unsigned)sizeof(payload));
+        } else if (mqtt.publish(mqtt.topic(MQTTManager::TOPIC_OTA), payload)) {
+            otaReported = state;
+            otaTrialReported = ota.getTrial();
+            otaReportedAt = now;
+        }
     }
     
-    led.begin();
+    if (state == OtaUpdater::READY && otaReported == OtaUpdater::READY && now - otaReportedAt >= OTA_RESTART_DELAY) {
+        logger.flush(settings.logging);
+        ota.restart();
+    }
+}
+
+static StoredSample batch[SampleStore::MAX_BATCH];
+
+// Publishes only the fields the deadband filter lets through; a sample in
+// which nothing moved is not sent at all
+bool publishLive(const StoredSample& sample) {
+    unsigned long now = millis();
+    bool keyframe;
+    uint32_t fields = deadband.select(sample.data, now, keyframe);
+    fields &= ~windowStats.getFields();  // those go out as window summaries
     
-    // Subscribe to command topic
-    mqtt.subscribe(COMMAND_TOPIC, handleCommand);
+    if ((fields != 0 || keyframe) && !mqtt.publishDelta(sample, fields, keyframe)) {
+        return false;
+    }
+    deadband.commit(sample.data, fields, keyframe, now);
+    return true;
+}
+
+// Batch mode: one message with as many queued samples as fit the MQTT
+// buffer, once enough are queued, the window is up or an alert is waiting
+void uploadBatch() {
+    size_t queued = sampleStore.size();
+    if (queued == 0) {
+        return;
+    }
+    if (queued < settings.batchSamples && millis() - batchStarted < settings.batchWindow * 1000 && !alertPending) {
+        return;
+    }
+    
+    size_t count = sampleStore.peek(batch, SampleStore::MAX_BATCH);
+    size_t sent;
+    if (!mqtt.publishBatch(batch, count, sent)) {
+        led.blink(3);  // Failure
+        return;
+    }
+    sampleStore.discard(sent);
+    led.blink(1);  // Success
     
-    logger.println("Setup complete!");
+    batchStarted = millis();
+    if (sampleStore.size() == 0) {
+        alertPending = false;
+    }
 }
 
-void loop() {
-    // First ensure WiFi is connected
-    if (!wifiManager.checkConnection()) {
-        logger.println("Attempting to reconnect WiFi...");
-        if (!wifiManager.connect()) {
-            delay(5000);
-            return;
+// Publishes up to one batch of queued samples, oldest first. The newest
+// sample goes to the live topic, anything older is backlog.
+void uploadTask() {
+    if (!online) {
+        return;
+    }
+    if (settings.batchSamples > 1) {
+        uploadBatch();
+        return;
+    }
+    
+    size_t count = sampleStore.peek(batch, SampleStore::MAX_BATCH);
+    size_t sent = 0;
+    
+    while (sent < count) {
+        bool live = batch[sent].seq == latestSeq;
+        if (!(live ? publishLive(batch[sent]) : mqtt.publish(batch[sent], true))) {
+            break;
+        }
+        if (live) {
+            led.blink(1);  // Success
         }
-        // Give time for WiFi to fully establish
-        delay(1000);
+        sent++;
     }
+    sampleStore.discard(sent);
+    
+    if (sent < count) {
+        led.blink(3);  // Failure
+    }
+}
 
-    // Only attempt MQTT operations if WiFi is connected
-    if (wifiManager.isWiFiConnected()) {
-        mqtt.loop();
-        if (!mqtt.isConnected()) {
-            logger.println("Attempting to reconnect MQTT...");
-            if (!mqtt.connect()) {
-                delay(5000);
-                return;
-            }
-            // Give time for MQTT to fully establish
-            delay(1000);
+// In SLEEP mode: once the queue is uploaded and commands had a moment to
+// arrive, publishes a last status and deep-sleeps. A wake that cannot get
+// its upload through in MAX_UPLOAD_AWAKE keeps the samples on flash for
+// the next one. A firmware download keeps the node awake until it ends.
+void powerTask() {
+    if (power.getMode() != PowerManager::POWER_SLEEP || ota.busy()) {
+        sleepModeSince = 0;
+        return;
+    }
+    unsigned long now = millis();
+    if (sleepModeSince == 0) {
+        sleepModeSince = now;
+    }
+    if (!online) {
+        onlineSince = 0;
+    } else if (onlineSince == 0) {
+        onlineSince = now;
+    }
+    
+    if (statusSentAt != 0) {
+        if (now - statusSentAt >= SLEEP_FLUSH) {
+            power.sleep();
         }
+        return;
+    }
+    bool uploaded = online && now - onlineSince >= COMMAND_WINDOW && sampleStore.size() == 0;
+    if (uploaded) {
+        publishStatus();
+        logger.flush(settings.logging);
+        statusSentAt = now;
+    } else if (now - sleepModeSince >= MAX_UPLOAD_AWAKE) {
+        LOG_WARN("Upload incomplete, sleeping with %u samples queued", (unsigned)sampleStore.size());
+        logger.flush(settings.logging);
+        sampleStore.persist();
+        power.sleep();
+    }
+}
 
-        // Only proceed with sensor operations if both WiFi and MQTT are connected
-        if (mqtt.isConnected()) {
-            // Publish status updates periodically
-            if (millis() - lastStatusUpdate >= statusInterval) {
-                publishStatus();
-                lastStatusUpdate = millis();
-            }
-            
-            // Only read and publish sensor data if device is enabled
-            if (deviceEnabled) {
-                SensorData data = sensors.readSensors();
-                sensors.printReadings(data);
-                
-                if (mqtt.publish(data)) {
-                    led.blink(1);  // Success
-                } else {
-                    led.blink(3);  // Failure
-                }
-            }
-            
-            delay(2000);
+// Timer wake in SLEEP mode: adds one sample to the RTC ring and goes back
+// to sleep, unless the ring is due for upload
+void sampleWake() {
+    SensorData data = sensors.sampleOnce();
+    uint64_t takenAt = currentEpochMillis();
+    power.record(data, (uint32_t)(takenAt / 1000));
+    bool alert = evaluateAlerts(data, takenAt);
+    if (!power.uploadDue(alert)) {
+        power.sleep();
+    }
+    uploadWake = true;
+}
+
+void setup() {
+    Serial.begin(115200);
+    while (!Serial) delay(10);
+    
+    // Settings and wiring come first, even on a sample wake
+    config.begin();
+    SensorManager::Pins pins = { settings.dhtPin, settings.mq8Pin, settings.radarRxPin,
+                                 settings.radarTxPin, settings.sdsRxPin, settings.sdsTxPin };
+    sensors.setPins(pins);
+    mqtt.begin();  // topics are needed before the first publish, even on a sample wake
+    power.begin();
+    alerts.begin();
+    applyConfig(nullptr);
+    if (power.isSampleWake()) {
+        sampleWake();  // returns only if this wake uploads
+    }
+    
+    // Samples left over from before a restart are replayed once online
+    sampleStore.begin();
+    SensorData slept;
+    uint32_t timestamp;
+    while (power.take(slept, timestamp)) {
+        latestSeq = sampleStore.push(slept, timestamp);
+    }
+    
+    // A firmware on trial counts this boot and may roll back right here
+    ota.setRestartHook([]() { sampleStore.persist(); });
+    ota.begin(true);
+    
+    // Initialize WiFiManager; the connection completes in networkTask()
+    wifiManager.addEnterpriseNetwork(0, ssid1, password1, identity1, mqtt_server1);
+    wifiManager.addRegularNetwork(1, ssid2, password2, mqtt_server2);
+    wifiManager.setRestartHook([]() { sampleStore.persist(); });
+    wifiManager.connect();
+    power.radioOn();
+    configTime(0, 0, "pool.ntp.org");
+    
+    if (!uploadWake) {
+        if (!sensors.begin()) {
+            LOG_ERROR("Failed to initialize sensors!");
+            while(1) { logger.flush(false); delay(1000); }
+        }
+        
+        // Sensor acquisition runs on core 0; this loop (core 1) does networking
+        if (xTaskCreatePinnedToCore(acquisitionTask, "acquire", 4096, nullptr, 1,
+                                    &acquisitionHandle, 0) != pdPASS) {
+            LOG_ERROR("Failed to start acquisition task!");
+            while(1) { logger.flush(false); delay(1000); }
         }
     }
     
-    led.update();
+    led.begin(settings.ledPin);
+    
+    // Commands for this node and for the whole fleet (applied as soon as
+    // MQTT connects)
+    mqtt.subscribe(mqtt.topic(MQTTManager::TOPIC_COMMAND), handleCommand);
+    mqtt.subscribe(mqtt.topic(MQTTManager::TOPIC_FLEET_COMMAND), handleCommand);
+    
+    scheduler.add("net", networkTask, NETWORK_PERIOD, 20000);
+    scheduler.add("led", ledTask, LED_PERIOD, 200);
+    scheduler.add("drain", drainTask, DRAIN_PERIOD, 20000);
+    scheduler.add("log", logTask, LOG_PERIOD, 20000);
+    scheduler.add("upload", uploadTask, UPLOAD_PERIOD, 50000);
+    scheduler.add("stats", statsTask, STATS_PERIOD, 20000);
+    scheduler.add("radar", radarTask, RADAR_PERIOD, 20000);
+    scheduler.add("power", powerTask, POWER_PERIOD, 20000);
+    scheduler.add("ota", otaTask, OTA_PERIOD, 50000);
+    statusTaskId = scheduler.add("status", statusTask, settings.statusInterval * 1000, 20000);
+    
+    LOG_INFO("Setup complete!");
+}
+
+void loop() {
+    unsigned long idle = scheduler.run();
+    // Sleep until the next task is due, which also yields to the WiFi stack
+    delay(idle < MAX_IDLE ? idle : MAX_IDLE);
 }
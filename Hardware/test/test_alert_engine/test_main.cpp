@@ -0,0 +1,114 @@
+// AlertEngine rate rules on the wall clock: rates are the same whether the
+// samples were taken awake or across deep sleep, samples before SNTP has
+// set the clock leave the rule alone, and a clock stepped back is not a
+// rate.
+
+#include <unity.h>
+
+#include "AlertEngine.h"
+#include "TelemetrySerializer.h"
+
+namespace {
+
+const uint64_t SYNCED = 1760000000000ULL;   // Unix time in ms
+
+AlertEngine alerts;
+AlertEngine::Event events[AlertEngine::MAX_RULES];
+
+SensorData co2Sample(uint16_t ppm) {
+    SensorData data = {};
+    data.co2 = ppm;
+    data.validMask = 1 << SENSOR_CCS811;
+    return data;
+}
+
+// CO2 rising by limit ppm per second or faster
+void rateRule(float limit) {
+    alerts.clear();
+    AlertEngine::Rule rule = { (uint8_t)TelemetrySerializer::fieldIndex("co2"), AlertEngine::ALERT_RATE, limit, 0 };
+    TEST_ASSERT_TRUE(alerts.add(rule));
+}
+
+size_t evaluate(uint16_t ppm, uint64_t epochMillis) {
+    return alerts.evaluate(co2Sample(ppm), epochMillis, events, AlertEngine::MAX_RULES);
+}
+
+}  // namespace
+
+void setUp() {
+    alerts.begin();
+}
+
+void tearDown() {}
+
+void test_rate_is_per_second_of_wall_time() {
+    rateRule(5.0f);
+    TEST_ASSERT_EQUAL(0, evaluate(400, SYNCED));
+    // 8 ppm in 2 s awake
+    TEST_ASSERT_EQUAL(0, evaluate(408, SYNCED + 2000));
+    // 12 ppm in 2 s
+    TEST_ASSERT_EQUAL(1, evaluate(420, SYNCED + 4000));
+    TEST_ASSERT_TRUE(events[0].raised);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 6.0f, events[0].observed);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)(SYNCED / 1000) + 4, events[0].timestamp);
+}
+
+void test_rate_spans_deep_sleep() {
+    // The same 600 ppm rise: over a 5 min sleep it is 2 ppm/s, not an alert
+    rateRule(5.0f);
+    evaluate(400, SYNCED);
+    TEST_ASSERT_EQUAL(0, evaluate(1000, SYNCED + 300000));
+    // and over 60 s it is 10 ppm/s
+    TEST_ASSERT_EQUAL(1, evaluate(1600, SYNCED + 360000));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 10.0f, events[0].observed);
+}
+
+void test_unsynced_samples_leave_rate_alone() {
+    rateRule(5.0f);
+    evaluate(400, SYNCED);
+    TEST_ASSERT_EQUAL(1, evaluate(500, SYNCED + 2000));
+    TEST_ASSERT_TRUE(events[0].raised);
+    uint32_t raised = alerts.getStats().raised;
+
+    // Clock lost: no rate, and the raised alert is not cleared by it
+    TEST_ASSERT_EQUAL(0, evaluate(400, 0));
+    TEST_ASSERT_EQUAL(0, evaluate(2000, 0));
+    TEST_ASSERT_EQUAL_UINT32(raised, alerts.getStats().raised);
+
+    // Back on the clock, the rate runs from the last timed reading
+    TEST_ASSERT_EQUAL(1, evaluate(520, SYNCED + 12000));
+    TEST_ASSERT_FALSE(events[0].raised);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 2.0f, events[0].observed);
+}
+
+void test_no_rate_before_first_sync() {
+    rateRule(5.0f);
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL(0, evaluate((uint16_t)(400 + i * 1000), 0));
+    }
+    // The first timed reading is only a baseline
+    TEST_ASSERT_EQUAL(0, evaluate(9000, SYNCED));
+    TEST_ASSERT_EQUAL(0, evaluate(9002, SYNCED + 2000));
+}
+
+void test_clock_stepped_back_is_not_a_rate() {
+    rateRule(-5.0f);
+    evaluate(1000, SYNCED);
+    // SNTP corrects the clock 30 s back: a new baseline, not a division by
+    // a negative interval
+    TEST_ASSERT_EQUAL(0, evaluate(990, SYNCED - 30000));
+    TEST_ASSERT_EQUAL(0, evaluate(990, SYNCED - 30000));
+    // A real fall from there still counts
+    TEST_ASSERT_EQUAL(1, evaluate(970, SYNCED - 28000));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, -10.0f, events[0].observed);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rate_is_per_second_of_wall_time);
+    RUN_TEST(test_rate_spans_deep_sleep);
+    RUN_TEST(test_unsynced_samples_leave_rate_alone);
+    RUN_TEST(test_no_rate_before_first_sync);
+    RUN_TEST(test_clock_stepped_back_is_not_a_rate);
+    return UNITY_END();
+}
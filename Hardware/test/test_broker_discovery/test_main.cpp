@@ -0,0 +1,175 @@
+// BrokerDiscovery on the fake LAN: probes that stay unanswered are given up
+// after PROBE_TIMEOUT and their slots reused, hosts from mDNS go ahead of
+// the sweep, and a search that cannot finish stops at DISCOVERY_TIMEOUT
+// with every socket closed.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <mdns.h>
+#include <unity.h>
+
+#include "BrokerDiscovery.h"
+#include "VirtualClock.h"
+
+namespace {
+
+const IPAddress LOCAL(192, 168, 1, 42);
+const IPAddress GATEWAY(192, 168, 1, 1);
+const IPAddress NONE;
+
+// One instance, like the firmware's: an mDNS query outlives the search
+// that started it, and the next search reaps it
+BrokerDiscovery discovery;
+
+// Steps once per simulated millisecond, as the WiFi task does at most
+BrokerDiscovery::State run() {
+    while (discovery.step() == BrokerDiscovery::RUNNING) {
+        delay(1);
+    }
+    return discovery.getState();
+}
+
+void stepUntil(unsigned long elapsed) {
+    unsigned long start = millis();
+    while (millis() - start < elapsed) {
+        discovery.step();
+        delay(1);
+    }
+    discovery.step();
+}
+
+}  // namespace
+
+void setUp() {
+    FakeLan::reset();
+    FakeMdns::clear();
+    // Let the last test's mDNS query run out
+    delay(BrokerDiscovery::MDNS_TIMEOUT);
+    discovery.step();
+}
+
+void tearDown() {
+    discovery.cancel();
+    TEST_ASSERT_EQUAL(0, FakeLan::openSockets());
+}
+
+void test_cached_broker_is_found_at_once() {
+    discovery.start(LOCAL, GATEWAY, IPAddress(192, 168, 1, 77));
+    TEST_ASSERT_EQUAL(BrokerDiscovery::FOUND, run());
+    TEST_ASSERT_TRUE(discovery.result() == IPAddress(192, 168, 1, 77));
+    TEST_ASSERT_EQUAL_UINT32(FakeLan::ACCEPT_MILLIS, discovery.duration());
+    TEST_ASSERT_EQUAL(0, FakeLan::openSockets());
+}
+
+void test_silent_probes_time_out_and_free_their_slots() {
+    discovery.start(LOCAL, GATEWAY, NONE);
+    discovery.step();
+    // The gateway and .2 to .12; the gateway and .10 refuse
+    TEST_ASSERT_EQUAL(BrokerDiscovery::MAX_PROBES, discovery.probeCount());
+    stepUntil(BrokerDiscovery::PROBE_TIMEOUT - 1);
+    TEST_ASSERT_EQUAL(BrokerDiscovery::MAX_PROBES + 2, discovery.probeCount());
+    TEST_ASSERT_EQUAL(BrokerDiscovery::MAX_PROBES, FakeLan::openSockets());
+
+    // The ten silent ones expire together and are replaced in the same step
+    delay(1);
+    discovery.step();
+    TEST_ASSERT_EQUAL(BrokerDiscovery::MAX_PROBES + 12, discovery.probeCount());
+    TEST_ASSERT_EQUAL(BrokerDiscovery::MAX_PROBES, FakeLan::openSockets());
+}
+
+void test_broker_slower_than_probe_timeout_is_passed_over() {
+    const uint8_t BROKER[4] = { 192, 168, 1, 77 };
+    FakeLan::setBroker(BROKER, BrokerDiscovery::PROBE_TIMEOUT - 50);
+    discovery.start(LOCAL, GATEWAY, IPAddress(192, 168, 1, 77));
+    TEST_ASSERT_EQUAL(BrokerDiscovery::FOUND, run());
+    TEST_ASSERT_EQUAL_UINT32(BrokerDiscovery::PROBE_TIMEOUT - 50, discovery.duration());
+
+    delay(BrokerDiscovery::MDNS_TIMEOUT);
+    FakeLan::setBroker(BROKER, BrokerDiscovery::PROBE_TIMEOUT + 50);
+    discovery.start(LOCAL, GATEWAY, IPAddress(192, 168, 1, 77));
+    TEST_ASSERT_EQUAL(BrokerDiscovery::FAILED, run());
+    TEST_ASSERT_TRUE(discovery.duration() < BrokerDiscovery::DISCOVERY_TIMEOUT);
+}
+
+void test_mdns_host_is_probed_before_the_sweep_reaches_it() {
+    const uint8_t BROKER[4] = { 192, 168, 1, 200 };
+    FakeLan::setBroker(BROKER);
+    discovery.start(LOCAL, GATEWAY, NONE);
+    TEST_ASSERT_EQUAL(BrokerDiscovery::FOUND, run());
+    unsigned long sweepOnly = discovery.duration();
+    TEST_ASSERT_TRUE(sweepOnly > BrokerDiscovery::MDNS_TIMEOUT + BrokerDiscovery::PROBE_TIMEOUT);
+
+    delay(BrokerDiscovery::MDNS_TIMEOUT);
+    discovery.step();
+    FakeMdns::advertise(BROKER);
+    discovery.start(LOCAL, GATEWAY, NONE);
+    TEST_ASSERT_EQUAL(BrokerDiscovery::FOUND, run());
+    TEST_ASSERT_TRUE(discovery.result() == IPAddress(192, 168, 1, 200));
+    // At the latest when the next probe slot frees up after the answer
+    TEST_ASSERT_TRUE(discovery.duration() >= BrokerDiscovery::MDNS_TIMEOUT);
+    TEST_ASSERT_TRUE(discovery.duration() <= BrokerDiscovery::MDNS_TIMEOUT +
+                                             BrokerDiscovery::PROBE_TIMEOUT + FakeLan::ACCEPT_MILLIS);
+    TEST_ASSERT_TRUE(discovery.duration() < sweepOnly);
+}
+
+void test_mdns_finds_a_broker_off_the_subnet() {
+    const uint8_t BROKER[4] = { 10, 0, 0, 5 };
+    FakeLan::setBroker(BROKER);
+    const uint8_t OTHER[4] = { 192, 168, 1, 99 };
+    FakeMdns::advertise(OTHER);
+    FakeMdns::advertise(BROKER);
+    discovery.start(LOCAL, GATEWAY, NONE);
+    TEST_ASSERT_EQUAL(BrokerDiscovery::FOUND, run());
+    TEST_ASSERT_TRUE(discovery.result() == IPAddress(10, 0, 0, 5));
+}
+
+void test_search_gives_up_after_sweep_without_broker() {
+    FakeLan::setBrokerUp(false);
+    discovery.start(LOCAL, GATEWAY, NONE);
+    TEST_ASSERT_EQUAL(BrokerDiscovery::FAILED, run());
+    // Every other host of the /24 once, then no more to try
+    TEST_ASSERT_EQUAL(253, discovery.probeCount());
+    TEST_ASSERT_TRUE(discovery.duration() < BrokerDiscovery::DISCOVERY_TIMEOUT);
+}
+
+void test_search_stops_at_deadline() {
+    // Most sockets taken by the rest of the firmware: the sweep crawls
+    FakeLan::setBrokerUp(false);
+    FakeLan::setSocketLimit(3);
+    discovery.start(LOCAL, GATEWAY, NONE);
+    TEST_ASSERT_EQUAL(BrokerDiscovery::FAILED, run());
+    TEST_ASSERT_EQUAL_UINT32(BrokerDiscovery::DISCOVERY_TIMEOUT, discovery.duration());
+    TEST_ASSERT_TRUE(discovery.probeCount() < 253);
+    TEST_ASSERT_EQUAL(0, FakeLan::openSockets());
+
+    // The next search, with the broker up and sockets free again, finds it
+    FakeLan::reset();
+    discovery.start(LOCAL, GATEWAY, NONE);
+    TEST_ASSERT_EQUAL(BrokerDiscovery::FOUND, run());
+    TEST_ASSERT_TRUE(discovery.result() == IPAddress(192, 168, 1, 77));
+}
+
+void test_cancel_closes_probes() {
+    discovery.start(LOCAL, GATEWAY, NONE);
+    stepUntil(100);
+    TEST_ASSERT_EQUAL(BrokerDiscovery::MAX_PROBES, FakeLan::openSockets());
+    discovery.cancel();
+    TEST_ASSERT_EQUAL(BrokerDiscovery::IDLE, discovery.getState());
+    TEST_ASSERT_EQUAL(0, FakeLan::openSockets());
+}
+
+int main(int argc, char** argv) {
+    // This thread is the only participant, so every delay() returns at once
+    VirtualClock::join();
+    UNITY_BEGIN();
+    RUN_TEST(test_cached_broker_is_found_at_once);
+    RUN_TEST(test_silent_probes_time_out_and_free_their_slots);
+    RUN_TEST(test_broker_slower_than_probe_timeout_is_passed_over);
+    RUN_TEST(test_mdns_host_is_probed_before_the_sweep_reaches_it);
+    RUN_TEST(test_mdns_finds_a_broker_off_the_subnet);
+    RUN_TEST(test_search_gives_up_after_sweep_without_broker);
+    RUN_TEST(test_search_stops_at_deadline);
+    RUN_TEST(test_cancel_closes_probes);
+    return UNITY_END();
+}
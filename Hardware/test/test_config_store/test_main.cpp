@@ -0,0 +1,336 @@
+// ConfigStore on the fake NVS: a slot torn or corrupted mid-write leaves
+// the other one in charge, records from older firmware load with defaults
+// for what they predate while newer ones are refused, and values out of
+// range never become active, whether they come from a command or from
+// flash. The alert rules and deadband policies go along with the rest.
+
+#include <Preferences.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <unity.h>
+#include <vector>
+
+#include "ConfigStore.h"
+#include "TelemetrySerializer.h"
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+// The record layout ConfigStore keeps in each slot
+const uint32_t MAGIC = 0x31474643;   // "CFG1"
+
+struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint32_t generation;
+    uint32_t crc;
+};
+
+// DeviceConfig as version 1 wrote it: everything before the tables
+const size_t V1_LENGTH = offsetof(DeviceConfig, alertCount);
+
+uint32_t crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+Bytes readSlot(size_t index) {
+    const char* key = index == 0 ? "slot0" : "slot1";
+    Preferences prefs;
+    prefs.begin("config", true);
+    Bytes bytes(prefs.getBytesLength(key));
+    prefs.getBytes(key, bytes.data(), bytes.size());
+    prefs.end();
+    return bytes;
+}
+
+void writeSlot(size_t index, const Bytes& bytes) {
+    Preferences prefs;
+    prefs.begin("config", false);
+    prefs.putBytes(index == 0 ? "slot0" : "slot1", bytes.data(), bytes.size());
+    prefs.end();
+}
+
+// A well-formed record as some firmware of the given version wrote it
+Bytes record(uint16_t version, uint32_t generation, const DeviceConfig& values, size_t length) {
+    Header header = { MAGIC, version, (uint16_t)length, generation, 0 };
+    Bytes bytes(sizeof(header) + length);
+    memcpy(bytes.data(), &header, sizeof(header));
+    memcpy(bytes.data() + sizeof(header), &values, length);
+    header.crc = crc32(bytes.data(), bytes.size());
+    memcpy(bytes.data(), &header, sizeof(header));
+    return bytes;
+}
+
+DeviceConfig defaults() {
+    ConfigStore fresh;
+    return fresh.get();
+}
+
+// Two commits: generation 1 in slot 0 with interval 60, 2 in slot 1 with 90
+void commitTwice(ConfigStore& config) {
+    config.begin();
+    TEST_ASSERT_TRUE(config.set("interval", 60));
+    TEST_ASSERT_TRUE(config.commit());
+    TEST_ASSERT_TRUE(config.set("interval", 90));
+    TEST_ASSERT_TRUE(config.commit());
+    TEST_ASSERT_EQUAL_UINT32(2, config.getGeneration());
+}
+
+}  // namespace
+
+void setUp() {
+    Preferences prefs;
+    prefs.begin("config", false);
+    prefs.clear();
+    prefs.end();
+}
+
+void tearDown() {}
+
+void test_empty_nvs_gives_defaults() {
+    ConfigStore config;
+    config.begin();
+    TEST_ASSERT_TRUE(config.getStats().defaulted);
+    TEST_ASSERT_EQUAL_UINT32(0, config.getGeneration());
+    TEST_ASSERT_EQUAL_UINT32(30, config.get().statusInterval);
+    TEST_ASSERT_EQUAL_UINT8(4, config.get().alertCount);
+    TEST_ASSERT_EQUAL_UINT8(TelemetrySerializer::fieldIndex("co2"), config.get().alertRules[0].field);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.0f, config.get().deadbandPolicies[TelemetrySerializer::fieldIndex("pm25")].delta);
+}
+
+void test_newest_record_wins_after_restart() {
+    ConfigStore config;
+    commitTwice(config);
+
+    ConfigStore restarted;
+    restarted.begin();
+    TEST_ASSERT_FALSE(restarted.getStats().defaulted);
+    TEST_ASSERT_EQUAL_UINT32(2, restarted.getGeneration());
+    TEST_ASSERT_EQUAL_UINT32(90, restarted.get().statusInterval);
+}
+
+void test_corrupted_newest_slot_falls_back_to_the_other() {
+    ConfigStore config;
+    commitTwice(config);
+    Bytes newest = readSlot(1);
+    newest[sizeof(Header) + offsetof(DeviceConfig, statusInterval)] ^= 0x01;
+    writeSlot(1, newest);
+
+    ConfigStore restarted;
+    restarted.begin();
+    TEST_ASSERT_EQUAL_UINT32(1, restarted.getGeneration());
+    TEST_ASSERT_EQUAL_UINT32(60, restarted.get().statusInterval);
+
+    // The next commit overwrites the broken slot, not the good one
+    TEST_ASSERT_TRUE(restarted.set("interval", 120));
+    TEST_ASSERT_TRUE(restarted.commit());
+    ConfigStore again;
+    again.begin();
+    TEST_ASSERT_EQUAL_UINT32(2, again.getGeneration());
+    TEST_ASSERT_EQUAL_UINT32(120, again.get().statusInterval);
+    Header header;
+    memcpy(&header, readSlot(0).data(), sizeof(header));
+    TEST_ASSERT_EQUAL_UINT32(1, header.generation);
+}
+
+void test_torn_write_falls_back_to_the_other() {
+    // Power lost partway through the write: the slot holds a prefix
+    for (size_t kept = 1; kept < sizeof(Header) + sizeof(DeviceConfig); kept += 7) {
+        setUp();
+        ConfigStore config;
+        commitTwice(config);
+        Bytes torn = readSlot(1);
+        torn.resize(kept);
+        writeSlot(1, torn);
+
+        ConfigStore restarted;
+        restarted.begin();
+        TEST_ASSERT_EQUAL_UINT32(1, restarted.getGeneration());
+        TEST_ASSERT_EQUAL_UINT32(60, restarted.get().statusInterval);
+    }
+}
+
+void test_both_slots_bad_gives_defaults() {
+    ConfigStore config;
+    commitTwice(config);
+    for (size_t i = 0; i < 2; i++) {
+        Bytes bytes = readSlot(i);
+        bytes[sizeof(Header) - 1] ^= 0x80;   // the CRC itself
+        writeSlot(i, bytes);
+    }
+    ConfigStore restarted;
+    restarted.begin();
+    TEST_ASSERT_TRUE(restarted.getStats().defaulted);
+    TEST_ASSERT_EQUAL_UINT32(30, restarted.get().statusInterval);
+}
+
+void test_version_1_record_loads_with_default_tables() {
+    DeviceConfig values = defaults();
+    values.statusInterval = 45;
+    values.ledPin = 5;
+    // What lies past a version 1 record is never read
+    values.alertCount = 200;
+    writeSlot(0, record(1, 7, values, V1_LENGTH));
+
+    ConfigStore config;
+    config.begin();
+    TEST_ASSERT_FALSE(config.getStats().defaulted);
+    TEST_ASSERT_EQUAL_UINT32(7, config.getGeneration());
+    TEST_ASSERT_EQUAL_UINT32(45, config.get().statusInterval);
+    TEST_ASSERT_EQUAL_UINT8(5, config.get().ledPin);
+    TEST_ASSERT_EQUAL_MEMORY(defaults().alertRules, config.get().alertRules, sizeof(values.alertRules));
+    TEST_ASSERT_EQUAL_UINT8(defaults().alertCount, config.get().alertCount);
+    TEST_ASSERT_EQUAL_MEMORY(defaults().deadbandPolicies, config.get().deadbandPolicies,
+                             sizeof(values.deadbandPolicies));
+
+    // The next commit writes the current version to the other slot
+    TEST_ASSERT_TRUE(config.set("interval", 50));
+    TEST_ASSERT_TRUE(config.commit());
+    Header header;
+    Bytes written = readSlot(1);
+    memcpy(&header, written.data(), sizeof(header));
+    TEST_ASSERT_EQUAL_UINT16(ConfigStore::VERSION, header.version);
+    TEST_ASSERT_EQUAL_UINT16(sizeof(DeviceConfig), header.length);
+    TEST_ASSERT_EQUAL_UINT32(8, header.generation);
+}
+
+void test_record_from_newer_firmware_is_refused() {
+    // After a rollback: the older record is used even though it is behind
+    DeviceConfig values = defaults();
+    values.statusInterval = 45;
+    writeSlot(0, record(ConfigStore::VERSION, 3, values, sizeof(values)));
+    values.statusInterval = 99;
+    writeSlot(1, record(ConfigStore::VERSION + 1, 4, values, sizeof(values)));
+
+    ConfigStore config;
+    config.begin();
+    TEST_ASSERT_EQUAL_UINT32(3, config.getGeneration());
+    TEST_ASSERT_EQUAL_UINT32(45, config.get().statusInterval);
+}
+
+void test_out_of_range_changes_are_rejected_whole() {
+    ConfigStore config;
+    config.begin();
+    DeviceConfig before = config.get();
+
+    // A good change and a bad one: neither takes effect
+    TEST_ASSERT_TRUE(config.set("rate_dht", 5000));
+    TEST_ASSERT_FALSE(config.set("interval", 0));
+    TEST_ASSERT_FALSE(config.commit());
+    TEST_ASSERT_EQUAL_STRING("interval must be 1 to 86400", config.lastError());
+    TEST_ASSERT_EQUAL_MEMORY(&before, &config.get(), sizeof(before));
+
+    TEST_ASSERT_FALSE(config.set("no_such_key", 1));
+    TEST_ASSERT_FALSE(config.commit());
+    TEST_ASSERT_EQUAL_STRING("unknown key no_such_key", config.lastError());
+
+    // GPIOs 34 to 39 cannot drive the LED or a UART TX line
+    const char* OUTPUTS[] = { "pin_led", "pin_radar_tx", "pin_sds_tx" };
+    for (size_t i = 0; i < 3; i++) {
+        for (uint32_t pin = 34; pin <= 40; pin++) {
+            TEST_ASSERT_FALSE(config.set(OUTPUTS[i], pin));
+            TEST_ASSERT_FALSE(config.commit());
+        }
+    }
+    TEST_ASSERT_TRUE(config.set("pin_mq8", 39));
+    TEST_ASSERT_FALSE(config.set("pin_mq8", 40));
+    config.revert();
+
+    // Typed changes are checked at commit
+    config.edit().ledPin = 35;
+    TEST_ASSERT_FALSE(config.commit());
+    TEST_ASSERT_EQUAL_STRING("pin_led must be 0 to 33", config.lastError());
+
+    config.edit().alertCount = AlertEngine::MAX_RULES + 1;
+    TEST_ASSERT_FALSE(config.commit());
+    TEST_ASSERT_EQUAL_STRING("invalid alert rule", config.lastError());
+
+    config.edit().alertRules[0].field = TelemetrySerializer::FIELD_COUNT;
+    TEST_ASSERT_FALSE(config.commit());
+
+    config.edit().deadbandPolicies[3].delta = NAN;
+    TEST_ASSERT_FALSE(config.commit());
+    TEST_ASSERT_EQUAL_STRING("invalid deadband policy", config.lastError());
+
+    config.edit().deadbandPolicies[3].heartbeatMillis = DeadbandFilter::MAX_HEARTBEAT + 1;
+    TEST_ASSERT_FALSE(config.commit());
+
+    TEST_ASSERT_EQUAL_MEMORY(&before, &config.get(), sizeof(before));
+    TEST_ASSERT_EQUAL_UINT32(0, config.getGeneration());
+    TEST_ASSERT_EQUAL(0, readSlot(0).size() + readSlot(1).size());
+}
+
+void test_stored_value_out_of_range_gets_its_default() {
+    DeviceConfig values = defaults();
+    values.statusInterval = 0;
+    values.sdsTxPin = 36;
+    values.mqttPort = 1884;
+    values.deadbandPolicies[0].delta = -1.0f;
+    writeSlot(0, record(ConfigStore::VERSION, 2, values, sizeof(values)));
+
+    ConfigStore config;
+    config.begin();
+    TEST_ASSERT_EQUAL_UINT32(2, config.getGeneration());
+    TEST_ASSERT_EQUAL_UINT32(30, config.get().statusInterval);
+    TEST_ASSERT_EQUAL_UINT8(26, config.get().sdsTxPin);
+    TEST_ASSERT_EQUAL_UINT16(1884, config.get().mqttPort);
+    TEST_ASSERT_EQUAL_MEMORY(defaults().deadbandPolicies, config.get().deadbandPolicies,
+                             sizeof(values.deadbandPolicies));
+}
+
+void test_alert_rules_and_deadband_policies_persist() {
+    ConfigStore config;
+    config.begin();
+    DeviceConfig& pending = config.edit();
+    memset(pending.alertRules, 0, sizeof(pending.alertRules));
+    pending.alertCount = 2;
+    pending.alertRules[0].field = (uint8_t)TelemetrySerializer::fieldIndex("hydrogen_raw");
+    pending.alertRules[0].kind = AlertEngine::ALERT_ANOMALY;
+    pending.alertRules[0].limit = 6.0f;
+    pending.alertRules[0].alpha = 0.1f;
+    pending.alertRules[1].field = (uint8_t)TelemetrySerializer::fieldIndex("co2");
+    pending.alertRules[1].kind = AlertEngine::ALERT_RATE;
+    pending.alertRules[1].limit = -5.0f;
+    size_t pm25 = TelemetrySerializer::fieldIndex("pm25");
+    pending.deadbandPolicies[pm25].delta = 2.5f;
+    pending.deadbandPolicies[pm25].heartbeatMillis = 60000;
+    TEST_ASSERT_TRUE(config.commit());
+
+    ConfigStore restarted;
+    restarted.begin();
+    TEST_ASSERT_EQUAL_UINT32(1, restarted.getGeneration());
+    TEST_ASSERT_EQUAL_UINT8(2, restarted.get().alertCount);
+    TEST_ASSERT_EQUAL_MEMORY(config.get().alertRules, restarted.get().alertRules, sizeof(pending.alertRules));
+    TEST_ASSERT_EQUAL(AlertEngine::ALERT_RATE, restarted.get().alertRules[1].kind);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 2.5f, restarted.get().deadbandPolicies[pm25].delta);
+    TEST_ASSERT_EQUAL_UINT32(60000, restarted.get().deadbandPolicies[pm25].heartbeatMillis);
+
+    // The same tables again are no change and no write
+    TEST_ASSERT_TRUE(restarted.commit());
+    TEST_ASSERT_EQUAL_UINT32(1, restarted.getGeneration());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_nvs_gives_defaults);
+    RUN_TEST(test_newest_record_wins_after_restart);
+    RUN_TEST(test_corrupted_newest_slot_falls_back_to_the_other);
+    RUN_TEST(test_torn_write_falls_back_to_the_other);
+    RUN_TEST(test_both_slots_bad_gives_defaults);
+    RUN_TEST(test_version_1_record_loads_with_default_tables);
+    RUN_TEST(test_record_from_newer_firmware_is_refused);
+    RUN_TEST(test_out_of_range_changes_are_rejected_whole);
+    RUN_TEST(test_stored_value_out_of_range_gets_its_default);
+    RUN_TEST(test_alert_rules_and_deadband_policies_persist);
+    return UNITY_END();
+}
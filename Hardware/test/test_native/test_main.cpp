@@ -0,0 +1,133 @@
+// The host fakes the other tests and the native runner stand on: simulated
+// time, the in-memory broker and NVS.
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <unity.h>
+#include <string>
+
+#include "VirtualClock.h"
+
+namespace {
+
+std::string received;
+
+void onMessage(char* topic, uint8_t* payload, unsigned int length) {
+    received.assign(reinterpret_cast<const char*>(payload), length);
+}
+
+void joinNetwork() {
+    WiFi.setLinkUp(true);
+    WiFi.begin("garden");
+    while (WiFi.status() != WL_CONNECTED) {
+        delay(10);
+    }
+}
+
+}  // namespace
+
+void setUp() {
+    Broker.topics.clear();
+    Broker.retained.clear();
+    Broker.inbound.clear();
+    Broker.available = true;
+    received.clear();
+}
+
+void tearDown() {}
+
+void test_idle_delay_jumps_clock() {
+    unsigned long start = millis();
+    delay(3600000UL);
+    TEST_ASSERT_EQUAL_UINT32(start + 3600000UL, millis());
+}
+
+void test_wifi_connects_after_scan_and_dhcp() {
+    WiFi.setLinkUp(true);
+    unsigned long start = millis();
+    WiFi.begin("garden");
+    TEST_ASSERT_EQUAL(WL_DISCONNECTED, WiFi.status());
+    while (WiFi.status() != WL_CONNECTED) {
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL_UINT32(WiFiClass::SCAN_MILLIS + WiFiClass::ASSOCIATE_MILLIS + WiFiClass::DHCP_MILLIS,
+                             millis() - start);
+    WiFi.setLinkUp(false);
+    TEST_ASSERT_EQUAL(WL_DISCONNECTED, WiFi.status());
+}
+
+void test_broker_enforces_buffer_size() {
+    joinNetwork();
+    WiFiClient socket;
+    PubSubClient client(socket);
+    client.setBufferSize(64);
+    TEST_ASSERT_TRUE(client.connect("garden-test", nullptr, nullptr, "t/status", 0, true, "offline"));
+
+    std::string payload(64, 'x');
+    TEST_ASSERT_FALSE(client.publish("t/live", payload.c_str()));
+    payload.resize(64 - MQTT_MAX_HEADER_SIZE - 2 - strlen("t/live"));
+    TEST_ASSERT_TRUE(client.publish("t/live", payload.c_str(), true));
+    TEST_ASSERT_EQUAL_UINT32(1, Broker.topics["t/live"].messages);
+    TEST_ASSERT_EQUAL_STRING(payload.c_str(), Broker.retained["t/live"].c_str());
+}
+
+void test_broker_sends_will_when_link_drops() {
+    joinNetwork();
+    WiFiClient socket;
+    PubSubClient client(socket);
+    TEST_ASSERT_TRUE(client.connect("garden-test", nullptr, nullptr, "t/status", 0, true, "offline"));
+    WiFi.setLinkUp(false);
+    TEST_ASSERT_FALSE(client.connected());
+    TEST_ASSERT_EQUAL(MQTT_CONNECTION_LOST, client.state());
+    TEST_ASSERT_EQUAL_STRING("offline", Broker.retained["t/status"].c_str());
+}
+
+void test_injected_message_waits_for_subscription() {
+    joinNetwork();
+    WiFiClient socket;
+    PubSubClient client(socket);
+    client.setCallback(onMessage);
+    TEST_ASSERT_TRUE(client.connect("garden-test", nullptr, nullptr, nullptr, 0, false, nullptr));
+    Broker.inject("t/command", "{\"enable\":true}");
+
+    client.loop();
+    TEST_ASSERT_TRUE(received.empty());
+    TEST_ASSERT_EQUAL(1, Broker.inbound.size());
+
+    client.subscribe("$share/garden/t/command");
+    client.loop();
+    TEST_ASSERT_EQUAL_STRING("{\"enable\":true}", received.c_str());
+    TEST_ASSERT_EQUAL(0, Broker.inbound.size());
+}
+
+void test_preferences_outlive_handles() {
+    Preferences writer;
+    writer.begin("fake", false);
+    uint32_t value = 0xC0FFEE;
+    TEST_ASSERT_EQUAL(sizeof(value), writer.putBytes("key", &value, sizeof(value)));
+    writer.end();
+
+    Preferences reader;
+    reader.begin("fake", true);
+    uint32_t stored = 0;
+    TEST_ASSERT_EQUAL(sizeof(stored), reader.getBytes("key", &stored, sizeof(stored)));
+    TEST_ASSERT_EQUAL_UINT32(value, stored);
+    TEST_ASSERT_EQUAL(0, reader.putBytes("key", &value, sizeof(value)));
+    TEST_ASSERT_FALSE(reader.isKey("other"));
+    reader.end();
+}
+
+int main(int argc, char** argv) {
+    // This thread is the only participant, so every delay() returns at once
+    VirtualClock::join();
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_delay_jumps_clock);
+    RUN_TEST(test_wifi_connects_after_scan_and_dhcp);
+    RUN_TEST(test_broker_enforces_buffer_size);
+    RUN_TEST(test_broker_sends_will_when_link_drops);
+    RUN_TEST(test_injected_message_waits_for_subscription);
+    RUN_TEST(test_preferences_outlive_handles);
+    return UNITY_END();
+}
@@ -0,0 +1,222 @@
+// SampleStore through simulated outages: samples queue in RAM, spill to the
+// LittleFS ring file, survive restarts and replay oldest first, each one
+// exactly once, with only overwritten or corrupt samples counted as dropped.
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+#include <vector>
+
+#include "SampleStore.h"
+
+namespace {
+
+const char* PATH = "/test.q";
+// Queue file layout: the header, then one slot per sample
+const size_t SLOT_SIZE = 8 + TelemetryRecord::SIZE;
+
+uint32_t clockSeconds;
+
+SensorData reading(uint32_t i) {
+    SensorData data = {};
+    data.soilMoisture = (uint16_t)i;
+    data.co2 = (uint16_t)(i >> 16);
+    data.airTemp = 20.0f + (i % 100) * 0.01f;
+    data.validMask = 0x3F;
+    return data;
+}
+
+// One sample every 2 s, like the acquisition task
+uint32_t takeSample(SampleStore& store) {
+    clockSeconds += 2;
+    return store.push(reading(clockSeconds), clockSeconds);
+}
+
+// The network task's replay: batches of up to MAX_BATCH, oldest first,
+// discarded once published. Returns what was delivered.
+std::vector<StoredSample> replay(SampleStore& store, size_t maxBatches = SIZE_MAX) {
+    std::vector<StoredSample> delivered;
+    StoredSample batch[SampleStore::MAX_BATCH];
+    for (size_t i = 0; i < maxBatches; i++) {
+        size_t n = store.peek(batch, SampleStore::MAX_BATCH);
+        if (n == 0) {
+            break;
+        }
+        delivered.insert(delivered.end(), batch, batch + n);
+        store.discard(n);
+    }
+    return delivered;
+}
+
+void assertSample(const StoredSample& sample) {
+    SensorData expected = reading(sample.timestamp);
+    TEST_ASSERT_EQUAL(expected.soilMoisture, sample.data.soilMoisture);
+    TEST_ASSERT_EQUAL(expected.co2, sample.data.co2);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, expected.airTemp, sample.data.airTemp);
+}
+
+size_t headerSize() {
+    // An empty queue file is just the header
+    SampleStore store("/header.q");
+    LittleFS.remove("/header.q");
+    store.begin();
+    File file = LittleFS.open("/header.q", "r");
+    size_t size = file.size();
+    file.close();
+    return size;
+}
+
+}  // namespace
+
+void setUp() {
+    LittleFS.remove(PATH);
+    clockSeconds = 1760000000;
+}
+
+void tearDown() {}
+
+void test_ram_overflow_spills_oldest_half_to_flash() {
+    SampleStore store(PATH);
+    TEST_ASSERT_TRUE(store.begin());
+    for (size_t i = 0; i < SampleStore::RAM_CAPACITY; i++) {
+        takeSample(store);
+    }
+    TEST_ASSERT_EQUAL(0, store.flashCount());
+
+    takeSample(store);
+    TEST_ASSERT_EQUAL(SampleStore::RAM_CAPACITY / 2, store.flashCount());
+    TEST_ASSERT_EQUAL(SampleStore::RAM_CAPACITY + 1, store.size());
+    TEST_ASSERT_EQUAL(0, store.droppedCount());
+
+    std::vector<StoredSample> delivered = replay(store);
+    TEST_ASSERT_EQUAL(SampleStore::RAM_CAPACITY + 1, delivered.size());
+    for (size_t i = 0; i < delivered.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, delivered[i].seq);
+        assertSample(delivered[i]);
+    }
+    TEST_ASSERT_EQUAL(0, store.size());
+}
+
+void test_outages_replay_every_sample_once_in_order() {
+    SampleStore store(PATH);
+    TEST_ASSERT_TRUE(store.begin());
+    std::vector<StoredSample> delivered;
+    uint32_t taken = 0;
+
+    // Outages of 0 to 5300 samples (just under 3 h), each followed by two
+    // hours of link during which the node sends at most two batches per
+    // sample. The ring file wraps past its last slot several times.
+    static const uint32_t OUTAGES[] = { 0, 15, 3600, 1, 1500, 5300, 64, 65, 2000 };
+    for (uint32_t outage : OUTAGES) {
+        for (uint32_t i = 0; i < outage; i++) {
+            takeSample(store);
+            taken++;
+        }
+        for (int i = 0; i < 3600; i++) {
+            takeSample(store);
+            taken++;
+            std::vector<StoredSample> sent = replay(store, 2);
+            delivered.insert(delivered.end(), sent.begin(), sent.end());
+        }
+    }
+
+    TEST_ASSERT_EQUAL(0, store.size());
+    TEST_ASSERT_EQUAL(0, store.droppedCount());
+    TEST_ASSERT_EQUAL(taken, delivered.size());
+    for (size_t i = 0; i < delivered.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, delivered[i].seq);
+        assertSample(delivered[i]);
+    }
+}
+
+void test_outage_longer_than_flash_drops_oldest() {
+    SampleStore store(PATH);
+    TEST_ASSERT_TRUE(store.begin());
+    const uint32_t extra = 777;
+    uint32_t taken = SampleStore::FLASH_CAPACITY + SampleStore::RAM_CAPACITY + extra;
+    for (uint32_t i = 0; i < taken; i++) {
+        takeSample(store);
+    }
+    TEST_ASSERT_EQUAL(SampleStore::FLASH_CAPACITY, store.flashCount());
+    TEST_ASSERT_EQUAL(taken - store.size(), store.droppedCount());
+
+    std::vector<StoredSample> delivered = replay(store);
+    TEST_ASSERT_EQUAL(taken - store.droppedCount(), delivered.size());
+    // Only the oldest went, and the rest is contiguous
+    for (size_t i = 0; i < delivered.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT32(store.droppedCount() + i, delivered[i].seq);
+        assertSample(delivered[i]);
+    }
+}
+
+void test_corrupt_head_slot_is_dropped() {
+    SampleStore store(PATH);
+    TEST_ASSERT_TRUE(store.begin());
+    for (size_t i = 0; i < SampleStore::RAM_CAPACITY + 1; i++) {
+        takeSample(store);
+    }
+    TEST_ASSERT_EQUAL(SampleStore::RAM_CAPACITY / 2, store.flashCount());
+
+    // The head is slot 0; break its record's version byte and the next
+    // slot's, as a torn flash write would
+    File file = LittleFS.open(PATH, "r+");
+    uint8_t bad = 0xEE;
+    for (size_t slot = 0; slot < 2; slot++) {
+        TEST_ASSERT_TRUE(file.seek(headerSize() + slot * SLOT_SIZE + 8));
+        TEST_ASSERT_EQUAL(1, file.write(&bad, 1));
+    }
+    file.close();
+
+    std::vector<StoredSample> delivered = replay(store);
+    TEST_ASSERT_EQUAL(2, store.droppedCount());
+    TEST_ASSERT_EQUAL(SampleStore::RAM_CAPACITY - 1, delivered.size());
+    for (size_t i = 0; i < delivered.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT32(i + 2, delivered[i].seq);
+        assertSample(delivered[i]);
+    }
+    TEST_ASSERT_EQUAL(0, store.size());
+}
+
+void test_restart_mid_outage_replays_in_order_without_reusing_seq() {
+    uint32_t firstRun;
+    {
+        SampleStore store(PATH);
+        TEST_ASSERT_TRUE(store.begin());
+        for (int i = 0; i < 1000; i++) {
+            takeSample(store);
+        }
+        // One batch went out before the restart
+        replay(store, 1);
+        firstRun = store.size();
+        store.persist();
+        TEST_ASSERT_EQUAL(firstRun, store.flashCount());
+    }
+
+    SampleStore store(PATH);
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_EQUAL(firstRun, store.size());
+    for (int i = 0; i < 500; i++) {
+        takeSample(store);
+    }
+    std::vector<StoredSample> delivered = replay(store);
+    TEST_ASSERT_EQUAL(firstRun + 500, delivered.size());
+    TEST_ASSERT_EQUAL_UINT32(SampleStore::MAX_BATCH, delivered[0].seq);
+    for (size_t i = 1; i < delivered.size(); i++) {
+        TEST_ASSERT_GREATER_THAN(delivered[i - 1].seq, delivered[i].seq);
+        TEST_ASSERT_GREATER_THAN(delivered[i - 1].timestamp, delivered[i].timestamp);
+        assertSample(delivered[i]);
+    }
+    // Samples taken after the restart get numbers the first run never used
+    TEST_ASSERT_GREATER_OR_EQUAL(1000, delivered[firstRun].seq);
+    TEST_ASSERT_EQUAL(0, store.droppedCount());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_ram_overflow_spills_oldest_half_to_flash);
+    RUN_TEST(test_outages_replay_every_sample_once_in_order);
+    RUN_TEST(test_outage_longer_than_flash_drops_oldest);
+    RUN_TEST(test_corrupt_head_slot_is_dropped);
+    RUN_TEST(test_restart_mid_outage_replays_in_order_without_reusing_seq);
+    return UNITY_END();
+}
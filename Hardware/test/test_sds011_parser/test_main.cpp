@@ -0,0 +1,240 @@
+// Sds011Parser on byte streams as the UART delivers them: clean frames,
+// corrupted, truncated and misaligned ones, command replies and line noise.
+// Every intact data frame is decoded, in order, and nothing else is; the
+// frame statistics count what was dropped.
+
+#include <unity.h>
+#include <vector>
+
+#include "Sds011Parser.h"
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+// The datasheet's example frame: PM2.5 123.6, PM10 261.8, sensor A160
+const uint8_t DATASHEET_FRAME[] = { 0xAA, 0xC0, 0xD4, 0x04, 0x3A, 0x0A, 0xA1, 0x60, 0x1D, 0xAB };
+
+// Reply to a set-sleep command, checksum valid
+const uint8_t SLEEP_REPLY[] = { 0xAA, 0xC5, 0x06, 0x01, 0x00, 0x00, 0xA1, 0x60, 0x08, 0xAB };
+
+struct Reading {
+    uint16_t pm25;   // tenths of ug/m3, as sent
+    uint16_t pm10;
+};
+
+Bytes frame(Reading reading) {
+    Bytes bytes = {
+        0xAA, 0xC0,
+        (uint8_t)reading.pm25, (uint8_t)(reading.pm25 >> 8),
+        (uint8_t)reading.pm10, (uint8_t)(reading.pm10 >> 8),
+        0xA1, 0x60, 0, 0xAB
+    };
+    uint8_t sum = 0;
+    for (size_t i = 2; i < 8; i++) {
+        sum += bytes[i];
+    }
+    bytes[8] = sum;
+    return bytes;
+}
+
+void append(Bytes& stream, const Bytes& bytes) {
+    stream.insert(stream.end(), bytes.begin(), bytes.end());
+}
+
+void append(Bytes& stream, const uint8_t* bytes, size_t length) {
+    stream.insert(stream.end(), bytes, bytes + length);
+}
+
+// Feeds the stream one byte per millisecond; returns the readings decoded
+std::vector<Reading> feed(Sds011Parser& parser, const Bytes& stream) {
+    std::vector<Reading> decoded;
+    unsigned long now = 1000;
+    for (uint8_t byte : stream) {
+        if (parser.feed(byte, now)) {
+            float pm25;
+            float pm10;
+            unsigned long at;
+            TEST_ASSERT_TRUE(parser.latest(pm25, pm10, at));
+            TEST_ASSERT_EQUAL(now, at);
+            Reading reading = { (uint16_t)(pm25 * 10 + 0.5f), (uint16_t)(pm10 * 10 + 0.5f) };
+            decoded.push_back(reading);
+        }
+        now++;
+    }
+    return decoded;
+}
+
+void assertReadings(const std::vector<Reading>& expected, const std::vector<Reading>& decoded) {
+    TEST_ASSERT_EQUAL(expected.size(), decoded.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT16(expected[i].pm25, decoded[i].pm25);
+        TEST_ASSERT_EQUAL_UINT16(expected[i].pm10, decoded[i].pm10);
+    }
+}
+
+uint32_t xorshift(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_datasheet_frame_decodes() {
+    Sds011Parser parser;
+    float pm25;
+    float pm10;
+    unsigned long at;
+    TEST_ASSERT_FALSE(parser.latest(pm25, pm10, at));
+
+    Bytes stream(DATASHEET_FRAME, DATASHEET_FRAME + sizeof(DATASHEET_FRAME));
+    assertReadings({ { 1236, 2618 } }, feed(parser, stream));
+    TEST_ASSERT_TRUE(parser.latest(pm25, pm10, at));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 123.6f, pm25);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 261.8f, pm10);
+    TEST_ASSERT_EQUAL_UINT32(1, parser.frameCount());
+    TEST_ASSERT_EQUAL_UINT32(0, parser.badFrameCount());
+}
+
+void test_replies_and_noise_between_frames_are_skipped() {
+    Sds011Parser parser;
+    Bytes stream = { 0x00, 0xFF, 0x13, 0xAB };
+    append(stream, frame({ 79, 122 }));
+    append(stream, SLEEP_REPLY, sizeof(SLEEP_REPLY));
+    stream.push_back(0x42);
+    append(stream, frame({ 80, 125 }));
+
+    assertReadings({ { 79, 122 }, { 80, 125 } }, feed(parser, stream));
+    TEST_ASSERT_EQUAL_UINT32(2, parser.frameCount());
+    TEST_ASSERT_EQUAL_UINT32(0, parser.badFrameCount());
+}
+
+void test_corrupted_checksum_and_tail_cost_one_frame_each() {
+    Sds011Parser parser;
+    Bytes badChecksum = frame({ 500, 600 });
+    badChecksum[8] ^= 0x01;
+    Bytes badTail = frame({ 501, 601 });
+    badTail[9] = 0xAA;
+    Bytes badData = frame({ 502, 602 });
+    badData[3] ^= 0x40;
+
+    Bytes stream;
+    append(stream, frame({ 1, 2 }));
+    append(stream, badChecksum);
+    append(stream, frame({ 3, 4 }));
+    append(stream, badTail);
+    append(stream, frame({ 5, 6 }));
+    append(stream, badData);
+    append(stream, frame({ 7, 8 }));
+
+    assertReadings({ { 1, 2 }, { 3, 4 }, { 5, 6 }, { 7, 8 } }, feed(parser, stream));
+    TEST_ASSERT_EQUAL_UINT32(4, parser.frameCount());
+    // The stray AA in place of a tail starts a frame of its own, which the
+    // following AA breaks
+    TEST_ASSERT_EQUAL_UINT32(4, parser.badFrameCount());
+}
+
+void test_truncated_frame_does_not_swallow_the_next() {
+    // Bytes lost mid-frame: the stub runs into the next frame's header,
+    // which the parser restarts from once the stub fails
+    for (size_t kept = 1; kept < Sds011Parser::FRAME_SIZE; kept++) {
+        Sds011Parser parser;
+        Bytes truncated = frame({ 900, 950 });
+        truncated.resize(kept);
+
+        Bytes stream;
+        append(stream, frame({ 10, 20 }));
+        append(stream, truncated);
+        append(stream, frame({ 11, 21 }));
+        append(stream, frame({ 12, 22 }));
+
+        assertReadings({ { 10, 20 }, { 11, 21 }, { 12, 22 } }, feed(parser, stream));
+        TEST_ASSERT_EQUAL_UINT32(3, parser.frameCount());
+        TEST_ASSERT_EQUAL_UINT32(1, parser.badFrameCount());
+    }
+}
+
+void test_capture_starting_mid_frame_aligns_on_next_frame() {
+    // Readings whose bytes look like a frame header: 0xC0AA is PM2.5 4929.0
+    Bytes tricky = frame({ 0xC0AA, 0xC0AA });
+    for (size_t offset = 1; offset < Sds011Parser::FRAME_SIZE; offset++) {
+        Sds011Parser parser;
+        Bytes stream(tricky.begin() + offset, tricky.end());
+        append(stream, frame({ 30, 40 }));
+        append(stream, tricky);
+
+        assertReadings({ { 30, 40 }, { 0xC0AA, 0xC0AA } }, feed(parser, stream));
+        TEST_ASSERT_EQUAL_UINT32(2, parser.frameCount());
+        // Only a false header inside the partial frame counts as a bad frame
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(2, parser.badFrameCount());
+    }
+}
+
+void test_reset_discards_partial_frame() {
+    Sds011Parser parser;
+    Bytes first = frame({ 70, 80 });
+    for (size_t i = 0; i < 6; i++) {
+        parser.feed(first[i], 0);
+    }
+    // Sensor put to sleep mid-frame; after waking, the stream starts afresh
+    parser.reset();
+    assertReadings({ { 71, 81 } }, feed(parser, frame({ 71, 81 })));
+    TEST_ASSERT_EQUAL_UINT32(0, parser.badFrameCount());
+}
+
+void test_long_recording_with_random_damage() {
+    // An hour at one frame per second: about one frame in eight hit by a
+    // flipped, lost or inserted byte. Intact frames all come through, in
+    // order; damaged ones never produce a reading.
+    Sds011Parser parser;
+    uint32_t state = 0x3C6EF372;
+    Bytes stream;
+    std::vector<Reading> intact;
+    uint32_t damaged = 0;
+    for (int i = 0; i < 3600; i++) {
+        Reading reading = { (uint16_t)(xorshift(state) % 10000), (uint16_t)(xorshift(state) % 20000) };
+        Bytes bytes = frame(reading);
+        // Line noise between frames now and then
+        if (xorshift(state) % 16 == 0) {
+            stream.push_back((uint8_t)xorshift(state));
+        }
+        if (i == 0 || xorshift(state) % 8 != 0) {
+            append(stream, bytes);
+            intact.push_back(reading);
+            continue;
+        }
+        damaged++;
+        size_t at = xorshift(state) % bytes.size();
+        switch (xorshift(state) % 3) {
+            case 0: bytes[at] ^= (uint8_t)(1 + xorshift(state) % 255); break;
+            case 1: bytes.erase(bytes.begin() + at); break;
+            // Inside the frame: before its head it is only more noise
+            default: bytes.insert(bytes.begin() + 1 + at % 8, (uint8_t)xorshift(state)); break;
+        }
+        append(stream, bytes);
+    }
+
+    // Noise bytes that happen to be AA can also open a bad frame
+    std::vector<Reading> decoded = feed(parser, stream);
+    assertReadings(intact, decoded);
+    TEST_ASSERT_EQUAL_UINT32(intact.size(), parser.frameCount());
+    TEST_ASSERT_GREATER_THAN(0, parser.badFrameCount());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(3 * damaged + 3600 / 16, parser.badFrameCount());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_datasheet_frame_decodes);
+    RUN_TEST(test_replies_and_noise_between_frames_are_skipped);
+    RUN_TEST(test_corrupted_checksum_and_tail_cost_one_frame_each);
+    RUN_TEST(test_truncated_frame_does_not_swallow_the_next);
+    RUN_TEST(test_capture_starting_mid_frame_aligns_on_next_frame);
+    RUN_TEST(test_reset_discards_partial_frame);
+    RUN_TEST(test_long_recording_with_random_damage);
+    return UNITY_END();
+}
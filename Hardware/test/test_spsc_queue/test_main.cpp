@@ -0,0 +1,172 @@
+// SpscQueue under a real producer and consumer thread: millions of items
+// arrive in order, none lost or duplicated, none torn, and every rejected
+// push is counted as a drop.
+
+#include <unity.h>
+#include <atomic>
+#include <thread>
+
+#include "SpscQueue.h"
+
+namespace {
+
+const uint32_t ITEMS = 4000000;
+const size_t WORDS = 7;
+
+// Large enough that a torn copy would mix two items' words
+struct Item {
+    uint32_t seq;
+    uint32_t words[WORDS];
+};
+
+Item makeItem(uint32_t seq) {
+    Item item;
+    item.seq = seq;
+    for (size_t i = 0; i < WORDS; i++) {
+        item.words[i] = seq * 2654435761u + (uint32_t)i;
+    }
+    return item;
+}
+
+bool intact(const Item& item) {
+    for (size_t i = 0; i < WORDS; i++) {
+        if (item.words[i] != item.seq * 2654435761u + (uint32_t)i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// What the consumer saw; checked on the test thread once it has joined
+struct Received {
+    uint32_t count = 0;
+    uint32_t outOfOrder = 0;     // not greater than the one before
+    uint32_t torn = 0;
+    uint32_t last = 0;
+    bool any = false;
+
+    void add(const Item& item) {
+        if (any && item.seq <= last) {
+            outOfOrder++;
+        }
+        if (!intact(item)) {
+            torn++;
+        }
+        last = item.seq;
+        any = true;
+        count++;
+    }
+};
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_producer_retrying_loses_nothing() {
+    static SpscQueue<Item, 64> queue;
+    std::atomic<bool> done(false);
+    uint32_t rejected = 0;
+    Received received;
+
+    std::thread consumer([&]() {
+        Item item;
+        for (;;) {
+            if (queue.pop(item)) {
+                received.add(item);
+            } else if (done.load(std::memory_order_acquire) && queue.size() == 0) {
+                break;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (uint32_t seq = 0; seq < ITEMS; seq++) {
+        Item item = makeItem(seq);
+        while (!queue.push(item)) {
+            rejected++;
+            std::this_thread::yield();
+        }
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(ITEMS, received.count);
+    TEST_ASSERT_EQUAL_UINT32(ITEMS - 1, received.last);
+    TEST_ASSERT_EQUAL_UINT32(0, received.outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, received.torn);
+    TEST_ASSERT_EQUAL_UINT32(rejected, queue.dropCount());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(queue.capacity(), queue.highWaterMark());
+    TEST_ASSERT_GREATER_THAN(0, queue.highWaterMark());
+}
+
+void test_dropping_producer_delivers_accepted_items_once() {
+    static SpscQueue<Item, 16> queue;
+    std::atomic<bool> done(false);
+    uint32_t accepted = 0;
+    Received received;
+
+    // The consumer peeks and removes in place, like the network task
+    std::thread consumer([&]() {
+        for (;;) {
+            Item* item = queue.front();
+            if (item != nullptr) {
+                received.add(*item);
+                queue.popFront();
+            } else if (done.load(std::memory_order_acquire) && queue.size() == 0) {
+                break;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (uint32_t seq = 0; seq < ITEMS; seq++) {
+        if (queue.push(makeItem(seq))) {
+            accepted++;
+        }
+        // Give the consumer a chance now and then, so both paths run
+        if ((seq & 255) == 0) {
+            std::this_thread::yield();
+        }
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(accepted, received.count);
+    TEST_ASSERT_EQUAL_UINT32(ITEMS - accepted, queue.dropCount());
+    TEST_ASSERT_EQUAL_UINT32(0, received.outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, received.torn);
+    TEST_ASSERT_GREATER_THAN(0, accepted);
+    TEST_ASSERT_EQUAL_UINT32(queue.capacity(), queue.highWaterMark());
+}
+
+void test_full_queue_rejects_until_consumer_frees_a_slot() {
+    SpscQueue<Item, 4> queue;
+    for (uint32_t seq = 0; seq < 4; seq++) {
+        TEST_ASSERT_TRUE(queue.push(makeItem(seq)));
+    }
+    TEST_ASSERT_FALSE(queue.push(makeItem(4)));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.dropCount());
+    TEST_ASSERT_EQUAL(4, queue.size());
+
+    Item item;
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL_UINT32(0, item.seq);
+    TEST_ASSERT_TRUE(queue.push(makeItem(5)));
+    static const uint32_t REMAINING[] = { 1, 2, 3, 5 };
+    for (uint32_t expected : REMAINING) {
+        TEST_ASSERT_TRUE(queue.pop(item));
+        TEST_ASSERT_EQUAL_UINT32(expected, item.seq);
+    }
+    TEST_ASSERT_FALSE(queue.pop(item));
+    TEST_ASSERT_NULL(queue.front());
+    TEST_ASSERT_EQUAL_UINT32(4, queue.highWaterMark());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_producer_retrying_loses_nothing);
+    RUN_TEST(test_dropping_producer_delivers_accepted_items_once);
+    RUN_TEST(test_full_queue_rejects_until_consumer_frees_a_slot);
+    return UNITY_END();
+}
@@ -0,0 +1,239 @@
+// TelemetryRecord: samples survive encode and the decode telemetry_decode
+// runs (TelemetryRecord::decode, then the serializer for its JSON output),
+// records of other versions or cut short are refused, and the record is
+// compared with the JSON payload for size and speed.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <chrono>
+
+#include "TelemetryRecord.h"
+#include "TelemetrySerializer.h"
+
+namespace {
+
+SensorData typicalSample() {
+    SensorData data = {};
+    data.soilTemp = 18.4375f;
+    data.soilMoisture = 612;
+    data.airTemp = 21.3f;
+    data.humidity = 48.7f;
+    data.h2Value = 1833;
+    data.h2Voltage = 1.4768f;
+    data.co2 = 415;
+    data.tvoc = 3;
+    data.targetCount = 1;
+    data.speed = -0.27f;
+    data.distance = 2.315f;
+    data.energy = 4821;
+    data.pm25 = 7.9f;
+    data.pm10 = 12.25f;
+    data.validMask = 0x2F;
+    const uint16_t AGES[SENSOR_CHANNEL_COUNT] = { 12, 3, 0, 9, 1, SENSOR_AGE_UNKNOWN };
+    memcpy(data.ageDeciseconds, AGES, sizeof(AGES));
+    return data;
+}
+
+uint32_t xorshift(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+float randomReading(uint32_t& state, float range) {
+    return ((float)(xorshift(state) % 2000001) / 1000000.0f - 1.0f) * range;
+}
+
+// A float field after the round trip: hundredths, rounded half away from zero
+void assertHundredths(float original, float decoded) {
+    if (isnan(original)) {
+        TEST_ASSERT_TRUE(isnan(decoded));
+        return;
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.005f + fabsf(original) * 1e-6f, original, decoded);
+}
+
+template <typename Fn>
+double nsPerCall(Fn fn, int calls) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+        fn();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_decoded_record_prints_the_live_payload() {
+    SensorData data = typicalSample();
+    uint8_t record[TelemetryRecord::SIZE];
+    TEST_ASSERT_EQUAL(TelemetryRecord::SIZE, TelemetryRecord::encode(data, record, sizeof(record)));
+    TEST_ASSERT_EQUAL(TelemetryRecord::VERSION, record[0]);
+
+    SensorData decoded = {};
+    TEST_ASSERT_TRUE(TelemetryRecord::decode(record, sizeof(record), decoded));
+    char live[512];
+    char fromRecord[512];
+    TEST_ASSERT_GREATER_THAN(0, TelemetrySerializer::serialize(data, live, sizeof(live)));
+    TEST_ASSERT_GREATER_THAN(0, TelemetrySerializer::serialize(decoded, fromRecord, sizeof(fromRecord)));
+    TEST_ASSERT_EQUAL_STRING(live, fromRecord);
+}
+
+void test_random_samples_round_trip() {
+    uint32_t state = 0x9E3779B9;
+    for (int i = 0; i < 100000; i++) {
+        SensorData data = {};
+        data.soilTemp = randomReading(state, 60.0f);
+        data.soilMoisture = (uint16_t)xorshift(state);
+        data.airTemp = randomReading(state, 60.0f);
+        data.humidity = randomReading(state, 100.0f);
+        data.h2Value = (int)(xorshift(state) % 4096);
+        data.h2Voltage = randomReading(state, 3.3f);
+        data.co2 = (uint16_t)xorshift(state);
+        data.tvoc = (uint16_t)xorshift(state);
+        data.targetCount = (uint8_t)xorshift(state);
+        data.speed = randomReading(state, 10.0f);
+        data.distance = randomReading(state, 20.0f);
+        data.energy = (uint16_t)xorshift(state);
+        data.pm25 = randomReading(state, 999.9f);
+        data.pm10 = randomReading(state, 1999.9f);
+        data.validMask = (uint8_t)(xorshift(state) & 0x3F);
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            data.ageDeciseconds[c] = (uint16_t)xorshift(state);
+        }
+        // Failed reads
+        if (i % 7 == 0) {
+            data.airTemp = NAN;
+            data.humidity = NAN;
+        }
+
+        uint8_t record[TelemetryRecord::SIZE];
+        TelemetryRecord::encode(data, record, sizeof(record));
+        SensorData decoded;
+        memset(&decoded, 0xA5, sizeof(decoded));
+        TEST_ASSERT_TRUE(TelemetryRecord::decode(record, sizeof(record), decoded));
+
+        assertHundredths(data.soilTemp, decoded.soilTemp);
+        assertHundredths(data.airTemp, decoded.airTemp);
+        assertHundredths(data.humidity, decoded.humidity);
+        assertHundredths(data.h2Voltage, decoded.h2Voltage);
+        assertHundredths(data.speed, decoded.speed);
+        assertHundredths(data.distance, decoded.distance);
+        assertHundredths(data.pm25, decoded.pm25);
+        assertHundredths(data.pm10, decoded.pm10);
+        TEST_ASSERT_EQUAL(data.soilMoisture, decoded.soilMoisture);
+        TEST_ASSERT_EQUAL(data.h2Value, decoded.h2Value);
+        TEST_ASSERT_EQUAL(data.co2, decoded.co2);
+        TEST_ASSERT_EQUAL(data.tvoc, decoded.tvoc);
+        TEST_ASSERT_EQUAL(data.targetCount, decoded.targetCount);
+        TEST_ASSERT_EQUAL(data.energy, decoded.energy);
+        TEST_ASSERT_EQUAL(data.validMask, decoded.validMask);
+        TEST_ASSERT_EQUAL(0, decoded.faultMask);
+        TEST_ASSERT_EQUAL_MEMORY(data.ageDeciseconds, decoded.ageDeciseconds, sizeof(data.ageDeciseconds));
+    }
+}
+
+void test_out_of_range_values_saturate() {
+    SensorData data = typicalSample();
+    data.soilTemp = INFINITY;
+    data.airTemp = -INFINITY;
+    data.humidity = 3e7f;
+    data.h2Value = 100000;
+    data.h2Voltage = -1e9f;
+    data.pm25 = NAN;
+
+    uint8_t record[TelemetryRecord::SIZE];
+    TelemetryRecord::encode(data, record, sizeof(record));
+    SensorData decoded = {};
+    TEST_ASSERT_TRUE(TelemetryRecord::decode(record, sizeof(record), decoded));
+    TEST_ASSERT_TRUE(isinf(decoded.soilTemp) && decoded.soilTemp > 0);
+    TEST_ASSERT_TRUE(isinf(decoded.airTemp) && decoded.airTemp < 0);
+    TEST_ASSERT_TRUE(isinf(decoded.humidity) && decoded.humidity > 0);
+    TEST_ASSERT_TRUE(isinf(decoded.h2Voltage) && decoded.h2Voltage < 0);
+    TEST_ASSERT_TRUE(isnan(decoded.pm25));
+    TEST_ASSERT_EQUAL(INT16_MAX, decoded.h2Value);
+}
+
+void test_version_1_record_decodes_without_freshness() {
+    SensorData data = typicalSample();
+    uint8_t record[TelemetryRecord::SIZE];
+    TelemetryRecord::encode(data, record, sizeof(record));
+    // Version 1 had the same fields, a zero flags byte and no ages
+    record[0] = 1;
+    record[1] = 0;
+
+    SensorData decoded = {};
+    TEST_ASSERT_TRUE(TelemetryRecord::decode(record, TelemetryRecord::V1_SIZE, decoded));
+    TEST_ASSERT_EQUAL((1 << SENSOR_CHANNEL_COUNT) - 1, decoded.validMask);
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        TEST_ASSERT_EQUAL(SENSOR_AGE_UNKNOWN, decoded.ageDeciseconds[c]);
+    }
+    TEST_ASSERT_EQUAL(data.co2, decoded.co2);
+    assertHundredths(data.pm10, decoded.pm10);
+}
+
+void test_unknown_versions_are_refused() {
+    uint8_t record[TelemetryRecord::SIZE + 8];
+    TelemetryRecord::encode(typicalSample(), record, sizeof(record));
+    static const uint8_t VERSIONS[] = { 0, TelemetryRecord::VERSION + 1, 0x7B, 0xFF };
+    for (uint8_t version : VERSIONS) {
+        record[0] = version;
+        SensorData decoded = {};
+        TEST_ASSERT_FALSE(TelemetryRecord::decode(record, sizeof(record), decoded));
+    }
+}
+
+void test_truncated_records_are_refused() {
+    uint8_t record[TelemetryRecord::SIZE];
+    TelemetryRecord::encode(typicalSample(), record, sizeof(record));
+    SensorData decoded = {};
+    for (size_t length = 0; length < TelemetryRecord::SIZE; length++) {
+        TEST_ASSERT_FALSE(TelemetryRecord::decode(record, length, decoded));
+    }
+    record[0] = 1;
+    for (size_t length = 0; length < TelemetryRecord::V1_SIZE; length++) {
+        TEST_ASSERT_FALSE(TelemetryRecord::decode(record, length, decoded));
+    }
+    TEST_ASSERT_EQUAL(0, TelemetryRecord::encode(typicalSample(), record, TelemetryRecord::SIZE - 1));
+}
+
+void test_record_is_smaller_and_faster_than_json() {
+    SensorData data = typicalSample();
+    char json[512];
+    uint8_t record[TelemetryRecord::SIZE];
+    const int CALLS = 100000;
+    size_t jsonLength = TelemetrySerializer::serialize(data, json, sizeof(json));
+
+    size_t sink = 0;
+    double jsonNs = nsPerCall([&]() { sink += TelemetrySerializer::serialize(data, json, sizeof(json)); }, CALLS);
+    double encodeNs = nsPerCall([&]() { sink += TelemetryRecord::encode(data, record, sizeof(record)); }, CALLS);
+    SensorData decoded;
+    double decodeNs = nsPerCall([&]() { sink += TelemetryRecord::decode(record, sizeof(record), decoded); }, CALLS);
+
+    char report[160];
+    snprintf(report, sizeof(report), "json %u B %.0f ns; record %u B, encode %.0f ns, decode %.0f ns",
+             (unsigned)jsonLength, jsonNs, (unsigned)TelemetryRecord::SIZE, encodeNs, decodeNs);
+    TEST_MESSAGE(report);
+    TEST_ASSERT_GREATER_THAN(0, sink);
+    TEST_ASSERT_LESS_THAN(60, TelemetryRecord::SIZE);
+    TEST_ASSERT_LESS_THAN(jsonLength / 4, TelemetryRecord::SIZE);
+    TEST_ASSERT_TRUE(encodeNs < jsonNs);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_decoded_record_prints_the_live_payload);
+    RUN_TEST(test_random_samples_round_trip);
+    RUN_TEST(test_out_of_range_values_saturate);
+    RUN_TEST(test_version_1_record_decodes_without_freshness);
+    RUN_TEST(test_unknown_versions_are_refused);
+    RUN_TEST(test_truncated_records_are_refused);
+    RUN_TEST(test_record_is_smaller_and_faster_than_json);
+    return UNITY_END();
+}
@@ -0,0 +1,304 @@
+// TelemetrySerializer and JsonWriter against the payload the firmware used
+// to build with String concatenation: the same keys in the same order and
+// the same number formatting, byte for byte. Ends with a timing of both.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <chrono>
+#include <string>
+
+#include "HeapStats.h"
+#include "JsonWriter.h"
+#include "TelemetrySerializer.h"
+
+namespace {
+
+// dtostrf() as in the ESP32 Arduino core, which String(float) called with
+// a width of decimals + 2
+char* coreDtostrf(double number, int width, unsigned int prec, char* s) {
+    bool negative = false;
+    if (isnan(number)) {
+        strcpy(s, "nan");
+        return s;
+    }
+    if (isinf(number)) {
+        strcpy(s, "inf");
+        return s;
+    }
+    char* out = s;
+    int fillme = width;
+    if (prec > 0) {
+        fillme -= (prec + 1);
+    }
+    if (number < 0.0) {
+        negative = true;
+        fillme--;
+        number = -number;
+    }
+    double rounding = 2.0;
+    for (unsigned int i = 0; i < prec; ++i) {
+        rounding *= 10.0;
+    }
+    rounding = 1.0 / rounding;
+    number += rounding;
+    double tenpow = 1.0;
+    int digitcount = 1;
+    while (number >= 10.0 * tenpow) {
+        tenpow *= 10.0;
+        digitcount++;
+    }
+    number /= tenpow;
+    fillme -= digitcount;
+    while (fillme-- > 0) {
+        *out++ = ' ';
+    }
+    if (negative) {
+        *out++ = '-';
+    }
+    digitcount += prec;
+    int8_t digit = 0;
+    while (digitcount-- > 0) {
+        digit = (int8_t)number;
+        if (digit > 9) {
+            digit = 9;
+        }
+        *out++ = (char)('0' | digit);
+        if ((digitcount == (int)prec) && (prec > 0)) {
+            *out++ = '.';
+        }
+        number -= digit;
+        number *= 10.0;
+    }
+    *out = 0;
+    return s;
+}
+
+std::string legacyFloat(float value) {
+    char buf[64];
+    return coreDtostrf(value, 4, 2, buf);
+}
+
+// MQTTManager::publish(const SensorData&) before the serializer
+std::string legacyPayload(const SensorData& data) {
+    std::string jsonPayload = "{";
+    jsonPayload += "\"soil_temperature\":" + legacyFloat(data.soilTemp) + ",";
+    jsonPayload += "\"soil_moisture\":" + std::to_string(data.soilMoisture) + ",";
+    jsonPayload += "\"air_temperature\":" + legacyFloat(data.airTemp) + ",";
+    jsonPayload += "\"humidity\":" + legacyFloat(data.humidity) + ",";
+    jsonPayload += "\"hydrogen_raw\":" + std::to_string(data.h2Value) + ",";
+    jsonPayload += "\"hydrogen_voltage\":" + legacyFloat(data.h2Voltage) + ",";
+    jsonPayload += "\"co2\":" + std::to_string(data.co2) + ",";
+    jsonPayload += "\"tvoc\":" + std::to_string(data.tvoc) + ",";
+    jsonPayload += "\"target_count\":" + std::to_string(data.targetCount) + ",";
+    jsonPayload += "\"target_speed\":" + legacyFloat(data.speed) + ",";
+    jsonPayload += "\"target_distance\":" + legacyFloat(data.distance) + ",";
+    jsonPayload += "\"target_energy\":" + std::to_string(data.energy) + ",";
+    jsonPayload += "\"pm25\":" + legacyFloat(data.pm25) + ",";
+    jsonPayload += "\"pm10\":" + legacyFloat(data.pm10);
+    jsonPayload += "}";
+    return jsonPayload;
+}
+
+// The telemetry fields alone, as the old payload had them
+std::string fieldsOnly(const SensorData& data) {
+    char buf[512];
+    JsonWriter json(buf, sizeof(buf));
+    json.beginObject();
+    TelemetrySerializer::writeFields(json, data);
+    json.endObject();
+    TEST_ASSERT_TRUE(json.ok());
+    return buf;
+}
+
+std::string written(float value) {
+    char buf[64];
+    JsonWriter json(buf, sizeof(buf));
+    json.value(value);
+    return buf;
+}
+
+SensorData typicalSample() {
+    SensorData data = {};
+    data.soilTemp = 18.4375f;
+    data.soilMoisture = 612;
+    data.airTemp = 21.3f;
+    data.humidity = 48.7f;
+    data.h2Value = 1833;
+    data.h2Voltage = 1.4768f;
+    data.co2 = 415;
+    data.tvoc = 3;
+    data.targetCount = 1;
+    data.speed = -0.27f;
+    data.distance = 2.315f;
+    data.energy = 4821;
+    data.pm25 = 7.9f;
+    data.pm10 = 12.25f;
+    data.validMask = 0x3F;
+    return data;
+}
+
+uint32_t xorshift(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+template <typename Fn>
+double nsPerCall(Fn fn, int calls) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+        fn();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_typical_sample_matches_legacy_payload() {
+    SensorData data = typicalSample();
+    TEST_ASSERT_EQUAL_STRING(legacyPayload(data).c_str(), fieldsOnly(data).c_str());
+}
+
+void test_invalid_readings_match_legacy_payload() {
+    SensorData data = typicalSample();
+    // Failed reads leave NaN, which the old payload printed as a bare nan
+    data.soilTemp = NAN;
+    data.airTemp = NAN;
+    data.humidity = -NAN;
+    data.h2Voltage = INFINITY;
+    data.pm25 = -INFINITY;
+    data.h2Value = -1;
+    data.soilMoisture = 65535;
+    data.targetCount = 255;
+    TEST_ASSERT_EQUAL_STRING(legacyPayload(data).c_str(), fieldsOnly(data).c_str());
+
+    SensorData empty = {};
+    TEST_ASSERT_EQUAL_STRING(legacyPayload(empty).c_str(), fieldsOnly(empty).c_str());
+}
+
+void test_rounding_edges_match_dtostrf() {
+    static const float VALUES[] = {
+        0.0f, -0.0f, 1.999f, 1.995f, 1.994999f, 0.005f, 0.004999f, -0.004f, -0.005f,
+        0.125f, -0.125f, 2.675f, 9.995f, 99.995f, 999.995f, 0.01f, 0.1f, 0.3f,
+        1e-9f, -1e-9f, 65535.0f, 123456.789f, 540391.375f, 1716927.125f,
+        4294967296.0f, 1e20f, -3.4e38f, 3.4e38f
+    };
+    for (float value : VALUES) {
+        char message[48];
+        snprintf(message, sizeof(message), "%.9g", value);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(legacyFloat(value).c_str(), written(value).c_str(), message);
+    }
+    TEST_ASSERT_EQUAL_STRING("nan", written(NAN).c_str());
+    // dtostrf checks for infinity before the sign
+    TEST_ASSERT_EQUAL_STRING("inf", written(-INFINITY).c_str());
+}
+
+void test_random_floats_match_dtostrf() {
+    uint32_t state = 0x2545F491;
+    for (int i = 0; i < 1000000; i++) {
+        uint32_t bits = xorshift(state);
+        float value;
+        if (i % 2) {
+            memcpy(&value, &bits, sizeof(value));
+        } else {
+            // Sensor-like magnitudes with few fraction bits, where ties are common
+            value = (float)(int32_t)bits / (float)(1u << (bits % 24));
+        }
+        std::string expected = legacyFloat(value);
+        std::string actual = written(value);
+        if (expected != actual) {
+            char message[48];
+            snprintf(message, sizeof(message), "%.9g", value);
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.c_str(), actual.c_str(), message);
+        }
+    }
+}
+
+void test_serialize_appends_freshness_to_legacy_fields() {
+    SensorData data = typicalSample();
+    data.faultMask = 0x04;
+    for (size_t i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        data.ageDeciseconds[i] = (uint16_t)(i * 7);
+    }
+    data.ageDeciseconds[SENSOR_SDS011] = SENSOR_AGE_UNKNOWN;
+
+    std::string legacy = legacyPayload(data);
+    legacy.pop_back();
+    legacy += ",\"valid\":63,\"fault\":4,\"age\":[0.0,0.7,1.4,2.1,2.8,-1]}";
+
+    char buf[512];
+    size_t length = TelemetrySerializer::serialize(data, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING(legacy.c_str(), buf);
+    TEST_ASSERT_EQUAL(legacy.size(), length);
+}
+
+void test_short_buffer_fails_without_overrun() {
+    SensorData data = typicalSample();
+    char full[512];
+    size_t length = TelemetrySerializer::serialize(data, full, sizeof(full));
+    TEST_ASSERT_GREATER_THAN(0, length);
+
+    char buf[512 + 8];
+    for (size_t size = 0; size <= length; size++) {
+        memset(buf, '#', sizeof(buf));
+        TEST_ASSERT_EQUAL(0, TelemetrySerializer::serialize(data, buf, size));
+        for (size_t i = size; i < sizeof(buf); i++) {
+            TEST_ASSERT_EQUAL('#', buf[i]);
+        }
+    }
+    TEST_ASSERT_EQUAL(length, TelemetrySerializer::serialize(data, buf, length + 1));
+    TEST_ASSERT_EQUAL_STRING(full, buf);
+}
+
+void test_serializer_allocates_nothing_unlike_string_builder() {
+    SensorData data = typicalSample();
+    char buf[512];
+    const int ROUNDS = 5;
+    const int CALLS = 40000;
+
+    uint64_t allocations = HeapStats::allocations();
+    TelemetrySerializer::serialize(data, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(0, HeapStats::allocations() - allocations);
+    allocations = HeapStats::allocations();
+    size_t legacyLength = legacyPayload(data).size();
+    uint64_t legacyAllocations = HeapStats::allocations() - allocations;
+
+    TEST_ASSERT_GREATER_THAN(0, legacyAllocations);
+
+    // Timing is reported, not asserted: a loaded host would make it a race.
+    // Best of interleaved rounds, so a noisy host slows both alike
+    double serializerNs = 1e18;
+    double legacyNs = 1e18;
+    size_t sink = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        serializerNs = fmin(serializerNs, nsPerCall([&]() {
+            sink += TelemetrySerializer::serialize(data, buf, sizeof(buf));
+        }, CALLS));
+        legacyNs = fmin(legacyNs, nsPerCall([&]() { sink += legacyPayload(data).size(); }, CALLS));
+    }
+
+    char report[160];
+    snprintf(report, sizeof(report),
+             "serializer %.0f ns, 0 allocations; string builder %.0f ns, %u allocations (%u B)",
+             serializerNs, legacyNs, (unsigned)legacyAllocations, (unsigned)legacyLength);
+    TEST_MESSAGE(report);
+    TEST_ASSERT_GREATER_THAN(0, sink);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_typical_sample_matches_legacy_payload);
+    RUN_TEST(test_invalid_readings_match_legacy_payload);
+    RUN_TEST(test_rounding_edges_match_dtostrf);
+    RUN_TEST(test_random_floats_match_dtostrf);
+    RUN_TEST(test_serialize_appends_freshness_to_legacy_fields);
+    RUN_TEST(test_short_buffer_fails_without_overrun);
+    RUN_TEST(test_serializer_allocates_nothing_unlike_string_builder);
+    return UNITY_END();
+}
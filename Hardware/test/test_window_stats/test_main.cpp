@@ -0,0 +1,264 @@
+// WindowStats against a two-pass long double reference over the same
+// readings: counts and extremes exact, mean and standard deviation within
+// float rounding, including signals with a large offset and little spread
+// where a single-pass sum of squares falls apart.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <vector>
+
+#include "TelemetrySerializer.h"
+#include "WindowStats.h"
+
+namespace {
+
+struct Reference {
+    uint32_t count;
+    float min;
+    float max;
+    long double mean;
+    long double stddev;
+};
+
+Reference twoPass(const std::vector<float>& values) {
+    Reference ref = {};
+    ref.count = (uint32_t)values.size();
+    if (values.empty()) {
+        return ref;
+    }
+    ref.min = values[0];
+    ref.max = values[0];
+    long double sum = 0;
+    for (float x : values) {
+        sum += x;
+        ref.min = fminf(ref.min, x);
+        ref.max = fmaxf(ref.max, x);
+    }
+    ref.mean = sum / values.size();
+    long double squares = 0;
+    for (float x : values) {
+        squares += (x - ref.mean) * (x - ref.mean);
+    }
+    ref.stddev = values.size() > 1 ? sqrtl(squares / (values.size() - 1)) : 0;
+    return ref;
+}
+
+uint32_t xorshift(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Uniform in [-1, 1]
+float noise(uint32_t& state) {
+    return (float)(xorshift(state) % 2000001) / 1000000.0f - 1.0f;
+}
+
+size_t field(const char* key) {
+    int index = TelemetrySerializer::fieldIndex(key);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, index);
+    return (size_t)index;
+}
+
+SensorData freshSample() {
+    SensorData data = {};
+    data.validMask = (1 << SENSOR_CHANNEL_COUNT) - 1;
+    return data;
+}
+
+// Within float rounding of the reference; absolute for values near zero
+void assertMatches(const Reference& ref, const WindowStats::Summary& s, const char* label) {
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(ref.count, s.count, label);
+    TEST_ASSERT_TRUE_MESSAGE(ref.min == s.min, label);
+    TEST_ASSERT_TRUE_MESSAGE(ref.max == s.max, label);
+    double meanError = fabs((double)(s.mean - ref.mean));
+    double stddevError = fabs((double)(s.stddev - ref.stddev));
+    TEST_ASSERT_TRUE_MESSAGE(meanError <= 1e-6 * fabs((double)ref.mean) + 1e-9, label);
+    TEST_ASSERT_TRUE_MESSAGE(stddevError <= 1e-6 * (double)ref.stddev + 1e-9, label);
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_100k_readings_match_two_pass_reference() {
+    // Each field a different shape: offset and spread as the sensors give them
+    const size_t soilTemp = field("soil_temperature");
+    const size_t moisture = field("soil_moisture");
+    const size_t humidity = field("humidity");
+    const size_t speed = field("target_speed");
+    const size_t pm25 = field("pm25");
+    WindowStats stats;
+    stats.setFields((1UL << soilTemp) | (1UL << moisture) | (1UL << humidity) |
+                    (1UL << speed) | (1UL << pm25));
+
+    std::vector<float> values[SENSOR_FIELD_COUNT];
+    uint32_t state = 0x6A09E667;
+    for (int i = 0; i < 100000; i++) {
+        SensorData data = freshSample();
+        data.soilTemp = 18.0f + 0.05f * noise(state);
+        data.soilMoisture = (uint16_t)(40000 + xorshift(state) % 16);
+        data.humidity = 55.0f + 40.0f * sinf(i * 0.001f) + noise(state);
+        data.speed = 3.0f * noise(state);
+        // Mostly clean air with rare spikes
+        data.pm25 = (i % 997 == 0) ? 900.0f + noise(state) : 4.0f + noise(state);
+        stats.add(data);
+
+        values[soilTemp].push_back(data.soilTemp);
+        values[moisture].push_back(data.soilMoisture);
+        values[humidity].push_back(data.humidity);
+        values[speed].push_back(data.speed);
+        values[pm25].push_back(data.pm25);
+    }
+
+    const size_t CHECKED[] = { soilTemp, moisture, humidity, speed, pm25 };
+    for (size_t f : CHECKED) {
+        assertMatches(twoPass(values[f]), stats.summary(f), TelemetrySerializer::FIELDS[f].key);
+    }
+}
+
+void test_large_offset_small_spread_beats_single_pass_sums() {
+    // 1e4 +- 0.01: the float single-pass variance the naive formula gives
+    // cancels to noise, Welford's stays with the reference
+    const size_t soilTemp = field("soil_temperature");
+    WindowStats stats;
+    stats.setFields(1UL << soilTemp);
+
+    std::vector<float> values;
+    float sum = 0;
+    float sumSquares = 0;
+    uint32_t state = 0xBB67AE85;
+    for (int i = 0; i < 100000; i++) {
+        SensorData data = freshSample();
+        data.soilTemp = 10000.0f + 0.01f * noise(state);
+        stats.add(data);
+        values.push_back(data.soilTemp);
+        sum += data.soilTemp;
+        sumSquares += data.soilTemp * data.soilTemp;
+    }
+
+    Reference ref = twoPass(values);
+    WindowStats::Summary s = stats.summary(soilTemp);
+    assertMatches(ref, s, "soil_temperature");
+    TEST_ASSERT_TRUE(ref.stddev > 0);
+
+    float n = (float)values.size();
+    float naiveVariance = (sumSquares - sum * sum / n) / (n - 1);
+    double naiveError = naiveVariance > 0 ? fabs(sqrt(naiveVariance) - (double)ref.stddev) : INFINITY;
+    double welfordError = fabs((double)(s.stddev - ref.stddev));
+    char report[128];
+    snprintf(report, sizeof(report), "stddev %.6Lf: welford error %.3g, single-pass float error %.3g",
+             ref.stddev, welfordError, naiveError);
+    TEST_MESSAGE(report);
+    TEST_ASSERT_TRUE(welfordError < naiveError);
+}
+
+void test_small_counts_and_constant_signal() {
+    const size_t co2 = field("co2");
+    WindowStats stats;
+    stats.setFields(1UL << co2);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.summary(co2).count);
+
+    SensorData data = freshSample();
+    data.co2 = 415;
+    stats.add(data);
+    WindowStats::Summary one = stats.summary(co2);
+    TEST_ASSERT_EQUAL_UINT32(1, one.count);
+    TEST_ASSERT_TRUE(one.mean == 415.0f && one.min == 415.0f && one.max == 415.0f);
+    TEST_ASSERT_TRUE(one.stddev == 0.0f);
+
+    for (int i = 0; i < 9999; i++) {
+        stats.add(data);
+    }
+    WindowStats::Summary constant = stats.summary(co2);
+    TEST_ASSERT_EQUAL_UINT32(10000, constant.count);
+    TEST_ASSERT_TRUE(constant.mean == 415.0f);
+    TEST_ASSERT_TRUE(constant.stddev == 0.0f);
+}
+
+void test_stale_and_nan_readings_are_skipped() {
+    const size_t airTemp = field("air_temperature");
+    const size_t co2 = field("co2");
+    WindowStats stats;
+    stats.setFields((1UL << airTemp) | (1UL << co2));
+
+    std::vector<float> counted;
+    for (int i = 0; i < 1000; i++) {
+        SensorData data = freshSample();
+        data.airTemp = 20.0f + i * 0.01f;
+        data.co2 = (uint16_t)(400 + i);
+        if (i % 3 == 0) {
+            data.validMask &= ~(1 << SENSOR_DHT);
+        } else if (i % 5 == 0) {
+            data.airTemp = NAN;
+        } else {
+            counted.push_back(data.airTemp);
+        }
+        stats.add(data);
+    }
+    assertMatches(twoPass(counted), stats.summary(airTemp), "air_temperature");
+    // Another channel's staleness does not touch co2
+    TEST_ASSERT_EQUAL_UINT32(1000, stats.summary(co2).count);
+}
+
+void test_reset_and_new_fields_start_empty() {
+    const size_t pm25 = field("pm25");
+    const size_t pm10 = field("pm10");
+    WindowStats stats;
+    stats.setFields(1UL << pm25);
+
+    SensorData data = freshSample();
+    data.pm25 = 100.0f;
+    data.pm10 = 100.0f;
+    stats.add(data);
+    stats.setFields((1UL << pm25) | (1UL << pm10));
+    data.pm25 = 2.0f;
+    data.pm10 = 2.0f;
+    stats.add(data);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.summary(pm25).count);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.summary(pm10).count);
+    TEST_ASSERT_TRUE(stats.summary(pm10).max == 2.0f);
+
+    stats.reset(5000, 1760000000);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.summary(pm25).count);
+    TEST_ASSERT_FALSE(stats.due(5000 + stats.getWindow() - 1));
+    TEST_ASSERT_TRUE(stats.due(5000 + stats.getWindow()));
+}
+
+void test_serialize_lists_selected_fields_with_readings() {
+    const size_t co2 = field("co2");
+    const size_t pm25 = field("pm25");
+    WindowStats stats;
+    stats.setFields((1UL << co2) | (1UL << pm25));
+    stats.reset(0, 1760000000);
+
+    SensorData data = freshSample();
+    data.validMask &= ~(1 << SENSOR_SDS011);
+    data.co2 = 400;
+    stats.add(data);
+    data.co2 = 500;
+    stats.add(data);
+    // pm25 never fresh, so it is left out
+    char buf[256];
+    size_t length = stats.serialize(1760000300, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"start\":1760000000,\"end\":1760000300,\"stats\":{\"co2\":[2,400.00,500.00,450.00,70.711]}}", buf);
+    TEST_ASSERT_EQUAL(strlen(buf), length);
+    TEST_ASSERT_EQUAL(0, stats.serialize(1760000300, buf, length));
+    TEST_ASSERT_EQUAL_UINT32(0, stats.summary(pm25).count);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_100k_readings_match_two_pass_reference);
+    RUN_TEST(test_large_offset_small_spread_beats_single_pass_sums);
+    RUN_TEST(test_small_counts_and_constant_signal);
+    RUN_TEST(test_stale_and_nan_readings_are_skipped);
+    RUN_TEST(test_reset_and_new_fields_start_empty);
+    RUN_TEST(test_serialize_lists_selected_fields_with_readings);
+    return UNITY_END();
+}